@@ -144,6 +144,34 @@ project("SHExtractor")
 	ToolSetup()	
 	files({ "src/tools/SHExtractor.cpp" })
 
+project("MeshOptimizer")
+	ToolSetup()	
+	files({ "src/tools/MeshOptimizer.cpp" })
+
+project("RaycasterBenchmark")
+	ToolSetup()	
+	files({ "src/tools/RaycasterBenchmark.cpp" })
+
+project("MeshKernelsBenchmark")
+	ToolSetup()	
+	files({ "src/tools/MeshKernelsBenchmark.cpp" })
+
+project("TransformsBenchmark")
+	ToolSetup()	
+	files({ "src/tools/TransformsBenchmark.cpp" })
+
+project("DynamicBVHBenchmark")
+	ToolSetup()	
+	files({ "src/tools/DynamicBVHBenchmark.cpp" })
+
+project("TaskSchedulerBenchmark")
+	ToolSetup()	
+	files({ "src/tools/TaskSchedulerBenchmark.cpp" })
+
+project("SceneCompiler")
+	ToolSetup()	
+	files({ "src/tools/SceneCompiler.cpp" })
+
 project("ShaderValidator")
 	ToolSetup()	
 	files({ "src/tools/ShaderValidator.cpp" })
@@ -157,7 +185,7 @@ group("Meta")
 project("ALL")
 	CPPSetup()
 	kind("ConsoleApp")
-	dependson( {"Engine", "PBRDemo", "Playground", "Atmosphere", "ImageViewer", "AtmosphericScatteringEstimator", "BRDFEstimator", "SHExtractor" })
+	dependson( {"Engine", "PBRDemo", "Playground", "Atmosphere", "ImageViewer", "AtmosphericScatteringEstimator", "BRDFEstimator", "SHExtractor", "MeshOptimizer", "RaycasterBenchmark", "MeshKernelsBenchmark", "TransformsBenchmark", "DynamicBVHBenchmark", "TaskSchedulerBenchmark", "SceneCompiler" })
 
 -- Actions
 
@@ -13,7 +13,7 @@ layout(binding = 0) uniform sampler2D albedoTexture; ///< Albedo.
 layout(binding = 1) uniform sampler2D normalTexture; ///< Normal.
 layout(binding = 2) uniform sampler2D depthTexture; ///< Depth.
 layout(binding = 3) uniform sampler2D effectsTexture; ///< Effects.
-layout(binding = 4) uniform sampler2D shadowMap; ///< Shadow map.
+layout(binding = 4) uniform sampler2D shadowMap; ///< Shadow atlas.
 
 uniform vec4 projectionMatrix; ///< Camera projection matrix
 uniform mat4 viewToLight; ///< View to light space matrix.
@@ -21,6 +21,7 @@ uniform mat4 viewToLight; ///< View to light space matrix.
 uniform vec3 lightDirection; ///< Light direction in view space.
 uniform vec3 lightColor; ///< Light intensity.
 uniform bool castShadow; ///< Should the shadow map be used.
+uniform vec4 shadowRegion; ///< Offset and scale of the light region in the shadow atlas.
 
 layout(location = 0) out vec3 fragColor; ///< Color.
 
@@ -44,8 +45,16 @@ vec3 positionFromDepth(float depth){
 */
 float shadow(vec3 lightSpacePosition){
 	float probabilityMax = 1.0;
-	// Read first and second moment from shadow map.
-	vec2 moments = texture(shadowMap, lightSpacePosition.xy).rg;
+	// Outside of the light frustum: no occluder.
+	if(any(lessThan(lightSpacePosition.xy, vec2(0.0))) || any(greaterThan(lightSpacePosition.xy, vec2(1.0)))){
+		return 1.0;
+	}
+	// Read first and second moment from the light region of the shadow atlas.
+	// Stay half a texel inside the region, so that filtering never reads the margin around it.
+	vec2 halfTexel = 0.5 / vec2(textureSize(shadowMap, 0));
+	vec2 regionMin = shadowRegion.xy + halfTexel;
+	vec2 regionMax = shadowRegion.xy + shadowRegion.zw - halfTexel;
+	vec2 moments = texture(shadowMap, clamp(shadowRegion.xy + lightSpacePosition.xy * shadowRegion.zw, regionMin, regionMax)).rg;
 	if(moments.x >= 1.0){
 		// No information in the depthmap: no occluder.
 		return 1.0;
@@ -0,0 +1,105 @@
+#version 330
+
+#define MATERIAL_ID 1 ///< The material ID.
+
+// Input: position in model space.
+in INTERFACE {
+	vec3 position;
+} In ; ///< vec3 position;
+
+layout(binding = 0) uniform sampler2D texture0; ///< Albedo and coverage atlas.
+layout(binding = 1) uniform sampler2D texture1; ///< Model space normal and depth atlas.
+layout(binding = 2) uniform sampler2D texture2; ///< Effects atlas.
+
+uniform mat4 mvp; ///< MVP transformation matrix.
+uniform mat3 normalMatrix; ///< Normal transformation matrix, from model space to view space.
+uniform vec3 viewPos; ///< The viewpoint position in model space.
+uniform vec3 center; ///< The center of the object bounding sphere, in model space.
+uniform float radius; ///< The radius of the object bounding sphere.
+uniform int frames; ///< The number of views along each side of the atlases.
+
+layout (location = 0) out vec4 fragColor; ///< Color.
+layout (location = 1) out vec3 fragNormal; ///< View space normal.
+layout (location = 2) out vec3 fragEffects; ///< Effects.
+
+/** Compute the direction of a view of the hemi-octahedral grid.
+ \param cell the coordinates of the view in the grid
+ \return the direction from the object towards the viewpoint
+ */
+vec3 frameDirection(vec2 cell){
+	vec2 uv = (cell + 0.5) / float(frames) * 2.0 - 1.0;
+	vec2 xz = 0.5 * vec2(uv.x + uv.y, uv.x - uv.y);
+	return normalize(vec3(xz.x, 1.0 - abs(xz.x) - abs(xz.y), xz.y));
+}
+
+/** Intersect the view ray with the plane of a baked view, and accumulate the atlases values at this point.
+ \param cell the coordinates of the view in the grid
+ \param weight the weight of the view
+ \param rayDir the view ray direction, in model space
+ \param albedo will accumulate the albedo and coverage
+ \param normal will accumulate the normal
+ \param effects will accumulate the effects
+ \param position will accumulate the model space position of the surface
+ */
+void accumulateFrame(vec2 cell, float weight, vec3 rayDir, inout vec4 albedo, inout vec3 normal, inout vec3 effects, inout vec3 position){
+	vec3 dir = frameDirection(cell);
+	// Same basis as the orthographic view used when baking.
+	vec3 up0 = abs(dir.y) > 0.999 ? vec3(0.0, 0.0, -1.0) : vec3(0.0, 1.0, 0.0);
+	vec3 right = normalize(cross(-dir, up0));
+	vec3 up = cross(right, -dir);
+	float denom = dot(rayDir, dir);
+	if(abs(denom) < 1e-4){
+		return;
+	}
+	vec3 hit = viewPos + dot(center - viewPos, dir) / denom * rayDir - center;
+	vec2 st = vec2(dot(hit, right), dot(hit, up)) / radius * 0.5 + 0.5;
+	if(any(lessThan(st, vec2(0.0))) || any(greaterThan(st, vec2(1.0)))){
+		return;
+	}
+	// Stay half a texel away from the neighbouring views.
+	float margin = 0.5 * float(frames) / float(textureSize(texture0, 0).x);
+	vec2 uv = (cell + clamp(st, margin, 1.0 - margin)) / float(frames);
+	vec4 color = texture(texture0, uv);
+	vec4 normalDepth = texture(texture1, uv);
+	float coverage = weight * color.a;
+	albedo += vec4(coverage * color.rgb, coverage);
+	normal += coverage * (normalDepth.rgb * 2.0 - 1.0);
+	effects += coverage * texture(texture2, uv).rgb;
+	// Depth is stored from the front to the back of the bounding sphere.
+	position += coverage * (center + hit + dir * radius * (1.0 - 2.0 * normalDepth.a));
+}
+
+/** Blend the four baked views closest to the viewing direction, and output the gbuffer values.
+ */
+void main(){
+	// Viewing direction, restricted to the upper hemisphere.
+	vec3 viewDir = normalize(viewPos - center);
+	viewDir.y = max(viewDir.y, 1e-4);
+	viewDir /= abs(viewDir.x) + abs(viewDir.y) + abs(viewDir.z);
+	vec2 grid = (vec2(viewDir.x + viewDir.z, viewDir.x - viewDir.z) * 0.5 + 0.5) * float(frames) - 0.5;
+	vec2 base = clamp(floor(grid), vec2(0.0), vec2(float(frames - 2)));
+	vec2 f = clamp(grid - base, 0.0, 1.0);
+	
+	vec3 rayDir = normalize(In.position - viewPos);
+	vec4 albedo = vec4(0.0);
+	vec3 normal = vec3(0.0);
+	vec3 effects = vec3(0.0);
+	vec3 position = vec3(0.0);
+	accumulateFrame(base, (1.0 - f.x) * (1.0 - f.y), rayDir, albedo, normal, effects, position);
+	accumulateFrame(base + vec2(1.0, 0.0), f.x * (1.0 - f.y), rayDir, albedo, normal, effects, position);
+	accumulateFrame(base + vec2(0.0, 1.0), (1.0 - f.x) * f.y, rayDir, albedo, normal, effects, position);
+	accumulateFrame(base + vec2(1.0, 1.0), f.x * f.y, rayDir, albedo, normal, effects, position);
+	if(albedo.a < 0.5){
+		discard;
+	}
+	
+	// Store values.
+	fragColor.rgb = albedo.rgb / albedo.a;
+	fragColor.a = float(MATERIAL_ID)/255.0;
+	fragNormal.rgb = normalize(normalMatrix * normal)*0.5+0.5;
+	fragEffects.rgb = effects / albedo.a;
+	
+	// Depth of the reconstructed surface.
+	vec4 clipPos = mvp * vec4(position / albedo.a, 1.0);
+	gl_FragDepth = ((gl_DepthRange.diff * clipPos.z / clipPos.w) + gl_DepthRange.near + gl_DepthRange.far)/2.0;
+}
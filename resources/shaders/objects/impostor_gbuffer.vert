@@ -0,0 +1,24 @@
+#version 330
+
+uniform mat4 mvp; ///< MVP transformation matrix.
+uniform vec3 viewPos; ///< The viewpoint position in model space.
+uniform vec3 center; ///< The center of the object bounding sphere, in model space.
+uniform float radius; ///< The radius of the object bounding sphere.
+
+// Output: position in model space.
+out INTERFACE {
+	vec3 position;
+} Out ; ///< vec3 position;
+
+/** Generate a quad facing the viewpoint and covering the object bounding sphere, from the vertex ID (triangle strip of four vertices).
+ */
+void main(){
+	vec2 corner = vec2(gl_VertexID % 2, gl_VertexID / 2) * 2.0 - 1.0;
+	vec3 dir = normalize(viewPos - center);
+	vec3 up0 = abs(dir.y) > 0.999 ? vec3(0.0, 0.0, -1.0) : vec3(0.0, 1.0, 0.0);
+	vec3 right = normalize(cross(up0, dir));
+	vec3 up = cross(dir, right);
+	// On the plane tangent to the sphere in front of it, the silhouette of the sphere fits in a square of the same radius.
+	Out.position = center + radius * (dir + corner.x * right + corner.y * up);
+	gl_Position = mvp * vec4(Out.position, 1.0);
+}
@@ -6,6 +6,9 @@ layout(location = 0) in vec3 v;///< Position.
 // Uniform: the MVP.
 uniform mat4 mvp; ///< The transformation matrix.
 
+// Also used for depth prepasses, which must match the shading pass depths exactly.
+invariant gl_Position;
+
 /** Apply the MVP transformation to the input vertex. */
 void main(){
 	// We multiply the coordinates by the MVP matrix, and ouput the result.
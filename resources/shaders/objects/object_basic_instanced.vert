@@ -0,0 +1,14 @@
+#version 330
+
+// Attributes
+layout(location = 0) in vec3 v;///< Position.
+layout(location = 3) in mat4 model; ///< Per-instance model transformation, including the positions dequantization.
+
+// Uniform: the view-projection.
+uniform mat4 vp; ///< The transformation matrix.
+
+/** Apply the instance and view-projection transformations to the input vertex. */
+void main(){
+	// We multiply the coordinates by the instance model and the view-projection matrices, and ouput the result.
+	gl_Position = vp * (model * vec4(v, 1.0));
+}
@@ -7,10 +7,11 @@ in INTERFACE {
     mat3 tbn;
 	vec2 uv;
 } In ; ///< mat3 tbn; vec2 uv;
+flat in int materialLayer; ///< Layer of the material in the texture arrays.
 
-layout(binding = 0) uniform sampler2D texture0; ///< Albedo.
-layout(binding = 1) uniform sampler2D texture1; ///< Normal map.
-layout(binding = 2) uniform sampler2D texture2; ///< Effects map.
+layout(binding = 0) uniform sampler2DArray texture0; ///< Albedo.
+layout(binding = 1) uniform sampler2DArray texture1; ///< Normal map.
+layout(binding = 2) uniform sampler2DArray texture2; ///< Effects map.
 
 layout (location = 0) out vec4 fragColor; ///< Color.
 layout (location = 1) out vec3 fragNormal; ///< View space normal.
@@ -21,13 +22,13 @@ layout (location = 2) out vec3 fragEffects; ///< Effects.
 void main(){
 	
 	// Compute the normal at the fragment using the tangent space matrix and the normal read in the normal map.
-	vec3 n = texture(texture1, In.uv).rgb;
+	vec3 n = texture(texture1, vec3(In.uv, materialLayer)).rgb;
 	n = normalize(n * 2.0 - 1.0);
 	
 	// Store values.
-	fragColor.rgb = texture(texture0,  In.uv).rgb;
+	fragColor.rgb = texture(texture0, vec3(In.uv, materialLayer)).rgb;
 	fragColor.a = float(MATERIAL_ID)/255.0;
 	fragNormal.rgb = normalize(In.tbn * n)*0.5+0.5;
-	fragEffects.rgb = texture(texture2, In.uv).rgb;
+	fragEffects.rgb = texture(texture2, vec3(In.uv, materialLayer)).rgb;
 	
 }
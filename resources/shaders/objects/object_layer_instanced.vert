@@ -0,0 +1,14 @@
+#version 330
+
+// Attributes
+layout(location = 0) in vec3 v; ///< Position.
+layout(location = 3) in mat4 model; ///< Per-instance model to world transformation.
+
+out GS_INTERFACE {
+	vec4 pos;
+} Out; ///< vec4 pos;
+
+/** Apply only the instance world transformation to the input vertex. */
+void main(){
+	Out.pos = model * vec4(v,1.0);
+}
@@ -0,0 +1,309 @@
+#version 330
+
+#define INV_M_PI 0.3183098862
+#define M_PI 3.1415926536
+
+// Input: tangent space matrix, position (view space) and uv coming from the vertex shader
+in INTERFACE {
+    mat3 tbn;
+	vec3 tangentSpacePosition;
+	vec3 viewSpacePosition;
+	vec2 uv;
+} In ; ///< mat3 tbn; vec3 tangentSpacePosition; vec3 viewSpacePosition; vec2 uv;
+flat in int materialLayer; ///< Layer of the material in the texture arrays.
+
+layout(binding = 0) uniform sampler2DArray texture0; ///< Albedo.
+layout(binding = 1) uniform sampler2DArray texture1; ///< Normal map.
+layout(binding = 2) uniform sampler2DArray texture2; ///< Effects map.
+layout(binding = 3) uniform sampler2DArray texture3; ///< Local depth map.
+uniform mat4 p; ///< Projection matrix.
+
+#define PARALLAX_MIN 8
+#define PARALLAX_MAX 32
+#define PARALLAX_SCALE 0.04
+
+layout(binding = 4) uniform samplerBuffer lightsData; ///< Clustered lights parameters, four texels per light.
+layout(binding = 5) uniform usamplerBuffer clustersData; ///< Offset and count of the lights list of each cluster.
+layout(binding = 6) uniform usamplerBuffer lightIndices; ///< Lights lists of all clusters.
+layout(binding = 7) uniform samplerCube textureCubeMap; ///< Background environment cubemap (with preconvoluted versions of increasing roughness in mipmap levels).
+layout(binding = 8) uniform sampler2D brdfPrecalc; ///< Preintegrated BRDF lookup table.
+layout(binding = 9) uniform sampler2D shadowMap; ///< Shadow atlas containing the shadow map of the shadowed directional light.
+
+uniform vec2 inverseScreenSize; ///< Size of a pixel in uv space.
+uniform ivec3 clusterGrid; ///< Number of tiles along each axis and of depth slices.
+uniform vec2 clusterSlices; ///< Scale and bias converting the log of a view space distance to a slice index.
+uniform vec3 shCoeffs[9]; ///< SH approximation of the environment irradiance.
+uniform mat4 inverseV; ///< The view to world transformation matrix.
+
+#define MAX_DIRECTIONAL 4
+uniform int directionalCount; ///< Number of directional lights.
+uniform vec3 directionalDirections[MAX_DIRECTIONAL]; ///< Directional lights directions in view space.
+uniform vec3 directionalColors[MAX_DIRECTIONAL]; ///< Directional lights intensities.
+uniform int shadowedDirectional; ///< Index of the directional light using the shadow map, or -1.
+uniform mat4 viewToLight; ///< View to light space matrix of the shadowed directional light.
+uniform vec4 shadowRegion; ///< Offset and scale of the light region in the shadow atlas.
+
+#define MAX_LOD 5
+
+/** Compute the shadow multiplicator based on shadow map.
+	\param lightSpacePosition fragment position in light space
+	\return the shadowing factor
+*/
+float shadow(vec3 lightSpacePosition){
+	float probabilityMax = 1.0;
+	// Outside of the light frustum: no occluder.
+	if(any(lessThan(lightSpacePosition.xy, vec2(0.0))) || any(greaterThan(lightSpacePosition.xy, vec2(1.0)))){
+		return 1.0;
+	}
+	// Read first and second moment from the light region of the shadow atlas.
+	// Stay half a texel inside the region, so that filtering never reads the margin around it.
+	vec2 halfTexel = 0.5 / vec2(textureSize(shadowMap, 0));
+	vec2 regionMin = shadowRegion.xy + halfTexel;
+	vec2 regionMax = shadowRegion.xy + shadowRegion.zw - halfTexel;
+	vec2 moments = texture(shadowMap, clamp(shadowRegion.xy + lightSpacePosition.xy * shadowRegion.zw, regionMin, regionMax)).rg;
+	if(moments.x >= 1.0){
+		// No information in the depthmap: no occluder.
+		return 1.0;
+	}
+	// Initial probability of light.
+	float probability = float(lightSpacePosition.z <= moments.x);
+	// Compute variance.
+	float variance = moments.y - (moments.x * moments.x);
+	variance = max(variance, 0.00001);
+	// Delta of depth.
+	float d = lightSpacePosition.z - moments.x;
+	// Use Chebyshev to estimate bound on probability.
+	probabilityMax = variance / (variance + d*d);
+	probabilityMax = max(probability, probabilityMax);
+	// Limit light bleeding by rescaling and clamping the probability factor.
+	probabilityMax = clamp( (probabilityMax - 0.1) / (1.0 - 0.1), 0.0, 1.0);
+	return probabilityMax;
+}
+
+/** Fresnel approximation.
+	\param F0 fresnel based coefficient
+	\param VdotH angle between the half and view directions
+	\return the Fresnel term
+*/
+vec3 F(vec3 F0, float VdotH){
+	float approx = pow(2.0, (-5.55473 * VdotH - 6.98316) * VdotH);
+	return F0 + approx * (1.0 - F0);
+}
+
+/** GGX Distribution term.
+	\param NdotH angle between the half and normal directions
+	\param alpha the roughness squared
+	\return the distribution term
+*/
+float D(float NdotH, float alpha){
+	float halfDenum = NdotH * NdotH * (alpha * alpha - 1.0) + 1.0;
+	float halfTerm = alpha / max(0.0001, halfDenum);
+	return halfTerm * halfTerm * INV_M_PI;
+}
+
+/** Geometric half-term of GGX BRDF.
+\param NdotX dot product of either the light or the view direction with the surface normal
+\param halfAlpha half squared roughness
+\return the value of the half-term
+*/
+float G1(float NdotX, float halfAlpha){
+	return 1.0 / max(0.0001, (NdotX * (1.0 - halfAlpha) + halfAlpha));
+}
+
+/** Geometric term of GGX BRDF, G.
+\param NdotL dot product of the light direction with the surface normal
+\param NdotV dot product of the view direction with the surface normal
+\param alpha squared roughness
+\return the value of G
+*/
+float G(float NdotL, float NdotV, float alpha){
+	float halfAlpha = alpha * 0.5;
+	return G1(NdotL, halfAlpha)*G1(NdotV, halfAlpha);
+}
+
+/** Evaluate the GGX BRDF for a given normal, view direction and 
+	material parameters.
+	\param n the surface normal
+	\param v the view direction
+	\param l the light direction
+	\param F0 the Fresnel coefficient
+	\param roughness the surface roughness
+	\return the BRDF value
+*/
+vec3 ggx(vec3 n, vec3 v, vec3 l, vec3 F0, float roughness){
+	// Compute half-vector.
+	vec3 h = normalize(v+l);
+	// Compute all needed dot products.
+	float NdotL = clamp(dot(n,l), 0.0, 1.0);
+	float NdotV = clamp(dot(n,v), 0.0, 1.0);
+	float NdotH = clamp(dot(n,h), 0.0, 1.0);
+	float VdotH = clamp(dot(v,h), 0.0, 1.0);
+	float alpha = max(0.0001, roughness*roughness);
+	
+	return D(NdotH, alpha) * G(NdotL, NdotV, alpha) * 0.25 * F(F0, VdotH);
+}
+
+/** Evaluate the ambient irradiance (as SH coefficients) in a given direction. 
+	\param wn the direction (normalized)
+	\return the ambient irradiance
+	*/
+vec3 applySH(vec3 wn){
+	return (shCoeffs[7] * wn.z + shCoeffs[4]  * wn.y + shCoeffs[8]  * wn.x + shCoeffs[3]) * wn.x +
+		   (shCoeffs[5] * wn.z - shCoeffs[8]  * wn.y + shCoeffs[1]) * wn.y +
+		   (shCoeffs[6] * wn.z + shCoeffs[2]) * wn.z +
+		    shCoeffs[0];
+}
+
+/** Compute the contributions of the environment, the directional lights and the point and spot lights of the fragment cluster.
+	\param position the view space position
+	\param n the view space normal
+	\param baseColor the surface albedo
+	\param infos the roughness, metallicness and ambient occlusion
+	\return the outgoing radiance
+*/
+vec3 shade(vec3 position, vec3 n, vec3 baseColor, vec3 infos){
+	float roughness = max(0.045, infos.r);
+	float metallic = infos.g;
+	vec3 v = normalize(-position);
+	
+	// BRDF contributions.
+	// Compute F0 (fresnel coeff).
+	// Dielectrics have a constant low coeff, metals use the baseColor (ie reflections are tinted).
+	vec3 F0 = mix(vec3(0.08), baseColor, metallic);
+	// Normalized diffuse contribution. Metallic materials have no diffuse contribution.
+	vec3 diffuse = INV_M_PI * (1.0 - metallic) * baseColor * (1.0 - F0);
+	
+	// Ambient contribution, using the precomputed AO only.
+	vec3 worldNormal = normalize(vec3(inverseV * vec4(n,0.0)));
+	vec3 r = normalize((inverseV * vec4(-reflect(v,n), 0.0)).xyz);
+	vec2 brdfParams = texture(brdfPrecalc, vec2(max(0.0, dot(v, n)), roughness)).rg;
+	vec3 ambientSpecular = textureLod(textureCubeMap, r, MAX_LOD * roughness).rgb * (brdfParams.x * F0 + brdfParams.y);
+	vec3 color = infos.b * (M_PI * diffuse * applySH(worldNormal) + ambientSpecular);
+	
+	// Directional lights.
+	for(int did = 0; did < directionalCount; ++did){
+		vec3 l = normalize(-directionalDirections[did]);
+		float orientation = max(0.0, dot(l,n));
+		float shadowing = 1.0;
+		if(did == shadowedDirectional){
+			vec3 lightSpacePosition = 0.5*(viewToLight * vec4(position,1.0)).xyz + 0.5;
+			shadowing = shadow(lightSpacePosition);
+		}
+		color += shadowing * orientation * (diffuse + ggx(n, v, l, F0, roughness)) * directionalColors[did] * M_PI;
+	}
+	
+	// Find the cluster containing the fragment.
+	ivec2 tile = clamp(ivec2(gl_FragCoord.xy * inverseScreenSize * vec2(clusterGrid.xy)), ivec2(0), clusterGrid.xy - 1);
+	int slice = clamp(int(log(-position.z) * clusterSlices.x + clusterSlices.y), 0, clusterGrid.z - 1);
+	uvec2 range = texelFetch(clustersData, (slice * clusterGrid.y + tile.y) * clusterGrid.x + tile.x).xy;
+	
+	// Point and spot lights.
+	for(uint i = 0u; i < range.y; ++i){
+		int lid = 4 * int(texelFetch(lightIndices, int(range.x + i)).r);
+		vec4 positionRadius = texelFetch(lightsData, lid);
+		vec4 colorType = texelFetch(lightsData, lid + 1);
+		vec3 deltaPosition = positionRadius.xyz - position;
+		float localRadius2 = dot(deltaPosition, deltaPosition);
+		// Skip if we are outside the sphere of influence.
+		if(localRadius2 > positionRadius.w * positionRadius.w){
+			continue;
+		}
+		vec3 l = deltaPosition / sqrt(localRadius2);
+		// Attenuation with increasing distance to the light.
+		float attenNum = clamp(1.0 - localRadius2 / (positionRadius.w * positionRadius.w), 0.0, 1.0);
+		float attenuation = attenNum * attenNum;
+		if(colorType.w > 0.5){
+			// Spot light: angular attenuation between the inner and outer cone angles.
+			vec4 directionOuter = texelFetch(lightsData, lid + 2);
+			float innerAngleCos = texelFetch(lightsData, lid + 3).x;
+			float currentAngleCos = dot(-l, directionOuter.xyz);
+			attenuation *= clamp((currentAngleCos - directionOuter.w)/(innerAngleCos - directionOuter.w), 0.0, 1.0);
+		}
+		float orientation = max(0.0, dot(l,n));
+		color += attenuation * orientation * (diffuse + ggx(n, v, l, F0, roughness)) * colorType.rgb * M_PI;
+	}
+	return color;
+}
+
+layout (location = 0) out vec3 fragColor; ///< Color.
+
+/**
+	Perform parallax mapping by marching against the local depth map, and output the final UV to use.
+	\param uv the initial texture coordinates
+	\param vTangentDir the view direction in tangent space
+	\param positionShift will contain the final position shift
+	\return the final texture coordinates to use to query the material maps
+*/
+vec2 parallax(vec2 uv, vec3 vTangentDir, out vec2 positionShift){
+
+	// We can adapt the layer count based on the view direction. If we are straight above the surface, we don't need many layers.
+	float layersCount = mix(PARALLAX_MAX, PARALLAX_MIN, abs(vTangentDir.z));
+	// Depth will vary between 0 and 1.
+	float layerHeight = 1.0 / layersCount;
+	float currentLayer = 0.0;
+	// Initial depth at the given position.
+	float currentDepth = texture(texture3, vec3(uv, materialLayer)).r;
+	
+	// Step vector: in tangent space, we walk on the surface, in the (X,Y) plane.
+	vec2 shift = PARALLAX_SCALE * vTangentDir.xy;
+	// This shift corresponds to a UV shift, scaled depending on the height of a layer and the vertical coordinate of the view direction.
+	vec2 shiftUV = shift / vTangentDir.z * layerHeight;
+	vec2 newUV = uv;
+	
+	// While the current layer is above the surface (ie smaller than depth), we march.
+	while (currentLayer < currentDepth) {
+		// We update the UV, going further away from the viewer.
+		newUV -= shiftUV;
+		// Update current depth.
+		currentDepth = texture(texture3, vec3(newUV, materialLayer)).r;
+		// Update current layer.
+		currentLayer += layerHeight;
+	}
+	
+	// Perform interpolation between the current depth layer and the previous one to refine the UV shift.
+	vec2 previousNewUV = newUV + shiftUV;
+	// The local depth is the gap between the current depth and the current depth layer.
+	float currentLocalDepth = currentDepth - currentLayer;
+	float previousLocalDepth = texture(texture3, vec3(previousNewUV, materialLayer)).r - (currentLayer - layerHeight);
+	
+	
+	// Interpolate between the two local depths to obtain the correct UV shift.
+	vec2 finalUV = mix(newUV,previousNewUV,currentLocalDepth / (currentLocalDepth - previousLocalDepth));
+	positionShift = (uv - finalUV) * vTangentDir.z / layerHeight;
+	return finalUV;
+}
+
+/** Shade the object with the environment and all lights affecting its cluster, in a single pass. Apply parallax mapping effect. */
+void main(){
+
+	vec2 localUV = In.uv;
+	vec2 positionShift;
+	
+	// Compute the new uvs, and use them for the remaining steps.
+	vec3 vTangentDir = normalize(- In.tangentSpacePosition);
+	localUV = parallax(localUV, vTangentDir, positionShift);
+	// If UV are outside the texture ([0,1]), we discard the fragment.
+	if(localUV.x > 1.0 || localUV.y  > 1.0 || localUV.x < 0.0 || localUV.y < 0.0){
+		discard;
+	}
+	
+	// Compute the normal at the fragment using the tangent space matrix and the normal read in the normal map.
+	vec3 n = texture(texture1, vec3(localUV, materialLayer)).rgb;
+	n = normalize(In.tbn * normalize(n * 2.0 - 1.0));
+	
+	// Read the depth.
+	float localDepth = texture(texture3, vec3(localUV, materialLayer)).r;
+	// Convert the 3D shift applied from tangent space to view space.
+	vec3 shift = In.tbn * vec3(positionShift.xy, -PARALLAX_SCALE * localDepth);
+	// Update the depth in view space.
+	vec3 newViewSpacePosition = In.viewSpacePosition - vec3(0.0,0.0, shift.z);
+	// Back to clip space.
+	vec4 clipPos = p * vec4(newViewSpacePosition,1.0);
+	// Perpsective division.
+	float newDepth = clipPos.z / clipPos.w;
+	// Update the fragment depth, taking into account the depth range parameters.
+	gl_FragDepth = ((gl_DepthRange.diff * newDepth) + gl_DepthRange.near + gl_DepthRange.far)/2.0;
+	
+	fragColor = shade(newViewSpacePosition, n, texture(texture0, vec3(localUV, materialLayer)).rgb, texture(texture2, vec3(localUV, materialLayer)).rgb);
+
+}
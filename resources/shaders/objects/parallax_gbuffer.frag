@@ -9,11 +9,12 @@ in INTERFACE {
 	vec3 viewSpacePosition;
 	vec2 uv;
 } In ; ///< mat3 tbn; vec3 tangentSpacePosition; vec3 viewSpacePosition; vec2 uv;
+flat in int materialLayer; ///< Layer of the material in the texture arrays.
 
-layout(binding = 0) uniform sampler2D texture0; ///< Albedo.
-layout(binding = 1) uniform sampler2D texture1; ///< Normal map.
-layout(binding = 2) uniform sampler2D texture2; ///< Effects map.
-layout(binding = 3) uniform sampler2D texture3; ///< Local depth map.
+layout(binding = 0) uniform sampler2DArray texture0; ///< Albedo.
+layout(binding = 1) uniform sampler2DArray texture1; ///< Normal map.
+layout(binding = 2) uniform sampler2DArray texture2; ///< Effects map.
+layout(binding = 3) uniform sampler2DArray texture3; ///< Local depth map.
 uniform mat4 p; ///< Projection matrix.
 
 #define PARALLAX_MIN 8
@@ -40,7 +41,7 @@ vec2 parallax(vec2 uv, vec3 vTangentDir, out vec2 positionShift){
 	float layerHeight = 1.0 / layersCount;
 	float currentLayer = 0.0;
 	// Initial depth at the given position.
-	float currentDepth = texture(texture3, uv).r;
+	float currentDepth = texture(texture3, vec3(uv, materialLayer)).r;
 	
 	// Step vector: in tangent space, we walk on the surface, in the (X,Y) plane.
 	vec2 shift = PARALLAX_SCALE * vTangentDir.xy;
@@ -53,7 +54,7 @@ vec2 parallax(vec2 uv, vec3 vTangentDir, out vec2 positionShift){
 		// We update the UV, going further away from the viewer.
 		newUV -= shiftUV;
 		// Update current depth.
-		currentDepth = texture(texture3,newUV).r;
+		currentDepth = texture(texture3, vec3(newUV, materialLayer)).r;
 		// Update current layer.
 		currentLayer += layerHeight;
 	}
@@ -62,7 +63,7 @@ vec2 parallax(vec2 uv, vec3 vTangentDir, out vec2 positionShift){
 	vec2 previousNewUV = newUV + shiftUV;
 	// The local depth is the gap between the current depth and the current depth layer.
 	float currentLocalDepth = currentDepth - currentLayer;
-	float previousLocalDepth = texture(texture3,previousNewUV).r - (currentLayer - layerHeight);
+	float previousLocalDepth = texture(texture3, vec3(previousNewUV, materialLayer)).r - (currentLayer - layerHeight);
 	
 	
 	// Interpolate between the two local depths to obtain the correct UV shift.
@@ -87,20 +88,20 @@ void main(){
 	}
 	
 	// Compute the normal at the fragment using the tangent space matrix and the normal read in the normal map.
-	vec3 n = texture(texture1,localUV).rgb;
+	vec3 n = texture(texture1, vec3(localUV, materialLayer)).rgb;
 	n = normalize(n * 2.0 - 1.0);
 	
 	// Store values.
-	fragColor.rgb = texture(texture0, localUV).rgb;
+	fragColor.rgb = texture(texture0, vec3(localUV, materialLayer)).rgb;
 	fragColor.a = float(MATERIAL_ID)/255.0;
 	fragNormal.rgb = normalize(In.tbn * n)*0.5+0.5;
-	fragEffects.rgb = texture(texture2,localUV).rgb;
+	fragEffects.rgb = texture(texture2, vec3(localUV, materialLayer)).rgb;
 	
 	// Store depth manually (see below).
 	gl_FragDepth = gl_FragCoord.z;
 	// Update the depth using the heightmap and the displacement applied.
 	// Read the depth.
-	float localDepth = texture(texture3,localUV).r;
+	float localDepth = texture(texture3, vec3(localUV, materialLayer)).r;
 	// Convert the 3D shift applied from tangent space to view space.
 	vec3 shift = In.tbn * vec3(positionShift.xy, -PARALLAX_SCALE * localDepth);
 	// Update the depth in view space.
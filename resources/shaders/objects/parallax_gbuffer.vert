@@ -2,14 +2,16 @@
 
 // Attributes
 layout(location = 0) in vec3 v; ///< Position.
-layout(location = 1) in vec3 n; ///< Normal.
+layout(location = 1) in ivec4 frame; ///< Octahedral normal (xy) and tangent (zw), bitangent sign in the lowest bit of w.
 layout(location = 2) in vec2 uv; ///< Texture coordinates.
-layout(location = 3) in vec3 tang; ///< Tangent.
-layout(location = 4) in vec3 binor; ///< Binormal.
 
 uniform mat4 mvp; ///< MVP transformation matrix.
 uniform mat4 mv; ///< MV transformation matrix.
 uniform mat3 normalMatrix; ///< Normal transformation matrix.
+uniform int material; ///< Layer of the object material in the texture arrays.
+
+// Tested against the depth prepass, the position must be computed identically.
+invariant gl_Position;
 
 // Output: tangent space matrix, position in view space and uv.
 out INTERFACE {
@@ -18,6 +20,19 @@ out INTERFACE {
 	vec3 viewSpacePosition;
 	vec2 uv;
 } Out ; ///< mat3 tbn; vec3 tangentSpacePosition; vec3 viewSpacePosition; vec2 uv;
+flat out int materialLayer; ///< Layer of the material in the texture arrays.
+
+/** Decode a unit vector from its octahedral representation.
+ \param p the coordinates on the unfolded octahedron, in [-1,1]^2
+ \return the unit vector
+ */
+vec3 decodeOctahedral(vec2 p){
+	vec3 n = vec3(p, 1.0 - abs(p.x) - abs(p.y));
+	if(n.z < 0.0){
+		n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	}
+	return normalize(n);
+}
 
 /** Apply the transformation to the input vertex.
  Compute the tangent-to-view space transformation matrix.
@@ -28,11 +43,17 @@ void main(){
 	gl_Position = mvp * vec4(v, 1.0);
 
 	Out.uv = uv;
+	materialLayer = material;
+
+	// Decode the tangent frame.
+	vec3 n = decodeOctahedral(vec2(frame.xy) / 32767.0);
+	vec3 tang = decodeOctahedral(vec2(float(frame.z) / 32767.0, float(frame.w >> 1) / 16383.0));
+	float bitangentSign = (frame.w & 1) == 1 ? -1.0 : 1.0;
 
 	// Compute the TBN matrix (from tangent space to view space).
 	vec3 T = normalize(normalMatrix * tang);
-	vec3 B = normalize(normalMatrix * binor);
 	vec3 N = normalize(normalMatrix * n);
+	vec3 B = bitangentSign * cross(N, T);
 	Out.tbn = mat3(T, B, N);
 	
 	Out.viewSpacePosition = (mv * vec4(v,1.0)).xyz;
@@ -4,6 +4,7 @@
 #include "input/InputCallbacks.hpp"
 #include "input/ControllableCamera.hpp"
 #include "helpers/InterfaceUtilities.hpp"
+#include "helpers/RenderThread.hpp"
 #include "resources/ResourcesManager.hpp"
 #include "graphics/ScreenQuad.hpp"
 #include "Config.hpp"
@@ -45,7 +46,7 @@ int main(int argc, char** argv) {
 	Log::Info() << Log::OpenGL << "Internal renderer: " << rendererString << "." << std::endl;
 	Log::Info() << Log::OpenGL << "Version supported: " << versionString << "." << std::endl;
 	
-	glEnable(GL_DEPTH_TEST);
+	GLUtilities::setEnabled(GL_DEPTH_TEST, true);
 	
 	// Setup the timer.
 	double timer = glfwGetTime();
@@ -78,6 +79,46 @@ int main(int argc, char** argv) {
 	unsigned int currentTiming = 0;
 	double smoothedFrameTime = 0.0;
 	
+	/// \brief State read by the rendering of a frame.
+	struct FrameState {
+		glm::mat4 clipToWorld = glm::mat4(1.0f); ///< Clip space to world space transformation, without translation.
+		glm::vec3 viewPos = glm::vec3(0.0f); ///< Camera position.
+		glm::vec3 lightDirection = glm::vec3(0.0f, 1.0f, 0.0f); ///< Sun direction.
+		glm::vec2 screenSize = glm::vec2(1.0f); ///< Window size.
+		bool resized = false; ///< Has the window been resized.
+	};
+	// The state prepared by the main loop, and the state of the frame being rendered.
+	FrameState preparedFrame;
+	FrameState renderedFrame;
+	
+	// Frames are rendered with the state handed over by the main loop, optionally on a dedicated thread.
+	RenderThread renderThread(window, config.renderThread, [&](){
+		if(renderedFrame.resized){
+			atmosphereFramebuffer->resize(renderedFrame.screenSize);
+		}
+		
+		// Draw the atmosphere.
+		GLUtilities::setEnabled(GL_DEPTH_TEST, false);
+		atmosphereFramebuffer->bind();
+		atmosphereFramebuffer->setViewport();
+		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+		
+		GLUtilities::useProgram(atmosphereProgram->id());
+		glUniformMatrix4fv(atmosphereProgram->uniform("clipToWorld"), 1, GL_FALSE, &renderedFrame.clipToWorld[0][0]);
+		glUniform3fv(atmosphereProgram->uniform("viewPos"), 1, &renderedFrame.viewPos[0]);
+		glUniform3fv(atmosphereProgram->uniform("lightDirection"), 1, &renderedFrame.lightDirection[0]);
+		ScreenQuad::draw(precomputedScattering);
+		atmosphereFramebuffer->unbind();
+		
+		// Tonemapping and final screen.
+		GLUtilities::setViewport(0, 0, (GLsizei)renderedFrame.screenSize[0], (GLsizei)renderedFrame.screenSize[1]);
+		GLUtilities::setEnabled(GL_FRAMEBUFFER_SRGB, true);
+		GLUtilities::useProgram(tonemapProgram->id());
+		ScreenQuad::draw(atmosphereFramebuffer->textureId());
+		GLUtilities::setEnabled(GL_FRAMEBUFFER_SRGB, false);
+	});
+	
 	// Start the display/interaction loop.
 	while (!glfwWindowShouldClose(window)) {
 		// Update events (inputs,...).
@@ -90,7 +131,9 @@ int main(int argc, char** argv) {
 		Interface::beginFrame();
 		// Reload resources.
 		if(Input::manager().triggered(Input::KeyP)){
-			Resources::manager().reload();
+			renderThread.run([](){
+				Resources::manager().reload();
+			});
 		}
 		
 		// Compute the time elapsed since last frame
@@ -121,49 +164,33 @@ int main(int argc, char** argv) {
 			fullTime += deltaTime;
 			remainingTime -= deltaTime;
 		}
-		// Handle resizing directly.
-		const glm::vec2 screenSize = Input::manager().size();
-		if(Input::manager().resized()){
-			atmosphereFramebuffer->resize(screenSize);
+		// Resizing is handled by the rendering.
+		preparedFrame.screenSize = Input::manager().size();
+		preparedFrame.resized = preparedFrame.resized || Input::manager().resized();
+		
+		// Settings.
+		if(ImGui::DragFloat3("Light dir", &lightDirection[0], 0.05f, -1.0f, 1.0f)){
+			lightDirection = glm::normalize(lightDirection);
 		}
 		
-		// Render.
+		// Prepare the frame.
 		const glm::mat4 camToWorld = glm::inverse(camera.view());
 		const glm::mat4 clipToCam = glm::inverse(camera.projection());
-		
-		// Draw the atmosphere.
-		glDisable(GL_DEPTH_TEST);
-		atmosphereFramebuffer->bind();
-		atmosphereFramebuffer->setViewport();
-		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT);
-		
-		glUseProgram(atmosphereProgram->id());
 		const glm::mat4 camToWorldNoT = glm::mat4(glm::mat3(camToWorld));
-		const glm::mat4 clipToWorld = camToWorldNoT * clipToCam;
-		glUniformMatrix4fv(atmosphereProgram->uniform("clipToWorld"), 1, GL_FALSE, &clipToWorld[0][0]);
-		glUniform3fv(atmosphereProgram->uniform("viewPos"), 1, &camera.position()[0]);
-		glUniform3fv(atmosphereProgram->uniform("lightDirection"), 1, &lightDirection[0]);
-		ScreenQuad::draw(precomputedScattering);
-		atmosphereFramebuffer->unbind();
-		
-		// Tonemapping and final screen.
-		glViewport(0, 0, (GLsizei)screenSize[0], (GLsizei)screenSize[1]);
-		glEnable(GL_FRAMEBUFFER_SRGB);
-		glUseProgram(tonemapProgram->id());
-		ScreenQuad::draw(atmosphereFramebuffer->textureId());
-		glDisable(GL_FRAMEBUFFER_SRGB);
+		preparedFrame.clipToWorld = camToWorldNoT * clipToCam;
+		preparedFrame.viewPos = camera.position();
+		preparedFrame.lightDirection = lightDirection;
 		
-		// Settings.
-		if(ImGui::DragFloat3("Light dir", &lightDirection[0], 0.05f, -1.0f, 1.0f)){
-			lightDirection = glm::normalize(lightDirection);
-		}
-		// Then render the interface.
-		Interface::endFrame();
-		//Display the result for the current rendering loop.
-		glfwSwapBuffers(window);
+		// Once the previous frame is rendered, hand the state of this one over.
+		renderThread.wait();
+		renderedFrame = preparedFrame;
+		preparedFrame.resized = false;
+		// Render the atmosphere and the interface, then display the result.
+		renderThread.submit();
 		
 	}
+	// Bring the GL context back to the main thread.
+	renderThread.stop();
 	
 	// Cleaning.
 	atmosphereFramebuffer->clean();
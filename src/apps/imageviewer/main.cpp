@@ -4,6 +4,7 @@
 #include "input/InputCallbacks.hpp"
 #include "input/ControllableCamera.hpp"
 #include "helpers/InterfaceUtilities.hpp"
+#include "helpers/RenderThread.hpp"
 #include "resources/ResourcesManager.hpp"
 #include "graphics/ScreenQuad.hpp"
 #include "graphics/GLUtilities.hpp"
@@ -39,7 +40,7 @@ int main(int argc, char** argv) {
 	// Initialize random generator;
 	Random::seed();
 	
-	glEnable(GL_CULL_FACE);
+	GLUtilities::setEnabled(GL_CULL_FACE, true);
 	
 	// Create the rendering program.
 	std::shared_ptr<ProgramInfos> program = Resources::manager().getProgram("image_display");
@@ -67,6 +68,78 @@ int main(int argc, char** argv) {
 	glm::vec2 mousePrev = glm::vec2(0.0f,0.0f);
 	glm::vec3 fgColor(0.6f);
 	
+	/// \brief State read by the rendering of a frame.
+	struct FrameState {
+		TextureInfos image; ///< The displayed image.
+		glm::vec3 bgColor = glm::vec3(0.6f); ///< Background color.
+		float exposure = 1.0f; ///< Exposure of HDR images.
+		bool applyGamma = true; ///< Apply gamma correction.
+		glm::bvec4 channelsFilter = glm::bvec4(true); ///< Displayed channels.
+		glm::bvec2 flipAxis = glm::bvec2(false); ///< Mirroring along each axis.
+		int angle = 0; ///< Rotation, in quarter turns.
+		float pixelScale = 1.0f; ///< Zoom level.
+		glm::vec2 mouseShift = glm::vec2(0.0f); ///< Image translation.
+		glm::vec2 screenSize = glm::vec2(1.0f); ///< Window size.
+		glm::vec2 readPosition = glm::vec2(0.0f); ///< Position of the pixel to read back, in pixels.
+		bool readColor = false; ///< Should the color under the cursor be read back.
+	};
+	// The state prepared by the main loop, and the state of the frame being rendered.
+	FrameState preparedFrame;
+	FrameState renderedFrame;
+	// Color read back by the rendering.
+	glm::vec3 readColor(0.0f);
+	bool hasReadColor = false;
+	
+	// Frames are rendered with the state handed over by the main loop, optionally on a dedicated thread.
+	RenderThread renderThread(window, config.renderThread, [&](){
+		const FrameState & frame = renderedFrame;
+		GLUtilities::setViewport(0, 0, (GLsizei)frame.screenSize[0], (GLsizei)frame.screenSize[1]);
+		// Render the background.
+		glClearColor(frame.bgColor[0], frame.bgColor[1], frame.bgColor[2], 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		
+		// Render the image if non empty.
+		if(frame.image.width == 0 || frame.image.height == 0){
+			return;
+		}
+		const bool isHorizontal = frame.angle == 1 || frame.angle == 3;
+		// Depending on the current rotation, the horizontal dimension of the image is the width or the height.
+		const unsigned int widthIndex = isHorizontal ? 1 : 0;
+		// Compute image and screen infos.
+		const glm::vec2 imageSize(frame.image.width, frame.image.height);
+		float screenRatio = std::max(frame.screenSize[1], 1.0f) / std::max(frame.screenSize[0], 1.0f);
+		float imageRatio = imageSize[1-widthIndex] / imageSize[widthIndex];
+		float widthRatio = frame.screenSize[0] / imageSize[0] * imageSize[widthIndex] / imageSize[0];
+		
+		GLUtilities::setEnabled(GL_BLEND, true);
+		
+		// Render the image.
+		GLUtilities::useProgram(program->id());
+		// Pass settings.
+		glUniform1f(program->uniform("screenRatio"), screenRatio);
+		glUniform1f(program->uniform("imageRatio"), imageRatio);
+		glUniform1f(program->uniform("widthRatio"), widthRatio);
+		glUniform1i(program->uniform("isHDR"), frame.image.hdr);
+		glUniform1f(program->uniform("exposure"), frame.exposure);
+		glUniform1i(program->uniform("gammaOutput"), frame.applyGamma);
+		glUniform4f(program->uniform("channelsFilter"), frame.channelsFilter[0], frame.channelsFilter[1], frame.channelsFilter[2], frame.channelsFilter[3]);
+		glUniform2f(program->uniform("flipAxis"), frame.flipAxis[0], frame.flipAxis[1]);
+		glUniform2f(program->uniform("angleTrig"), std::cos(frame.angle*M_PI_2), std::sin(frame.angle*M_PI_2));
+		glUniform1f(program->uniform("pixelScale"), frame.pixelScale);
+		glUniform2fv(program->uniform("mouseShift"), 1, &frame.mouseShift[0]);
+		
+		// Draw.
+		ScreenQuad::draw(frame.image.id);
+		
+		GLUtilities::setEnabled(GL_BLEND, false);
+		
+		// Read back color under cursor when right-clicking.
+		if(frame.readColor){
+			glReadPixels(int(frame.readPosition.x), int(frame.readPosition.y), 1, 1, GL_RGB, GL_FLOAT, &readColor[0]);
+			hasReadColor = true;
+		}
+	});
+	
 	// Start the display/interaction loop.
 	while (!glfwWindowShouldClose(window)) {
 		// Update events (inputs,...).
@@ -79,7 +152,9 @@ int main(int argc, char** argv) {
 		Interface::beginFrame();
 		// Reload resources.
 		if(Input::manager().triggered(Input::KeyP)){
-			Resources::manager().reload();
+			renderThread.run([](){
+				Resources::manager().reload();
+			});
 		}
 		
 		// Update scale and position.
@@ -96,54 +171,14 @@ int main(int argc, char** argv) {
 			mousePrev = mouseNew;
 		}
 		
-		// Screen infos.
-		const glm::vec2 screenSize = Input::manager().size();
-		glViewport(0, 0, (GLsizei)screenSize[0], (GLsizei)screenSize[1]);
-		// Render the background.
-		glClearColor(bgColor[0], bgColor[1], bgColor[2], 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		
-		// Render the image if non empty.
+		// The image is rendered if non empty.
 		bool hasImage = imageInfos.width > 0 && imageInfos.height > 0;
 		const bool isHorizontal = currentAngle == 1 || currentAngle == 3;
 		
-		if(hasImage){
-			// Depending on the current rotation, the horizontal dimension of the image is the width or the height.
-			const unsigned int widthIndex = isHorizontal ? 1 : 0;
-			// Compute image and screen infos.
-			const glm::vec2 imageSize(imageInfos.width, imageInfos.height);
-			float screenRatio = std::max(screenSize[1], 1.0f) / std::max(screenSize[0], 1.0f);
-			float imageRatio = imageSize[1-widthIndex] / imageSize[widthIndex];
-			float widthRatio = screenSize[0] / imageSize[0] * imageSize[widthIndex] / imageSize[0];
-			
-			glEnable(GL_BLEND);
-			
-			// Render the image.
-			glUseProgram(program->id());
-			// Pass settings.
-			glUniform1f(program->uniform("screenRatio"), screenRatio);
-			glUniform1f(program->uniform("imageRatio"), imageRatio);
-			glUniform1f(program->uniform("widthRatio"), widthRatio);
-			glUniform1i(program->uniform("isHDR"), imageInfos.hdr);
-			glUniform1f(program->uniform("exposure"), exposure);
-			glUniform1i(program->uniform("gammaOutput"), applyGamma);
-			glUniform4f(program->uniform("channelsFilter"), channelsFilter[0], channelsFilter[1], channelsFilter[2], channelsFilter[3]);
-			glUniform2f(program->uniform("flipAxis"), flipAxis[0], flipAxis[1]);
-			glUniform2f(program->uniform("angleTrig"), std::cos(currentAngle*M_PI_2), std::sin(currentAngle*M_PI_2));
-			glUniform1f(program->uniform("pixelScale"), pixelScale);
-			glUniform2fv(program->uniform("mouseShift"), 1, &mouseShift[0]);
-			
-			// Draw.
-			ScreenQuad::draw(imageInfos.id);
-			
-			glDisable(GL_BLEND);
-
-			// Read back color under cursor when right-clicking.
-			if(Input::manager().pressed(Input::MouseRight)){
-				const glm::vec2 mousePosition = Input::manager().mouse(true);
-				glReadPixels(int(mousePosition.x), int(mousePosition.y), 1, 1, GL_RGB, GL_FLOAT, &fgColor[0]);
-			}
-		
+		// Read back color under cursor when right-clicking.
+		preparedFrame.readColor = hasImage && Input::manager().pressed(Input::MouseRight);
+		if(preparedFrame.readColor){
+			preparedFrame.readPosition = Input::manager().mouse(true);
 		}
 		
 		// Interface.
@@ -164,14 +199,16 @@ int main(int argc, char** argv) {
 				bool res = Interface::showPicker(Interface::Load, "../../../resources", newImagePath, "jpg,bmp,png,tga;exr");
 				// If user picked a path, load the texture from disk.
 				if(res && !newImagePath.empty()){
-					Log::Info() << "Loading " << newImagePath << "." << std::endl;
-					imageInfos = GLUtilities::loadTexture({newImagePath}, true);
-					// Apply the proper filtering.
-					const GLenum filteringSetting = (imageInterp == Nearest) ? GL_NEAREST : GL_LINEAR;
-					glBindTexture(GL_TEXTURE_2D, imageInfos.id);
-					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filteringSetting);
-					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filteringSetting);
-					glBindTexture(GL_TEXTURE_2D, 0);
+					renderThread.run([&](){
+						Log::Info() << "Loading " << newImagePath << "." << std::endl;
+						imageInfos = GLUtilities::loadTexture({newImagePath}, true);
+						// Apply the proper filtering.
+						const GLenum filteringSetting = (imageInterp == Nearest) ? GL_NEAREST : GL_LINEAR;
+						GLUtilities::bindTexture(0, GL_TEXTURE_2D, imageInfos.id);
+						glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filteringSetting);
+						glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filteringSetting);
+						GLUtilities::bindTexture(0, GL_TEXTURE_2D, 0);
+					});
 					// Reset display settings.
 					pixelScale = 1.0f;
 					mouseShift = glm::vec2(0.0f);
@@ -201,11 +238,13 @@ int main(int argc, char** argv) {
 			
 			// Filtering.
 			if(ImGui::Combo("Filtering", (int*)(&imageInterp), "Nearest\0Linear\0\0")){
-				const GLenum filteringSetting = (imageInterp == Nearest) ? GL_NEAREST : GL_LINEAR;
-				glBindTexture(GL_TEXTURE_2D, imageInfos.id);
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filteringSetting);
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filteringSetting);
-				glBindTexture(GL_TEXTURE_2D, 0);
+				renderThread.run([&](){
+					const GLenum filteringSetting = (imageInterp == Nearest) ? GL_NEAREST : GL_LINEAR;
+					GLUtilities::bindTexture(0, GL_TEXTURE_2D, imageInfos.id);
+					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filteringSetting);
+					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filteringSetting);
+					GLUtilities::bindTexture(0, GL_TEXTURE_2D, 0);
+				});
 			}
 			
 			// Image modifications.
@@ -248,42 +287,63 @@ int main(int argc, char** argv) {
 				// Export either in LDR or HDR.
 				bool res = Interface::showPicker(Interface::Save, "../../../resources", destinationPath, "png;exr");
 				if(res && !destinationPath.empty()){
-					const GLenum typedFormat = ImageUtilities::isHDR(destinationPath) ? GL_RGBA32F : GL_RGBA8;
-					// Create a framebuffer at the right size and format, and render in it.
-					const unsigned int outputWidth = isHorizontal ? imageInfos.height : imageInfos.width;
-					const unsigned int outputHeight = isHorizontal ? imageInfos.width : imageInfos.height;
-					std::shared_ptr<Framebuffer> framebuffer = std::make_shared<Framebuffer>(outputWidth, outputHeight, typedFormat, false);
-					framebuffer->bind();
-					framebuffer->setViewport();
+					renderThread.run([&](){
+						const GLenum typedFormat = ImageUtilities::isHDR(destinationPath) ? GL_RGBA32F : GL_RGBA8;
+						// Create a framebuffer at the right size and format, and render in it.
+						const unsigned int outputWidth = isHorizontal ? imageInfos.height : imageInfos.width;
+						const unsigned int outputHeight = isHorizontal ? imageInfos.width : imageInfos.height;
+						std::shared_ptr<Framebuffer> framebuffer = std::make_shared<Framebuffer>(outputWidth, outputHeight, typedFormat, false);
+						framebuffer->bind();
+						framebuffer->setViewport();
 					
-					// Render the image in it.
-					glEnable(GL_BLEND);
-					glUseProgram(program->id());
-					// No scaling or translation.
-					glUniform1f(program->uniform("screenRatio"), 1.0f);
-					glUniform1f(program->uniform("imageRatio"), 1.0f);
-					glUniform1f(program->uniform("widthRatio"), 1.0f);
-					glUniform1f(program->uniform("pixelScale"), 1.0f);
-					glUniform2f(program->uniform("mouseShift"), 0.0f, 0.0f);
-					ScreenQuad::draw(imageInfos.id);
-					glDisable(GL_BLEND);
+						// Render the image in it.
+						GLUtilities::setEnabled(GL_BLEND, true);
+						GLUtilities::useProgram(program->id());
+						// No scaling or translation.
+						glUniform1f(program->uniform("screenRatio"), 1.0f);
+						glUniform1f(program->uniform("imageRatio"), 1.0f);
+						glUniform1f(program->uniform("widthRatio"), 1.0f);
+						glUniform1f(program->uniform("pixelScale"), 1.0f);
+						glUniform2f(program->uniform("mouseShift"), 0.0f, 0.0f);
+						ScreenQuad::draw(imageInfos.id);
+						GLUtilities::setEnabled(GL_BLEND, false);
 					
-					framebuffer->unbind();
+						framebuffer->unbind();
 					
-					// Then save it to the given path.
-					GLUtilities::saveFramebuffer(framebuffer, outputWidth, outputHeight, destinationPath.substr(0, destinationPath.size()-4), true, false);
+						// Then save it to the given path.
+						GLUtilities::saveFramebuffer(framebuffer, outputWidth, outputHeight, destinationPath.substr(0, destinationPath.size()-4), true, false);
+					});
 				}
 			}
 			
 		}
 		ImGui::End();
 		
-		// Then render the interface.
-		Interface::endFrame();
-		//Display the result for the current rendering loop.
-		glfwSwapBuffers(window);
+		// Prepare the frame.
+		preparedFrame.image = imageInfos;
+		preparedFrame.bgColor = bgColor;
+		preparedFrame.exposure = exposure;
+		preparedFrame.applyGamma = applyGamma;
+		preparedFrame.channelsFilter = channelsFilter;
+		preparedFrame.flipAxis = flipAxis;
+		preparedFrame.angle = currentAngle;
+		preparedFrame.pixelScale = pixelScale;
+		preparedFrame.mouseShift = mouseShift;
+		preparedFrame.screenSize = Input::manager().size();
+		
+		// Once the previous frame is rendered, hand the state of this one over, and get the color read back.
+		renderThread.wait();
+		if(hasReadColor){
+			fgColor = readColor;
+			hasReadColor = false;
+		}
+		renderedFrame = preparedFrame;
+		// Render the image and the interface, then display the result.
+		renderThread.submit();
 
 	}
+	// Bring the GL context back to the main thread.
+	renderThread.stop();
 	
 	// Clean the interface.
 	Interface::clean();
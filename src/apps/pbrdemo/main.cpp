@@ -1,11 +1,17 @@
 #include "Common.hpp"
 #include "helpers/GenerationUtilities.hpp"
+#include "helpers/TaskScheduler.hpp"
 #include "input/Input.hpp"
 #include "input/InputCallbacks.hpp"
 #include "renderers/deferred/DeferredRenderer.hpp"
+#include "renderers/forward/ForwardPlusRenderer.hpp"
 #include "renderers/utils/RendererCube.hpp"
 #include "helpers/InterfaceUtilities.hpp"
+#include "helpers/RenderThread.hpp"
+#include "raycaster/Raycaster.hpp"
 #include "scenes/Scenes.hpp"
+#include "Impostor.hpp"
+#include "SceneSimulation.hpp"
 
 /**
  \defgroup PBRDemo Physically-based rendering demo
@@ -17,6 +23,7 @@
  \see GLSL::Frag::Point_light
  \see GLSL::Frag::Directional_light
  \see GLSL::Frag::Spot_light
+ \see GLSL::Frag::Object_forward
  \ingroup Applications
  */
 
@@ -35,6 +42,7 @@ int main(int argc, char** argv) {
 		Log::setDefaultFile(config.logPath);
 	}
 	Log::setDefaultVerbose(config.logVerbose);
+	TaskScheduler::setup(config.threadCount);
 	
 	GLFWwindow* window = Interface::initWindow("PBR demo", config);
 	if(!window){
@@ -49,24 +57,89 @@ int main(int argc, char** argv) {
 	Log::Info() << Log::OpenGL << "Internal renderer: " << rendererString << "." << std::endl;
 	Log::Info() << Log::OpenGL << "Version supported: " << versionString << "." << std::endl;
 	
+	// Compile the programs used last time first, the others will be compiled on demand.
+	if(config.lazyShaders){
+		Resources::manager().setLazyPrograms(true);
+		Resources::manager().loadProgramsWarmup(config.shadersWarmupPath);
+	}
 	
-	
-	// Create the renderer.
-	std::shared_ptr<DeferredRenderer> renderer(new DeferredRenderer(config));
+	// Create the renderers.
+	std::shared_ptr<DeferredRenderer> deferredRenderer(new DeferredRenderer(config));
+	std::shared_ptr<ForwardPlusRenderer> forwardRenderer(new ForwardPlusRenderer(config));
+	char const * rendererNames[] = {"Deferred", "Forward+"};
+	int selected_renderer = 0;
+	std::shared_ptr<Renderer> renderer = deferredRenderer;
 	
 	double timer = glfwGetTime();
 	double fullTime = 0.0;
 	double remainingTime = 0.0;
 	const double dt = 1.0/120.0; // Small physics timestep.
+	// Smoothed duration of the frames, for display.
+	double averageFrameTime = 0.0;
+	// Animations are run while the previous frame is rendered, and handed over to the rendering.
+	SceneSimulation simulation;
 	
+	// Only the active renderer holds the scene.
+	// Should be called while no frame is rendered.
+	const auto setScene = [&](std::shared_ptr<Scene> scene){
+		// The scene can't be animated while the renderer initializes it.
+		simulation.setScene(nullptr);
+		if(selected_renderer == 0){
+			deferredRenderer->setScene(scene);
+		} else {
+			forwardRenderer->setScene(scene);
+		}
+		simulation.setScene(scene);
+	};
+	
+	// Baked impostors are cached between sessions.
+	Impostor::cachePath = config.impostorsCachePath;
 	std::vector<std::shared_ptr<Scene>> scenes;
+	std::vector<std::string> sceneLabels = {"Dragon", "Spheres", "Lights"};
 	scenes.emplace_back(new DragonScene());
 	scenes.emplace_back(new SphereScene());
-	scenes.emplace_back(new DeskScene());
-	char const * sceneNames[] = {"Dragon", "Spheres", "Desk", "None"};
+	scenes.emplace_back(new LightsScene());
+	// Add the scenes described in the resources, compiled or in text.
+	std::map<std::string, std::string> sceneFiles;
+	std::map<std::string, std::string> compiledSceneFiles;
+	Resources::manager().getFiles("scene", sceneFiles);
+	Resources::manager().getFiles("scenebin", compiledSceneFiles);
+	sceneFiles.insert(compiledSceneFiles.begin(), compiledSceneFiles.end());
+	for(const auto & sceneFile : sceneFiles){
+		scenes.emplace_back(new FileScene(sceneFile.first));
+		sceneLabels.push_back(sceneFile.first);
+	}
+	sceneLabels.push_back("None");
+	std::vector<const char *> sceneNames;
+	for(const std::string & label : sceneLabels){
+		sceneNames.push_back(label.c_str());
+	}
 	// Load the first scene by default.
 	int selected_scene = 0;
-	renderer->setScene(scenes[selected_scene]);
+	setScene(scenes[selected_scene]);
+	bool firstFrame = true;
+	// Result of the last mouse picking query.
+	RayHit picked;
+	glm::vec3 pickedPosition(0.0f);
+	// GL state changes of the last frame, and of the frame being rendered.
+	StateStatistics frameState;
+	StateStatistics renderedState;
+	
+	// Frames are rendered with the state handed over by the main loop, optionally on a dedicated thread.
+	RenderThread renderThread(window, config.renderThread, [&](){
+		// Apply the scene animated during the previous frame.
+		simulation.apply();
+		renderer->draw();
+		renderedState = GLUtilities::stateStatistics();
+		GLUtilities::resetStateStatistics();
+		// Finish the programs compiled in the background since the last frame.
+		if(config.lazyShaders){
+			Resources::manager().pollPrograms();
+		}
+	});
+	if(renderThread.threaded()){
+		Log::Info() << Log::OpenGL << "Rendering on a dedicated thread." << std::endl;
+	}
 	
 	// Start the display/interaction loop.
 	while (!glfwWindowShouldClose(window)) {
@@ -80,22 +153,66 @@ int main(int argc, char** argv) {
 		Interface::beginFrame();
 		// Reload resources.
 		if(Input::manager().triggered(Input::KeyP)){
-			Resources::manager().reload();
+			renderThread.run([](){
+				Resources::manager().reload();
+			});
 		}
 		
 		// Handle scene switching.
 		if(ImGui::Begin("Renderer")){
-			if(ImGui::Combo("Scene", &selected_scene, sceneNames, scenes.size()+1)){
-				if(selected_scene == scenes.size()){
-					renderer->setScene(nullptr);
-				} else {
-					Log::Info() << Log::Resources << "Loading scene " << sceneNames[selected_scene] << "." << std::endl;
-					renderer->setScene(scenes[selected_scene]);
-				}
+			const std::shared_ptr<Scene> currentScene = selected_scene < int(scenes.size()) ? scenes[selected_scene] : nullptr;
+			if(ImGui::Combo("Renderer", &selected_renderer, rendererNames, 2)){
+				// Hand the scene over to the new renderer, that might have missed resize events.
+				renderThread.run([&](){
+					deferredRenderer->setScene(nullptr);
+					forwardRenderer->setScene(nullptr);
+					renderer = selected_renderer == 0 ? std::static_pointer_cast<Renderer>(deferredRenderer) : std::static_pointer_cast<Renderer>(forwardRenderer);
+					renderer->resize((unsigned int)config.screenResolution[0], (unsigned int)config.screenResolution[1]);
+					setScene(currentScene);
+				});
 			}
+			if(ImGui::Combo("Scene", &selected_scene, sceneNames.data(), int(sceneNames.size()))){
+				renderThread.run([&](){
+					if(selected_scene == scenes.size()){
+						setScene(nullptr);
+					} else {
+						Log::Info() << Log::Resources << "Loading scene " << sceneNames[selected_scene] << "." << std::endl;
+						setScene(scenes[selected_scene]);
+					}
+				});
+				picked = RayHit();
+			}
+			if(picked.hit){
+				ImGui::Text("Picked object %d at (%.2f, %.2f, %.2f)", int(picked.object), pickedPosition[0], pickedPosition[1], pickedPosition[2]);
+			} else {
+				ImGui::Text("Right click to pick an object.");
+			}
+			ImGui::Text("GL state changes: %d sent, %d skipped", int(frameState.calls), int(frameState.skipped));
+			ImGui::Text("Frame time: %.2f ms", averageFrameTime * 1000.0);
 		}
 		ImGui::End();
 		
+		// Pick the object under the cursor.
+		if(selected_scene < int(scenes.size()) && Input::manager().triggered(Input::MouseRight)){
+			const Camera & camera = selected_renderer == 0 ? deferredRenderer->camera() : forwardRenderer->camera();
+			// The mouse position is measured from the top of the window.
+			const glm::vec2 mouse = Input::manager().mouse();
+			const glm::vec2 ndcPosition(2.0f * mouse.x - 1.0f, 1.0f - 2.0f * mouse.y);
+			const glm::mat4 clipToWorld = glm::inverse(camera.projection() * camera.view());
+			const glm::vec4 nearPoint = clipToWorld * glm::vec4(ndcPosition, -1.0f, 1.0f);
+			const glm::vec4 farPoint = clipToWorld * glm::vec4(ndcPosition, 1.0f, 1.0f);
+			const glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+			// The ray spans the view depth range.
+			const Ray ray(origin, glm::vec3(farPoint) / farPoint.w - origin);
+			// Objects can move, so the top level hierarchy is rebuilt for each query.
+			// The objects are updated by the rendering.
+			renderThread.run([&](){
+				const Raycaster raycaster(scenes[selected_scene]->objects);
+				picked = raycaster.intersect(ray, 0.0f, 1.0f);
+			});
+			pickedPosition = ray.origin + picked.dist * ray.direction;
+		}
+		
 		// We separate punctual events from the main physics/movement update loop.
 		renderer->update();
 		
@@ -103,6 +220,7 @@ int main(int argc, char** argv) {
 		double currentTime = glfwGetTime();
 		double frameTime = currentTime - timer;
 		timer = currentTime;
+		averageFrameTime = 0.95 * averageFrameTime + 0.05 * frameTime;
 		
 		// Physics simulation
 		// First avoid super high frametime by clamping.
@@ -118,13 +236,28 @@ int main(int argc, char** argv) {
 			fullTime += deltaTime;
 			remainingTime -= deltaTime;
 		}
-		// Update the content of the window.
-		renderer->draw();
-		// Then render the interface.
-		Interface::endFrame();
-		//Display the result for the current rendering loop.
-		glfwSwapBuffers(window);
+		simulation.record();
+		
+		// Once the previous frame is rendered, hand the state of this one over.
+		renderThread.wait();
+		renderer->exchange();
+		simulation.exchange();
+		frameState = renderedState;
+		// Render the content of the window and the interface, then display the result.
+		renderThread.submit();
 
+		if(firstFrame){
+			firstFrame = false;
+			renderThread.wait();
+			Log::Info() << Log::OpenGL << "First frame submitted after " << glfwGetTime() << "s." << std::endl;
+		}
+	}
+	// Bring the GL context back to the main thread.
+	renderThread.stop();
+	
+	// Save the programs used in this session for the next launch.
+	if(config.lazyShaders){
+		Resources::manager().saveProgramsWarmup(config.shadersWarmupPath);
 	}
 	
 	// Clean the interface.
@@ -132,9 +265,13 @@ int main(int argc, char** argv) {
 	// Remove the window.
 	glfwDestroyWindow(window);
 	// Clean other resources
-	renderer->clean();
+	simulation.setScene(nullptr);
+	// The inactive renderer doesn't hold the scene anymore.
+	deferredRenderer->clean();
+	forwardRenderer->clean();
 	// Close GL context and any other GLFW resources.
 	glfwTerminate();
+	TaskScheduler::clean();
 	
 	return 0;
 }
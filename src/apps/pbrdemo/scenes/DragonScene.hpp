@@ -2,12 +2,18 @@
 #define DragonScene_h
 
 #include "Scene.hpp"
+#include "Impostor.hpp"
 
 
 class DragonScene : public Scene {
 public:
 	void init();
 	void update(double fullTime, double frameTime);
+	
+private:
+	TransformHierarchy::Node _suzanne = TransformHierarchy::None; ///< The animated object node.
+	std::vector<glm::vec3> _pointPositions; ///< Initial position of each point light.
+	float _pointAngle = 0.0f; ///< Rotation of the point lights around the vertical axis.
 };
 
 
@@ -27,20 +33,21 @@ void DragonScene::init(){
 	Object dragon(Object::Type::Regular, "dragon", { { "dragon_texture_color", true }, { "dragon_texture_normal", false }, { "dragon_texture_rough_met_ao", false } });
 	Object plane(Object::Type::Parallax, "plane", { { "plane_texture_color", true }, { "plane_texture_normal", false }, { "plane_texture_rough_met_ao", false }, { "plane_texture_depth", false } }, {}, false);
 	
-	suzanne.update(suzanneModel);
-	dragon.update(dragonModel);
-	plane.update(planeModel);
+	// Distant views of the suzanne and the dragon are replaced by impostors.
+	suzanne.setImpostor(std::make_shared<Impostor>(suzanne, "suzanne"));
+	dragon.setImpostor(std::make_shared<Impostor>(dragon, "dragon"));
 	
-	objects.push_back(suzanne);
-	objects.push_back(dragon);
-	objects.push_back(plane);
+	_suzanne = addObject(suzanne, suzanneModel);
+	addObject(dragon, dragonModel);
+	addObject(plane, planeModel);
+	updateTransforms();
 	
 	// Background creation.
 	background = Object(Object::Type::Skybox, "skybox", {}, {{"corsica_beach_cube", true }});
 	backgroundReflection = Resources::manager().getCubemap("corsica_beach_cube").id;
 	loadSphericalHarmonics("corsica_beach_cube_shcoeffs");
 	
-	// Compute the bounding box of the shadow casters.
+	// Compute the bounding box of the shadow casters, the lights shadow maps are then fitted by the scene when objects and lights move.
 	const BoundingBox bbox = computeBoundingBox(true);
 	
 	// Lights creation.
@@ -57,22 +64,25 @@ void DragonScene::init(){
 	for(size_t i = 0; i < 4; ++i){
 		const glm::vec3 position = glm::vec3(-1.0f+2.0f*(i%2),-0.1f,-1.0f+2.0f*(i/2));
 		pointLights.emplace_back(position, colors[i], 1.2f, bbox);
+		_pointPositions.push_back(position);
 	}
 }
 
 void DragonScene::update(double fullTime, double frameTime){
 	// Update lights.
-	directionalLights[0].update(glm::vec3(-2.0f, -1.5f+sin(0.5*fullTime),0.0f));
-	spotLights[0].update(glm::vec3(1.1f+sin(fullTime),2.0f,1.1f+sin(fullTime)));
-	for(size_t i = 0; i <pointLights.size(); ++i){
-		auto& pointLight = pointLights[i];
-		const glm::vec4 newPosition = glm::rotate(glm::mat4(1.0f), (float)frameTime, glm::vec3(0.0f, 1.0f, 0.0f))*glm::vec4(pointLight.position(), 1.0f);
-		pointLight.update(glm::vec3(newPosition));
+	moveDirectionalLight(0, glm::vec3(-2.0f, -1.5f+sin(0.5*fullTime),0.0f));
+	moveSpotLight(0, glm::vec3(1.1f+sin(fullTime),2.0f,1.1f+sin(fullTime)));
+	// The lights are not read back, as they might be rendered at the same time.
+	_pointAngle += (float)frameTime;
+	const glm::mat4 rotation = glm::rotate(glm::mat4(1.0f), _pointAngle, glm::vec3(0.0f, 1.0f, 0.0f));
+	for(size_t i = 0; i < _pointPositions.size(); ++i){
+		const glm::vec4 newPosition = rotation*glm::vec4(_pointPositions[i], 1.0f);
+		movePointLight(i, glm::vec3(newPosition));
 	}
 	
 	// Update objects.
 	const glm::mat4 suzanneModel = glm::scale(glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(0.2,0.0,0.0)),float(fullTime),glm::vec3(0.0f,1.0f,0.0f)),glm::vec3(0.25f));
-	objects[0].update(suzanneModel);
+	transforms.setLocal(_suzanne, suzanneModel);
 }
 
 
@@ -0,0 +1,54 @@
+#ifndef FileScene_h
+#define FileScene_h
+
+#include "Scene.hpp"
+#include <chrono>
+
+
+/** \brief Scene loaded from a description in the resources, compiled with SceneCompiler or in text. Its objects and lights are static. \see SceneDescription */
+class FileScene : public Scene {
+public:
+	/** Constructor.
+	 \param name the name of the description file, without extension
+	 */
+	FileScene(const std::string & name) : _name(name) {}
+	
+	void init();
+	void update(double fullTime, double frameTime);
+
+private:
+	std::string _name; ///< Name of the description file.
+};
+
+
+void FileScene::init(){
+	if(_loaded){
+		return;
+	}
+	_loaded = true;
+	
+	const auto start = std::chrono::steady_clock::now();
+	// Prefer the compiled description, read without parsing.
+	SceneDescription description;
+	std::map<std::string, std::string> compiled;
+	Resources::manager().getFiles("scenebin", compiled);
+	bool valid = false;
+	if(compiled.count(_name) > 0){
+		const std::string data = Resources::manager().getString(_name + ".scenebin");
+		valid = description.read(data.data(), data.size());
+	}
+	if(!valid){
+		valid = description.parse(Resources::manager().getString(_name + ".scene"));
+	}
+	if(!valid){
+		return;
+	}
+	loadDescription(description);
+	const auto end = std::chrono::steady_clock::now();
+	Log::Info() << Log::Resources << "Scene " << _name << " loaded in " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << "ms." << std::endl;
+}
+
+void FileScene::update(double fullTime, double frameTime){
+}
+
+#endif
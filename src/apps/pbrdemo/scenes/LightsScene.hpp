@@ -0,0 +1,79 @@
+#ifndef LightsScene_h
+#define LightsScene_h
+
+#include "Scene.hpp"
+#include "helpers/GenerationUtilities.hpp"
+
+
+/** \brief Stress scene with hundreds of small moving lights over a grid of spheres, to compare the cost of lighting in the renderers. */
+class LightsScene : public Scene {
+public:
+	void init();
+	void update(double fullTime, double frameTime);
+
+private:
+	std::vector<glm::vec4> _orbits; ///< Orbit radius, height, phase and angular speed of each point light.
+};
+
+
+void LightsScene::init(){
+	if(_loaded){
+		return;
+	}
+	_loaded = true;
+	
+	// Objects creation.
+	Object plane(Object::Type::Parallax, "plane", { { "plane_texture_color", true }, { "plane_texture_normal", false }, { "plane_texture_rough_met_ao", false }, { "plane_texture_depth", false } }, {}, false);
+	addObject(plane, glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -0.25f, 0.0f)), glm::vec3(6.0f)));
+	
+	const Object wood(Object::Type::Regular, "sphere", { {"sphere_wood_lacquered_albedo", true }, {"sphere_wood_lacquered_normal", false}, {"sphere_wood_lacquered_rough_met_ao", false}});
+	const Object gold(Object::Type::Regular, "sphere", { {"sphere_gold_worn_albedo", true }, {"sphere_gold_worn_normal", false}, {"sphere_gold_worn_rough_met_ao", false}});
+	// The spheres are placed relative to the grid.
+	const TransformHierarchy::Node grid = transforms.add(glm::scale(glm::mat4(1.0f), glm::vec3(0.25f)));
+	const int gridSize = 10;
+	for(int z = 0; z < gridSize; ++z){
+		for(int x = 0; x < gridSize; ++x){
+			const glm::vec3 position = glm::vec3(float(x) - 0.5f * float(gridSize - 1), 0.0f, float(z) - 0.5f * float(gridSize - 1));
+			addObject(((x + z) % 2 == 0) ? wood : gold, glm::translate(glm::mat4(1.0f), 4.0f * position), grid);
+		}
+	}
+	updateTransforms();
+	// All objects are static: pack their meshes in shared buffers to render them without switching vertex arrays.
+	Object::batch(objects);
+	
+	// Background creation.
+	background = Object(Object::Type::Skybox, "skybox", {}, {{"studio", true }});
+	backgroundReflection = Resources::manager().getCubemap("studio").id;
+	loadSphericalHarmonics("studio_shcoeffs");
+	
+	// Compute the bounding box of the shadow casters.
+	const BoundingBox bbox = computeBoundingBox(true);
+	
+	// Lights creation.
+	// Create many small point lights, orbiting around the center of the grid. None of them casts shadows.
+	const size_t pointCount = 384;
+	for(size_t i = 0; i < pointCount; ++i){
+		const glm::vec4 orbit(Random::Float(0.5f, 6.0f), Random::Float(-0.1f, 0.6f), Random::Float(0.0f, 2.0f * float(M_PI)), Random::Float(-0.4f, 0.4f));
+		_orbits.push_back(orbit);
+		const glm::vec3 color = 2.0f * glm::vec3(Random::Float(), Random::Float(), Random::Float());
+		pointLights.emplace_back(glm::vec3(orbit[0] * std::cos(orbit[2]), orbit[1], orbit[0] * std::sin(orbit[2])), color, Random::Float(0.4f, 0.9f), bbox);
+	}
+	// Create spotlights along the grid border, looking at its center.
+	const size_t spotCount = 16;
+	for(size_t i = 0; i < spotCount; ++i){
+		const float angle = 2.0f * float(M_PI) * float(i) / float(spotCount);
+		const glm::vec3 position = glm::vec3(6.0f * std::cos(angle), 2.5f, 6.0f * std::sin(angle));
+		spotLights.emplace_back(position, glm::vec3(0.0f, -0.25f, 0.0f) - position, glm::vec3(6.0f, 5.0f, 4.0f), 0.3f, 0.4f, 9.0f, bbox);
+	}
+
+}
+
+void LightsScene::update(double fullTime, double frameTime){
+	for(size_t i = 0; i < _orbits.size(); ++i){
+		const glm::vec4 & orbit = _orbits[i];
+		const float angle = orbit[2] + orbit[3] * float(fullTime);
+		movePointLight(i, glm::vec3(orbit[0] * std::cos(angle), orbit[1], orbit[0] * std::sin(angle)));
+	}
+}
+
+#endif
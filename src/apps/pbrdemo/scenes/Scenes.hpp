@@ -2,5 +2,6 @@
 #define Scenes_h
 #include "DragonScene.hpp"
 #include "SphereScene.hpp"
-#include "DeskScene.hpp"
+#include "LightsScene.hpp"
+#include "FileScene.hpp"
 #endif
@@ -8,6 +8,9 @@ class SphereScene : public Scene {
 public:
 	void init();
 	void update(double fullTime, double frameTime);
+	
+private:
+	TransformHierarchy::Node _rotating = TransformHierarchy::None; ///< The animated sphere node.
 };
 
 
@@ -22,11 +25,9 @@ void SphereScene::init(){
 	Object sphere2(Object::Type::Regular, "sphere", { {"sphere_gold_worn_albedo", true }, {"sphere_gold_worn_normal", false}, {"sphere_gold_worn_rough_met_ao", false}});
 	const glm::mat4 model1 = glm::translate(glm::scale(glm::mat4(1.0f),glm::vec3(0.3f)), glm::vec3(1.2f,0.0f, 0.0f));
 	const glm::mat4 model2 = glm::translate(glm::scale(glm::mat4(1.0f),glm::vec3(0.3f)), glm::vec3(-1.2f,0.0f, 0.0f));
-	sphere1.update(model1);
-	sphere2.update(model2);
-	
-	objects.push_back(sphere1);
-	objects.push_back(sphere2);
+	_rotating = addObject(sphere1, model1);
+	addObject(sphere2, model2);
+	updateTransforms();
 	
 	// Background creation.
 	background = Object(Object::Type::Skybox, "skybox", {}, {{"studio", true }});
@@ -46,7 +47,7 @@ void SphereScene::init(){
 
 void SphereScene::update(double fullTime, double frameTime){
 	const glm::mat4 model = glm::rotate(glm::translate(glm::scale(glm::mat4(1.0f),glm::vec3(0.3f)), glm::vec3(1.2f,0.0f, 0.0f)), 0.2f*float(fullTime), glm::vec3(0.0f,1.0f,0.0f));
-	objects[0].update(model);
+	transforms.setLocal(_rotating, model);
 	
 }
 
@@ -58,7 +58,7 @@ int main(int argc, char** argv) {
 		Log::Info() << std::endl;
 	}
 	
-	glEnable(GL_DEPTH_TEST);
+	GLUtilities::setEnabled(GL_DEPTH_TEST, true);
 	
 	// Setup the timer.
 	double timer = glfwGetTime();
@@ -110,16 +110,16 @@ int main(int argc, char** argv) {
 		// Render.
 		const glm::vec2 screenSize = Input::manager().size();
 		const glm::mat4 MVP = camera.projection() * camera.view();
-		glViewport(0, 0, (GLsizei)screenSize[0], (GLsizei)screenSize[1]);
+		GLUtilities::setViewport(0, 0, (GLsizei)screenSize[0], (GLsizei)screenSize[1]);
 		glClearColor(0.2f, 0.3f, 0.25f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		glUseProgram(program->id());
+		GLUtilities::useProgram(program->id());
 		glUniformMatrix4fv(program->uniform("mvp"), 1, GL_FALSE, &MVP[0][0]);
-		glBindVertexArray(mesh.vId);
+		GLUtilities::bindVertexArray(mesh.vId);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.eId);
-		glDrawElements(GL_TRIANGLES, mesh.count, GL_UNSIGNED_INT, (void*)0);
-		glBindVertexArray(0);
-		glUseProgram(0);
+		glDrawElements(GL_TRIANGLES, mesh.count, mesh.indexType, (void*)0);
+		GLUtilities::bindVertexArray(0);
+		GLUtilities::useProgram(0);
 		ImGui::Text("ImGui is functional!");
 		
 		// Then render the interface.
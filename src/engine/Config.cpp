@@ -53,6 +53,16 @@ void Config::processArguments(){
 			internalVerticalResolution = std::stof(values[0]);
 		} else if(key == "log-path"){
 			logPath = values[0];
+		} else if(key == "lazy-shaders"){
+			lazyShaders = true;
+		} else if(key == "shaders-warmup"){
+			shadersWarmupPath = values[0];
+		} else if(key == "impostors-cache"){
+			impostorsCachePath = values[0];
+		} else if(key == "threads"){
+			threadCount = (unsigned int)std::stoi(values[0]);
+		} else if(key == "render-thread"){
+			renderThread = true;
 		} else if(key == "wxh"){
 			const unsigned int w = (unsigned int)std::stoi(values[0]);
 			const unsigned int h = (unsigned int)std::stoi(values[1]);
@@ -59,6 +59,21 @@ public:
 	/// Output log file path.
 	std::string logPath = "";
 	
+	/// Compile shader programs on first use instead of at creation.
+	bool lazyShaders = false;
+	
+	/// Path to the list of programs used in the last session, compiled first at launch when shaders are lazy.
+	std::string shadersWarmupPath = "./shaders_warmup.txt";
+	
+	/// Directory where baked impostors are cached.
+	std::string impostorsCachePath = "./";
+	
+	/// Number of threads executing tasks, 0 to use the hardware thread count.
+	unsigned int threadCount = 0;
+
+	/// Render the frames on a dedicated thread owning the GL context, while the next frame is prepared.
+	bool renderThread = false;
+
 public:
 	
 	/**
@@ -0,0 +1,325 @@
+#include "DynamicBVH.hpp"
+
+const DynamicBVH::Proxy DynamicBVH::None;
+
+/// Maximum depth of the traversal stacks, far above the height of a balanced hierarchy.
+static const size_t maxStackSize = 128;
+
+/** Compute the surface area of a box.
+ \param box the box
+ \return the area
+ */
+static float area(const BoundingBox & box){
+	const glm::vec3 size = box.maxis - box.minis;
+	return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+/** Compute the union of two boxes.
+ \param a the first box
+ \param b the second box
+ \return the smallest box containing both
+ */
+static BoundingBox merged(const BoundingBox & a, const BoundingBox & b){
+	BoundingBox box = a;
+	box.merge(b);
+	return box;
+}
+
+/** Test if a box contains another one.
+ \param outer the containing box
+ \param inner the contained box
+ \return true if inner is inside outer
+ */
+static bool contains(const BoundingBox & outer, const BoundingBox & inner){
+	return glm::all(glm::lessThanEqual(outer.minis, inner.minis)) && glm::all(glm::greaterThanEqual(outer.maxis, inner.maxis));
+}
+
+/** Test if two boxes overlap.
+ \param a the first box
+ \param b the second box
+ \return true if the boxes share at least a point
+ */
+static bool overlaps(const BoundingBox & a, const BoundingBox & b){
+	return glm::all(glm::lessThanEqual(a.minis, b.maxis)) && glm::all(glm::lessThanEqual(b.minis, a.maxis));
+}
+
+DynamicBVH::DynamicBVH(float margin) : _margin(margin) {
+}
+
+DynamicBVH::Proxy DynamicBVH::insert(const BoundingBox & box, unsigned int data){
+	const Proxy leaf = allocate();
+	Node & node = _nodes[leaf];
+	node.box.minis = box.minis - glm::vec3(_margin);
+	node.box.maxis = box.maxis + glm::vec3(_margin);
+	node.data = data;
+	node.height = 0;
+	insertLeaf(leaf);
+	++_leafCount;
+	return leaf;
+}
+
+void DynamicBVH::remove(Proxy proxy){
+	removeLeaf(proxy);
+	release(proxy);
+	--_leafCount;
+}
+
+bool DynamicBVH::update(Proxy proxy, const BoundingBox & box){
+	const BoundingBox & fat = _nodes[proxy].box;
+	// Keep the leaf if it still contains the box, unless the box has shrunk a lot.
+	BoundingBox loose;
+	loose.minis = box.minis - glm::vec3(4.0f * _margin);
+	loose.maxis = box.maxis + glm::vec3(4.0f * _margin);
+	if(contains(fat, box) && contains(loose, fat)){
+		return false;
+	}
+	removeLeaf(proxy);
+	_nodes[proxy].box.minis = box.minis - glm::vec3(_margin);
+	_nodes[proxy].box.maxis = box.maxis + glm::vec3(_margin);
+	insertLeaf(proxy);
+	return true;
+}
+
+void DynamicBVH::queryOverlap(const BoundingBox & box, std::vector<unsigned int> & results) const {
+	results.clear();
+	if(_root == None){
+		return;
+	}
+	Proxy stack[maxStackSize];
+	size_t count = 0;
+	stack[count++] = _root;
+	while(count > 0){
+		const Node & node = _nodes[stack[--count]];
+		if(!overlaps(node.box, box)){
+			continue;
+		}
+		if(node.leaf()){
+			results.push_back(node.data);
+			continue;
+		}
+		stack[count++] = node.children[0];
+		stack[count++] = node.children[1];
+	}
+}
+
+void DynamicBVH::queryFrustum(const Frustum & frustum, std::vector<unsigned int> & results) const {
+	results.clear();
+	if(_root == None){
+		return;
+	}
+	Proxy stack[maxStackSize];
+	size_t count = 0;
+	stack[count++] = _root;
+	while(count > 0){
+		const Node & node = _nodes[stack[--count]];
+		if(!frustum.intersects(node.box)){
+			continue;
+		}
+		if(node.leaf()){
+			results.push_back(node.data);
+			continue;
+		}
+		stack[count++] = node.children[0];
+		stack[count++] = node.children[1];
+	}
+}
+
+void DynamicBVH::queryRay(const glm::vec3 & origin, const glm::vec3 & direction, float maxDistance, std::vector<unsigned int> & results) const {
+	results.clear();
+	if(_root == None){
+		return;
+	}
+	// Slabs test, infinite inverse components are handled by the IEEE comparisons.
+	const glm::vec3 invDirection = 1.0f / direction;
+	Proxy stack[maxStackSize];
+	size_t count = 0;
+	stack[count++] = _root;
+	while(count > 0){
+		const Node & node = _nodes[stack[--count]];
+		const glm::vec3 t0 = (node.box.minis - origin) * invDirection;
+		const glm::vec3 t1 = (node.box.maxis - origin) * invDirection;
+		const glm::vec3 tNear = glm::min(t0, t1);
+		const glm::vec3 tFar = glm::max(t0, t1);
+		const float tEnter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+		const float tExit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+		if(tEnter > tExit){
+			continue;
+		}
+		if(node.leaf()){
+			results.push_back(node.data);
+			continue;
+		}
+		stack[count++] = node.children[0];
+		stack[count++] = node.children[1];
+	}
+}
+
+float DynamicBVH::cost() const {
+	if(_root == None){
+		return 0.0f;
+	}
+	float total = 0.0f;
+	for(const Node & node : _nodes){
+		if(node.height > 0){
+			total += area(node.box);
+		}
+	}
+	return total / std::max(area(_nodes[_root].box), 1e-8f);
+}
+
+void DynamicBVH::clear(){
+	_nodes.clear();
+	_root = None;
+	_free = None;
+	_leafCount = 0;
+}
+
+DynamicBVH::Proxy DynamicBVH::allocate(){
+	if(_free == None){
+		_nodes.emplace_back();
+		_free = Proxy(_nodes.size() - 1);
+		_nodes[_free].parent = None;
+	}
+	const Proxy node = _free;
+	_free = _nodes[node].parent;
+	_nodes[node].parent = None;
+	_nodes[node].children[0] = None;
+	_nodes[node].children[1] = None;
+	_nodes[node].data = 0;
+	_nodes[node].height = 0;
+	return node;
+}
+
+void DynamicBVH::release(Proxy node){
+	_nodes[node].parent = _free;
+	_nodes[node].height = -1;
+	_free = node;
+}
+
+void DynamicBVH::insertLeaf(Proxy leaf){
+	if(_root == None){
+		_root = leaf;
+		_nodes[leaf].parent = None;
+		return;
+	}
+	
+	// Descend towards the sibling minimizing the total area of the hierarchy.
+	const BoundingBox leafBox = _nodes[leaf].box;
+	Proxy index = _root;
+	while(!_nodes[index].leaf()){
+		const Node & node = _nodes[index];
+		const float nodeArea = area(node.box);
+		const float combinedArea = area(merged(node.box, leafBox));
+		// Cost of creating a new parent for this node and the new leaf.
+		const float cost = 2.0f * combinedArea;
+		// Minimum cost of pushing the leaf further down: all ancestors grow.
+		const float inheritedCost = 2.0f * (combinedArea - nodeArea);
+		float childCosts[2];
+		for(int cid = 0; cid < 2; ++cid){
+			const Node & child = _nodes[node.children[cid]];
+			const float childArea = area(merged(child.box, leafBox));
+			childCosts[cid] = (child.leaf() ? childArea : (childArea - area(child.box))) + inheritedCost;
+		}
+		if(cost < childCosts[0] && cost < childCosts[1]){
+			break;
+		}
+		index = childCosts[0] < childCosts[1] ? node.children[0] : node.children[1];
+	}
+	const Proxy sibling = index;
+	
+	// Create a new parent for the sibling and the leaf.
+	const Proxy oldParent = _nodes[sibling].parent;
+	const Proxy newParent = allocate();
+	_nodes[newParent].parent = oldParent;
+	_nodes[newParent].box = merged(leafBox, _nodes[sibling].box);
+	_nodes[newParent].height = _nodes[sibling].height + 1;
+	_nodes[newParent].children[0] = sibling;
+	_nodes[newParent].children[1] = leaf;
+	_nodes[sibling].parent = newParent;
+	_nodes[leaf].parent = newParent;
+	if(oldParent == None){
+		_root = newParent;
+	} else {
+		Node & parent = _nodes[oldParent];
+		parent.children[parent.children[0] == sibling ? 0 : 1] = newParent;
+	}
+	
+	refit(_nodes[leaf].parent);
+}
+
+void DynamicBVH::removeLeaf(Proxy leaf){
+	if(leaf == _root){
+		_root = None;
+		return;
+	}
+	const Proxy parent = _nodes[leaf].parent;
+	const Proxy grandParent = _nodes[parent].parent;
+	const Proxy sibling = _nodes[parent].children[_nodes[parent].children[0] == leaf ? 1 : 0];
+	release(parent);
+	_nodes[leaf].parent = None;
+	
+	// The sibling replaces the parent.
+	_nodes[sibling].parent = grandParent;
+	if(grandParent == None){
+		_root = sibling;
+		return;
+	}
+	Node & node = _nodes[grandParent];
+	node.children[node.children[0] == parent ? 0 : 1] = sibling;
+	refit(grandParent);
+}
+
+void DynamicBVH::refit(Proxy node){
+	while(node != None){
+		node = balance(node);
+		Node & current = _nodes[node];
+		const Node & child0 = _nodes[current.children[0]];
+		const Node & child1 = _nodes[current.children[1]];
+		current.box = merged(child0.box, child1.box);
+		current.height = 1 + std::max(child0.height, child1.height);
+		node = current.parent;
+	}
+}
+
+DynamicBVH::Proxy DynamicBVH::balance(Proxy a){
+	Node & nodeA = _nodes[a];
+	if(nodeA.leaf() || nodeA.height < 2){
+		return a;
+	}
+	const int heightDelta = _nodes[nodeA.children[1]].height - _nodes[nodeA.children[0]].height;
+	if(heightDelta >= -1 && heightDelta <= 1){
+		return a;
+	}
+	
+	// The highest child (up) takes the place of the node (a), which keeps the other child (stay) and the lowest grandchild.
+	const int upSide = heightDelta > 1 ? 1 : 0;
+	const Proxy up = nodeA.children[upSide];
+	const Proxy stay = nodeA.children[1 - upSide];
+	Node & nodeUp = _nodes[up];
+	const Proxy f = nodeUp.children[0];
+	const Proxy g = nodeUp.children[1];
+	const bool keepF = _nodes[f].height > _nodes[g].height;
+	const Proxy kept = keepF ? f : g;
+	const Proxy moved = keepF ? g : f;
+	
+	// Swap a and up.
+	nodeUp.children[0] = a;
+	nodeUp.parent = nodeA.parent;
+	nodeA.parent = up;
+	if(nodeUp.parent == None){
+		_root = up;
+	} else {
+		Node & parent = _nodes[nodeUp.parent];
+		parent.children[parent.children[0] == a ? 0 : 1] = up;
+	}
+	
+	// The highest grandchild stays under up, the other one replaces up under a.
+	nodeUp.children[1] = kept;
+	nodeA.children[upSide] = moved;
+	_nodes[moved].parent = a;
+	nodeA.box = merged(_nodes[stay].box, _nodes[moved].box);
+	nodeA.height = 1 + std::max(_nodes[stay].height, _nodes[moved].height);
+	nodeUp.box = merged(nodeA.box, _nodes[kept].box);
+	nodeUp.height = 1 + std::max(nodeA.height, _nodes[kept].height);
+	return up;
+}
@@ -0,0 +1,150 @@
+#ifndef DynamicBVH_h
+#define DynamicBVH_h
+#include "Common.hpp"
+#include "resources/MeshUtilities.hpp"
+
+/**
+ \brief Bounding volume hierarchy over moving boxes, maintained incrementally.
+ \details Each leaf stores an enlarged ("fat") version of the box it was given, so that small motions can be absorbed without modifying the tree. When a box leaves its fat box, the leaf is removed and reinserted next to the sibling minimizing the increase in surface area. Ancestors of a modified leaf are refitted and rebalanced with rotations, keeping the height of the two children of each node within one level of each other.
+ \ingroup Engine
+ */
+class DynamicBVH {
+
+public:
+
+	/// \brief Index of a leaf in the hierarchy.
+	typedef unsigned int Proxy;
+	
+	/// Invalid leaf index.
+	static const Proxy None = ~0u;
+	
+	/** Constructor.
+	 \param margin the enlargement of the boxes stored in the leaves, in world units
+	 */
+	DynamicBVH(float margin = 0.1f);
+	
+	/** Insert a box in the hierarchy.
+	 \param box the box to insert
+	 \param data user value reported by queries for this box
+	 \return the leaf storing the box
+	 */
+	Proxy insert(const BoundingBox & box, unsigned int data);
+	
+	/** Remove a box from the hierarchy.
+	 \param proxy the leaf to remove
+	 */
+	void remove(Proxy proxy);
+	
+	/** Move a box. The hierarchy is only modified if the new box isn't contained in the leaf fat box, or is much smaller than it.
+	 \param proxy the leaf storing the box
+	 \param box the new box
+	 \return true if the leaf was reinserted
+	 */
+	bool update(Proxy proxy, const BoundingBox & box);
+	
+	/** Collect the boxes overlapping a query box.
+	 \param box the query box
+	 \param results will contain the data of the leaves whose fat boxes overlap the query
+	 */
+	void queryOverlap(const BoundingBox & box, std::vector<unsigned int> & results) const;
+	
+	/** Collect the boxes at least partially inside a frustum.
+	 \param frustum the query frustum
+	 \param results will contain the data of the leaves whose fat boxes intersect the frustum
+	 */
+	void queryFrustum(const Frustum & frustum, std::vector<unsigned int> & results) const;
+	
+	/** Collect the boxes intersected by a ray segment.
+	 \param origin the ray origin
+	 \param direction the ray direction
+	 \param maxDistance the length of the segment, in units of direction
+	 \param results will contain the data of the leaves whose fat boxes are intersected
+	 */
+	void queryRay(const glm::vec3 & origin, const glm::vec3 & direction, float maxDistance, std::vector<unsigned int> & results) const;
+	
+	/** Query the enlarged box stored in a leaf.
+	 \param proxy the leaf
+	 \return the fat box
+	 */
+	const BoundingBox & fatBox(Proxy proxy) const { return _nodes[proxy].box; }
+	
+	/** Query the user value associated to a leaf.
+	 \param proxy the leaf
+	 \return the data given at insertion
+	 */
+	unsigned int data(Proxy proxy) const { return _nodes[proxy].data; }
+	
+	/** Query the number of boxes in the hierarchy.
+	 \return the leaf count
+	 */
+	size_t size() const { return _leafCount; }
+	
+	/** Query the height of the hierarchy.
+	 \return the number of levels below the root, 0 for a single leaf or an empty hierarchy
+	 */
+	int height() const { return _root == None ? 0 : _nodes[_root].height; }
+	
+	/** Query the quality of the hierarchy, as the sum of the surface areas of the internal nodes relative to the area of the root.
+	 \return the relative cost, lower is better
+	 */
+	float cost() const;
+	
+	/** Remove all boxes. */
+	void clear();
+
+private:
+
+	/// \brief A node of the hierarchy, either a leaf storing a box or an internal node with two children.
+	struct Node {
+		BoundingBox box; ///< The fat box of a leaf, or the union of the children boxes.
+		Proxy parent; ///< The parent node, or the next free node for unused nodes.
+		Proxy children[2]; ///< The two children, None for a leaf.
+		unsigned int data; ///< The user value of a leaf.
+		int height; ///< Number of levels below the node, 0 for a leaf and -1 for an unused node.
+		
+		/** Query if the node is a leaf.
+		 \return true if the node has no children
+		 */
+		bool leaf() const { return children[0] == None; }
+	};
+	
+	/** Get an unused node, growing the storage if needed.
+	 \return the node index
+	 */
+	Proxy allocate();
+	
+	/** Add a node to the list of unused nodes.
+	 \param node the node to release
+	 */
+	void release(Proxy node);
+	
+	/** Attach a leaf to the hierarchy, next to the node minimizing the added surface area.
+	 \param leaf the leaf to attach
+	 */
+	void insertLeaf(Proxy leaf);
+	
+	/** Detach a leaf from the hierarchy, its sibling takes the place of their parent.
+	 \param leaf the leaf to detach
+	 */
+	void removeLeaf(Proxy leaf);
+	
+	/** Refit and rebalance the nodes from a given one up to the root.
+	 \param node the first node to update
+	 */
+	void refit(Proxy node);
+	
+	/** Rotate a node with its highest child if the heights of its children differ by more than one level.
+	 \param node the node to balance
+	 \return the node now in place of the initial one
+	 */
+	Proxy balance(Proxy node);
+	
+	std::vector<Node> _nodes; ///< All nodes, used or not.
+	Proxy _root = None; ///< The root node.
+	Proxy _free = None; ///< The first unused node.
+	size_t _leafCount = 0; ///< Number of leaves.
+	float _margin; ///< Enlargement of the leaves boxes.
+
+};
+
+#endif
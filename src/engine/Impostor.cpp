@@ -0,0 +1,277 @@
+#include "Impostor.hpp"
+#include "Object.hpp"
+#include "graphics/Framebuffer.hpp"
+#include "resources/ImageUtilities.hpp"
+#include <glm/gtc/color_space.hpp>
+#include <fstream>
+
+std::string Impostor::cachePath = "./";
+
+GLuint Impostor::_vao = 0;
+
+/** Compute the direction of a view of the hemi-octahedral grid.
+ \param cell the coordinates of the view in the grid
+ \param frames the number of views along each side of the grid
+ \return the direction from the object towards the viewpoint
+ */
+static glm::vec3 frameDirection(const glm::vec2 & cell, unsigned int frames){
+	const glm::vec2 uv = (cell + 0.5f) / float(frames) * 2.0f - 1.0f;
+	const float x = 0.5f * (uv.x + uv.y);
+	const float z = 0.5f * (uv.x - uv.y);
+	return glm::normalize(glm::vec3(x, 1.0f - std::abs(x) - std::abs(z), z));
+}
+
+/** Compute the up vector used to orient a view, avoiding vertical directions.
+ \param dir the direction of the view
+ \return the up vector
+ */
+static glm::vec3 frameUp(const glm::vec3 & dir){
+	return std::abs(dir.y) > 0.999f ? glm::vec3(0.0f, 0.0f, -1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+}
+
+/** Spread the values of covered pixels in the empty pixels around them, staying inside each view. This avoids dark fringes when filtering near silhouettes.
+ \param images the RGBA images to process
+ \param covered the coverage of each pixel, will be updated
+ \param side the size of the images
+ \param frameSize the size of a view
+ \param iterations the number of pixels to spread
+ */
+static void dilate(const std::vector<std::vector<unsigned char> *> & images, std::vector<bool> & covered, unsigned int side, unsigned int frameSize, unsigned int iterations){
+	const int offsets[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+	for(unsigned int it = 0; it < iterations; ++it){
+		std::vector<bool> newCovered = covered;
+		for(unsigned int y = 0; y < side; ++y){
+			for(unsigned int x = 0; x < side; ++x){
+				const size_t pid = size_t(y) * side + x;
+				if(covered[pid]){
+					continue;
+				}
+				glm::vec4 sums[3] = {glm::vec4(0.0f), glm::vec4(0.0f), glm::vec4(0.0f)};
+				int count = 0;
+				for(const auto & offset : offsets){
+					const int nx = int(x) + offset[0];
+					const int ny = int(y) + offset[1];
+					if(nx < 0 || ny < 0 || nx >= int(side) || ny >= int(side) || unsigned(nx) / frameSize != x / frameSize || unsigned(ny) / frameSize != y / frameSize){
+						continue;
+					}
+					const size_t nid = size_t(ny) * side + size_t(nx);
+					if(!covered[nid]){
+						continue;
+					}
+					for(size_t iid = 0; iid < images.size(); ++iid){
+						const unsigned char * texel = &(*images[iid])[4 * nid];
+						sums[iid] += glm::vec4(texel[0], texel[1], texel[2], texel[3]);
+					}
+					++count;
+				}
+				if(count == 0){
+					continue;
+				}
+				for(size_t iid = 0; iid < images.size(); ++iid){
+					unsigned char * texel = &(*images[iid])[4 * pid];
+					// Keep the coverage of the albedo.
+					const int channels = iid == 0 ? 3 : 4;
+					for(int c = 0; c < channels; ++c){
+						texel[c] = (unsigned char)(std::round(sums[iid][c] / float(count)));
+					}
+				}
+				newCovered[pid] = true;
+			}
+		}
+		covered.swap(newCovered);
+	}
+}
+
+Impostor::Impostor(const Object & object, const std::string & name, unsigned int frames, unsigned int frameSize){
+	_frames = std::max(frames, 2u);
+	_frameSize = frameSize;
+	_program = Resources::manager().getProgram("impostor_gbuffer");
+	
+	// Work in model space.
+	Object local = object;
+	local.update(glm::mat4(1.0f));
+	_bounds = local.getBoundingBox().getSphere();
+	_bounds.radius = std::max(_bounds.radius, 1e-4f);
+	
+	const unsigned int side = _frames * _frameSize;
+	const std::string basePath = cachePath + name + "_impostor_" + std::to_string(_frames) + "x" + std::to_string(_frameSize);
+	const std::string suffixes[3] = { "_albedo.png", "_normal.png", "_effects.png" };
+	std::vector<unsigned char> atlases[3];
+	
+	// Try to load the atlases from the cache.
+	bool cached = true;
+	for(int aid = 0; aid < 3 && cached; ++aid){
+		unsigned int width = 0;
+		unsigned int height = 0;
+		unsigned int channels = 0;
+		unsigned char * data = nullptr;
+		if(!std::ifstream(basePath + suffixes[aid]).good()){
+			cached = false;
+			break;
+		}
+		const int ret = ImageUtilities::loadImage(basePath + suffixes[aid], width, height, channels, (void**)&data, true, true);
+		if(ret != 0 || data == nullptr || width != side || height != side || channels != 4){
+			cached = false;
+		} else {
+			atlases[aid].assign(data, data + 4 * size_t(side) * side);
+		}
+		free(data);
+	}
+	
+	if(cached){
+		Log::Info() << Log::Resources << "Impostor " << name << " loaded from cache." << std::endl;
+	} else {
+		bake(local, atlases[0], atlases[1], atlases[2]);
+		for(int aid = 0; aid < 3; ++aid){
+			ImageUtilities::saveLDRImage(basePath + suffixes[aid], side, side, 4, atlases[aid].data(), true, false);
+		}
+		Log::Info() << Log::Resources << "Impostor " << name << " baked and cached at " << basePath << "." << std::endl;
+	}
+	upload(atlases[0], atlases[1], atlases[2]);
+	checkGLError();
+}
+
+void Impostor::bake(const Object & object, std::vector<unsigned char> & albedo, std::vector<unsigned char> & normal, std::vector<unsigned char> & effects) const {
+	const unsigned int side = _frames * _frameSize;
+	const size_t pixelCount = size_t(side) * side;
+	const float radius = _bounds.radius;
+	
+	// Same formats as the renderer gbuffer.
+	const Framebuffer::Descriptor albedoDesc = { GL_RGBA16F, GL_NEAREST, GL_CLAMP_TO_EDGE };
+	const Framebuffer::Descriptor normalDesc = { GL_RGB16F, GL_NEAREST, GL_CLAMP_TO_EDGE };
+	const Framebuffer::Descriptor effectsDesc = { GL_RGB8, GL_NEAREST, GL_CLAMP_TO_EDGE };
+	Framebuffer atlas(side, side, {albedoDesc, normalDesc, effectsDesc}, true);
+	
+	GLfloat clearColor[4];
+	glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+	const GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+	const GLboolean cullFace = glIsEnabled(GL_CULL_FACE);
+	GLUtilities::setEnabled(GL_DEPTH_TEST, true);
+	GLUtilities::setEnabled(GL_CULL_FACE, true);
+	
+	atlas.bind();
+	atlas.setViewport();
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	
+	// Orthographic views, looking at the sphere center from a distance of twice its radius.
+	const glm::mat4 projection = glm::ortho(-radius, radius, -radius, radius, radius, 3.0f * radius);
+	std::vector<glm::mat3> viewToModel(_frames * _frames);
+	for(unsigned int j = 0; j < _frames; ++j){
+		for(unsigned int i = 0; i < _frames; ++i){
+			const glm::vec3 dir = frameDirection(glm::vec2(i, j), _frames);
+			const glm::mat4 view = glm::lookAt(_bounds.center + 2.0f * radius * dir, _bounds.center, frameUp(dir));
+			viewToModel[j * _frames + i] = glm::transpose(glm::mat3(view));
+			GLUtilities::setViewport(GLint(i * _frameSize), GLint(j * _frameSize), GLsizei(_frameSize), GLsizei(_frameSize));
+			object.draw(view, projection);
+		}
+	}
+	
+	// Read back all attachments.
+	std::vector<glm::vec4> albedoData(pixelCount);
+	std::vector<glm::vec4> normalData(pixelCount);
+	std::vector<glm::vec4> effectsData(pixelCount);
+	std::vector<float> depthData(pixelCount);
+	glm::vec4 * colorData[3] = { albedoData.data(), normalData.data(), effectsData.data() };
+	for(GLenum aid = 0; aid < 3; ++aid){
+		glReadBuffer(GL_COLOR_ATTACHMENT0 + aid);
+		glReadPixels(0, 0, GLsizei(side), GLsizei(side), GL_RGBA, GL_FLOAT, colorData[aid]);
+	}
+	glReadPixels(0, 0, GLsizei(side), GLsizei(side), GL_DEPTH_COMPONENT, GL_FLOAT, depthData.data());
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	atlas.unbind();
+	atlas.clean();
+	
+	glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+	if(!depthTest){
+		GLUtilities::setEnabled(GL_DEPTH_TEST, false);
+	}
+	if(!cullFace){
+		GLUtilities::setEnabled(GL_CULL_FACE, false);
+	}
+	
+	// Pack the atlases: albedo in sRGB with coverage, normal in model space with depth.
+	albedo.assign(4 * pixelCount, 0);
+	normal.assign(4 * pixelCount, 0);
+	effects.assign(4 * pixelCount, 0);
+	std::vector<bool> covered(pixelCount, false);
+	for(size_t pid = 0; pid < pixelCount; ++pid){
+		if(depthData[pid] >= 1.0f){
+			continue;
+		}
+		covered[pid] = true;
+		const unsigned int x = (unsigned int)(pid % side) / _frameSize;
+		const unsigned int y = (unsigned int)(pid / side) / _frameSize;
+		const glm::vec3 color = glm::convertLinearToSRGB(glm::clamp(glm::vec3(albedoData[pid]), 0.0f, 1.0f));
+		const glm::vec3 viewNormal = glm::vec3(normalData[pid]) * 2.0f - 1.0f;
+		const glm::vec3 modelNormal = glm::normalize(viewToModel[y * _frames + x] * viewNormal) * 0.5f + 0.5f;
+		const glm::vec3 effect = glm::clamp(glm::vec3(effectsData[pid]), 0.0f, 1.0f);
+		for(int c = 0; c < 3; ++c){
+			albedo[4 * pid + c] = (unsigned char)(std::round(color[c] * 255.0f));
+			normal[4 * pid + c] = (unsigned char)(std::round(glm::clamp(modelNormal[c], 0.0f, 1.0f) * 255.0f));
+			effects[4 * pid + c] = (unsigned char)(std::round(effect[c] * 255.0f));
+		}
+		albedo[4 * pid + 3] = 255;
+		normal[4 * pid + 3] = (unsigned char)(std::round(glm::clamp(depthData[pid], 0.0f, 1.0f) * 255.0f));
+		effects[4 * pid + 3] = 255;
+	}
+	dilate({&albedo, &normal, &effects}, covered, side, _frameSize, 4);
+}
+
+void Impostor::upload(const std::vector<unsigned char> & albedo, const std::vector<unsigned char> & normal, const std::vector<unsigned char> & effects){
+	const unsigned int side = _frames * _frameSize;
+	// Stop the mipmaps before views get smaller than 8 pixels, to limit bleeding between them.
+	int maxLevel = 0;
+	while((_frameSize >> (maxLevel + 1)) >= 8){
+		++maxLevel;
+	}
+	const std::vector<unsigned char> * atlases[3] = { &albedo, &normal, &effects };
+	_textures.clear();
+	for(int aid = 0; aid < 3; ++aid){
+		TextureInfos infos;
+		glGenTextures(1, &infos.id);
+		GLUtilities::bindTexture(0, GL_TEXTURE_2D, infos.id);
+		glTexImage2D(GL_TEXTURE_2D, 0, aid == 0 ? GL_SRGB8_ALPHA8 : GL_RGBA8, GLsizei(side), GLsizei(side), 0, GL_RGBA, GL_UNSIGNED_BYTE, atlases[aid]->data());
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, maxLevel);
+		glGenerateMipmap(GL_TEXTURE_2D);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		infos.width = infos.height = side;
+		infos.mipmap = (unsigned int)maxLevel + 1;
+		_textures.push_back(infos);
+	}
+	GLUtilities::bindTexture(0, GL_TEXTURE_2D, 0);
+}
+
+void Impostor::draw(const glm::mat4 & view, const glm::mat4 & projection, const glm::mat4 & model) const {
+	if(_vao == 0){
+		// Empty vertex array (imposed by the OpenGL spec).
+		glGenVertexArrays(1, &_vao);
+	}
+	const glm::mat4 MV = view * model;
+	const glm::mat4 MVP = projection * MV;
+	const glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(MV)));
+	const glm::vec3 viewPos = glm::vec3(glm::inverse(MV) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+	
+	GLUtilities::useProgram(_program->id());
+	glUniformMatrix4fv(_program->uniform("mvp"), 1, GL_FALSE, &MVP[0][0]);
+	glUniformMatrix3fv(_program->uniform("normalMatrix"), 1, GL_FALSE, &normalMatrix[0][0]);
+	glUniform3fv(_program->uniform("viewPos"), 1, &viewPos[0]);
+	glUniform3fv(_program->uniform("center"), 1, &_bounds.center[0]);
+	glUniform1f(_program->uniform("radius"), _bounds.radius);
+	glUniform1i(_program->uniform("frames"), int(_frames));
+	
+	for(unsigned int i = 0; i < _textures.size(); ++i){
+		GLUtilities::bindTexture(i, GL_TEXTURE_2D, _textures[i].id);
+	}
+	GLUtilities::bindVertexArray(_vao);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
+
+void Impostor::clean() const {
+	for(const auto & texture : _textures){
+		GLUtilities::deleteTexture(texture.id);
+	}
+}
@@ -0,0 +1,73 @@
+#ifndef Impostor_h
+#define Impostor_h
+#include "resources/ResourcesManager.hpp"
+#include "Common.hpp"
+
+class Object;
+
+/**
+ \brief Billboard replacing an object seen from afar, rendered from atlases of views baked over the upper hemisphere.
+ \details Views are placed on a hemi-octahedral grid: the view from a direction d is stored in the cell containing (d.x + d.z, d.x - d.z) / (|d.x| + |d.y| + |d.z|). Each view stores the albedo and coverage, the model space normal and depth, and the effects of the object, as rendered by its gbuffer program. At runtime, the four views closest to the viewing direction are blended.
+ \see GLSL::Vert::Impostor_gbuffer, GLSL::Frag::Impostor_gbuffer
+ \ingroup Engine
+ */
+class Impostor {
+
+public:
+
+	/** Load the impostor of an object from the cache, or bake and cache it.
+	 \param object the object to represent, its transformation is ignored
+	 \param name the name of the impostor in the cache, should be unique for each object geometry and material
+	 \param frames the number of views along each side of the atlases
+	 \param frameSize the size in pixels of each view
+	 \note Baking renders the object and should happen outside of any rendering pass.
+	 */
+	Impostor(const Object & object, const std::string & name, unsigned int frames = 8, unsigned int frameSize = 128);
+	
+	/** Render the impostor in the gbuffer.
+	 \param view the camera view matrix
+	 \param projection the camera projection matrix
+	 \param model the object transformation
+	 */
+	void draw(const glm::mat4 & view, const glm::mat4 & projection, const glm::mat4 & model) const;
+	
+	/** Query the bounding sphere of the object, in model space.
+	 \return the sphere covered by the impostor
+	 */
+	const BoundingSphere & bounds() const { return _bounds; }
+	
+	/** Clean internal resources. */
+	void clean() const;
+	
+	/** Directory where baked impostors are cached, along with other derived assets.
+	 */
+	static std::string cachePath;
+
+private:
+
+	/** Render the object views and fill the atlases.
+	 \param object the object to render
+	 \param albedo will contain the albedo (sRGB) and coverage
+	 \param normal will contain the model space normal and the depth
+	 \param effects will contain the effects
+	 */
+	void bake(const Object & object, std::vector<unsigned char> & albedo, std::vector<unsigned char> & normal, std::vector<unsigned char> & effects) const;
+	
+	/** Upload the atlases to the GPU.
+	 \param albedo the albedo (sRGB) and coverage
+	 \param normal the model space normal and the depth
+	 \param effects the effects
+	 */
+	void upload(const std::vector<unsigned char> & albedo, const std::vector<unsigned char> & normal, const std::vector<unsigned char> & effects);
+	
+	std::shared_ptr<ProgramInfos> _program; ///< The impostor program.
+	std::vector<TextureInfos> _textures; ///< The albedo, normal and effects atlases.
+	BoundingSphere _bounds; ///< The object bounding sphere in model space.
+	unsigned int _frames; ///< The number of views along each side of the atlases.
+	unsigned int _frameSize; ///< The size in pixels of each view.
+	
+	static GLuint _vao; ///< Empty vertex array, the billboard vertices are generated in the vertex shader.
+
+};
+
+#endif
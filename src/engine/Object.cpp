@@ -1,4 +1,6 @@
 #include "Object.hpp"
+#include "Impostor.hpp"
+#include <tuple>
 
 
 Object::Object() {}
@@ -8,26 +10,38 @@ Object::Object(const Object::Type & type, const std::string& meshPath, const std
 	_material = static_cast<int>(type);
 	_castShadow = castShadows;
 	
+	// The gbuffer programs expect the compact vertex layout. The skybox is rendered without translation and can't use quantized positions.
+	unsigned int meshProcessing = Resources::OptimizeCache | Resources::CompactLayout;
 	switch (_material) {
 	case Object::Skybox:
 		_program = Resources::manager().getProgram("skybox_gbuffer");
 		break;
 	case Object::Parallax:
 		_program = Resources::manager().getProgram("parallax_gbuffer");
+		_programInstanced = Resources::manager().getProgram("parallax_gbuffer_instanced", "parallax_gbuffer_instanced", "parallax_gbuffer");
+		meshProcessing |= Resources::QuantizePositions | Resources::GenerateLevels | Resources::BuildMeshlets | Resources::BuildBVH;
 		break;
 	case Object::Regular:
 	default:
 		_program = Resources::manager().getProgram("object_gbuffer");
+		_programInstanced = Resources::manager().getProgram("object_gbuffer_instanced", "object_gbuffer_instanced", "object_gbuffer");
+		meshProcessing |= Resources::QuantizePositions | Resources::GenerateLevels | Resources::BuildMeshlets | Resources::BuildBVH;
 		break;
 	}
 
 	// Load geometry.
-	_mesh = Resources::manager().getMesh(meshPath);
+	_mesh = Resources::manager().getMesh(meshPath, meshProcessing);
 
-	// Load and upload the textures.
-	for (unsigned int i = 0; i < texturesPaths.size(); ++i) {
-		const auto & textureName = texturesPaths[i];
-		_textures.push_back(Resources::manager().getTexture(textureName.first, textureName.second));
+	// Load and upload the textures. Regular and parallax objects store their textures in arrays shared with other materials.
+	if(_material == Object::Regular || _material == Object::Parallax){
+		const MaterialInfos material = Resources::manager().getMaterial(texturesPaths);
+		_textures = material.textures;
+		_materialLayer = material.layer;
+	} else {
+		for (unsigned int i = 0; i < texturesPaths.size(); ++i) {
+			const auto & textureName = texturesPaths[i];
+			_textures.push_back(Resources::manager().getTexture(textureName.first, textureName.second));
+		}
 	}
 	for (unsigned int i = 0; i < cubemapPaths.size(); ++i) {
 		const auto & textureName = cubemapPaths[i];
@@ -35,6 +49,7 @@ Object::Object(const Object::Type & type, const std::string& meshPath, const std
 	}
 	
 	_model = glm::mat4(1.0f);
+	_normalMatrix = glm::mat3(1.0f);
 	checkGLError();
 
 }
@@ -48,7 +63,7 @@ Object::Object(std::shared_ptr<ProgramInfos> & program, const std::string& meshP
 	_program = program;
 	
 	// Load geometry.
-	_mesh = Resources::manager().getMesh(meshPath);
+	_mesh = Resources::manager().getMesh(meshPath, Resources::OptimizeCache);
 	
 	// Load and upload the textures.
 	for (unsigned int i = 0; i < texturesPaths.size(); ++i) {
@@ -60,6 +75,7 @@ Object::Object(std::shared_ptr<ProgramInfos> & program, const std::string& meshP
 		_textures.push_back(Resources::manager().getCubemap(textureName.first, textureName.second));
 	}
 	_model = glm::mat4(1.0f);
+	_normalMatrix = glm::mat3(1.0f);
 	checkGLError();
 	
 }
@@ -67,64 +83,307 @@ Object::Object(std::shared_ptr<ProgramInfos> & program, const std::string& meshP
 void Object::update(const glm::mat4& model) {
 
 	_model = model;
+	_normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+	++_revision;
 
 }
 
+void Object::update(const glm::mat4& model, const glm::mat3& normalMatrix) {
 
-void Object::draw(const glm::mat4& view, const glm::mat4& projection) const {
+	_model = model;
+	_normalMatrix = normalMatrix;
+	++_revision;
+
+}
+
+
+void Object::draw(const glm::mat4& view, const glm::mat4& projection, unsigned int level, const DrawRanges * ranges) const {
+	setupProgram(*_program, view, projection);
+	if(ranges){
+		drawGeometry(*ranges);
+	} else {
+		drawGeometry(level);
+	}
+	GLUtilities::useProgram(0);
+}
 
-	// Combine the three matrices.
-	glm::mat4 MV = view * _model;
-	glm::mat4 MVP = projection * MV;
 
-	// Compute the normal matrix
-	glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(MV)));
+void Object::draw(const ProgramInfos & program, const glm::mat4& view, const glm::mat4& projection, const DrawRanges & ranges) const {
+	setupProgram(program, view, projection);
+	drawGeometry(ranges);
+	GLUtilities::useProgram(0);
+}
+
+
+void Object::setupProgram(const ProgramInfos & program, const glm::mat4& view, const glm::mat4& projection) const {
 	// Select the program (and shaders).
-	glUseProgram(_program->id());
+	GLUtilities::useProgram(program.id());
+	uploadUniforms(program, view, projection);
+	bindTextures();
+}
+
+
+void Object::uploadUniforms(const ProgramInfos & program, const glm::mat4& view, const glm::mat4& projection) const {
+	DrawUniforms uniforms;
+	computeUniforms(view, projection, uniforms);
+	uploadUniforms(program, uniforms, projection);
+}
+
+
+void Object::computeUniforms(const glm::mat4& view, const glm::mat4& projection, DrawUniforms & uniforms) const {
+	// Combine the three matrices.
+	uniforms.mv = view * vertexModel();
+	uniforms.mvp = projection * uniforms.mv;
+	// The view matrix is rigid, the normal matrix only needs the view rotation applied to the cached model one.
+	uniforms.normalMatrix = glm::mat3(view) * _normalMatrix;
+}
+
+
+void Object::uploadUniforms(const ProgramInfos & program, const DrawUniforms & uniforms, const glm::mat4& projection) const {
 
 	// Upload the MVP matrix.
-	glUniformMatrix4fv(_program->uniform("mvp"), 1, GL_FALSE, &MVP[0][0]);
+	glUniformMatrix4fv(program.uniform("mvp"), 1, GL_FALSE, &uniforms.mvp[0][0]);
 
 	switch (_material) {
 		case Object::Parallax:
 			// Upload the projection matrix.
-			glUniformMatrix4fv(_program->uniform("p"), 1, GL_FALSE, &projection[0][0]);
+			glUniformMatrix4fv(program.uniform("p"), 1, GL_FALSE, &projection[0][0]);
 			// Upload the MV matrix.
-			glUniformMatrix4fv(_program->uniform("mv"), 1, GL_FALSE, &MV[0][0]);
+			glUniformMatrix4fv(program.uniform("mv"), 1, GL_FALSE, &uniforms.mv[0][0]);
 			// Upload the normal matrix.
-			glUniformMatrix3fv(_program->uniform("normalMatrix"), 1, GL_FALSE, &normalMatrix[0][0]);
+			glUniformMatrix3fv(program.uniform("normalMatrix"), 1, GL_FALSE, &uniforms.normalMatrix[0][0]);
+			// Upload the material layer.
+			glUniform1i(program.uniform("material"), int(_materialLayer));
 			break;
 		case Object::Regular:
 			// Upload the normal matrix.
-			glUniformMatrix3fv(_program->uniform("normalMatrix"), 1, GL_FALSE, &normalMatrix[0][0]);
+			glUniformMatrix3fv(program.uniform("normalMatrix"), 1, GL_FALSE, &uniforms.normalMatrix[0][0]);
+			// Upload the material layer.
+			glUniform1i(program.uniform("material"), int(_materialLayer));
 			break;
 		default:
 			break;
 	}
-	
+}
 
-	// Bind the textures.
+
+void Object::bindTextures() const {
 	for (unsigned int i = 0; i < _textures.size(); ++i){
-		glActiveTexture(GL_TEXTURE0 + i);
-		glBindTexture(_textures[i].cubemap ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D, _textures[i].id);
+		const GLenum target = _textures[i].cubemap ? GL_TEXTURE_CUBE_MAP : (_textures[i].array ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D);
+		GLUtilities::bindTexture(i, target, _textures[i].id);
+	}
+}
+
+
+void Object::drawGeometry(unsigned int level) const {
+	if(_mesh.levels.empty()){
+		return;
 	}
-	drawGeometry();
-	glUseProgram(0);
+	const LevelOfDetail & lod = _mesh.levels[std::min(size_t(level), _mesh.levels.size() - 1)];
+	GLUtilities::bindVertexArray(_mesh.vId);
+	GLUtilities::drawElements((GLsizei)lod.count, _mesh.indexType, lod.firstIndex, _mesh.baseVertex);
 }
 
 
-void Object::drawGeometry() const {
-	glBindVertexArray(_mesh.vId);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _mesh.eId);
-	glDrawElements(GL_TRIANGLES, _mesh.count, GL_UNSIGNED_INT, (void*)0);
-	glBindVertexArray(0);
+void Object::drawPositions(unsigned int level) const {
+	if(_mesh.levels.empty()){
+		return;
+	}
+	const LevelOfDetail & lod = _mesh.levels[std::min(size_t(level), _mesh.levels.size() - 1)];
+	GLUtilities::bindVertexArray(_mesh.vIdDepth);
+	GLUtilities::drawElements((GLsizei)lod.count, _mesh.indexTypeDepth, lod.firstIndex, _mesh.baseVertexDepth);
+}
+
+
+void Object::drawGeometry(const DrawRanges & ranges) const {
+	if(ranges.counts.empty()){
+		return;
+	}
+	GLUtilities::bindVertexArray(_mesh.vId);
+	GLUtilities::multiDrawElements(ranges.counts, _mesh.indexType, ranges.offsets, ranges.baseVertices);
+}
+
+
+void Object::drawPositions(const DrawRanges & ranges) const {
+	if(ranges.counts.empty()){
+		return;
+	}
+	GLUtilities::bindVertexArray(_mesh.vIdDepth);
+	GLUtilities::multiDrawElements(ranges.counts, _mesh.indexTypeDepth, ranges.offsets, ranges.baseVertices);
+}
+
+
+void Object::DrawRanges::append(size_t firstIndex, size_t count, size_t indexSize, GLint baseVertex){
+	const size_t offset = firstIndex * indexSize;
+	if(!counts.empty() && baseVertices.back() == baseVertex && size_t(offsets.back()) + size_t(counts.back()) * indexSize == offset){
+		counts.back() += (GLsizei)count;
+		return;
+	}
+	counts.push_back((GLsizei)count);
+	offsets.push_back((const void *)offset);
+	baseVertices.push_back(baseVertex);
+}
+
+
+void Object::DrawRanges::clear(){
+	counts.clear();
+	offsets.clear();
+	baseVertices.clear();
+}
+
+
+void Object::appendLevel(unsigned int level, bool positionsOnly, DrawRanges & ranges) const {
+	if(_mesh.levels.empty()){
+		return;
+	}
+	const LevelOfDetail & lod = _mesh.levels[std::min(size_t(level), _mesh.levels.size() - 1)];
+	const GLenum indexType = positionsOnly ? _mesh.indexTypeDepth : _mesh.indexType;
+	const size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+	ranges.append(lod.firstIndex, lod.count, indexSize, positionsOnly ? _mesh.baseVertexDepth : _mesh.baseVertex);
+}
+
+
+size_t Object::cullClusters(const glm::mat4 & viewProjection, const glm::vec4 & viewPoint, bool testFrustum, bool positionsOnly, DrawRanges & ranges) const {
+	// Clusters data is expressed in the mesh frame.
+	const Frustum frustum = testFrustum ? Frustum(viewProjection * _model) : Frustum();
+	const glm::vec4 localViewPoint = glm::inverse(_model) * viewPoint;
+	const GLenum indexType = positionsOnly ? _mesh.indexTypeDepth : _mesh.indexType;
+	const size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+	const GLint baseVertex = positionsOnly ? _mesh.baseVertexDepth : _mesh.baseVertex;
+	
+	size_t visibleCount = 0;
+	for(const Meshlet & meshlet : _mesh.meshlets){
+		if(!meshlet.visible(frustum, localViewPoint)){
+			continue;
+		}
+		++visibleCount;
+		ranges.append(meshlet.firstIndex, meshlet.count, indexSize, baseVertex);
+	}
+	return visibleCount;
+}
+
+
+bool Object::sharesDrawState(const Object & other, bool positionsOnly) const {
+	if(vertexModel() != other.vertexModel()){
+		return false;
+	}
+	if(positionsOnly){
+		return _mesh.vIdDepth == other._mesh.vIdDepth && _mesh.indexTypeDepth == other._mesh.indexTypeDepth;
+	}
+	if(_mesh.vId != other._mesh.vId || _mesh.indexType != other._mesh.indexType || _program != other._program || _material != other._material || _materialLayer != other._materialLayer){
+		return false;
+	}
+	return sharesTextures(other);
+}
+
+
+bool Object::sharesTextures(const Object & other) const {
+	if(_textures.size() != other._textures.size()){
+		return false;
+	}
+	for(size_t tid = 0; tid < _textures.size(); ++tid){
+		if(_textures[tid].id != other._textures[tid].id){
+			return false;
+		}
+	}
+	return true;
+}
+
+
+size_t Object::batch(std::vector<Object> & objects){
+	// Group meshes by vertex layout, objects sharing a mesh are only packed once.
+	std::map<std::tuple<GLsizei, GLsizei, bool>, std::vector<MeshInfos *>> layouts;
+	std::map<GLuint, MeshInfos *> uniqueMeshes;
+	for(Object & object : objects){
+		MeshInfos & mesh = object._mesh;
+		if(mesh.vertexBuffer == 0 || uniqueMeshes.count(mesh.vId) > 0){
+			continue;
+		}
+		uniqueMeshes[mesh.vId] = &mesh;
+		layouts[std::make_tuple(mesh.vertexSize, mesh.vertexSizeDepth, mesh.quantizedPositions)].push_back(&mesh);
+	}
+	
+	// Keep the original mesh of each object to update the ones sharing it.
+	std::vector<GLuint> originalIds(objects.size());
+	for(size_t oid = 0; oid < objects.size(); ++oid){
+		originalIds[oid] = objects[oid]._mesh.vId;
+	}
+	for(const auto & layout : layouts){
+		if(layout.second.size() > 1){
+			GLUtilities::batchMeshes(layout.second);
+		}
+	}
+	
+	size_t batchedCount = 0;
+	for(size_t oid = 0; oid < objects.size(); ++oid){
+		if(uniqueMeshes.count(originalIds[oid]) == 0){
+			continue;
+		}
+		const MeshInfos & batched = *uniqueMeshes[originalIds[oid]];
+		if(batched.vId == originalIds[oid]){
+			// The mesh was left in its own buffers.
+			continue;
+		}
+		objects[oid]._mesh = batched;
+		++batchedCount;
+	}
+	return batchedCount;
+}
+
+
+unsigned int Object::selectLevel(const glm::vec3 & viewPoint, float pixelsPerUnit, bool orthographic, float maxPixelError) const {
+	if(_mesh.levels.size() < 2){
+		return 0;
+	}
+	const BoundingSphere sphere = getBoundingBox().getSphere();
+	float projectedRadius = sphere.radius * pixelsPerUnit;
+	if(!orthographic){
+		const float distance = glm::length(sphere.center - viewPoint);
+		// The viewpoint is inside the object bounds.
+		if(distance <= sphere.radius){
+			return 0;
+		}
+		projectedRadius /= distance;
+	}
+	// Errors are relative to the radius and increase with each level.
+	unsigned int level = 0;
+	while(level + 1 < _mesh.levels.size() && _mesh.levels[level+1].error * projectedRadius <= maxPixelError){
+		++level;
+	}
+	return level;
+}
+
+
+bool Object::showsImpostor(const glm::vec3 & viewPoint, float pixelsPerUnit, float maxPixelSize) const {
+	if(!_impostor){
+		return false;
+	}
+	const BoundingSphere sphere = getBoundingBox().getSphere();
+	const float distance = glm::length(sphere.center - viewPoint);
+	if(distance <= sphere.radius){
+		return false;
+	}
+	return 2.0f * sphere.radius * pixelsPerUnit / distance < maxPixelSize;
+}
+
+
+void Object::drawImpostor(const glm::mat4& view, const glm::mat4& projection) const {
+	if(_impostor){
+		_impostor->draw(view, projection, _model);
+	}
 }
 
 
 void Object::clean() const {
-	glDeleteVertexArrays(1, &_mesh.vId);
+	// Deleting the bound vertex array would silently reset the binding.
+	GLUtilities::bindVertexArray(0);
+	GLUtilities::deleteVertexArray(_mesh.vId);
+	GLUtilities::deleteVertexArray(_mesh.vIdDepth);
 	for (auto & texture : _textures) {
-		glDeleteTextures(1, &(texture.id));
+		GLUtilities::deleteTexture(texture.id);
+	}
+	if(_impostor){
+		_impostor->clean();
 	}
 }
 
@@ -3,6 +3,8 @@
 #include "resources/ResourcesManager.hpp"
 #include "Common.hpp"
 
+class Impostor;
+
 /**
  \brief Represent a 3D textured object.
  \ingroup Engine
@@ -14,10 +16,41 @@ public:
 	/// \brief Type of shading/effects.
 	enum Type {
 		Skybox = 0, ///< \see GLSL::Vert::Skybox_gbuffer, GLSL::Frag::Skybox_gbuffer
-		Regular = 1, ///< \see GLSL::Vert::Object_gbuffer, GLSL::Frag::Object_gbuffer
-		Parallax = 2, ///< \see GLSL::Vert::Parallax_gbuffer, GLSL::Frag::Parallax_gbuffer
+		Regular = 1, ///< \see GLSL::Vert::Object_gbuffer, GLSL::Vert::Object_gbuffer_instanced, GLSL::Frag::Object_gbuffer
+		Parallax = 2, ///< \see GLSL::Vert::Parallax_gbuffer, GLSL::Vert::Parallax_gbuffer_instanced, GLSL::Frag::Parallax_gbuffer
 		Custom = 3  ///< \see GLSL::Vert::Object_basic, GLSL::Frag::Object_basic, GLSL::Vert::Skybox_basic, GLSL::Frag::Skybox_basic
 	};
+	
+	/// \brief Ranges of an element buffer to render in a single call, for instance the visible clusters of one or several objects sharing the same buffers.
+	struct DrawRanges {
+		std::vector<GLsizei> counts; ///< Number of indices in each range.
+		std::vector<const void *> offsets; ///< Byte offset of each range in the element buffer.
+		std::vector<GLint> baseVertices; ///< Offset added to the indices of each range when fetching vertices.
+		
+		/** Append a range, merging it with the last one if they are contiguous.
+		 \param firstIndex the position of the range first index
+		 \param count the number of indices
+		 \param indexSize the size of an index in bytes
+		 \param baseVertex the offset added to indices when fetching vertices
+		 */
+		void append(size_t firstIndex, size_t count, size_t indexSize, GLint baseVertex);
+		
+		/** Remove all ranges. */
+		void clear();
+	};
+	
+	/// \brief Transformations of an object for a viewpoint, computed ahead of rendering.
+	struct DrawUniforms {
+		glm::mat4 mvp; ///< Model-view-projection transformation, including the positions dequantization.
+		glm::mat4 mv; ///< Model-view transformation, including the positions dequantization.
+		glm::mat3 normalMatrix; ///< Normal transformation to view space.
+	};
+	
+	/// \brief Counts of clusters considered and rendered by a pass.
+	struct ClusterStatistics {
+		size_t total = 0; ///< Number of clusters of the objects rendered at full resolution.
+		size_t drawn = 0; ///< Number of clusters that passed the culling tests.
+	};
 
 	/** Constructor */
 	Object();
@@ -46,16 +79,146 @@ public:
 	 */
 	void update(const glm::mat4& model);
 	
+	/** Update the object transformation matrix, with a precomputed normal matrix.
+	 \param model the new model matrix
+	 \param normalMatrix the inverse transpose of the model matrix upper-left 3x3 block
+	 */
+	void update(const glm::mat4& model, const glm::mat3& normalMatrix);
+	
 	/** Render the object using its textures and shading program.
 	 \param view the camera view matrix
 	 \param projection the camera projection matrix
+	 \param level the level of detail to render
+	 \param ranges if non-null, the ranges of the full resolution level to render instead
+	 \note The view matrix should be rigid, as it is combined with the cached normal matrix.
+	 */
+	void draw(const glm::mat4& view, const glm::mat4& projection, unsigned int level = 0, const DrawRanges * ranges = nullptr) const;
+	
+	/** Render the object using its textures and another shading program, expecting the same uniforms and textures as the object program.
+	 \param program the program to use
+	 \param view the camera view matrix
+	 \param projection the camera projection matrix
+	 \param ranges the ranges of the object levels to render
+	 */
+	void draw(const ProgramInfos & program, const glm::mat4& view, const glm::mat4& projection, const DrawRanges & ranges) const;
+	
+	/** Upload the object transformations and material layer to a program, which should already be in use.
+	 \param program the program to upload to
+	 \param view the camera view matrix
+	 \param projection the camera projection matrix
+	 */
+	void uploadUniforms(const ProgramInfos & program, const glm::mat4& view, const glm::mat4& projection) const;
+	
+	/** Compute the object transformations for a viewpoint, without any GL call.
+	 \param view the camera view matrix, should be rigid
+	 \param projection the camera projection matrix
+	 \param uniforms will contain the transformations
 	 */
-	void draw(const glm::mat4& view, const glm::mat4& projection) const;
+	void computeUniforms(const glm::mat4& view, const glm::mat4& projection, DrawUniforms & uniforms) const;
+	
+	/** Upload precomputed object transformations and the material layer to a program, which should already be in use.
+	 \param program the program to upload to
+	 \param uniforms the transformations computed for the current viewpoint
+	 \param projection the camera projection matrix
+	 */
+	void uploadUniforms(const ProgramInfos & program, const DrawUniforms & uniforms, const glm::mat4& projection) const;
+	
+	/** Bind the object textures to successive texture units, starting at the first one. */
+	void bindTextures() const;
+	
+	/** Pack the meshes of objects in shared buffers, so that successive objects can be rendered without switching vertex arrays. Objects sharing a mesh share the same part of the buffers.
+	 \param objects the objects to batch, only those using the compact vertex layout are considered
+	 \return the number of objects batched
+	 \note One set of buffers is created for each vertex layout. \see GLUtilities::batchMeshes
+	 */
+	static size_t batch(std::vector<Object> & objects);
+	
+	/** Test if the geometry of another object can be appended to the same draw call as this object: both objects should use the same vertex array and transformation, and the same program, textures and material layer unless only positions are rendered.
+	 \param other the other object
+	 \param positionsOnly is the position-only geometry rendered
+	 \return true if the draws can be merged
+	 */
+	bool sharesDrawState(const Object & other, bool positionsOnly) const;
+	
+	/** Test if another object uses the same textures, in the same order.
+	 \param other the other object
+	 \return true if the bound textures can be reused
+	 */
+	bool sharesTextures(const Object & other) const;
+	
+	/** Append a level of detail to a list of ranges.
+	 \param level the level of detail to render
+	 \param positionsOnly should the range refer to the position-only element buffer
+	 \param ranges the ranges to append to
+	 */
+	void appendLevel(unsigned int level, bool positionsOnly, DrawRanges & ranges) const;
 	
 	/**
 	 Just bind and draw the geometry, with no implicit shader or textures.
+	 \param level the level of detail to render
+	 */
+	void drawGeometry(unsigned int level = 0) const;
+	
+	/**
+	 Just bind and draw some ranges of the geometry, with no implicit shader or textures.
+	 \param ranges the ranges to render, as generated by cullClusters or appendLevel, for this object or others sharing its draw state
+	 */
+	void drawGeometry(const DrawRanges & ranges) const;
+	
+	/**
+	 Just bind and draw the position-only geometry, for depth-only passes.
+	 \param level the level of detail to render
+	 */
+	void drawPositions(unsigned int level = 0) const;
+	
+	/**
+	 Just bind and draw some ranges of the position-only geometry, for depth-only passes.
+	 \param ranges the ranges to render, as generated by cullClusters or appendLevel, for this object or others sharing its draw state
 	 */
-	void drawGeometry() const;
+	void drawPositions(const DrawRanges & ranges) const;
+	
+	/** Cull the clusters of the full resolution level against a view frustum and their normal cones, and merge the remaining ones in contiguous ranges.
+	 \param viewProjection the view-projection matrix of the viewpoint
+	 \param viewPoint the world space position of the viewpoint (w = 1), or the direction towards it for orthographic projections (w = 0)
+	 \param testFrustum should clusters outside of the view frustum be culled
+	 \param positionsOnly should the ranges refer to the position-only element buffer
+	 \param ranges the visible ranges will be appended to it
+	 \return the number of visible clusters
+	 */
+	size_t cullClusters(const glm::mat4 & viewProjection, const glm::vec4 & viewPoint, bool testFrustum, bool positionsOnly, DrawRanges & ranges) const;
+	
+	/** Query the number of clusters of the full resolution level.
+	 \return the cluster count, zero if the mesh was not split
+	 */
+	size_t clusterCount() const { return _mesh.meshlets.size(); }
+	
+	/** Select the coarsest level of detail whose simplification error, once projected, stays below a given threshold.
+	 \param viewPoint the world space position of the viewpoint, ignored for orthographic projections
+	 \param pixelsPerUnit the size in pixels of a unit length at a unit distance from the viewpoint, or at any distance for orthographic projections
+	 \param orthographic is the projection orthographic
+	 \param maxPixelError the maximum projected error allowed, in pixels
+	 \return the level of detail index
+	 */
+	unsigned int selectLevel(const glm::vec3 & viewPoint, float pixelsPerUnit, bool orthographic, float maxPixelError) const;
+	
+	/** Use an impostor to render the object when it is small on screen.
+	 \param impostor the impostor, baked from the object
+	 */
+	void setImpostor(const std::shared_ptr<Impostor> & impostor){ _impostor = impostor; }
+	
+	/** Test if the object should be rendered with its impostor, when the projection of its bounding sphere is small enough.
+	 \param viewPoint the world space position of the viewpoint
+	 \param pixelsPerUnit the size in pixels of a unit length at a unit distance from the viewpoint
+	 \param maxPixelSize the maximum projected diameter of the bounding sphere, in pixels
+	 \return true if the object has an impostor and it should be used
+	 */
+	bool showsImpostor(const glm::vec3 & viewPoint, float pixelsPerUnit, float maxPixelSize) const;
+	
+	/** Render the object impostor in the gbuffer.
+	 \param view the camera view matrix
+	 \param projection the camera projection matrix
+	 */
+	void drawImpostor(const glm::mat4& view, const glm::mat4& projection) const;
 	
 	/** Clean internal data */
 	void clean() const;
@@ -65,27 +228,101 @@ public:
 	 */
 	BoundingBox getBoundingBox() const;
 	
+	/** Query the bounding box of the object mesh, before transformation.
+	 \return the model space bounding box
+	 */
+	const BoundingBox & getModelBoundingBox() const { return _mesh.bbox; }
+	
 	/** Query if the object should cast shadows or not.
 	 \return if it is a shadow caster
 	 */
 	bool castsShadow() const { return _castShadow; }
 	
+	/** Query the number of times the object transformation has been updated, to detect changes of its bounds.
+	 \return the revision counter
+	 */
+	unsigned int revision() const { return _revision; }
+	
+	/** Query the object material type.
+	 \return the type
+	 */
+	Type type() const { return Type(_material); }
+	
+	/** Query the program used to render the object.
+	 \return the program
+	 */
+	const ProgramInfos & program() const { return *_program; }
+	
+	/** Query the program used to render several instances of the object in a single call, reading the per-instance transformations and material from vertex attributes. \see RenderQueue::Instance
+	 \return the program, or null if the object can't be instanced
+	 */
+	const ProgramInfos * instancedProgram() const { return _programInstanced.get(); }
+	
+	/** Query the textures used by the object.
+	 \return the 2D textures followed by the cubemaps
+	 */
+	const std::vector<TextureInfos> & textures() const { return _textures; }
+	
+	/** Query the layer of the object material in its texture arrays.
+	 \return the layer, 0 if the object textures are not arrays
+	 */
+	unsigned int materialLayer() const { return _materialLayer; }
+	
+	/** Query the vertex array storing the object geometry.
+	 \param positionsOnly should the position-only vertex array be returned
+	 \return the vertex array OpenGL ID
+	 */
+	GLuint vertexArray(bool positionsOnly) const { return positionsOnly ? _mesh.vIdDepth : _mesh.vId; }
+	
+	/** Query the size of the indices of the object geometry.
+	 \param positionsOnly should the size of the position-only indices be returned
+	 \return the size of an index in bytes
+	 */
+	size_t indexSize(bool positionsOnly) const { return (positionsOnly ? _mesh.indexTypeDepth : _mesh.indexType) == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint); }
+	
 	/** Query the object transformation palcing it in world space.
 	 \return the model matrix
 	 */
 	const glm::mat4 & model() const { return _model; }
 	
+	/** Query the transformation placing the stored mesh vertices in world space, including the dequantization of positions.
+	 \return the model matrix to use for rendering
+	 */
+	glm::mat4 vertexModel() const { return _model * _mesh.dequantization; }
+	
+	/** Query the transformation of normals from the object frame to world space.
+	 \return the cached normal matrix
+	 */
+	const glm::mat3 & normalMatrix() const { return _normalMatrix; }
+	
+	/** Query the hierarchy over the object mesh triangles, in model space.
+	 \return the hierarchy, or null if the mesh was loaded without it
+	 */
+	const MeshBVH * bvh() const { return _mesh.bvh.get(); }
+
 private:
 	
+	/** Select a program and upload the object transformations and textures.
+	 \param program the program to use
+	 \param view the camera view matrix
+	 \param projection the camera projection matrix
+	 */
+	void setupProgram(const ProgramInfos & program, const glm::mat4& view, const glm::mat4& projection) const;
+	
 	std::shared_ptr<ProgramInfos> _program; ///< Shader responsible for the object rendering.
+	std::shared_ptr<ProgramInfos> _programInstanced; ///< Shader responsible for the instanced object rendering, can be null.
 	MeshInfos _mesh; ///< Geometry of the object.
 	
 	std::vector<TextureInfos> _textures; ///< Textures used by the object.
+	unsigned int _materialLayer = 0; ///< Layer of the material in the texture arrays.
+	std::shared_ptr<Impostor> _impostor; ///< Billboard used when the object is small on screen, can be null.
 	
 	glm::mat4 _model; ///< The transformation matrix of the 3D model.
+	glm::mat3 _normalMatrix; ///< The normal transformation matrix, cached when the model matrix changes.
 	
 	int _material; ///< The material ID, based on shading effects.
 	bool _castShadow; ///< Can the object casts shadows.
+	unsigned int _revision = 0; ///< Incremented each time the transformation is updated.
 
 };
 
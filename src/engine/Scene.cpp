@@ -1,5 +1,8 @@
 #include "Scene.hpp"
 #include "Common.hpp"
+#include "Impostor.hpp"
+#include <map>
+#include <tuple>
 
 Scene::Scene(){};
 
@@ -23,22 +26,370 @@ void Scene::loadSphericalHarmonics(const std::string & name){
 	
 }
 
+TransformHierarchy::Node Scene::addObject(const Object & object, const glm::mat4 & local, TransformHierarchy::Node parent){
+	// Objects added directly are not attached to any node.
+	_objectNodes.resize(objects.size(), TransformHierarchy::None);
+	const TransformHierarchy::Node node = transforms.add(local, parent);
+	objects.push_back(object);
+	_objectNodes.push_back(node);
+	return node;
+}
+
+void Scene::loadDescription(const SceneDescription & description){
+	const std::vector<SceneDescription::Instance> & instances = description.instances();
+	const std::vector<SceneDescription::Material> & materials = description.materials();
+	
+	// Request all meshes and materials first, through one prototype object for each combination.
+	std::map<std::tuple<uint32_t, uint32_t, uint32_t, uint32_t>, size_t> prototypeIds;
+	std::vector<Object> prototypes;
+	std::vector<size_t> instancePrototypes(instances.size());
+	for(size_t iid = 0; iid < instances.size(); ++iid){
+		const SceneDescription::Instance & instance = instances[iid];
+		const auto key = std::make_tuple(instance.type, instance.mesh, instance.material, instance.flags);
+		auto prototype = prototypeIds.find(key);
+		if(prototype == prototypeIds.end()){
+			const SceneDescription::Material & material = materials[instance.material];
+			std::vector<std::pair<std::string, bool>> textures;
+			for(uint32_t tid = 0; tid < material.count; ++tid){
+				textures.emplace_back(description.string(material.textures[tid]), ((material.srgb >> tid) & 1) != 0);
+			}
+			const std::string mesh = description.string(instance.mesh);
+			prototypes.emplace_back(Object::Type(instance.type), mesh, textures, std::vector<std::pair<std::string, bool>>(), (instance.flags & SceneDescription::CastShadow) != 0);
+			if(instance.flags & SceneDescription::UseImpostor){
+				prototypes.back().setImpostor(std::make_shared<Impostor>(prototypes.back(), mesh));
+			}
+			prototype = prototypeIds.emplace(key, prototypes.size() - 1).first;
+		}
+		instancePrototypes[iid] = prototype->second;
+	}
+	
+	// Nodes are listed after their parents.
+	const std::vector<SceneDescription::Node> & nodes = description.nodes();
+	std::vector<TransformHierarchy::Node> nodeIds(nodes.size());
+	for(size_t nid = 0; nid < nodes.size(); ++nid){
+		const uint32_t parent = nodes[nid].parent;
+		nodeIds[nid] = transforms.add(nodes[nid].local, parent == SceneDescription::None ? TransformHierarchy::None : nodeIds[parent]);
+	}
+	
+	// Objects share the resources of their prototype.
+	_objectNodes.resize(objects.size(), TransformHierarchy::None);
+	objects.reserve(objects.size() + instances.size());
+	_objectNodes.reserve(objects.size() + instances.size());
+	for(size_t iid = 0; iid < instances.size(); ++iid){
+		objects.push_back(prototypes[instancePrototypes[iid]]);
+		_objectNodes.push_back(nodeIds[instances[iid].node]);
+	}
+	updateTransforms();
+	if(description.flags() & SceneDescription::Batch){
+		Object::batch(objects);
+	}
+	Log::Info() << Log::Resources << "Scene: " << instances.size() << " objects created from " << prototypes.size() << " prototypes." << std::endl;
+	
+	// Background and ambient lighting.
+	if(description.background() != SceneDescription::None){
+		const std::string cubemap = description.string(description.background());
+		background = Object(Object::Type::Skybox, "skybox", {}, {{cubemap, true }});
+		backgroundReflection = Resources::manager().getCubemap(cubemap).id;
+	}
+	if(description.irradiance() != SceneDescription::None){
+		loadSphericalHarmonics(description.string(description.irradiance()));
+	}
+	
+	// Lights, their shadow maps cover the shadow casters.
+	const BoundingBox bbox = computeBoundingBox(true);
+	for(const SceneDescription::Light & light : description.lights()){
+		const bool castShadow = (light.flags & SceneDescription::CastShadow) != 0;
+		if(light.type == SceneDescription::LightType::Directional){
+			directionalLights.emplace_back(light.direction, light.color, bbox);
+			directionalLights.back().castShadow(castShadow);
+		} else if(light.type == SceneDescription::LightType::Point){
+			pointLights.emplace_back(light.position, light.color, light.radius, bbox);
+			pointLights.back().castShadow(castShadow);
+		} else {
+			spotLights.emplace_back(light.position, light.direction, light.color, light.innerAngle, light.outerAngle, light.radius, bbox);
+			spotLights.back().castShadow(castShadow);
+		}
+	}
+}
+
+void Scene::Frame::clear(){
+	objects.clear();
+	models.clear();
+	normalMatrices.clear();
+	lights.clear();
+}
+
+void Scene::moveDirectionalLight(size_t lid, const glm::vec3 & direction){
+	_lightMoves.push_back({ Frame::LightType::Directional, (unsigned int)lid, direction });
+}
+
+void Scene::movePointLight(size_t lid, const glm::vec3 & position){
+	_lightMoves.push_back({ Frame::LightType::Point, (unsigned int)lid, position });
+}
+
+void Scene::moveSpotLight(size_t lid, const glm::vec3 & position){
+	_lightMoves.push_back({ Frame::LightType::Spot, (unsigned int)lid, position });
+}
+
+void Scene::animate(double fullTime, double frameTime){
+	update(fullTime, frameTime);
+	if(_simulated){
+		return;
+	}
+	updateTransforms();
+	updateBounds();
+}
+
+void Scene::updateTransforms(){
+	recordFrame(_frame);
+	applyFrame(_frame);
+}
+
+void Scene::recordFrame(Frame & frame){
+	frame.clear();
+	// Exchange the buffers, so that both keep their memory.
+	std::swap(frame.lights, _lightMoves);
+	if(transforms.update() == 0){
+		return;
+	}
+	const size_t count = _objectNodes.size();
+	for(size_t oid = 0; oid < count; ++oid){
+		const TransformHierarchy::Node node = _objectNodes[oid];
+		if(node != TransformHierarchy::None && transforms.changed(node)){
+			frame.objects.push_back((unsigned int)oid);
+			frame.models.push_back(transforms.world(node));
+			frame.normalMatrices.push_back(transforms.normalMatrix(node));
+		}
+	}
+}
+
+void Scene::applyFrame(const Frame & frame){
+	const size_t count = frame.objects.size();
+	for(size_t mid = 0; mid < count; ++mid){
+		const unsigned int oid = frame.objects[mid];
+		if(oid < objects.size()){
+			objects[oid].update(frame.models[mid], frame.normalMatrices[mid]);
+		}
+	}
+	for(const Frame::LightMove & move : frame.lights){
+		if(move.type == Frame::LightType::Directional && move.index < directionalLights.size()){
+			directionalLights[move.index].update(move.vector);
+		} else if(move.type == Frame::LightType::Point && move.index < pointLights.size()){
+			pointLights[move.index].update(move.vector);
+		} else if(move.type == Frame::LightType::Spot && move.index < spotLights.size()){
+			spotLights[move.index].update(move.vector);
+		}
+	}
+}
+
+/** Collect the objects lit by a point or spot light, and fit the light shadow map to the casters among them.
+ \param light the light
+ \param hierarchy the hierarchy of objects bounds
+ \param objects the objects
+ \param boxes the world space bounding boxes of the objects
+ \param lit will contain the indices of the objects intersecting the light volume
+ */
+template<typename LightType>
+static void collectLitObjects(LightType & light, const DynamicBVH & hierarchy, const std::vector<Object> & objects, const BoundingBoxArray & boxes, std::vector<unsigned int> & lit){
+	hierarchy.queryOverlap(light.boundingBox(), lit);
+	std::sort(lit.begin(), lit.end());
+	// The hierarchy stores enlarged boxes, test the exact ones against the light volume.
+	BoundingBox castersBox;
+	bool hasCasters = false;
+	size_t count = 0;
+	for(const unsigned int oid : lit){
+		const BoundingBox box = boxes.get(oid);
+		if(!light.intersects(box)){
+			continue;
+		}
+		lit[count++] = oid;
+		if(!objects[oid].castsShadow()){
+			continue;
+		}
+		if(hasCasters){
+			castersBox.merge(box);
+		} else {
+			castersBox = box;
+			hasCasters = true;
+		}
+	}
+	lit.resize(count);
+	// Without casters, the shadow map will be empty whatever its projection.
+	if(hasCasters && light.castsShadow()){
+		light.setShadowBounds(castersBox);
+	}
+}
+
+void Scene::updateBounds(){
+	const size_t objectCount = objects.size();
+	const size_t pointCount = pointLights.size();
+	const size_t spotCount = spotLights.size();
+	// Removed objects or lights would shift the indices stored in the hierarchies, start from scratch.
+	if(objectCount < _objectLeaves.size() || pointCount < _pointLightLeaves.size() || spotCount < _spotLightLeaves.size()){
+		_objectHierarchy.clear();
+		_lightHierarchy.clear();
+		_objectLeaves.clear();
+		_pointLightLeaves.clear();
+		_spotLightLeaves.clear();
+		_fittedDirectionalLights = 0;
+	}
+	_objectLeaves.resize(objectCount);
+	_pointLightLeaves.resize(pointCount);
+	_spotLightLeaves.resize(spotCount);
+	_pointLightObjects.resize(pointCount);
+	_spotLightObjects.resize(spotCount);
+	_objectBoxes.resize(objectCount);
+	
+	// Refit the moved lights, their lit objects will be collected again.
+	_pointLightsDirty.assign(pointCount, 0);
+	_spotLightsDirty.assign(spotCount, 0);
+	for(size_t lid = 0; lid < pointCount; ++lid){
+		BoundsLeaf & leaf = _pointLightLeaves[lid];
+		const PointLight & light = pointLights[lid];
+		if(leaf.proxy != DynamicBVH::None && leaf.revision == light.revision()){
+			continue;
+		}
+		if(leaf.proxy == DynamicBVH::None){
+			leaf.proxy = _lightHierarchy.insert(light.boundingBox(), (unsigned int)lid);
+		} else {
+			_lightHierarchy.update(leaf.proxy, light.boundingBox());
+		}
+		leaf.revision = light.revision();
+		_pointLightsDirty[lid] = 1;
+	}
+	for(size_t lid = 0; lid < spotCount; ++lid){
+		BoundsLeaf & leaf = _spotLightLeaves[lid];
+		const SpotLight & light = spotLights[lid];
+		if(leaf.proxy != DynamicBVH::None && leaf.revision == light.revision()){
+			continue;
+		}
+		if(leaf.proxy == DynamicBVH::None){
+			leaf.proxy = _lightHierarchy.insert(light.boundingBox(), (unsigned int)lid | SpotLightBit);
+		} else {
+			_lightHierarchy.update(leaf.proxy, light.boundingBox());
+		}
+		leaf.revision = light.revision();
+		_spotLightsDirty[lid] = 1;
+	}
+	
+	// Refit the moved objects, the lights overlapping their previous or new bounds are affected.
+	auto markLights = [this](const BoundingBox & box){
+		_lightHierarchy.queryOverlap(box, _boundsQuery);
+		for(const unsigned int id : _boundsQuery){
+			if(id & SpotLightBit){
+				_spotLightsDirty[id & ~SpotLightBit] = 1;
+			} else {
+				_pointLightsDirty[id] = 1;
+			}
+		}
+	};
+	bool castersMoved = false;
+	for(size_t oid = 0; oid < objectCount; ++oid){
+		BoundsLeaf & leaf = _objectLeaves[oid];
+		const Object & object = objects[oid];
+		if(leaf.proxy != DynamicBVH::None && leaf.revision == object.revision()){
+			continue;
+		}
+		const BoundingBox box = object.getBoundingBox();
+		if(leaf.proxy == DynamicBVH::None){
+			leaf.proxy = _objectHierarchy.insert(box, (unsigned int)oid);
+		} else {
+			markLights(_objectBoxes.get(oid));
+			_objectHierarchy.update(leaf.proxy, box);
+		}
+		markLights(box);
+		_objectBoxes.set(oid, box);
+		leaf.revision = object.revision();
+		castersMoved = castersMoved || object.castsShadow();
+	}
+	
+	// Collect the objects lit by the affected lights.
+	for(size_t lid = 0; lid < pointCount; ++lid){
+		if(_pointLightsDirty[lid]){
+			collectLitObjects(pointLights[lid], _objectHierarchy, objects, _objectBoxes, _pointLightObjects[lid]);
+		}
+	}
+	for(size_t lid = 0; lid < spotCount; ++lid){
+		if(_spotLightsDirty[lid]){
+			collectLitObjects(spotLights[lid], _objectHierarchy, objects, _objectBoxes, _spotLightObjects[lid]);
+		}
+	}
+	
+	// Directional lights shadow maps cover all casters.
+	if(!castersMoved && _fittedDirectionalLights == directionalLights.size()){
+		return;
+	}
+	_fittedDirectionalLights = directionalLights.size();
+	BoundingBox castersBox;
+	bool hasCasters = false;
+	for(size_t oid = 0; oid < objectCount; ++oid){
+		if(!objects[oid].castsShadow()){
+			continue;
+		}
+		if(hasCasters){
+			castersBox.merge(_objectBoxes.get(oid));
+		} else {
+			castersBox = _objectBoxes.get(oid);
+			hasCasters = true;
+		}
+	}
+	if(!hasCasters){
+		return;
+	}
+	for(auto & light : directionalLights){
+		light.setShadowBounds(castersBox);
+	}
+}
+
+void Scene::objectsInFrustum(const Frustum & frustum, std::vector<unsigned int> & indices) const {
+	_objectHierarchy.queryFrustum(frustum, indices);
+	std::sort(indices.begin(), indices.end());
+	// The hierarchy stores enlarged boxes, test the exact ones.
+	size_t count = 0;
+	for(const unsigned int oid : indices){
+		if(frustum.intersects(_objectBoxes.get(oid))){
+			indices[count++] = oid;
+		}
+	}
+	indices.resize(count);
+}
+
+size_t Scene::cullObjects(const Frustum & frustum, std::vector<unsigned char> & visibility) const {
+	std::vector<unsigned int> indices;
+	objectsInFrustum(frustum, indices);
+	visibility.assign(objects.size(), 0);
+	for(const unsigned int oid : indices){
+		visibility[oid] = 1;
+	}
+	return indices.size();
+}
+
 BoundingBox Scene::computeBoundingBox(bool onlyShadowCasters){
 	BoundingBox bbox;
 	if(objects.empty()){
 		return bbox;
 	}
-	bool first = true;
-	for(size_t oid = 0; oid < objects.size(); ++oid){
-		if(onlyShadowCasters && !objects[oid].castsShadow()){
-			continue;
-		}
-		if(first){
-			first = false;
-			bbox = objects[oid].getBoundingBox();
+	// Transform all boxes at once.
+	BoundingBoxArray boxes;
+	std::vector<glm::mat4> models;
+	boxes.resize(objects.size());
+	models.reserve(objects.size());
+	size_t count = 0;
+	for(const auto & object : objects){
+		if(onlyShadowCasters && !object.castsShadow()){
 			continue;
 		}
-		bbox.merge(objects[oid].getBoundingBox());
+		boxes.set(count++, object.getModelBoundingBox());
+		models.push_back(object.model());
+	}
+	if(count == 0){
+		return bbox;
+	}
+	boxes.resize(count);
+	MeshUtilities::transformBoundingBoxes(boxes, models, boxes);
+	bbox = boxes.get(0);
+	for(size_t bid = 1; bid < count; ++bid){
+		bbox.merge(boxes.get(bid));
 	}
 	Log::Info() << Log::Resources << "Scene bounding box: [" << bbox.minis << ", " << bbox.maxis << "]." << std::endl;
 	return bbox;
@@ -49,13 +400,8 @@ void Scene::clean() const {
 		object.clean();
 	}
 	background.clean();
-	for(auto& dirLight : directionalLights){
-		dirLight.clean();
-	}
+	// Directional and spot lights shadow maps are owned by the renderers shadow atlases.
 	for(auto& pointLight : pointLights){
 		pointLight.clean();
 	}
-	for(auto& spotLight : spotLights){
-		spotLight.clean();
-	}
 };
@@ -2,10 +2,13 @@
 #define Scene_h
 #include "Common.hpp"
 #include "Object.hpp"
+#include "TransformHierarchy.hpp"
+#include "DynamicBVH.hpp"
 #include "lights/DirectionalLight.hpp"
 #include "lights/PointLight.hpp"
 #include "lights/SpotLight.hpp"
 #include "resources/ResourcesManager.hpp"
+#include "resources/SceneDescription.hpp"
 #include <sstream>
 
 /**
@@ -16,6 +19,30 @@ class Scene {
 
 public:
 
+	/// \brief Modifications of the animated state of the scene: world transformations of the moved objects and new placements of the moved lights. Recorded after the animations and applied to the objects and lights before rendering.
+	struct Frame {
+	
+		/// \brief Type of a moved light.
+		enum class LightType : unsigned char {
+			Directional, Point, Spot
+		};
+		
+		/// \brief New placement of a light.
+		struct LightMove {
+			LightType type; ///< The light type.
+			unsigned int index; ///< The light index in the list of its type.
+			glm::vec3 vector; ///< The new direction of a directional light, or the new position of a point or spot light.
+		};
+		
+		std::vector<unsigned int> objects; ///< Indices of the moved objects.
+		std::vector<glm::mat4> models; ///< World transformation of each moved object.
+		std::vector<glm::mat3> normalMatrices; ///< Normal matrix of each moved object.
+		std::vector<LightMove> lights; ///< Moved lights, in the order of the moves.
+		
+		/** Clear the modifications, keeping the allocated memory. */
+		void clear();
+	};
+	
 	/** Constructor */
 	Scene();
 	
@@ -26,9 +53,81 @@ public:
 	/** Update the animations in the scene.
 	 \param fullTime the time elapsed since the beginning of the render loop
 	 \param frameTime the duration of the last frame
+	 \warning Animations can be executed on the main thread while the scene is rendered on another thread: they should only modify the transformation hierarchy and move lights with moveDirectionalLight, movePointLight and moveSpotLight.
 	 */
 	virtual void update(double fullTime, double frameTime) = 0;
 	
+	/** Update the animations, then the objects, lights and bounds hierarchies.
+	 \param fullTime the time elapsed since the beginning of the render loop
+	 \param frameTime the duration of the last frame
+	 \note While the scene is animated by a SceneSimulation, only the animations are updated.
+	 */
+	void animate(double fullTime, double frameTime);
+	
+	/** Apply the transformations and light moves recorded since the last call to the objects and lights.
+	 \note Only the modified nodes and their descendants are recomputed.
+	 */
+	void updateTransforms();
+	
+	/** Record the transformations and light moves modified by the animations since the last call. Only accesses the state modified by the animations.
+	 \param frame will contain the modifications, its memory is reused
+	 */
+	void recordFrame(Frame & frame);
+	
+	/** Apply recorded modifications to the objects and lights.
+	 \param frame the modifications
+	 \note Bounds are not updated.
+	 */
+	void applyFrame(const Frame & frame);
+	
+	/** Refit the hierarchies of objects bounds and lights volumes for the objects and lights moved since the last call. The objects lit by each modified light, or by a light overlapping a modified object, are collected again, and the light shadow map is fitted to the casters among them.
+	 \note Call after updateTransforms, the first call inserts all objects and lights.
+	 */
+	void updateBounds();
+	
+	/** Query the world space bounding boxes of the objects, as of the last bounds update.
+	 \return the boxes, in the same order as the objects
+	 */
+	const BoundingBoxArray & objectBoxes() const { return _objectBoxes; }
+	
+	/** Collect the objects at least partially inside a frustum, using the hierarchy of objects bounds.
+	 \param frustum the frustum to test
+	 \param indices will contain the indices of the objects inside the frustum, in increasing order
+	 */
+	void objectsInFrustum(const Frustum & frustum, std::vector<unsigned int> & indices) const;
+	
+	/** Test the objects against a frustum, using the hierarchy of objects bounds.
+	 \param frustum the frustum to test
+	 \param visibility will contain a flag for each object, raised if the object is at least partially inside the frustum
+	 \return the number of objects inside the frustum
+	 */
+	size_t cullObjects(const Frustum & frustum, std::vector<unsigned char> & visibility) const;
+	
+	/** Query the objects lit by a point light, as of the last bounds update.
+	 \param lid the index of the light
+	 \return the indices of the objects intersecting the light sphere, in increasing order
+	 */
+	const std::vector<unsigned int> & pointLightObjects(size_t lid) const { return _pointLightObjects[lid]; }
+	
+	/** Query the objects lit by a spot light, as of the last bounds update.
+	 \param lid the index of the light
+	 \return the indices of the objects intersecting the light cone, in increasing order
+	 */
+	const std::vector<unsigned int> & spotLightObjects(size_t lid) const { return _spotLightObjects[lid]; }
+	
+	/** Query the hierarchy of objects bounds, for overlap, frustum and ray queries.
+	 \return the hierarchy, whose leaves store the objects indices
+	 */
+	const DynamicBVH & objectHierarchy() const { return _objectHierarchy; }
+	
+	/** Query the hierarchy of point and spot lights volumes, for overlap, frustum and ray queries.
+	 \return the hierarchy, whose leaves store the point lights indices, and the spot lights indices combined with SpotLightBit
+	 */
+	const DynamicBVH & lightHierarchy() const { return _lightHierarchy; }
+	
+	/// Flag marking spot lights in the lights hierarchy.
+	static const unsigned int SpotLightBit = 1u << 31;
+	
 	/** Clean internal resources. */
 	void clean() const;
 	
@@ -44,9 +143,42 @@ public:
 	std::vector<DirectionalLight> directionalLights; ///< Directional lights present in the scene.
 	std::vector<PointLight> pointLights; ///< Omni-directional lights present in the scene.
 	std::vector<SpotLight> spotLights; ///< Spotlights present in the scene.
+	TransformHierarchy transforms; ///< Hierarchy of transformations placing the attached objects in world space.
 	
 protected:
 	
+	/** Add an object attached to a new node of the transformation hierarchy.
+	 \param object the object to add
+	 \param local the object transformation relative to the parent node
+	 \param parent the parent node, or None
+	 \return the object node
+	 */
+	TransformHierarchy::Node addObject(const Object & object, const glm::mat4 & local, TransformHierarchy::Node parent = TransformHierarchy::None);
+	
+	/** Move a directional light, the change is applied at the next transformations update.
+	 \param lid the index of the light
+	 \param direction the new light direction
+	 */
+	void moveDirectionalLight(size_t lid, const glm::vec3 & direction);
+	
+	/** Move a point light, the change is applied at the next transformations update.
+	 \param lid the index of the light
+	 \param position the new light position
+	 */
+	void movePointLight(size_t lid, const glm::vec3 & position);
+	
+	/** Move a spot light, the change is applied at the next transformations update.
+	 \param lid the index of the light
+	 \param position the new light position
+	 */
+	void moveSpotLight(size_t lid, const glm::vec3 & position);
+	
+	/** Create the objects, lights and environment listed in a description. Each mesh and material is requested once, before the objects are created as copies of a prototype for each combination of type, mesh, material and flags.
+	 \param description the scene description
+	 \note The lights shadow maps are fitted to the shadow casters of the scene.
+	 */
+	void loadDescription(const SceneDescription & description);
+	
 	/** Load a file containing some SH coefficients approximating background irradiance.
 	 \param name the name of the text file
 	 \see SphericalHarmonics
@@ -60,6 +192,33 @@ protected:
 	BoundingBox computeBoundingBox(bool onlyShadowCasters = false);
 	
 	bool _loaded = false; ///< Has the scene already been loaded from disk.
+	std::vector<TransformHierarchy::Node> _objectNodes; ///< Node of each object in the hierarchy, or None if the object is placed directly.
+
+private:
+
+	friend class SceneSimulation;
+	
+	/// \brief Leaf of an object or light in a bounds hierarchy, with the revision of the object or light when it was last refitted.
+	struct BoundsLeaf {
+		DynamicBVH::Proxy proxy = DynamicBVH::None; ///< The leaf, or None if not inserted yet.
+		unsigned int revision = 0; ///< The revision of the object or light at the last refit.
+	};
+	
+	DynamicBVH _objectHierarchy; ///< Hierarchy of the objects bounds.
+	DynamicBVH _lightHierarchy; ///< Hierarchy of the point and spot lights volumes.
+	BoundingBoxArray _objectBoxes; ///< World space bounding boxes of the objects.
+	std::vector<BoundsLeaf> _objectLeaves; ///< Leaf of each object in the objects hierarchy.
+	std::vector<BoundsLeaf> _pointLightLeaves; ///< Leaf of each point light in the lights hierarchy.
+	std::vector<BoundsLeaf> _spotLightLeaves; ///< Leaf of each spot light in the lights hierarchy.
+	std::vector<std::vector<unsigned int>> _pointLightObjects; ///< Objects lit by each point light.
+	std::vector<std::vector<unsigned int>> _spotLightObjects; ///< Objects lit by each spot light.
+	size_t _fittedDirectionalLights = 0; ///< Number of directional lights whose shadow map has been fitted to the casters.
+	std::vector<unsigned int> _boundsQuery; ///< Results of the hierarchies queries during a bounds update.
+	std::vector<unsigned char> _pointLightsDirty; ///< Point lights whose lit objects are collected again during a bounds update.
+	std::vector<unsigned char> _spotLightsDirty; ///< Spot lights whose lit objects are collected again during a bounds update.
+	std::vector<Frame::LightMove> _lightMoves; ///< Lights moved by the animations since the last recording.
+	Frame _frame; ///< Modifications recorded and applied by updateTransforms.
+	bool _simulated = false; ///< Are the animations modifications handed over to the rendering by a SceneSimulation.
 
 };
 #endif
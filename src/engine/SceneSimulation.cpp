@@ -0,0 +1,45 @@
+#include "SceneSimulation.hpp"
+
+SceneSimulation::~SceneSimulation(){
+	setScene(nullptr);
+}
+
+void SceneSimulation::setScene(const std::shared_ptr<Scene> & scene){
+	if(_scene){
+		// The recorded and not yet recorded modifications would be lost otherwise.
+		_scene->applyFrame(_frames[_recorded]);
+		_scene->recordFrame(_frames[_recorded]);
+		_scene->applyFrame(_frames[_recorded]);
+		_scene->updateBounds();
+		_scene->_simulated = false;
+	}
+	_frames[0].clear();
+	_frames[1].clear();
+	_recorded = 1;
+	_scene = scene;
+	if(_scene){
+		_scene->_simulated = true;
+	}
+}
+
+void SceneSimulation::record(){
+	if(_scene){
+		_scene->recordFrame(_frames[_recorded]);
+	}
+}
+
+void SceneSimulation::exchange(){
+	// The recorded frame is handed over, the next one is recorded in the other frame.
+	_recorded = 1 - _recorded;
+}
+
+void SceneSimulation::apply(){
+	if(!_scene){
+		return;
+	}
+	Scene::Frame & frame = _frames[1 - _recorded];
+	_scene->applyFrame(frame);
+	// Apply each recorded frame only once.
+	frame.clear();
+	_scene->updateBounds();
+}
@@ -0,0 +1,51 @@
+#ifndef SceneSimulation_h
+#define SceneSimulation_h
+#include "Scene.hpp"
+
+/**
+ \brief Hand the animations of a scene over to the rendering thread, one frame ahead of the rendering.
+ \details While the rendering thread draws frame N, the main thread runs the animations of frame N+1 and records their modifications. Once the rendering of frame N is complete, the recorded frame is handed over and applied to the objects and lights by the rendering thread, while the main thread records the next one in the other frame. The two frames keep their memory, so that no allocation happens once their capacity has settled.
+ \ingroup Engine
+ */
+class SceneSimulation {
+
+public:
+
+	/** Constructor. */
+	SceneSimulation() = default;
+	
+	/** Start handing the animations of a scene over, bringing the previous one up to date. The objects, lights and bounds of the scene are not updated by its animations anymore.
+	 \param scene the initialized scene to animate, or null
+	 \note Should be called while the scene is not rendered.
+	 */
+	void setScene(const std::shared_ptr<Scene> & scene);
+	
+	/** Record the modifications of the animations run since the last call. Should be called once per frame by the main thread, after the animations. */
+	void record();
+	
+	/** Hand the recorded frame over to the rendering. Should be called once per frame, while the scene is not rendered. */
+	void exchange();
+	
+	/** Apply the frame handed over to the scene objects, lights and bounds. Should be called once per frame by the rendering thread, before drawing. */
+	void apply();
+	
+	/** Destructor. Brings the scene up to date. */
+	~SceneSimulation();
+	
+	/** Copy constructor (disabled). */
+	SceneSimulation(const SceneSimulation &) = delete;
+	
+	/** Copy assignment (disabled).
+	 \return a reference to the object assigned to
+	 */
+	SceneSimulation & operator= (const SceneSimulation &) = delete;
+
+private:
+
+	std::shared_ptr<Scene> _scene; ///< The animated scene.
+	Scene::Frame _frames[2]; ///< The frame applied by the rendering thread, and the frame recorded by the main thread.
+	unsigned int _recorded = 1; ///< Index of the frame recorded by the main thread.
+
+};
+
+#endif
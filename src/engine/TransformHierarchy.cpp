@@ -0,0 +1,60 @@
+#include "TransformHierarchy.hpp"
+
+const TransformHierarchy::Node TransformHierarchy::None;
+
+TransformHierarchy::Node TransformHierarchy::add(const glm::mat4 & local, Node parent){
+	const Node node = Node(_parents.size());
+	if(parent != None && parent >= node){
+		Log::Error() << Log::Resources << "Unknown parent " << parent << " for transformation node " << node << ", attaching it to the root." << std::endl;
+		parent = None;
+	}
+	_locals.push_back(local);
+	_worlds.push_back(local);
+	_normals.emplace_back(1.0f);
+	_parents.push_back(parent);
+	_dirty.push_back(1);
+	_changed.push_back(0);
+	_firstDirty = std::min(_firstDirty, size_t(node));
+	return node;
+}
+
+void TransformHierarchy::setLocal(Node node, const glm::mat4 & local){
+	_locals[node] = local;
+	_dirty[node] = 1;
+	_firstDirty = std::min(_firstDirty, size_t(node));
+}
+
+size_t TransformHierarchy::update(){
+	// Reset the flags raised by the previous update.
+	std::fill(_changed.begin() + _firstChanged, _changed.end(), 0);
+	_firstChanged = _firstDirty;
+	
+	// Parents are always updated before their children.
+	size_t count = 0;
+	const size_t nodeCount = _parents.size();
+	for(size_t nid = _firstDirty; nid < nodeCount; ++nid){
+		const Node parent = _parents[nid];
+		const bool parentChanged = parent != None && _changed[parent];
+		if(!_dirty[nid] && !parentChanged){
+			continue;
+		}
+		_worlds[nid] = parent == None ? _locals[nid] : _worlds[parent] * _locals[nid];
+		_normals[nid] = glm::transpose(glm::inverse(glm::mat3(_worlds[nid])));
+		_dirty[nid] = 0;
+		_changed[nid] = 1;
+		++count;
+	}
+	_firstDirty = nodeCount;
+	return count;
+}
+
+void TransformHierarchy::clear(){
+	_locals.clear();
+	_worlds.clear();
+	_normals.clear();
+	_parents.clear();
+	_dirty.clear();
+	_changed.clear();
+	_firstDirty = 0;
+	_firstChanged = 0;
+}
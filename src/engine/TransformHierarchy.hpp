@@ -0,0 +1,90 @@
+#ifndef TransformHierarchy_h
+#define TransformHierarchy_h
+#include "Common.hpp"
+
+/**
+ \brief Hierarchy of transformations, where each node is placed relative to its parent.
+ \details Local and world matrices, cached normal matrices and parent indices are stored in contiguous arrays. Nodes can only be attached to previously created nodes, so that parents always come before their children and the world transformations can be computed in a single ordered pass. Modified nodes are flagged, and an update only recomputes them and their descendants, starting from the first modified node.
+ \ingroup Engine
+ */
+class TransformHierarchy {
+
+public:
+
+	/// \brief Index of a node in the hierarchy.
+	typedef unsigned int Node;
+	
+	/// Parent index of the root nodes.
+	static const Node None = ~0u;
+	
+	/** Create a node.
+	 \param local the transformation relative to the parent
+	 \param parent the parent node, or None for a root node
+	 \return the new node
+	 \note The world transformation of the node is available after the next update.
+	 */
+	Node add(const glm::mat4 & local, Node parent = None);
+	
+	/** Modify the transformation of a node relative to its parent. The node and its descendants will be updated.
+	 \param node the node to modify
+	 \param local the new local transformation
+	 */
+	void setLocal(Node node, const glm::mat4 & local);
+	
+	/** Recompute the world transformations and normal matrices of the modified nodes and their descendants.
+	 \return the number of nodes updated
+	 */
+	size_t update();
+	
+	/** Query the transformation of a node relative to its parent.
+	 \param node the node
+	 \return the local matrix
+	 */
+	const glm::mat4 & local(Node node) const { return _locals[node]; }
+	
+	/** Query the transformation of a node in world space, as of the last update.
+	 \param node the node
+	 \return the world matrix
+	 */
+	const glm::mat4 & world(Node node) const { return _worlds[node]; }
+	
+	/** Query the matrix transforming normals from the node space to world space, as of the last update.
+	 \param node the node
+	 \return the inverse transpose of the world matrix upper-left 3x3 block
+	 */
+	const glm::mat3 & normalMatrix(Node node) const { return _normals[node]; }
+	
+	/** Query the parent of a node.
+	 \param node the node
+	 \return the parent, or None for a root node
+	 */
+	Node parent(Node node) const { return _parents[node]; }
+	
+	/** Query if the world transformation of a node was recomputed during the last update.
+	 \param node the node
+	 \return true if the node or one of its ancestors was modified
+	 */
+	bool changed(Node node) const { return _changed[node] != 0; }
+	
+	/** Query the number of nodes.
+	 \return the node count
+	 */
+	size_t size() const { return _parents.size(); }
+	
+	/** Remove all nodes. */
+	void clear();
+
+private:
+
+	std::vector<glm::mat4> _locals; ///< Transformation of each node relative to its parent.
+	std::vector<glm::mat4> _worlds; ///< Transformation of each node in world space.
+	std::vector<glm::mat3> _normals; ///< Normal matrix of each node in world space.
+	std::vector<Node> _parents; ///< Parent of each node, always smaller than the node index.
+	std::vector<unsigned char> _dirty; ///< Has the local transformation of each node been modified since the last update.
+	std::vector<unsigned char> _changed; ///< Has the world transformation of each node been recomputed during the last update.
+	size_t _firstDirty = 0; ///< No node before this one has been modified since the last update.
+	size_t _firstChanged = 0; ///< No node before this one has been recomputed during the last update.
+
+};
+
+#endif
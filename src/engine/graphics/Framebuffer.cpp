@@ -16,7 +16,7 @@ Framebuffer::Framebuffer(unsigned int width, unsigned int height, const std::vec
 	
 	// Create a framebuffer.
 	glGenFramebuffers(1, &_id);
-	glBindFramebuffer(GL_FRAMEBUFFER, _id);
+	GLUtilities::bindFramebuffer(GL_FRAMEBUFFER, _id);
 	bool depthBufferSetup = false;
 	
 	for(size_t i = 0; i < descriptors.size(); ++i){
@@ -27,7 +27,7 @@ Framebuffer::Framebuffer(unsigned int width, unsigned int height, const std::vec
 		
 		if(format == GL_DEPTH_COMPONENT || format == GL_DEPTH_STENCIL){
 			glGenTextures(1, &_idDepth);
-			glBindTexture(GL_TEXTURE_2D, _idDepth);
+			GLUtilities::bindTexture(0, GL_TEXTURE_2D, _idDepth);
 			glTexImage2D(GL_TEXTURE_2D, 0, descriptor.typedFormat, (GLsizei)_width , (GLsizei)_height, 0, format, type, 0);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, (GLint)descriptor.filtering);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, (GLint)descriptor.filtering);
@@ -51,7 +51,7 @@ Framebuffer::Framebuffer(unsigned int width, unsigned int height, const std::vec
 		} else {
 			GLuint idColor = 0;
 			glGenTextures(1, &idColor);
-			glBindTexture(GL_TEXTURE_2D, idColor);
+			GLUtilities::bindTexture(0, GL_TEXTURE_2D, idColor);
 			glTexImage2D(GL_TEXTURE_2D, 0, descriptor.typedFormat, (GLsizei)_width , (GLsizei)_height, 0, format, type, 0);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, (GLint)descriptor.filtering);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, (GLint)descriptor.filtering);
@@ -95,23 +95,23 @@ Framebuffer::Framebuffer(unsigned int width, unsigned int height, const std::vec
 	}
 	glDrawBuffers(drawBuffers.size(), &drawBuffers[0]);
 	checkGLFramebufferError();
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	GLUtilities::bindFramebuffer(GL_FRAMEBUFFER, 0);
 	checkGLError();
 
 }
 
 
 void Framebuffer::bind() const {
-	glBindFramebuffer(GL_FRAMEBUFFER, _id);
+	GLUtilities::bindFramebuffer(GL_FRAMEBUFFER, _id);
 }
 
 void Framebuffer::setViewport() const
 {
-	glViewport(0, 0, (GLsizei)_width, (GLsizei)_height);
+	GLUtilities::setViewport(0, 0, (GLsizei)_width, (GLsizei)_height);
 }
 
 void Framebuffer::unbind() const {
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	GLUtilities::bindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 void Framebuffer::resize(unsigned int width, unsigned int height){
@@ -126,7 +126,7 @@ void Framebuffer::resize(unsigned int width, unsigned int height){
 	} else if(_depthUse == TEXTURE){
 		GLuint type, format;
 		GLUtilities::getTypeAndFormat(_depthDescriptor.typedFormat, type, format);
-		glBindTexture(GL_TEXTURE_2D, _idDepth);
+		GLUtilities::bindTexture(0, GL_TEXTURE_2D, _idDepth);
 		glTexImage2D(GL_TEXTURE_2D, 0, _depthDescriptor.typedFormat, (GLsizei)_width , (GLsizei)_height, 0, format, type, 0);
 	}
 	// Resize the textures.
@@ -134,7 +134,7 @@ void Framebuffer::resize(unsigned int width, unsigned int height){
 		const auto & descriptor = _colorDescriptors[i];
 		GLuint type, format;
 		GLUtilities::getTypeAndFormat(descriptor.typedFormat, type, format);
-		glBindTexture(GL_TEXTURE_2D, _idColors[i]);
+		GLUtilities::bindTexture(0, GL_TEXTURE_2D, _idColors[i]);
 		glTexImage2D(GL_TEXTURE_2D, 0, descriptor.typedFormat, (GLsizei)_width, (GLsizei)_height, 0, format, type, 0);
 	}
 	
@@ -148,12 +148,12 @@ void Framebuffer::clean() const {
 	if (_depthUse == RENDERBUFFER) {
 		glDeleteRenderbuffers(1, &_idDepth);
 	} else if(_depthUse == TEXTURE){
-		glDeleteTextures(1, &_idDepth);
+		GLUtilities::deleteTexture(_idDepth);
 	}
 	for(const auto idColor : _idColors){
-		glDeleteTextures(1, &idColor);
+		GLUtilities::deleteTexture(idColor);
 	}
-	glDeleteFramebuffers(1, &_id);
+	GLUtilities::deleteFramebuffer(_id);
 }
 
 
@@ -13,10 +13,10 @@ FramebufferCube::FramebufferCube(unsigned int side, const Framebuffer::Descripto
 	
 	// Create a framebuffer.
 	glGenFramebuffers(1, &_id);
-	glBindFramebuffer(GL_FRAMEBUFFER, _id);
+	GLUtilities::bindFramebuffer(GL_FRAMEBUFFER, _id);
 	// Create the texture to store the result.
 	glGenTextures(1, &_idColor);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, _idColor);
+	GLUtilities::bindTexture(0, GL_TEXTURE_CUBE_MAP, _idColor);
 	
 	// Allocate all 6 layers.
 	for(unsigned int i = 0; i < 6; ++i){
@@ -34,7 +34,7 @@ FramebufferCube::FramebufferCube(unsigned int side, const Framebuffer::Descripto
 	if (_useDepth) {
 		// Create the depth buffer.
 		glGenTextures(1, &_idRenderbuffer);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, _idRenderbuffer);
+		GLUtilities::bindTexture(0, GL_TEXTURE_CUBE_MAP, _idRenderbuffer);
 		// Allocate all 6 layers.
 		for(unsigned int i = 0; i < 6; ++i){
 			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X+i, 0, GL_DEPTH_COMPONENT32F, (GLsizei)_side , (GLsizei)_side, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
@@ -51,21 +51,21 @@ FramebufferCube::FramebufferCube(unsigned int side, const Framebuffer::Descripto
 	GLenum drawBuffers[1] = {GL_COLOR_ATTACHMENT0};
 	glDrawBuffers(1, drawBuffers);
 	checkGLFramebufferError();
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	GLUtilities::bindFramebuffer(GL_FRAMEBUFFER, 0);
 	checkGLError();
 }
 
 void FramebufferCube::bind() const {
-	glBindFramebuffer(GL_FRAMEBUFFER, _id);
+	GLUtilities::bindFramebuffer(GL_FRAMEBUFFER, _id);
 }
 
 void FramebufferCube::setViewport() const
 {
-	glViewport(0, 0, (GLsizei)_side, (GLsizei)_side);
+	GLUtilities::setViewport(0, 0, (GLsizei)_side, (GLsizei)_side);
 }
 
 void FramebufferCube::unbind() const {
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	GLUtilities::bindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 
@@ -73,7 +73,7 @@ void FramebufferCube::resize(unsigned int side){
 	_side = side;
 	// Resize the renderbuffer.
 	if (_useDepth) {
-		glBindTexture(GL_TEXTURE_CUBE_MAP, _idRenderbuffer);
+		GLUtilities::bindTexture(0, GL_TEXTURE_CUBE_MAP, _idRenderbuffer);
 		// Allocate all 6 layers.
 		for(unsigned int i = 0; i < 6; ++i){
 			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X+i, 0, GL_DEPTH_COMPONENT32F, (GLsizei)_side , (GLsizei)_side, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
@@ -83,7 +83,7 @@ void FramebufferCube::resize(unsigned int side){
 	GLenum type, format;
 	GLUtilities::getTypeAndFormat(_descriptor.typedFormat, type, format);
 	
-	glBindTexture(GL_TEXTURE_CUBE_MAP, _idColor);
+	GLUtilities::bindTexture(0, GL_TEXTURE_CUBE_MAP, _idColor);
 	// Reallocate all 6 layers.
 	for(unsigned int i = 0; i < 6; ++i){
 		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X+i, 0, _descriptor.typedFormat, (GLsizei)_side , (GLsizei)_side, 0, format, type, 0);
@@ -93,9 +93,9 @@ void FramebufferCube::resize(unsigned int side){
 
 void FramebufferCube::clean() const {
 	if (_useDepth) {
-		glDeleteTextures(1, &_idRenderbuffer);
+		GLUtilities::deleteTexture(_idRenderbuffer);
 	}
-	glDeleteTextures(1, &_idColor);
-	glDeleteFramebuffers(1, &_id);
+	GLUtilities::deleteTexture(_idColor);
+	GLUtilities::deleteFramebuffer(_id);
 }
 
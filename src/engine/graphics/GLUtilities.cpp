@@ -1,5 +1,13 @@
 #include "GLUtilities.hpp"
 #include "../resources/ImageUtilities.hpp"
+#include <glm/gtc/packing.hpp>
+#include <cstring>
+#include <cmath>
+
+// From GL_KHR_parallel_shader_compile, not exposed by gl3w.
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
 
 std::string getGLErrorString(GLenum error) {
 	std::string msg;
@@ -95,6 +103,13 @@ void replace(std::string & source, const std::string& fromString, const std::str
 }
 
 GLuint GLUtilities::loadShader(const std::string & prog, GLuint type, std::map<std::string, int> & bindings, std::string & finalLog){
+	const GLuint id = compileShader(prog, type, bindings);
+	finalLog = shaderLog(id);
+	// Return the id to the successfuly compiled shader program.
+	return id;
+}
+
+GLuint GLUtilities::compileShader(const std::string & prog, GLuint type, std::map<std::string, int> & bindings){
 	// We need to detect texture slots and store them, to avoid having to register them in
 	// the rest of the code (object, renderer), while not having support for 'layout(binding=n)' in OpenGL <4.2.
 	std::stringstream inputLines(prog);
@@ -182,10 +197,12 @@ GLuint GLUtilities::loadShader(const std::string & prog, GLuint type, std::map<s
 	// Compile the shader on the GPU.
 	glCompileShader(id);
 	checkGLError();
+	return id;
+}
 
+std::string GLUtilities::shaderLog(GLuint id){
 	GLint success;
 	glGetShaderiv(id,GL_COMPILE_STATUS, &success);
-	finalLog = "";
 	// If compilation failed, get information and display it.
 	if (success != GL_TRUE) {
 		// Get the log string length for allocation.
@@ -199,51 +216,82 @@ GLuint GLUtilities::loadShader(const std::string & prog, GLuint type, std::map<s
 		
 		replace(infoLogString, "\n", "\n\t");
 		infoLogString.insert(0, "\t");
-		finalLog = infoLogString;
+		return infoLogString;
 	}
-	// Return the id to the successfuly compiled shader program.
-	return id;
+	return "";
 }
 
 GLuint GLUtilities::createProgram(const std::string & vertexContent, const std::string & fragmentContent, const std::string & geometryContent, std::map<std::string, int> & bindings, const std::string & debugInfos){
-	GLuint vp(0), fp(0), gp(0), id(0);
-	id = glCreateProgram();
+	const PendingProgram program = startProgram(vertexContent, fragmentContent, geometryContent, bindings, debugInfos);
+	return finishProgram(program);
+}
+
+PendingProgram GLUtilities::startProgram(const std::string & vertexContent, const std::string & fragmentContent, const std::string & geometryContent, std::map<std::string, int> & bindings, const std::string & debugInfos){
+	PendingProgram program;
+	program.debugInfos = debugInfos;
+	program.id = glCreateProgram();
 	checkGLError();
 	
 	Log::Verbose() << Log::OpenGL << "Compiling " << debugInfos << "." << std::endl;
 	
-	std::string compilationLog;
 	// If vertex program code is given, compile it.
 	if (!vertexContent.empty()) {
-		vp = loadShader(vertexContent, GL_VERTEX_SHADER, bindings, compilationLog);
-		glAttachShader(id,vp);
+		program.vertexId = compileShader(vertexContent, GL_VERTEX_SHADER, bindings);
+		glAttachShader(program.id, program.vertexId);
+	}
+	// If fragment program code is given, compile it.
+	if (!fragmentContent.empty()) {
+		program.fragmentId = compileShader(fragmentContent, GL_FRAGMENT_SHADER, bindings);
+		glAttachShader(program.id, program.fragmentId);
+	}
+	// If geometry program code is given, compile it.
+	if (!geometryContent.empty()) {
+		program.geometryId = compileShader(geometryContent, GL_GEOMETRY_SHADER, bindings);
+		glAttachShader(program.id, program.geometryId);
+	}
+	
+	// Link everything. We don't query any status here, so that the driver can work in the background.
+	glLinkProgram(program.id);
+	checkGLError();
+	return program;
+}
+
+bool GLUtilities::isProgramReady(const PendingProgram & program){
+	if(!setupParallelShaderCompilation()){
+		return true;
+	}
+	GLint completed = GL_TRUE;
+	glGetProgramiv(program.id, GL_COMPLETION_STATUS_KHR, &completed);
+	return completed == GL_TRUE;
+}
+
+GLuint GLUtilities::finishProgram(const PendingProgram & program){
+	const GLuint id = program.id;
+	const std::string & debugInfos = program.debugInfos;
+	
+	// Report compilation errors for each stage.
+	if (program.vertexId != 0) {
+		const std::string compilationLog = shaderLog(program.vertexId);
 		if(!compilationLog.empty()){
 			Log::Error() << Log::OpenGL << "Vertex shader failed to compile:" << std::endl
 			<< compilationLog << std::endl;
 		}
 	}
-	// If fragment program code is given, compile it.
-	if (!fragmentContent.empty()) {
-		fp = loadShader(fragmentContent, GL_FRAGMENT_SHADER, bindings, compilationLog);
-		glAttachShader(id,fp);
+	if (program.fragmentId != 0) {
+		const std::string compilationLog = shaderLog(program.fragmentId);
 		if(!compilationLog.empty()){
 			Log::Error() << Log::OpenGL << "Fragment shader failed to compile:" << std::endl
 			<< compilationLog << std::endl;
 		}
 	}
-	// If geometry program code is given, compile it.
-	if (!geometryContent.empty()) {
-		gp = loadShader(geometryContent, GL_GEOMETRY_SHADER, bindings, compilationLog);
-		glAttachShader(id,gp);
+	if (program.geometryId != 0) {
+		const std::string compilationLog = shaderLog(program.geometryId);
 		if(!compilationLog.empty()){
 			Log::Error() << Log::OpenGL << "Geometry shader failed to compile:" << std::endl
 			<< compilationLog << std::endl;
 		}
 	}
 
-	// Link everything
-	glLinkProgram(id);
-	checkGLError();
 	//Check linking status.
 	GLint success = GL_FALSE;
 	glGetProgramiv(id, GL_LINK_STATUS, &success);
@@ -267,26 +315,63 @@ GLuint GLUtilities::createProgram(const std::string & vertexContent, const std::
 		return 0;
 	}
 	// We can now clean the shaders objects, by first detaching them
-	if (vp != 0) {
-		glDetachShader(id,vp);
+	if (program.vertexId != 0) {
+		glDetachShader(id, program.vertexId);
 	}
-	if (fp != 0) {
-		glDetachShader(id,fp);
+	if (program.fragmentId != 0) {
+		glDetachShader(id, program.fragmentId);
 	}
-	if (gp != 0) {
-		glDetachShader(id,gp);
+	if (program.geometryId != 0) {
+		glDetachShader(id, program.geometryId);
 	}
 	checkGLError();
 	//And deleting them
-	glDeleteShader(vp);
-	glDeleteShader(fp);
-	glDeleteShader(gp);
+	glDeleteShader(program.vertexId);
+	glDeleteShader(program.fragmentId);
+	glDeleteShader(program.geometryId);
 
 	checkGLError();
 	// Return the id to the successfuly linked GLProgram.
 	return id;
 }
 
+bool GLUtilities::setupParallelShaderCompilation(){
+	// -1: not queried yet, 0: unsupported, 1: supported.
+	static int supported = -1;
+	if(supported >= 0){
+		return supported == 1;
+	}
+	supported = 0;
+	// Look for the KHR or ARB flavor of the extension, they share the same enums.
+	std::string procName = "";
+	GLint extensionCount = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+	for(GLint i = 0; i < extensionCount; ++i){
+		const std::string extension((const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i));
+		if(extension == "GL_KHR_parallel_shader_compile"){
+			procName = "glMaxShaderCompilerThreadsKHR";
+			break;
+		} else if(extension == "GL_ARB_parallel_shader_compile"){
+			procName = "glMaxShaderCompilerThreadsARB";
+		}
+	}
+	if(procName.empty()){
+		Log::Verbose() << Log::OpenGL << "Parallel shader compilation not supported." << std::endl;
+		return false;
+	}
+	typedef void (*MaxShaderCompilerThreadsProc)(GLuint count);
+	MaxShaderCompilerThreadsProc maxShaderCompilerThreads = (MaxShaderCompilerThreadsProc)gl3wGetProcAddress(procName.c_str());
+	if(maxShaderCompilerThreads == NULL){
+		return false;
+	}
+	// Let the driver pick the number of threads.
+	maxShaderCompilerThreads(0xFFFFFFFF);
+	checkGLError();
+	supported = 1;
+	Log::Info() << Log::OpenGL << "Parallel shader compilation enabled." << std::endl;
+	return true;
+}
+
 
 
 TextureInfos GLUtilities::loadTexture(const std::vector<std::string>& paths, bool sRGB){
@@ -299,7 +384,7 @@ TextureInfos GLUtilities::loadTexture(const std::vector<std::string>& paths, boo
 	// Create 2D texture.
 	GLuint textureId;
 	glGenTextures(1, &textureId);
-	glBindTexture(GL_TEXTURE_2D, textureId);
+	GLUtilities::bindTexture(0, GL_TEXTURE_2D, textureId);
 	
 	// Set proper max mipmap level.
 	if(paths.size()>1){
@@ -372,7 +457,7 @@ TextureInfos GLUtilities::loadTextureCubemap(const std::vector<std::vector<std::
 	// Create and bind texture.
 	GLuint textureId;
 	glGenTextures(1, &textureId);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, textureId);
+	GLUtilities::bindTexture(0, GL_TEXTURE_CUBE_MAP, textureId);
 	
 	// Set proper max mipmap level.
 	if(allPaths.size()>1){
@@ -430,6 +515,243 @@ TextureInfos GLUtilities::loadTextureCubemap(const std::vector<std::vector<std::
 	return infos;
 }
 
+TextureInfos GLUtilities::createTextureArray(unsigned int width, unsigned int height, unsigned int layers, bool sRGB){
+	TextureInfos infos;
+	infos.array = true;
+	infos.width = width;
+	infos.height = height;
+	// Full mipmap pyramid, down to a single texel.
+	infos.mipmap = 1;
+	while((std::max(width, height) >> infos.mipmap) > 0){
+		++infos.mipmap;
+	}
+	
+	glGenTextures(1, &infos.id);
+	GLUtilities::bindTexture(0, GL_TEXTURE_2D_ARRAY, infos.id);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, (int)infos.mipmap - 1);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	resizeTextureArray(infos, 0, layers, sRGB);
+	return infos;
+}
+
+void GLUtilities::resizeTextureArray(const TextureInfos & texture, unsigned int layers, unsigned int newLayers, bool sRGB){
+	const GLenum preciseFormat = GLenum(sRGB ? GL_SRGB8_ALPHA8 : GL_RGBA8);
+	GLUtilities::bindTexture(0, GL_TEXTURE_2D_ARRAY, texture.id);
+	// Read back the existing layers, as there is no texture copy in OpenGL 3.3.
+	std::vector<std::vector<unsigned char>> levels(layers > 0 ? texture.mipmap : 0);
+	for(unsigned int mid = 0; mid < levels.size(); ++mid){
+		const size_t levelSize = size_t(std::max(texture.width >> mid, 1u)) * size_t(std::max(texture.height >> mid, 1u)) * 4;
+		levels[mid].resize(levelSize * layers);
+		glGetTexImage(GL_TEXTURE_2D_ARRAY, (GLint)mid, GL_RGBA, GL_UNSIGNED_BYTE, levels[mid].data());
+	}
+	for(unsigned int mid = 0; mid < texture.mipmap; ++mid){
+		const GLsizei width = GLsizei(std::max(texture.width >> mid, 1u));
+		const GLsizei height = GLsizei(std::max(texture.height >> mid, 1u));
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, (GLint)mid, preciseFormat, width, height, (GLsizei)newLayers, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		if(mid < levels.size()){
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, (GLint)mid, 0, 0, 0, width, height, (GLsizei)layers, GL_RGBA, GL_UNSIGNED_BYTE, levels[mid].data());
+		}
+	}
+}
+
+/** Halve the size of an 8-bits RGBA image with a box filter.
+ \param image the image pixels
+ \param width the image width
+ \param height the image height
+ \param sRGB is the color gamma encoded, in which case it is filtered in linear space
+ \param result will contain the downscaled pixels
+ */
+static void downscaleImage(const unsigned char * image, unsigned int width, unsigned int height, bool sRGB, std::vector<unsigned char> & result){
+	// Conversions between the gamma encoded values and linear intensities.
+	static float toLinear[256];
+	static bool tableReady = false;
+	if(!tableReady){
+		for(int vid = 0; vid < 256; ++vid){
+			const float value = float(vid) / 255.0f;
+			toLinear[vid] = value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+		}
+		tableReady = true;
+	}
+	const unsigned int newWidth = std::max(width / 2, 1u);
+	const unsigned int newHeight = std::max(height / 2, 1u);
+	result.resize(size_t(newWidth) * size_t(newHeight) * 4);
+	for(unsigned int y = 0; y < newHeight; ++y){
+		for(unsigned int x = 0; x < newWidth; ++x){
+			// Clamp the footprint for odd or unit dimensions.
+			const unsigned int xs[2] = {std::min(2 * x, width - 1), std::min(2 * x + 1, width - 1)};
+			const unsigned int ys[2] = {std::min(2 * y, height - 1), std::min(2 * y + 1, height - 1)};
+			for(unsigned int cid = 0; cid < 4; ++cid){
+				// The alpha channel is always linear.
+				const bool linearize = sRGB && cid < 3;
+				float sum = 0.0f;
+				for(unsigned int sid = 0; sid < 4; ++sid){
+					const unsigned char value = image[(size_t(ys[sid / 2]) * width + xs[sid % 2]) * 4 + cid];
+					sum += linearize ? toLinear[value] : float(value) / 255.0f;
+				}
+				float average = 0.25f * sum;
+				if(linearize){
+					average = average <= 0.0031308f ? 12.92f * average : 1.055f * std::pow(average, 1.0f / 2.4f) - 0.055f;
+				}
+				result[(size_t(y) * newWidth + x) * 4 + cid] = (unsigned char)(glm::clamp(average, 0.0f, 1.0f) * 255.0f + 0.5f);
+			}
+		}
+	}
+}
+
+void GLUtilities::uploadTextureLayer(const TextureInfos & texture, unsigned int layer, const unsigned char * image, bool sRGB){
+	GLUtilities::bindTexture(0, GL_TEXTURE_2D_ARRAY, texture.id);
+	glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, (GLint)layer, (GLsizei)texture.width, (GLsizei)texture.height, 1, GL_RGBA, GL_UNSIGNED_BYTE, image);
+	// glGenerateMipmap would process all layers, filter this one on the CPU instead.
+	std::vector<unsigned char> levels[2];
+	const unsigned char * previous = image;
+	unsigned int width = texture.width;
+	unsigned int height = texture.height;
+	for(unsigned int mid = 1; mid < texture.mipmap; ++mid){
+		std::vector<unsigned char> & level = levels[mid % 2];
+		downscaleImage(previous, width, height, sRGB, level);
+		width = std::max(width / 2, 1u);
+		height = std::max(height / 2, 1u);
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, (GLint)mid, 0, 0, (GLint)layer, (GLsizei)width, (GLsizei)height, 1, GL_RGBA, GL_UNSIGNED_BYTE, level.data());
+		previous = level.data();
+	}
+}
+
+
+/** Create an element buffer for the mesh indices, bound to the current vertex array. 16-bits indices are used if the vertex count allows it.
+ \param mesh the mesh
+ \param indexType will contain the type of the indices
+ \return the buffer ID
+ */
+static GLuint setupIndexBuffer(const Mesh & mesh, GLenum & indexType){
+	GLuint ebo = 0;
+	glGenBuffers(1, &ebo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+	if(mesh.positions.size() <= 65536){
+		const std::vector<GLushort> shortIndices(mesh.indices.begin(), mesh.indices.end());
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLushort) * shortIndices.size(), shortIndices.data(), GL_STATIC_DRAW);
+		indexType = GL_UNSIGNED_SHORT;
+	} else {
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * mesh.indices.size(), mesh.indices.data(), GL_STATIC_DRAW);
+		indexType = GL_UNSIGNED_INT;
+	}
+	return ebo;
+}
+
+/** Describe the levels of detail of a mesh, with a single level if the mesh has no coarser levels.
+ \param mesh the mesh
+ \param infos will receive the levels and the full resolution index count
+ */
+static void setupLevels(const Mesh & mesh, MeshInfos & infos){
+	infos.levels = mesh.levels;
+	if(infos.levels.empty()){
+		infos.levels.push_back({0, (unsigned int)mesh.indices.size(), 0.0f});
+	}
+	infos.count = (GLsizei)infos.levels[0].count;
+	infos.meshlets = mesh.meshlets;
+}
+
+/** Describe the attributes of the position-only layout, for the bound vertex array and array buffer.
+ \param quantize are positions stored as 16-bits integers
+ */
+static void setupDepthAttributes(bool quantize){
+	glEnableVertexAttribArray(0);
+	if(quantize){
+		glVertexAttribPointer(0, 4, GL_UNSIGNED_SHORT, GL_TRUE, 0, NULL);
+	} else {
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
+	}
+}
+
+/** Describe the attributes of the compact interleaved layout, for the bound vertex array and array buffer.
+ \param quantize are positions stored as 16-bits integers
+ \param stride the size of a vertex
+ \see GLUtilities::setupCompactBuffers
+ */
+static void setupCompactAttributes(bool quantize, size_t stride){
+	const size_t positionSize = quantize ? (4 * sizeof(GLushort)) : (3 * sizeof(GLfloat));
+	const size_t frameSize = 4 * sizeof(GLshort);
+	glEnableVertexAttribArray(0);
+	if(quantize){
+		glVertexAttribPointer(0, 4, GL_UNSIGNED_SHORT, GL_TRUE, (GLsizei)stride, (void*)0);
+	} else {
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, (GLsizei)stride, (void*)0);
+	}
+	glEnableVertexAttribArray(1);
+	glVertexAttribIPointer(1, 4, GL_SHORT, (GLsizei)stride, (void*)(positionSize));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, (GLsizei)stride, (void*)(positionSize + frameSize));
+}
+
+/** Create a tightly packed position-only vertex array for depth-only passes. Vertices with identical positions are merged, and the resulting triangles of each level of detail are reordered for the vertex cache.
+ \param mesh the mesh
+ \param quantize should positions be stored as 16-bits integers
+ \param minis the lower corner of the quantization box
+ \param extent the size of the quantization box
+ \param infos will receive the position-only array and element buffer IDs, and the index type
+ */
+static void setupDepthBuffers(const Mesh & mesh, bool quantize, const glm::vec3 & minis, float extent, MeshInfos & infos){
+	Mesh positionMesh;
+	MeshUtilities::extractPositions(mesh, positionMesh);
+	std::vector<unsigned int> clusters;
+	MeshUtilities::optimizeVertexCache(positionMesh, 16, clusters);
+	MeshUtilities::optimizeVertexFetch(positionMesh);
+	
+	GLuint vbo = 0;
+	glGenBuffers(1, &vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	if(quantize){
+		std::vector<GLushort> quantized(4 * positionMesh.positions.size(), 0);
+		for(size_t vid = 0; vid < positionMesh.positions.size(); ++vid){
+			const glm::vec3 pos = glm::clamp((positionMesh.positions[vid] - minis) / extent, 0.0f, 1.0f);
+			for(int k = 0; k < 3; ++k){
+				quantized[4 * vid + k] = GLushort(std::round(pos[k] * 65535.0f));
+			}
+		}
+		glBufferData(GL_ARRAY_BUFFER, sizeof(GLushort) * quantized.size(), quantized.data(), GL_STATIC_DRAW);
+	} else {
+		glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 3 * positionMesh.positions.size(), positionMesh.positions.data(), GL_STATIC_DRAW);
+	}
+	
+	GLuint vao = 0;
+	glGenVertexArrays(1, &vao);
+	GLUtilities::bindVertexArray(vao);
+	setupDepthAttributes(quantize);
+	infos.eIdDepth = setupIndexBuffer(positionMesh, infos.indexTypeDepth);
+	GLUtilities::bindVertexArray(0);
+	infos.vIdDepth = vao;
+	infos.vertexBufferDepth = vbo;
+	infos.vertexSizeDepth = GLsizei(quantize ? (4 * sizeof(GLushort)) : (3 * sizeof(GLfloat)));
+	
+	Log::Verbose() << Log::OpenGL << "Mesh: position-only stream with " << positionMesh.positions.size() << " vertices instead of " << mesh.positions.size() << "." << std::endl;
+}
+
+/** Map a unit vector onto the octahedron, unfolded in the [-1,1]^2 square.
+ \param dir the direction to encode
+ \return the octahedral coordinates
+ */
+static glm::vec2 encodeOctahedral(const glm::vec3 & dir){
+	const float l1Norm = std::abs(dir.x) + std::abs(dir.y) + std::abs(dir.z);
+	if(l1Norm == 0.0f){
+		return glm::vec2(0.0f);
+	}
+	const glm::vec3 n = dir / l1Norm;
+	if(n.z >= 0.0f){
+		return glm::vec2(n.x, n.y);
+	}
+	// Fold the lower hemisphere on the corners.
+	return glm::vec2((1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f), (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f));
+}
+
+/** Convert a float in [-1,1] to a normalized signed 16-bits integer.
+ \param x the value to convert
+ \return the quantized value
+ */
+static GLshort toSnorm16(float x){
+	return GLshort(std::round(glm::clamp(x, -1.0f, 1.0f) * 32767.0f));
+}
 
 MeshInfos GLUtilities::setupBuffers(const Mesh & mesh){
 	MeshInfos infos;
@@ -437,7 +759,6 @@ MeshInfos GLUtilities::setupBuffers(const Mesh & mesh){
 	GLuint vbo_nor = 0;
 	GLuint vbo_uv = 0;
 	GLuint vbo_tan = 0;
-	GLuint vbo_binor = 0;
 	
 	// Create an array buffer to host the geometry data.
 	if(mesh.positions.size() > 0){
@@ -461,19 +782,13 @@ MeshInfos GLUtilities::setupBuffers(const Mesh & mesh){
 	if(mesh.tangents.size() > 0){
 		glGenBuffers(1, &vbo_tan);
 		glBindBuffer(GL_ARRAY_BUFFER, vbo_tan);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * mesh.tangents.size() * 3, &(mesh.tangents[0]), GL_STATIC_DRAW);
-	}
-	
-	if(mesh.binormals.size() > 0){
-		glGenBuffers(1, &vbo_binor);
-		glBindBuffer(GL_ARRAY_BUFFER, vbo_binor);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * mesh.binormals.size() * 3, &(mesh.binormals[0]), GL_STATIC_DRAW);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * mesh.tangents.size() * 4, &(mesh.tangents[0]), GL_STATIC_DRAW);
 	}
 	
 	// Generate a vertex array.
 	GLuint vao = 0;
 	glGenVertexArrays (1, &vao);
-	glBindVertexArray(vao);
+	GLUtilities::bindVertexArray(vao);
 	
 	// Setup attributes.
 	unsigned int currentAttribute = 0;
@@ -498,45 +813,554 @@ MeshInfos GLUtilities::setupBuffers(const Mesh & mesh){
 	if(vbo_tan > 0){
 		glEnableVertexAttribArray(currentAttribute);
 		glBindBuffer(GL_ARRAY_BUFFER, vbo_tan);
-		glVertexAttribPointer(currentAttribute, 3, GL_FLOAT, GL_FALSE, 0, NULL);
+		glVertexAttribPointer(currentAttribute, 4, GL_FLOAT, GL_FALSE, 0, NULL);
 		++currentAttribute;
 	}
-	if(vbo_binor > 0){
-		glEnableVertexAttribArray(currentAttribute);
-		glBindBuffer(GL_ARRAY_BUFFER, vbo_binor);
-		glVertexAttribPointer(currentAttribute, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-		++currentAttribute;
+	
+	// We load the indices data
+	infos.eId = setupIndexBuffer(mesh, infos.indexType);
+	setupLevels(mesh, infos);
+	
+	GLUtilities::bindVertexArray(0);
+	
+	infos.vId = vao;
+	
+	// Position-only stream for depth passes.
+	setupDepthBuffers(mesh, false, glm::vec3(0.0f), 1.0f, infos);
+	return infos;
+}
+
+MeshInfos GLUtilities::setupCompactBuffers(const Mesh & mesh, bool quantizePositions){
+	MeshInfos infos;
+	const size_t vertCount = mesh.positions.size();
+	
+	// Quantized positions use the same scale on all axis, so that normals don't have to be corrected.
+	const BoundingBox bbox = MeshUtilities::computeBoundingBox(mesh);
+	const glm::vec3 extents = bbox.maxis - bbox.minis;
+	float extent = std::max(extents.x, std::max(extents.y, extents.z));
+	extent = extent > 0.0f ? extent : 1.0f;
+	if(quantizePositions){
+		infos.dequantization = glm::scale(glm::translate(glm::mat4(1.0f), bbox.minis), glm::vec3(extent));
+	}
+	
+	// Interleaved layout: position (3 floats or 4 normalized shorts), frame (4 shorts), uv (2 halfs).
+	const size_t positionSize = quantizePositions ? (4 * sizeof(GLushort)) : (3 * sizeof(GLfloat));
+	const size_t frameSize = 4 * sizeof(GLshort);
+	const size_t uvSize = 2 * sizeof(GLushort);
+	const size_t stride = positionSize + frameSize + uvSize;
+	std::vector<unsigned char> data(stride * vertCount);
+	
+	for(size_t vid = 0; vid < vertCount; ++vid){
+		unsigned char * dst = &data[stride * vid];
+		
+		if(quantizePositions){
+			const glm::vec3 pos = glm::clamp((mesh.positions[vid] - bbox.minis) / extent, 0.0f, 1.0f);
+			const GLushort quantized[4] = { GLushort(std::round(pos.x * 65535.0f)), GLushort(std::round(pos.y * 65535.0f)), GLushort(std::round(pos.z * 65535.0f)), 0 };
+			std::memcpy(dst, quantized, positionSize);
+		} else {
+			std::memcpy(dst, &(mesh.positions[vid][0]), positionSize);
+		}
+		dst += positionSize;
+		
+		// Tangent frame, with defaults for missing attributes.
+		const glm::vec3 normal = vid < mesh.normals.size() ? mesh.normals[vid] : glm::vec3(0.0f, 0.0f, 1.0f);
+		const glm::vec4 tangentFrame = vid < mesh.tangents.size() ? mesh.tangents[vid] : glm::vec4(1.0f, 0.0f, 0.0f, 1.0f);
+		const glm::vec3 tangent = glm::vec3(tangentFrame);
+		const bool flipBitangent = tangentFrame.w < 0.0f;
+		const glm::vec2 octNormal = encodeOctahedral(normal);
+		const glm::vec2 octTangent = encodeOctahedral(tangent);
+		// The bitangent sign is stored in the lowest bit of the last component, leaving 15 bits for the tangent.
+		const int tangentY = int(std::round(glm::clamp(octTangent.y, -1.0f, 1.0f) * 16383.0f));
+		const GLshort frame[4] = { toSnorm16(octNormal.x), toSnorm16(octNormal.y), toSnorm16(octTangent.x), GLshort(tangentY * 2 + (flipBitangent ? 1 : 0)) };
+		std::memcpy(dst, frame, frameSize);
+		dst += frameSize;
+		
+		const glm::vec2 uv = vid < mesh.texcoords.size() ? mesh.texcoords[vid] : glm::vec2(0.0f);
+		const GLushort halfs[2] = { glm::packHalf1x16(uv.x), glm::packHalf1x16(uv.y) };
+		std::memcpy(dst, halfs, uvSize);
 	}
 	
+	GLuint vbo = 0;
+	glGenBuffers(1, &vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, data.size(), data.data(), GL_STATIC_DRAW);
+	
+	// Generate a vertex array.
+	GLuint vao = 0;
+	glGenVertexArrays (1, &vao);
+	GLUtilities::bindVertexArray(vao);
+	
+	// Setup attributes.
+	setupCompactAttributes(quantizePositions, stride);
+	
 	// We load the indices data
+	infos.eId = setupIndexBuffer(mesh, infos.indexType);
+	setupLevels(mesh, infos);
+	
+	GLUtilities::bindVertexArray(0);
+	
+	infos.vId = vao;
+	infos.vertexBuffer = vbo;
+	infos.vertexSize = (GLsizei)stride;
+	infos.quantizedPositions = quantizePositions;
+	
+	// Position-only stream for depth passes, using the same quantization.
+	setupDepthBuffers(mesh, quantizePositions, bbox.minis, extent, infos);
+	
+	const size_t indexSize = infos.indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+	Log::Verbose() << Log::OpenGL << "Mesh: compact layout of " << stride << " bytes per vertex and " << indexSize << " bytes per index, " << (stride * vertCount + indexSize * mesh.indices.size()) << " bytes in total." << std::endl;
+	return infos;
+}
+
+/** Read back the content of a buffer, appending it to a vector.
+ \param buffer the buffer OpenGL ID
+ \param data will receive the buffer content
+ \return the size of the buffer in bytes
+ */
+static size_t readBuffer(GLuint buffer, std::vector<unsigned char> & data){
+	glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+	GLint size = 0;
+	glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &size);
+	const size_t start = data.size();
+	data.resize(start + size_t(size));
+	if(size > 0){
+		glGetBufferSubData(GL_COPY_READ_BUFFER, 0, size, &data[start]);
+	}
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	return size_t(size);
+}
+
+/** Read back the content of an element buffer, appending it to a vector of 32-bits indices.
+ \param buffer the buffer OpenGL ID
+ \param type the type of the indices
+ \param indices will receive the indices
+ \return the number of indices read
+ */
+static size_t readIndices(GLuint buffer, GLenum type, std::vector<GLuint> & indices){
+	std::vector<unsigned char> data;
+	readBuffer(buffer, data);
+	const size_t indexSize = type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+	const size_t count = data.size() / indexSize;
+	const size_t start = indices.size();
+	indices.resize(start + count);
+	for(size_t iid = 0; iid < count; ++iid){
+		if(type == GL_UNSIGNED_SHORT){
+			GLushort index;
+			std::memcpy(&index, &data[iid * indexSize], indexSize);
+			indices[start + iid] = index;
+		} else {
+			std::memcpy(&indices[start + iid], &data[iid * indexSize], indexSize);
+		}
+	}
+	return count;
+}
+
+/** Re-encode quantized positions, stored as the first three 16-bits integers of each vertex, in a new box.
+ \param data the vertices
+ \param count the number of vertices
+ \param stride the size of a vertex
+ \param dequantization the current transformation from quantized positions to model space
+ \param minis the lower corner of the new box
+ \param extent the size of the new box
+ */
+static void requantizePositions(unsigned char * data, size_t count, size_t stride, const glm::mat4 & dequantization, const glm::vec3 & minis, float extent){
+	for(size_t vid = 0; vid < count; ++vid){
+		GLushort quantized[3];
+		std::memcpy(quantized, data + stride * vid, sizeof(quantized));
+		const glm::vec3 position = glm::vec3(dequantization * glm::vec4(glm::vec3(quantized[0], quantized[1], quantized[2]) / 65535.0f, 1.0f));
+		const glm::vec3 pos = glm::clamp((position - minis) / extent, 0.0f, 1.0f);
+		for(int k = 0; k < 3; ++k){
+			quantized[k] = GLushort(std::round(pos[k] * 65535.0f));
+		}
+		std::memcpy(data + stride * vid, quantized, sizeof(quantized));
+	}
+}
+
+/** Create an element buffer from 32-bits indices, bound to the current vertex array.
+ \param indices the indices
+ \param shortIndices should the indices be stored on 16 bits
+ \return the buffer ID
+ */
+static GLuint setupIndexBuffer(const std::vector<GLuint> & indices, bool shortIndices){
 	GLuint ebo = 0;
 	glGenBuffers(1, &ebo);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * mesh.indices.size(), &(mesh.indices[0]), GL_STATIC_DRAW);
+	if(shortIndices){
+		const std::vector<GLushort> packedIndices(indices.begin(), indices.end());
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLushort) * packedIndices.size(), packedIndices.data(), GL_STATIC_DRAW);
+	} else {
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * indices.size(), indices.data(), GL_STATIC_DRAW);
+	}
+	return ebo;
+}
+	
+bool GLUtilities::batchMeshes(const std::vector<MeshInfos *> & meshes){
+	if(meshes.empty()){
+		return false;
+	}
+	const MeshInfos & first = *meshes[0];
+	for(const MeshInfos * mesh : meshes){
+		if(mesh->vertexBuffer == 0 || mesh->vertexBufferDepth == 0 || mesh->vertexSize != first.vertexSize || mesh->vertexSizeDepth != first.vertexSizeDepth || mesh->quantizedPositions != first.quantizedPositions){
+			Log::Error() << Log::OpenGL << "Unable to batch meshes with different vertex layouts." << std::endl;
+			return false;
+		}
+	}
+	const bool quantize = first.quantizedPositions;
 	
-	glBindVertexArray(0);
+	// Box enclosing all quantization boxes, with the same scale on all axis.
+	glm::vec3 minis(0.0f);
+	float extent = 1.0f;
+	if(quantize){
+		// The dequantization maps the unit cube to each mesh box.
+		minis = glm::vec3(first.dequantization[3]);
+		glm::vec3 maxis = minis;
+		for(const MeshInfos * mesh : meshes){
+			minis = glm::min(minis, glm::vec3(mesh->dequantization[3]));
+			maxis = glm::max(maxis, glm::vec3(mesh->dequantization * glm::vec4(1.0f)));
+		}
+		const glm::vec3 extents = maxis - minis;
+		extent = std::max(extents.x, std::max(extents.y, extents.z));
+		extent = extent > 0.0f ? extent : 1.0f;
+	}
+	const glm::mat4 dequantization = quantize ? glm::scale(glm::translate(glm::mat4(1.0f), minis), glm::vec3(extent)) : glm::mat4(1.0f);
 	
-	infos.vId = vao;
-	infos.eId = ebo;
-	infos.count = (GLsizei)mesh.indices.size();
-	return infos;
+	// Gather all vertices and indices. Indices stay relative to each mesh, thanks to base vertices.
+	std::vector<unsigned char> vertices;
+	std::vector<unsigned char> verticesDepth;
+	std::vector<GLuint> indices;
+	std::vector<GLuint> indicesDepth;
+	std::vector<unsigned int> firstIndices(meshes.size());
+	std::vector<GLint> baseVertices(meshes.size());
+	std::vector<GLint> baseVerticesDepth(meshes.size());
+	bool shortIndices = true;
+	bool shortIndicesDepth = true;
+	for(size_t mid = 0; mid < meshes.size(); ++mid){
+		const MeshInfos & mesh = *meshes[mid];
+		const size_t vertexStart = vertices.size();
+		const size_t vertexStartDepth = verticesDepth.size();
+		const size_t size = readBuffer(mesh.vertexBuffer, vertices);
+		const size_t sizeDepth = readBuffer(mesh.vertexBufferDepth, verticesDepth);
+		if(quantize){
+			requantizePositions(&vertices[vertexStart], size / mesh.vertexSize, mesh.vertexSize, mesh.dequantization, minis, extent);
+			requantizePositions(&verticesDepth[vertexStartDepth], sizeDepth / mesh.vertexSizeDepth, mesh.vertexSizeDepth, mesh.dequantization, minis, extent);
+		}
+		baseVertices[mid] = GLint(vertexStart / mesh.vertexSize);
+		baseVerticesDepth[mid] = GLint(vertexStartDepth / mesh.vertexSizeDepth);
+		
+		// Both element buffers contain the same ranges, only the triangles order within clusters and levels differ.
+		firstIndices[mid] = (unsigned int)indices.size();
+		const size_t count = readIndices(mesh.eId, mesh.indexType, indices);
+		const size_t countDepth = readIndices(mesh.eIdDepth, mesh.indexTypeDepth, indicesDepth);
+		if(count != countDepth){
+			Log::Error() << Log::OpenGL << "Unable to batch meshes, the position-only stream has a different number of indices." << std::endl;
+			return false;
+		}
+		shortIndices = shortIndices && mesh.indexType == GL_UNSIGNED_SHORT;
+		shortIndicesDepth = shortIndicesDepth && mesh.indexTypeDepth == GL_UNSIGNED_SHORT;
+	}
+	
+	// Upload the shared buffers.
+	GLuint vbo = 0;
+	glGenBuffers(1, &vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size(), vertices.data(), GL_STATIC_DRAW);
+	GLuint vao = 0;
+	glGenVertexArrays(1, &vao);
+	GLUtilities::bindVertexArray(vao);
+	setupCompactAttributes(quantize, first.vertexSize);
+	const GLuint ebo = setupIndexBuffer(indices, shortIndices);
+	
+	GLuint vboDepth = 0;
+	glGenBuffers(1, &vboDepth);
+	glBindBuffer(GL_ARRAY_BUFFER, vboDepth);
+	glBufferData(GL_ARRAY_BUFFER, verticesDepth.size(), verticesDepth.data(), GL_STATIC_DRAW);
+	GLuint vaoDepth = 0;
+	glGenVertexArrays(1, &vaoDepth);
+	GLUtilities::bindVertexArray(vaoDepth);
+	setupDepthAttributes(quantize);
+	const GLuint eboDepth = setupIndexBuffer(indicesDepth, shortIndicesDepth);
+	GLUtilities::bindVertexArray(0);
+	
+	// Point each mesh to its part of the shared buffers.
+	for(size_t mid = 0; mid < meshes.size(); ++mid){
+		MeshInfos & mesh = *meshes[mid];
+		mesh.vId = vao;
+		mesh.eId = ebo;
+		mesh.indexType = shortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+		mesh.vertexBuffer = vbo;
+		mesh.vIdDepth = vaoDepth;
+		mesh.eIdDepth = eboDepth;
+		mesh.indexTypeDepth = shortIndicesDepth ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+		mesh.vertexBufferDepth = vboDepth;
+		mesh.dequantization = dequantization;
+		mesh.baseVertex = baseVertices[mid];
+		mesh.baseVertexDepth = baseVerticesDepth[mid];
+		for(LevelOfDetail & level : mesh.levels){
+			level.firstIndex += firstIndices[mid];
+		}
+		for(Meshlet & meshlet : mesh.meshlets){
+			meshlet.firstIndex += firstIndices[mid];
+		}
+	}
+	Log::Info() << Log::OpenGL << "Batched " << meshes.size() << " meshes: " << (vertices.size() / first.vertexSize) << " vertices and " << indices.size() << " indices in shared buffers." << std::endl;
+	return true;
+}
+
+// The tracked state starts with the default values of a new context.
+GLuint GLUtilities::_boundVertexArray = 0;
+DrawStatistics GLUtilities::_statistics;
+GLuint GLUtilities::_boundProgram = 0;
+GLuint GLUtilities::_activeTextureUnit = 0;
+GLuint GLUtilities::_boundTextures[TRACKED_TEXTURE_UNITS][TRACKED_TEXTURE_TARGETS] = {};
+GLuint GLUtilities::_boundFramebuffers[2] = {0, 0};
+GLuint GLUtilities::_viewport[4] = {UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN};
+GLuint GLUtilities::_capabilities[TRACKED_CAPABILITIES] = {};
+GLuint GLUtilities::_depthMask = GL_TRUE;
+GLuint GLUtilities::_depthFunc = GL_LESS;
+GLuint GLUtilities::_cullFace = GL_BACK;
+GLuint GLUtilities::_blendFunc[2] = {GL_ONE, GL_ZERO};
+GLuint GLUtilities::_polygonMode = GL_FILL;
+StateStatistics GLUtilities::_stateStatistics;
+
+bool GLUtilities::changeState(GLuint & current, GLuint value){
+	if(current == value){
+		++_stateStatistics.skipped;
+		return false;
+	}
+	current = value;
+	++_stateStatistics.calls;
+	return true;
+}
+
+int GLUtilities::textureTargetSlot(GLenum target){
+	switch(target){
+		case GL_TEXTURE_2D: return 0;
+		case GL_TEXTURE_CUBE_MAP: return 1;
+		case GL_TEXTURE_BUFFER: return 2;
+		case GL_TEXTURE_2D_ARRAY: return 3;
+		case GL_TEXTURE_3D: return 4;
+		default: return -1;
+	}
+}
+
+int GLUtilities::capabilitySlot(GLenum capability){
+	switch(capability){
+		case GL_BLEND: return 0;
+		case GL_DEPTH_TEST: return 1;
+		case GL_CULL_FACE: return 2;
+		case GL_FRAMEBUFFER_SRGB: return 3;
+		case GL_TEXTURE_CUBE_MAP_SEAMLESS: return 4;
+		case GL_SCISSOR_TEST: return 5;
+		default: return -1;
+	}
+}
+
+void GLUtilities::bindVertexArray(GLuint vao){
+	if(!changeState(_boundVertexArray, vao)){
+		++_statistics.skippedBinds;
+		return;
+	}
+	glBindVertexArray(vao);
+	++_statistics.vertexArrayBinds;
+}
+
+void GLUtilities::useProgram(GLuint program){
+	if(changeState(_boundProgram, program)){
+		glUseProgram(program);
+	}
+}
+
+void GLUtilities::bindTexture(GLuint unit, GLenum target, GLuint texture){
+	const int slot = textureTargetSlot(target);
+	const bool tracked = slot >= 0 && unit < GLuint(TRACKED_TEXTURE_UNITS);
+	if(tracked && _boundTextures[unit][slot] == texture){
+		++_stateStatistics.skipped;
+		return;
+	}
+	if(changeState(_activeTextureUnit, unit)){
+		glActiveTexture(GL_TEXTURE0 + unit);
+	}
+	glBindTexture(target, texture);
+	++_stateStatistics.calls;
+	if(tracked){
+		_boundTextures[unit][slot] = texture;
+	}
+}
+
+void GLUtilities::bindFramebuffer(GLenum target, GLuint framebuffer){
+	if(target == GL_FRAMEBUFFER){
+		if(_boundFramebuffers[0] == framebuffer && _boundFramebuffers[1] == framebuffer){
+			++_stateStatistics.skipped;
+			return;
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		_boundFramebuffers[0] = _boundFramebuffers[1] = framebuffer;
+		++_stateStatistics.calls;
+		return;
+	}
+	if(changeState(_boundFramebuffers[target == GL_READ_FRAMEBUFFER ? 1 : 0], framebuffer)){
+		glBindFramebuffer(target, framebuffer);
+	}
+}
+
+GLuint GLUtilities::boundFramebuffer(){
+	if(_boundFramebuffers[0] == UNKNOWN){
+		GLint framebuffer = 0;
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+		_boundFramebuffers[0] = GLuint(framebuffer);
+	}
+	return _boundFramebuffers[0];
+}
+
+void GLUtilities::setViewport(GLint x, GLint y, GLsizei width, GLsizei height){
+	if(_viewport[0] == GLuint(x) && _viewport[1] == GLuint(y) && _viewport[2] == GLuint(width) && _viewport[3] == GLuint(height)){
+		++_stateStatistics.skipped;
+		return;
+	}
+	glViewport(x, y, width, height);
+	_viewport[0] = GLuint(x);
+	_viewport[1] = GLuint(y);
+	_viewport[2] = GLuint(width);
+	_viewport[3] = GLuint(height);
+	++_stateStatistics.calls;
+}
+
+void GLUtilities::setEnabled(GLenum capability, bool enabled){
+	const int slot = capabilitySlot(capability);
+	if(slot < 0){
+		++_stateStatistics.calls;
+	} else if(!changeState(_capabilities[slot], enabled ? 1 : 0)){
+		return;
+	}
+	if(enabled){
+		glEnable(capability);
+	} else {
+		glDisable(capability);
+	}
+}
+
+void GLUtilities::setDepthMask(bool write){
+	if(changeState(_depthMask, write ? GL_TRUE : GL_FALSE)){
+		glDepthMask(write ? GL_TRUE : GL_FALSE);
+	}
+}
+
+void GLUtilities::setDepthFunc(GLenum function){
+	if(changeState(_depthFunc, function)){
+		glDepthFunc(function);
+	}
+}
+
+void GLUtilities::setCullFace(GLenum face){
+	if(changeState(_cullFace, face)){
+		glCullFace(face);
+	}
+}
+
+void GLUtilities::setBlendFunc(GLenum source, GLenum destination){
+	if(_blendFunc[0] == source && _blendFunc[1] == destination){
+		++_stateStatistics.skipped;
+		return;
+	}
+	glBlendFunc(source, destination);
+	_blendFunc[0] = source;
+	_blendFunc[1] = destination;
+	++_stateStatistics.calls;
+}
+
+void GLUtilities::setPolygonMode(GLenum mode){
+	if(changeState(_polygonMode, mode)){
+		glPolygonMode(GL_FRONT_AND_BACK, mode);
+	}
+}
+
+void GLUtilities::deleteTexture(GLuint texture){
+	// Deleted textures are unbound by the driver, and their ID can be reused.
+	for(auto & unit : _boundTextures){
+		for(GLuint & bound : unit){
+			bound = bound == texture ? 0 : bound;
+		}
+	}
+	glDeleteTextures(1, &texture);
+}
+
+void GLUtilities::deleteFramebuffer(GLuint framebuffer){
+	for(GLuint & bound : _boundFramebuffers){
+		bound = bound == framebuffer ? 0 : bound;
+	}
+	glDeleteFramebuffers(1, &framebuffer);
+}
+
+void GLUtilities::deleteProgram(GLuint program){
+	// A program in use is only deleted once it is not used anymore, release it.
+	if(_boundProgram == program){
+		useProgram(0);
+	}
+	glDeleteProgram(program);
+}
+
+void GLUtilities::deleteVertexArray(GLuint vao){
+	if(_boundVertexArray == vao){
+		_boundVertexArray = 0;
+	}
+	glDeleteVertexArrays(1, &vao);
+}
+
+void GLUtilities::invalidateState(){
+	_boundVertexArray = UNKNOWN;
+	_boundProgram = UNKNOWN;
+	_activeTextureUnit = UNKNOWN;
+	for(auto & unit : _boundTextures){
+		for(GLuint & bound : unit){
+			bound = UNKNOWN;
+		}
+	}
+	for(GLuint & value : _boundFramebuffers){ value = UNKNOWN; }
+	for(GLuint & value : _viewport){ value = UNKNOWN; }
+	for(GLuint & value : _capabilities){ value = UNKNOWN; }
+	for(GLuint & value : _blendFunc){ value = UNKNOWN; }
+	_depthMask = UNKNOWN;
+	_depthFunc = UNKNOWN;
+	_cullFace = UNKNOWN;
+	_polygonMode = UNKNOWN;
+}
+
+void GLUtilities::drawElements(GLsizei count, GLenum type, size_t firstIndex, GLint baseVertex){
+	const size_t indexSize = type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+	glDrawElementsBaseVertex(GL_TRIANGLES, count, type, (void*)(firstIndex * indexSize), baseVertex);
+	++_statistics.drawCalls;
+}
+
+void GLUtilities::multiDrawElements(const std::vector<GLsizei> & counts, GLenum type, const std::vector<const void *> & offsets, const std::vector<GLint> & baseVertices){
+	if(counts.empty()){
+		return;
+	}
+	glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts.data(), type, offsets.data(), (GLsizei)counts.size(), baseVertices.data());
+	++_statistics.drawCalls;
+}
+
+size_t GLUtilities::drawElementsInstanced(const std::vector<GLsizei> & counts, GLenum type, const std::vector<const void *> & offsets, const std::vector<GLint> & baseVertices, GLsizei instanceCount){
+	// There is no instanced multi-draw in OpenGL 3.3.
+	for(size_t rid = 0; rid < counts.size(); ++rid){
+		glDrawElementsInstancedBaseVertex(GL_TRIANGLES, counts[rid], type, offsets[rid], instanceCount, baseVertices[rid]);
+	}
+	_statistics.drawCalls += counts.size();
+	return counts.size();
 }
 
 void GLUtilities::saveDefaultFramebuffer(const unsigned int width, const unsigned int height, const std::string & path){
 	
-	GLint currentBoundFB = 0;
-	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &currentBoundFB);
+	const GLuint currentBoundFB = GLUtilities::boundFramebuffer();
 	
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	GLUtilities::bindFramebuffer(GL_FRAMEBUFFER, 0);
 	GLUtilities::savePixels(GL_UNSIGNED_BYTE, GL_RGBA, width, height, 4, path, true, true);
 	
-	glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)currentBoundFB);
+	GLUtilities::bindFramebuffer(GL_FRAMEBUFFER, currentBoundFB);
 }
 
 void GLUtilities::saveFramebuffer(const std::shared_ptr<Framebuffer> & framebuffer, const unsigned int width, const unsigned int height, const std::string & path, const bool flip, const bool ignoreAlpha){
 	
-	GLint currentBoundFB = 0;
-	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &currentBoundFB);
+	const GLuint currentBoundFB = GLUtilities::boundFramebuffer();
 	
 	framebuffer->bind();
 	GLenum type, format;
@@ -546,7 +1370,7 @@ void GLUtilities::saveFramebuffer(const std::shared_ptr<Framebuffer> & framebuff
 
 	GLUtilities::savePixels(type, format, width, height, components, path, flip, ignoreAlpha);
 	
-	glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)currentBoundFB);
+	GLUtilities::bindFramebuffer(GL_FRAMEBUFFER, currentBoundFB);
 }
 
 
@@ -6,6 +6,8 @@
 #include "../resources/MeshUtilities.hpp"
 #include "Framebuffer.hpp"
 
+class MeshBVH;
+
 /**
  \addtogroup Graphics
  @{
@@ -48,10 +50,24 @@ struct TextureInfos {
 	unsigned int height; ///< The texture height.
 	unsigned int mipmap; ///< The number of mipmaps.
 	bool cubemap; ///< Denote if the texture is a cubemap.
+	bool array; ///< Denote if the texture is a 2D array.
 	bool hdr; ///< Denote if the texture is HDR (float values).
 	
 	/** Default constructor. */
-	TextureInfos() : id(0), width(0), height(0), mipmap(0), cubemap(false), hdr(false) {}
+	TextureInfos() : id(0), width(0), height(0), mipmap(0), cubemap(false), array(false), hdr(false) {}
+
+};
+
+/**
+ \brief Store a material: its textures are layers of texture arrays shared with other materials.
+ \ingroup Graphics
+ */
+struct MaterialInfos {
+	std::vector<TextureInfos> textures; ///< The texture arrays, one for each texture of the material.
+	unsigned int layer; ///< The layer of the material in each texture array.
+	
+	/** Default constructor. */
+	MaterialInfos() : layer(0) {}
 
 };
 
@@ -62,15 +78,65 @@ struct TextureInfos {
 struct MeshInfos {
 	GLuint vId; ///< The vertex array OpenGL ID.
 	GLuint eId; ///< The element buffer OpenGL ID.
-	GLsizei count; ///< The number of vertices.
+	GLsizei count; ///< The number of vertices of the full resolution level.
+	GLenum indexType; ///< The type of the indices (GL_UNSIGNED_SHORT or GL_UNSIGNED_INT).
 	BoundingBox bbox; ///< The mesh bounding box in model space.
+	glm::mat4 dequantization; ///< Transformation from the stored vertex positions to model space, identity unless positions are quantized.
+	GLuint vIdDepth; ///< The position-only vertex array OpenGL ID, for depth-only passes.
+	GLuint eIdDepth; ///< The element buffer OpenGL ID of the position-only vertex array, with its own index order.
+	GLenum indexTypeDepth; ///< The type of the position-only indices.
+	std::vector<LevelOfDetail> levels; ///< The levels of detail, as ranges of the element buffers (shared by both vertex arrays). Always contains the full resolution level.
+	std::vector<Meshlet> meshlets; ///< The clusters of the full resolution level, as ranges of the element buffers (shared by both vertex arrays), with their culling data. Can be empty.
+	std::shared_ptr<const MeshBVH> bvh; ///< The hierarchy over the mesh triangles in model space, for CPU ray queries. Can be null.
+	GLuint vertexBuffer; ///< The interleaved vertex buffer OpenGL ID, 0 for layouts using one buffer per attribute.
+	GLuint vertexBufferDepth; ///< The position-only vertex buffer OpenGL ID.
+	GLsizei vertexSize; ///< The size in bytes of a vertex in the interleaved buffer.
+	GLsizei vertexSizeDepth; ///< The size in bytes of a vertex in the position-only buffer.
+	bool quantizedPositions; ///< Are positions stored as 16-bits integers.
+	GLint baseVertex; ///< Offset added to the indices when fetching vertices, non zero if the buffers are shared with other meshes.
+	GLint baseVertexDepth; ///< Offset added to the position-only indices when fetching vertices.
 	
 	/** Default constructor. */
-	MeshInfos() : vId(0), eId(0), count(0), bbox() {}
+	MeshInfos() : vId(0), eId(0), count(0), indexType(GL_UNSIGNED_INT), bbox(), dequantization(1.0f), vIdDepth(0), eIdDepth(0), indexTypeDepth(GL_UNSIGNED_INT), vertexBuffer(0), vertexBufferDepth(0), vertexSize(0), vertexSizeDepth(0), quantizedPositions(false), baseVertex(0), baseVertexDepth(0) {}
 
 };
 
 
+/**
+ \brief Count the vertex array binds and draw calls submitted through GLUtilities.
+ \ingroup Graphics
+ */
+struct DrawStatistics {
+	size_t drawCalls = 0; ///< Number of draw calls, a multi-draw counting as one.
+	size_t vertexArrayBinds = 0; ///< Number of vertex array binds sent to the driver.
+	size_t skippedBinds = 0; ///< Number of redundant vertex array binds that were skipped.
+};
+
+/**
+ \brief Count the state changes sent to the driver through GLUtilities, and the redundant ones that were skipped.
+ \ingroup Graphics
+ */
+struct StateStatistics {
+	size_t calls = 0; ///< Number of state changes sent to the driver.
+	size_t skipped = 0; ///< Number of redundant state changes that were skipped.
+};
+
+/**
+ \brief Store a program submitted to the driver for compilation and linking, whose status has not been queried yet.
+ \ingroup Graphics
+ */
+struct PendingProgram {
+	GLuint id; ///< The OpenGL program ID.
+	GLuint vertexId; ///< The vertex shader ID (or 0).
+	GLuint fragmentId; ///< The fragment shader ID (or 0).
+	GLuint geometryId; ///< The geometry shader ID (or 0).
+	std::string debugInfos; ///< The name of the program, for logging.
+	
+	/** Default constructor. */
+	PendingProgram() : id(0), vertexId(0), fragmentId(0), geometryId(0), debugInfos("") {}
+
+};
+
 /**
  \brief Provide utility functions to communicate with the driver and GPU.
  \ingroup Graphics
@@ -78,6 +144,12 @@ struct MeshInfos {
 class GLUtilities {
 	
 public:
+
+	/** Check if the driver can compile shaders on background threads (GL_KHR_parallel_shader_compile or GL_ARB_parallel_shader_compile), and enable it.
+	 \return true if parallel compilation is available
+	 \note The query is only performed once, subsequent calls return the cached result.
+	 */
+	static bool setupParallelShaderCompilation();
 	
 	/** Create a shader of a given type from a string. Extract additional informations from the shader.
 	 \param prog the content of the shader
@@ -98,6 +170,29 @@ public:
 	 */
 	static GLuint createProgram(const std::string & vertexContent, const std::string & fragmentContent, const std::string & geometryContent, std::map<std::string, int> & bindings, const std::string & debugInfos);
 	
+	/** Submit shaders for compilation and a program for linking, without querying their status. This lets the driver process them in the background.
+	 \param vertexContent the vertex shader string
+	 \param fragmentContent the fragment shader string
+	 \param geometryContent the optional geometry shader string
+	 \param bindings will be filled with the samplers present in the shaders and their user-defined locations
+	 \param debugInfos the name of the program, or any custom debug infos that will be logged.
+	 \return the pending program, to pass to GLUtilities::finishProgram
+	 */
+	static PendingProgram startProgram(const std::string & vertexContent, const std::string & fragmentContent, const std::string & geometryContent, std::map<std::string, int> & bindings, const std::string & debugInfos);
+	
+	/** Check if the driver has finished compiling and linking a pending program, without blocking.
+	 \param program the pending program
+	 \return true if the program can be finished without stalling
+	 \note If parallel compilation is not supported, always returns true.
+	 */
+	static bool isProgramReady(const PendingProgram & program);
+	
+	/** Query the compilation and link status of a pending program, log errors and release the shaders. Will block until the driver is done.
+	 \param program the pending program
+	 \return the OpenGL ID of the program, or 0 if linking failed
+	 */
+	static GLuint finishProgram(const PendingProgram & program);
+	
 	// Texture loading.
 	/** Send a 2D texture to the GPU.
 	 \param path a list of paths, one for each mipmap level of the texture
@@ -115,13 +210,193 @@ public:
 	 */
 	static TextureInfos loadTextureCubemap(const std::vector<std::vector<std::string>> & paths, bool sRGB);
 	
+	/** Create an 8-bits RGBA 2D texture array, with a full mipmap pyramid.
+	 \param width the width of each layer
+	 \param height the height of each layer
+	 \param layers the number of layers to allocate
+	 \param sRGB denotes if gamma conversion should be applied to the texture when used
+	 \return the texture informations, including the OpenGL ID
+	 */
+	static TextureInfos createTextureArray(unsigned int width, unsigned int height, unsigned int layers, bool sRGB);
+	
+	/** Reallocate a texture array with more layers, preserving the content of the existing ones. The texture ID is unchanged.
+	 \param texture the texture array
+	 \param layers the current number of layers
+	 \param newLayers the new number of layers
+	 \param sRGB denotes if gamma conversion should be applied to the texture when used
+	 */
+	static void resizeTextureArray(const TextureInfos & texture, unsigned int layers, unsigned int newLayers, bool sRGB);
+	
+	/** Upload an image to a layer of a texture array, and compute its mipmaps.
+	 \param texture the texture array
+	 \param layer the layer to fill
+	 \param image the 8-bits RGBA pixels, with the size of the array layers
+	 \param sRGB denotes if the image is gamma encoded, to filter the mipmaps in linear space
+	 */
+	static void uploadTextureLayer(const TextureInfos & texture, unsigned int layer, const unsigned char * image, bool sRGB);
+	
 	/** Mesh loading: send a mesh data to the GPU.
 	 \param mesh the mesh to upload
 	 \return the mesh infos, including OpenGL array/buffer IDs
-	 \note The order of attribute locations is: position, normal, uvs, tangents, binormals.
+	 \note The order of attribute locations is: position, normal, uvs, tangents (with the bitangent sign in w).
+	 \note A position-only vertex array is also created, for depth-only passes.
 	 */
 	static MeshInfos setupBuffers(const Mesh & mesh);
 	
+	/** Upload a mesh data to the GPU in a single interleaved buffer, using a compact vertex format.
+	 \param mesh the mesh to upload
+	 \param quantizePositions should positions be stored as 16-bits integers relative to the mesh bounding box
+	 \return the mesh infos, including OpenGL array/buffer IDs
+	 \note The order of attribute locations is: position, frame (octahedral normal, octahedral tangent and bitangent sign), uvs.
+	 \note Quantized positions are in [0,1]^3 and must be transformed by the MeshInfos dequantization matrix.
+	 \note A position-only vertex array is also created, for depth-only passes.
+	 */
+	static MeshInfos setupCompactBuffers(const Mesh & mesh, bool quantizePositions);
+	
+	/** Pack meshes uploaded with the compact layout in shared vertex and element buffers, with a single vertex array for each vertex stream. Each mesh is then rendered by offsetting its indices with its base vertex, and its levels of detail and clusters point to its part of the shared element buffers.
+	 \param meshes the meshes to pack, updated in place
+	 \return true if the meshes were packed
+	 \note Quantized positions are re-encoded in a box enclosing all meshes, and the dequantization matrices updated.
+	 \note The meshes original buffers are not released, as they can be shared with other resources.
+	 \warning All meshes should use the same vertex layout.
+	 */
+	static bool batchMeshes(const std::vector<MeshInfos *> & meshes);
+	
+	/** Bind a vertex array, skipping the call if it is already bound.
+	 \param vao the vertex array OpenGL ID
+	 \warning All vertex array binds should go through this function for the bound array to be known.
+	 */
+	static void bindVertexArray(GLuint vao);
+	
+	/** Use a program, skipping the call if it is already in use.
+	 \param program the program OpenGL ID
+	 */
+	static void useProgram(GLuint program);
+	
+	/** Bind a texture to a texture unit, skipping the calls if it is already bound.
+	 \param unit the texture unit index (not the GL_TEXTUREi enum)
+	 \param target the texture target (GL_TEXTURE_2D,...)
+	 \param texture the texture OpenGL ID
+	 \note The active texture unit is changed to the one requested.
+	 */
+	static void bindTexture(GLuint unit, GLenum target, GLuint texture);
+	
+	/** Bind a framebuffer, skipping the call if it is already bound.
+	 \param target the binding point (GL_FRAMEBUFFER, GL_DRAW_FRAMEBUFFER or GL_READ_FRAMEBUFFER)
+	 \param framebuffer the framebuffer OpenGL ID
+	 */
+	static void bindFramebuffer(GLenum target, GLuint framebuffer);
+	
+	/** Query the framebuffer bound for drawing.
+	 \return the framebuffer OpenGL ID
+	 */
+	static GLuint boundFramebuffer();
+	
+	/** Set the viewport, skipping the call if it is unchanged.
+	 \param x the horizontal position of the lower left corner
+	 \param y the vertical position of the lower left corner
+	 \param width the viewport width
+	 \param height the viewport height
+	 */
+	static void setViewport(GLint x, GLint y, GLsizei width, GLsizei height);
+	
+	/** Enable or disable a capability, skipping the call if it is unchanged.
+	 \param capability the capability (GL_BLEND, GL_DEPTH_TEST,...)
+	 \param enabled the new status
+	 */
+	static void setEnabled(GLenum capability, bool enabled);
+	
+	/** Enable or disable depth writes, skipping the call if it is unchanged.
+	 \param write should the depth be written
+	 */
+	static void setDepthMask(bool write);
+	
+	/** Set the depth comparison function, skipping the call if it is unchanged.
+	 \param function the comparison function (GL_LESS,...)
+	 */
+	static void setDepthFunc(GLenum function);
+	
+	/** Set the faces to cull, skipping the call if it is unchanged.
+	 \param face the faces to cull (GL_BACK,...)
+	 */
+	static void setCullFace(GLenum face);
+	
+	/** Set the blending factors, skipping the call if they are unchanged.
+	 \param source the source factor
+	 \param destination the destination factor
+	 */
+	static void setBlendFunc(GLenum source, GLenum destination);
+	
+	/** Set the rasterization mode of front and back faces, skipping the call if it is unchanged.
+	 \param mode the polygon mode (GL_FILL, GL_LINE,...)
+	 */
+	static void setPolygonMode(GLenum mode);
+	
+	/** Delete a texture, and forget its bindings.
+	 \param texture the texture OpenGL ID
+	 */
+	static void deleteTexture(GLuint texture);
+	
+	/** Delete a framebuffer, and forget its bindings.
+	 \param framebuffer the framebuffer OpenGL ID
+	 */
+	static void deleteFramebuffer(GLuint framebuffer);
+	
+	/** Delete a program, and forget it if it is in use.
+	 \param program the program OpenGL ID
+	 */
+	static void deleteProgram(GLuint program);
+	
+	/** Delete a vertex array, and forget it if it is bound.
+	 \param vao the vertex array OpenGL ID
+	 */
+	static void deleteVertexArray(GLuint vao);
+	
+	/** Forget all the tracked state, for instance after external code modified it. The next calls will be sent to the driver. */
+	static void invalidateState();
+	
+	/** Query the number of state changes sent and skipped since the last reset.
+	 \return the counters
+	 */
+	static const StateStatistics & stateStatistics(){ return _stateStatistics; }
+	
+	/** Reset the state changes counters. */
+	static void resetStateStatistics(){ _stateStatistics = StateStatistics(); }
+	
+	/** Render a range of the element buffer of the bound vertex array.
+	 \param count the number of indices
+	 \param type the type of the indices
+	 \param firstIndex the position of the first index in the element buffer
+	 \param baseVertex the offset to add to indices when fetching vertices
+	 */
+	static void drawElements(GLsizei count, GLenum type, size_t firstIndex, GLint baseVertex);
+	
+	/** Render several ranges of the element buffer of the bound vertex array in a single call.
+	 \param counts the number of indices of each range
+	 \param type the type of the indices
+	 \param offsets the byte offset of each range in the element buffer
+	 \param baseVertices the offset to add to indices when fetching vertices, for each range
+	 */
+	static void multiDrawElements(const std::vector<GLsizei> & counts, GLenum type, const std::vector<const void *> & offsets, const std::vector<GLint> & baseVertices);
+	
+	/** Render several instances of ranges of the element buffer of the bound vertex array, with one call per range.
+	 \param counts the number of indices of each range
+	 \param type the type of the indices
+	 \param offsets the byte offset of each range in the element buffer
+	 \param baseVertices the offset to add to indices when fetching vertices, for each range
+	 \param instanceCount the number of instances
+	 \return the number of draw calls issued
+	 */
+	static size_t drawElementsInstanced(const std::vector<GLsizei> & counts, GLenum type, const std::vector<const void *> & offsets, const std::vector<GLint> & baseVertices, GLsizei instanceCount);
+	
+	/** Query the number of binds and draw calls since the last reset.
+	 \return the counters
+	 */
+	static const DrawStatistics & statistics(){ return _statistics; }
+	
+	/** Reset the binds and draw calls counters. */
+	static void resetStatistics(){ _statistics = DrawStatistics(); }
+	
 	/** Save a given framebuffer content to the disk.
 	 \param framebuffer the framebuffer to save
 	 \param width the width of the region to save
@@ -145,6 +420,20 @@ public:
 	
 private:
 	
+	/** Preprocess a shader string (extracting samplers bindings) and submit it for compilation, without querying the result.
+	 \param prog the content of the shader
+	 \param type the type of shader (GL_VERTEX_SHADER,...)
+	 \param bindings will be filled with the samplers present in the shader and their user-defined locations
+	 \return the OpenGL ID of the shader object
+	 */
+	static GLuint compileShader(const std::string & prog, GLuint type, std::map<std::string, int> & bindings);
+	
+	/** Query the compilation status of a shader, blocking until it is available.
+	 \param id the OpenGL ID of the shader object
+	 \return the indented compilation log, empty if the compilation succeeded
+	 */
+	static std::string shaderLog(GLuint id);
+	
 	/** Read back the currently bound framebuffer to the CPU and save it in the best possible format on disk.
 	 \param type the type of the framebuffer
 	 \param format the format of the framebuffer
@@ -158,6 +447,45 @@ private:
 	 */
 	static void savePixels(const GLenum type, const GLenum format, const unsigned int width, const unsigned int height, const unsigned int components, const std::string & path, const bool flip, const bool ignoreAlpha);
 	
+	/** Map a texture target to its slot in the tracked bindings.
+	 \param target the texture target
+	 \return the slot index, or -1 if the target is not tracked
+	 */
+	static int textureTargetSlot(GLenum target);
+	
+	/** Map a capability to its slot in the tracked capabilities.
+	 \param capability the capability
+	 \return the slot index, or -1 if the capability is not tracked
+	 */
+	static int capabilitySlot(GLenum capability);
+	
+	/** Record a state change, and test if it is redundant.
+	 \param current the tracked value, updated to the new one
+	 \param value the new value
+	 \return true if the call should be sent to the driver
+	 */
+	static bool changeState(GLuint & current, GLuint value);
+	
+	static const GLuint UNKNOWN = ~0u; ///< Value of the state not known to the tracker.
+	static const int TRACKED_TEXTURE_UNITS = 32; ///< Number of texture units tracked.
+	static const int TRACKED_TEXTURE_TARGETS = 5; ///< Number of texture targets tracked per unit.
+	static const int TRACKED_CAPABILITIES = 6; ///< Number of capabilities tracked.
+	
+	static GLuint _boundVertexArray; ///< The currently bound vertex array.
+	static DrawStatistics _statistics; ///< Binds and draw calls counters.
+	static GLuint _boundProgram; ///< The program in use.
+	static GLuint _activeTextureUnit; ///< The active texture unit index.
+	static GLuint _boundTextures[TRACKED_TEXTURE_UNITS][TRACKED_TEXTURE_TARGETS]; ///< The texture bound to each target of each unit.
+	static GLuint _boundFramebuffers[2]; ///< The framebuffers bound for drawing and reading.
+	static GLuint _viewport[4]; ///< The viewport position and size.
+	static GLuint _capabilities[TRACKED_CAPABILITIES]; ///< Status of the tracked capabilities.
+	static GLuint _depthMask; ///< Are depth writes enabled.
+	static GLuint _depthFunc; ///< The depth comparison function.
+	static GLuint _cullFace; ///< The culled faces.
+	static GLuint _blendFunc[2]; ///< The blending source and destination factors.
+	static GLuint _polygonMode; ///< The rasterization mode.
+	static StateStatistics _stateStatistics; ///< State changes counters.
+
 };
 
 
@@ -7,20 +7,58 @@
 ProgramInfos::ProgramInfos(){
 	_id = 0;
 	_uniforms.clear();
+	_state = Idle;
+	_used = false;
 }
 
-ProgramInfos::ProgramInfos(const std::string & vertexName, const std::string & fragmentName, const std::string & geometryName){
+ProgramInfos::ProgramInfos(const std::string & vertexName, const std::string & fragmentName, const std::string & geometryName, bool lazy){
 	_vertexName = vertexName;
 	_fragmentName = fragmentName;
 	_geometryName = geometryName;
+	_id = 0;
+	_state = Idle;
+	_used = false;
 	
-	std::map<std::string, int> bindings;
+	if(!lazy){
+		finish();
+	}
+}
+
+void ProgramInfos::compile(){
+	submit();
+}
+
+bool ProgramInfos::poll(){
+	if(_state == Compiling && GLUtilities::isProgramReady(_pending)){
+		finish();
+	}
+	return _state == Ready;
+}
+
+void ProgramInfos::submit() const {
+	if(_state != Idle){
+		return;
+	}
+	_bindings.clear();
 	const std::string vertexContent = Resources::manager().getShader(_vertexName, Resources::Vertex);
 	const std::string fragmentContent = Resources::manager().getShader(_fragmentName, Resources::Fragment);
 	const std::string geometryContent = _geometryName.empty() ? "" : Resources::manager().getShader(_geometryName, Resources::Geometry);
 	const std::string debugName = "(" + _vertexName + ", " + (_geometryName.empty() ? "" : (_geometryName + ", ")) + _fragmentName + ")";
 	
-	_id = GLUtilities::createProgram(vertexContent, fragmentContent, geometryContent, bindings, debugName);
+	_pending = GLUtilities::startProgram(vertexContent, fragmentContent, geometryContent, _bindings, debugName);
+	_id = _pending.id;
+	_state = Compiling;
+}
+
+void ProgramInfos::finish() const {
+	if(_state == Ready){
+		return;
+	}
+	if(_state == Idle){
+		submit();
+	}
+	_id = GLUtilities::finishProgram(_pending);
+	_state = Ready;
 	_uniforms.clear();
 	
 	// Get the number of active uniforms and their maximum length.
@@ -29,7 +67,7 @@ ProgramInfos::ProgramInfos(const std::string & vertexName, const std::string & f
 	glGetProgramiv(_id, GL_ACTIVE_UNIFORMS, &count);
 	glGetProgramiv(_id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &size);
 	
-	glUseProgram(_id);
+	GLUtilities::useProgram(_id);
 	for(GLuint i = 0; i < (GLuint)count; ++i){
 		// Get infos (name, name length, type,...) of each uniform.
 		std::vector<GLchar> uname(size);
@@ -57,15 +95,20 @@ ProgramInfos::ProgramInfos(const std::string & vertexName, const std::string & f
 		}
 	}
 	// Register texture slots.
-	for(auto& texture : bindings){
+	for(auto& texture : _bindings){
 		glUniform1i(_uniforms[texture.first], texture.second);
-		checkGLErrorInfos("Unused texture \"" + texture.first + "\" in program " + debugName + ".");
+		checkGLErrorInfos("Unused texture \"" + texture.first + "\" in program " + _pending.debugInfos + ".");
 	}
 	
-	glUseProgram(0);
+	GLUtilities::useProgram(0);
 	checkGLError();
 }
 
+const GLuint ProgramInfos::id() const {
+	finish();
+	_used = true;
+	return _id;
+}
 
 const GLint ProgramInfos::uniform(const std::string & name) const {
 	if(_uniforms.count(name) > 0) {
@@ -77,18 +120,23 @@ const GLint ProgramInfos::uniform(const std::string & name) const {
 
 void ProgramInfos::cacheUniformArray(const std::string & name, const std::vector<glm::vec3> & vals) {
 	// Store the vec3s elements in a cache, to avoid re-setting them at each frame.
-	glUseProgram(_id);
+	GLUtilities::useProgram(id());
 	for(size_t i = 0; i < vals.size(); ++i){
 		const std::string elementName = name + "[" + std::to_string(i) + "]";
 		_vec3s[elementName] = vals[i];
 		glUniform3fv(_uniforms[elementName], 1, &(_vec3s[elementName][0]));
 	}
-	glUseProgram(0);
+	GLUtilities::useProgram(0);
 	checkGLError();
 }
 
 void ProgramInfos::reload()
 {
+	// Lazy programs that were never submitted will pick up the new shaders when used.
+	if(_state == Idle){
+		return;
+	}
+	finish();
 	std::map<std::string, int> bindings;
 	const std::string vertexContent = Resources::manager().getShader(_vertexName, Resources::Vertex);
 	const std::string fragmentContent = Resources::manager().getShader(_fragmentName, Resources::Fragment);
@@ -97,7 +145,7 @@ void ProgramInfos::reload()
 	_id = GLUtilities::createProgram(vertexContent, fragmentContent, geometryContent, bindings, debugName);
 	
 	// For each stored uniform, update its location, and update textures slots and cached values.
-	glUseProgram(_id);
+	GLUtilities::useProgram(_id);
 	for (auto & uni : _uniforms) {
 		_uniforms[uni.first] = glGetUniformLocation(_id, uni.first.c_str());
 		if (_vec3s.count(uni.first) > 0) {
@@ -109,12 +157,12 @@ void ProgramInfos::reload()
 		glUniform1i(_uniforms[texture.first], texture.second);
 		checkGLErrorInfos("Unused texture \"" + texture.first + "\" in program " + debugName + ".");
 	}
-	glUseProgram(0);
+	GLUtilities::useProgram(0);
 }
 
 
 void ProgramInfos::validate(){
-	glValidateProgram(_id);
+	glValidateProgram(id());
 	int status = -2;
 	glGetProgramiv(_id, GL_VALIDATE_STATUS, &status);
 	Log::Error() << Log::OpenGL << "Program with shaders: " << _vertexName << ", " << _fragmentName << " is " << (status == GL_TRUE ? "" : "not ") << "validated." << std::endl;
@@ -137,7 +185,7 @@ void ProgramInfos::saveBinary(const std::string & outputPath){
 		return;
 	}
 	int length = 0;
-	glGetProgramiv(_id, GL_PROGRAM_BINARY_LENGTH, &length);
+	glGetProgramiv(id(), GL_PROGRAM_BINARY_LENGTH, &length);
 	if (length <= 0) {
 		Log::Error() << Log::OpenGL << "No binary for program using shaders (" << _vertexName << "," << _fragmentName << ")." << std::endl;
 		return;
@@ -152,5 +200,5 @@ void ProgramInfos::saveBinary(const std::string & outputPath){
 
 
 ProgramInfos::~ProgramInfos(){
-	glDeleteProgram(_id);
+	GLUtilities::deleteProgram(_id);
 }
@@ -2,6 +2,7 @@
 #define ProgramInfos_h
 
 #include "../Common.hpp"
+#include "GLUtilities.hpp"
 #include <map>
 
 /**
@@ -20,8 +21,19 @@ public:
 	 \param vertexName the name of the vertex shader
 	 \param fragmentName the name of the fragment shader
 	 \param geometryName the name of the geometry shader (can be empty)
+	 \param lazy if true, compilation is deferred until the program is first bound or explicitly submitted
 	 */
-	ProgramInfos(const std::string & vertexName, const std::string & fragmentName, const std::string & geometryName);
+	ProgramInfos(const std::string & vertexName, const std::string & fragmentName, const std::string & geometryName, bool lazy = false);
+	
+	/** Submit the shaders to the driver for compilation and linking, without waiting for the result.
+	 \note Status queries are deferred until the program ID is first requested. No-op if the program has already been submitted.
+	 */
+	void compile();
+	
+	/** Finish the program if the driver has completed its compilation and linking, without blocking.
+	 \return true if the program can be bound without stalling
+	 */
+	bool poll();
 	
 	/** Destructor */
 	~ProgramInfos();
@@ -57,20 +69,61 @@ public:
 	 */
 	void saveBinary(const std::string & outputPath);
 
-	/** Query the program ID.
+	/** Query the program ID. If the program is lazy, this will finish its compilation.
 	 \return the OpenGL ID
+	 \note The program is then flagged as used.
 	 */
-	const GLuint id() const { return _id; }
+	const GLuint id() const;
+	
+	/** Query if the program has been bound at least once.
+	 \return true if the program ID has been requested
+	 */
+	bool used() const { return _used; }
+	
+	/** Query the vertex shader name.
+	 \return the name
+	 */
+	const std::string & vertexName() const { return _vertexName; }
+	
+	/** Query the fragment shader name.
+	 \return the name
+	 */
+	const std::string & fragmentName() const { return _fragmentName; }
+	
+	/** Query the geometry shader name.
+	 \return the name (empty if no geometry shader)
+	 */
+	const std::string & geometryName() const { return _geometryName; }
 	
 private:
 	
-	GLuint _id; ///< The OpenGL program ID.
+	/// \brief Compilation state of the program.
+	enum State {
+		Idle, ///< Nothing submitted to the driver yet.
+		Compiling, ///< Submitted, status not queried yet.
+		Ready ///< Linked and introspected.
+	};
+	
+	/** Load the shaders and submit them to the driver, if not already done. */
+	void submit() const;
+	
+	/** Wait for the program compilation and linking (submitting it if needed), then register its uniforms and texture slots.
+	 \note Lazy programs are finished on first use, which is why the state is mutable.
+	 */
+	void finish() const;
+	
+	mutable GLuint _id; ///< The OpenGL program ID.
 	std::string _vertexName; ///< The vertex shader filename
 	std::string _fragmentName; ///< The fragment shader filename
 	std::string _geometryName; ///< The geometry shader filename
-	std::map<std::string, GLint> _uniforms; ///< The list of automatically registered uniforms and their locations.
+	mutable std::map<std::string, GLint> _uniforms; ///< The list of automatically registered uniforms and their locations.
 	std::map<std::string, glm::vec3> _vec3s; ///< Internal vec3 uniforms cache, for reloading.
 	
+	mutable State _state; ///< Current compilation state.
+	mutable PendingProgram _pending; ///< The program being compiled by the driver.
+	mutable std::map<std::string, int> _bindings; ///< Texture slots detected in the shaders.
+	mutable bool _used; ///< Has the program ID been requested.
+	
 };
 
 
@@ -2,30 +2,94 @@
 #include "../Common.hpp"
 #include "../input/InputCallbacks.hpp"
 #include "../input/Input.hpp"
+#include "../graphics/GLUtilities.hpp"
 
 #include <nfd/nfd.h>
+#include <mutex>
+#include <cstring>
 
 
 namespace Interface {
 	
+	/// Protects the display scale, written when starting a frame and read when rendering one, possibly on another thread.
+	static std::mutex _displayMutex;
 
 	void setupImGui(GLFWwindow * window){
 		ImGui::CreateContext();
 		ImGuiIO& io = ImGui::GetIO(); (void)io;
 		ImGui_ImplGlfw_InitForOpenGL(window, false);
 		ImGui_ImplOpenGL3_Init("#version 150");
+		// Create the GL objects now, frames might then be started on a thread without the GL context.
+		ImGui_ImplOpenGL3_CreateDeviceObjects();
 		ImGui::StyleColorsDark();
 	}
 		
 	void beginFrame(){
 		ImGui_ImplOpenGL3_NewFrame();
-		ImGui_ImplGlfw_NewFrame();
+		{
+			std::lock_guard<std::mutex> lock(_displayMutex);
+			ImGui_ImplGlfw_NewFrame();
+		}
 		ImGui::NewFrame();
 	}
 	
 	void endFrame(){
 		ImGui::Render();
 		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+		// The interface renderer binds its own state behind our back.
+		GLUtilities::invalidateState();
+	}
+	
+	/** Copy an interface buffer, reusing the memory of the destination.
+	 \param src the buffer to copy
+	 \param dst the destination buffer
+	 */
+	template<typename T>
+	static void copyBuffer(const ImVector<T> & src, ImVector<T> & dst){
+		dst.resize(src.Size);
+		if(src.Size > 0){
+			std::memcpy(dst.Data, src.Data, size_t(src.Size) * sizeof(T));
+		}
+	}
+	
+	void DrawData::capture(){
+		ImGui::Render();
+		const ImDrawData * data = ImGui::GetDrawData();
+		while(int(_lists.size()) < data->CmdListsCount){
+			_lists.push_back(new ImDrawList(ImGui::GetDrawListSharedData()));
+		}
+		for(int lid = 0; lid < data->CmdListsCount; ++lid){
+			const ImDrawList & list = *data->CmdLists[lid];
+			copyBuffer(list.CmdBuffer, _lists[lid]->CmdBuffer);
+			copyBuffer(list.IdxBuffer, _lists[lid]->IdxBuffer);
+			copyBuffer(list.VtxBuffer, _lists[lid]->VtxBuffer);
+			_lists[lid]->Flags = list.Flags;
+		}
+		_data.Valid = data->Valid;
+		_data.CmdLists = _lists.data();
+		_data.CmdListsCount = data->CmdListsCount;
+		_data.TotalIdxCount = data->TotalIdxCount;
+		_data.TotalVtxCount = data->TotalVtxCount;
+		_data.DisplayPos = data->DisplayPos;
+		_data.DisplaySize = data->DisplaySize;
+	}
+	
+	void DrawData::render(){
+		if(!_data.Valid){
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(_displayMutex);
+			ImGui_ImplOpenGL3_RenderDrawData(&_data);
+		}
+		// The interface renderer binds its own state behind our back.
+		GLUtilities::invalidateState();
+	}
+	
+	DrawData::~DrawData(){
+		for(ImDrawList * list : _lists){
+			delete list;
+		}
 	}
 	
 	void clean(){
@@ -109,11 +173,11 @@ namespace Interface {
 		Input::manager().resizeEvent(width, height);
 		
 		// Default OpenGL state, just in case.
-		glDisable(GL_DEPTH_TEST);
-		glDisable(GL_CULL_FACE);
+		GLUtilities::setEnabled(GL_DEPTH_TEST, false);
+		GLUtilities::setEnabled(GL_CULL_FACE, false);
 		glBlendEquation(GL_FUNC_ADD);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-		glDisable(GL_BLEND);
+		GLUtilities::setBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		GLUtilities::setEnabled(GL_BLEND, false);
 		
 		return window;
 	}
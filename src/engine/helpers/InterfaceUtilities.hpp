@@ -7,6 +7,7 @@
 #include <imgui/imgui.h>
 #include <imgui/imgui_impl_glfw.h>
 #include <imgui/imgui_impl_opengl3.h>
+#include <vector>
 
 struct GLFWwindow;
 
@@ -27,6 +28,39 @@ namespace Interface {
 	/** Finish registering GUI items and render them. */
 	void endFrame();
 	
+	/**
+	 \brief Copy of the interface draw commands of a frame, to render them later, possibly on another thread than the one registering the GUI items. The copied buffers keep their memory between frames.
+	 \ingroup Helpers
+	 */
+	class DrawData {
+	public:
+		
+		/** Constructor. */
+		DrawData() = default;
+		
+		/** Finish registering GUI items and copy their draw commands. */
+		void capture();
+		
+		/** Render the draw commands copied by the last capture. */
+		void render();
+		
+		/** Destructor. */
+		~DrawData();
+		
+		/** Copy constructor (disabled). */
+		DrawData(const DrawData &) = delete;
+		
+		/** Copy assignment (disabled).
+		 \return a reference to the object assigned to
+		 */
+		DrawData & operator= (const DrawData &) = delete;
+		
+	private:
+		
+		ImDrawData _data; ///< Draw data referencing the copied lists.
+		std::vector<ImDrawList *> _lists; ///< The copied draw lists.
+	};
+	
 	/** Clean internal resources. */
 	void clean();
 	
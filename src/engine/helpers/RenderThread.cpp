@@ -0,0 +1,100 @@
+#include "RenderThread.hpp"
+#include "../Common.hpp"
+
+RenderThread::RenderThread(GLFWwindow * window, bool threaded, const std::function<void()> & frame) : _window(window), _frame(frame) {
+	if(!threaded){
+		return;
+	}
+	// A context can only be current on one thread at a time.
+	glfwMakeContextCurrent(nullptr);
+	_running = true;
+	_thread = std::thread(&RenderThread::loop, this);
+}
+
+RenderThread::~RenderThread(){
+	stop();
+}
+
+void RenderThread::wait(){
+	if(!_running){
+		return;
+	}
+	std::unique_lock<std::mutex> lock(_mutex);
+	_condition.wait(lock, [this](){ return _request == Request::None; });
+}
+
+void RenderThread::submit(){
+	wait();
+	// The interface of the previous frame has been rendered, its copy can be replaced.
+	_interface.capture();
+	if(!_running){
+		render();
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_request = Request::Frame;
+	}
+	_condition.notify_all();
+}
+
+void RenderThread::run(const std::function<void()> & task){
+	if(!_running){
+		task();
+		return;
+	}
+	std::unique_lock<std::mutex> lock(_mutex);
+	_condition.wait(lock, [this](){ return _request == Request::None; });
+	_task = &task;
+	_request = Request::Task;
+	_condition.notify_all();
+	_condition.wait(lock, [this](){ return _request == Request::None; });
+	_task = nullptr;
+}
+
+void RenderThread::stop(){
+	if(!_running){
+		return;
+	}
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_condition.wait(lock, [this](){ return _request == Request::None; });
+		_request = Request::Stop;
+	}
+	_condition.notify_all();
+	_thread.join();
+	_running = false;
+	_request = Request::None;
+	glfwMakeContextCurrent(_window);
+}
+
+void RenderThread::loop(){
+	glfwMakeContextCurrent(_window);
+	std::unique_lock<std::mutex> lock(_mutex);
+	while(true){
+		_condition.wait(lock, [this](){ return _request != Request::None; });
+		const Request request = _request;
+		if(request == Request::Stop){
+			break;
+		}
+		lock.unlock();
+		
+		if(request == Request::Frame){
+			render();
+		} else {
+			(*_task)();
+		}
+		
+		lock.lock();
+		_request = Request::None;
+		_condition.notify_all();
+	}
+	lock.unlock();
+	glfwMakeContextCurrent(nullptr);
+}
+
+void RenderThread::render(){
+	_frame();
+	_interface.render();
+	glfwSwapBuffers(_window);
+}
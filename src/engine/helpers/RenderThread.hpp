@@ -0,0 +1,90 @@
+#ifndef RenderThread_h
+#define RenderThread_h
+
+#include "InterfaceUtilities.hpp"
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+struct GLFWwindow;
+
+/**
+ \brief Render the frames of a window, optionally on a dedicated thread owning the GL context.
+ \details The calling thread polls the window events, registers the interface items and prepares frame N+1, while the rendering thread issues the GL commands of frame N, renders its interface and swaps the window buffers. The state read by the rendering is double-buffered: the calling thread waits for the rendering of the previous frame, hands the prepared state over, and submits the frame. Without a dedicated thread, frames are rendered by the calling thread when submitted.
+ \warning Once the rendering thread is started, the calling thread shouldn't perform any GL call, nor use the resources manager, outside of the tasks executed with run().
+ \ingroup Helpers
+ */
+class RenderThread {
+
+public:
+
+	/** Constructor. With a dedicated thread, the window context is moved from the calling thread to the rendering thread.
+	 \param window the window to render to, its context should be current on the calling thread
+	 \param threaded should the frames be rendered on a dedicated thread
+	 \param frame the function issuing the GL commands of a frame, it should only read the state handed over when submitting the frame
+	 */
+	RenderThread(GLFWwindow * window, bool threaded, const std::function<void()> & frame);
+	
+	/** Wait for the rendering of the previous frame to complete. Until the next submission, the state read by the rendering can be modified. */
+	void wait();
+	
+	/** Capture the interface items registered since the last frame, and render the frame: the frame function, the interface and the buffers swap. With a dedicated thread, returns immediately.
+	 \note Waits for the rendering of the previous frame first.
+	 */
+	void submit();
+	
+	/** Execute a task with the GL context, on the rendering thread, and wait for its completion. Used for loading resources, resizing framebuffers, or accessing the state owned by the rendering.
+	 \param task the function to execute
+	 \note Waits for the rendering of the previous frame first.
+	 */
+	void run(const std::function<void()> & task);
+	
+	/** Wait for the last frame, stop the rendering thread and make the window context current on the calling thread again. */
+	void stop();
+	
+	/** Query if the frames are rendered on a dedicated thread.
+	 \return true if a rendering thread is running
+	 */
+	bool threaded() const { return _running; }
+	
+	/** Destructor. Stops the rendering thread. */
+	~RenderThread();
+	
+	/** Copy constructor (disabled). */
+	RenderThread(const RenderThread &) = delete;
+	
+	/** Copy assignment (disabled).
+	 \return a reference to the object assigned to
+	 */
+	RenderThread & operator= (const RenderThread &) = delete;
+
+private:
+
+	/// \brief Work requested from the rendering thread.
+	enum class Request {
+		None, ///< The rendering thread is idle.
+		Frame, ///< Render the submitted frame.
+		Task, ///< Execute a task.
+		Stop ///< Release the context and exit.
+	};
+	
+	/** Execute the requests until the rendering thread is stopped. */
+	void loop();
+	
+	/** Render the submitted frame, its interface and swap the window buffers. */
+	void render();
+	
+	GLFWwindow * _window; ///< The window rendered to.
+	std::function<void()> _frame; ///< Issue the GL commands of a frame.
+	Interface::DrawData _interface; ///< The interface of the submitted frame.
+	std::thread _thread; ///< The rendering thread.
+	std::mutex _mutex; ///< Protects the requests.
+	std::condition_variable _condition; ///< Signals requests and completions.
+	const std::function<void()> * _task = nullptr; ///< The task to execute, owned by the caller of run().
+	Request _request = Request::None; ///< The pending request.
+	bool _running = false; ///< Is the rendering thread running.
+
+};
+
+#endif
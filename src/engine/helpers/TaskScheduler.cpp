@@ -0,0 +1,275 @@
+#include "TaskScheduler.hpp"
+#include <deque>
+#include <thread>
+#include <condition_variable>
+#include <memory>
+#include <algorithm>
+
+/// \brief A scheduled task and the group it belongs to.
+struct Task {
+	std::function<void()> func; ///< The function to execute.
+	TaskGroup * group; ///< The group to notify on completion.
+};
+
+/// \brief The tasks owned by a thread. The owner pushes and pops at the back, other threads steal at the front.
+struct TaskQueue {
+	std::deque<Task> tasks; ///< The pending tasks.
+	std::mutex mutex; ///< Protects the tasks.
+};
+
+/// \brief The threads and queues of the scheduler.
+struct SchedulerState {
+
+	/** Create the queues and start the threads.
+	 \param threadCount the total number of threads executing tasks, including the waiting thread
+	 */
+	SchedulerState(unsigned int threadCount);
+	
+	/** Stop and join the threads. */
+	~SchedulerState();
+	
+	/** Execute tasks until the scheduler is stopped.
+	 \param index the index of the queue owned by the thread
+	 */
+	void loop(unsigned int index);
+	
+	/** Get a task, from a given queue first and then from the others.
+	 \param index the queue to pop from first
+	 \param task will contain the task
+	 \return false if all queues are empty
+	 */
+	bool pop(unsigned int index, Task & task);
+	
+	std::vector<std::unique_ptr<TaskQueue>> queues; ///< One queue per thread, the first one is shared by threads outside the pool.
+	std::vector<std::thread> threads; ///< The pool threads.
+	std::atomic<size_t> queued; ///< Number of tasks in all queues.
+	std::atomic<size_t> sleeping; ///< Number of pool threads waiting for tasks.
+	std::mutex sleepMutex; ///< Protects the transitions of sleeping threads.
+	std::condition_variable sleepCondition; ///< Wakes up sleeping threads when tasks are queued or the scheduler is stopped.
+	bool running = true; ///< Is the scheduler running.
+};
+
+static std::unique_ptr<SchedulerState> _state; ///< The current scheduler state.
+static std::atomic<SchedulerState *> _current(nullptr); ///< The current scheduler state, read without locking.
+static std::mutex _stateMutex; ///< Protects the creation and destruction of the state.
+static thread_local unsigned int _queueIndex = 0; ///< Queue owned by the current thread, 0 for threads outside the pool.
+
+SchedulerState::SchedulerState(unsigned int threadCount) : queued(0), sleeping(0) {
+	for(unsigned int tid = 0; tid < threadCount; ++tid){
+		queues.emplace_back(new TaskQueue());
+	}
+	for(unsigned int tid = 1; tid < threadCount; ++tid){
+		threads.emplace_back(&SchedulerState::loop, this, tid);
+	}
+}
+
+SchedulerState::~SchedulerState(){
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		running = false;
+	}
+	sleepCondition.notify_all();
+	for(auto & thread : threads){
+		thread.join();
+	}
+}
+
+void SchedulerState::loop(unsigned int index){
+	_queueIndex = index;
+	Task task;
+	while(true){
+		if(pop(index, task)){
+			task.func();
+			task.group->finish();
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		// The sleeping count is incremented before checking for tasks, and submit() increments the task count before checking for sleepers, so at least one of them sees the other.
+		++sleeping;
+		sleepCondition.wait(lock, [this](){ return !running || queued > 0; });
+		--sleeping;
+		if(!running){
+			return;
+		}
+	}
+}
+
+bool SchedulerState::pop(unsigned int index, Task & task){
+	if(queued == 0){
+		return false;
+	}
+	// Most recent task of our own queue, its data is more likely to still be in cache.
+	{
+		TaskQueue & queue = *queues[index];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if(!queue.tasks.empty()){
+			task = std::move(queue.tasks.back());
+			queue.tasks.pop_back();
+			--queued;
+			return true;
+		}
+	}
+	// Oldest task of another queue, usually covering the largest amount of work.
+	const size_t count = queues.size();
+	for(size_t qid = 1; qid < count; ++qid){
+		TaskQueue & queue = *queues[(index + qid) % count];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if(!queue.tasks.empty()){
+			task = std::move(queue.tasks.front());
+			queue.tasks.pop_front();
+			--queued;
+			return true;
+		}
+	}
+	return false;
+}
+
+/** Get the current scheduler state, creating it with the hardware thread count if needed.
+ \return the state
+ */
+static SchedulerState & state(){
+	SchedulerState * current = _current.load(std::memory_order_acquire);
+	if(current){
+		return *current;
+	}
+	std::lock_guard<std::mutex> lock(_stateMutex);
+	if(!_state){
+		_state.reset(new SchedulerState(std::max(1u, std::thread::hardware_concurrency())));
+		_current.store(_state.get(), std::memory_order_release);
+	}
+	return *_state;
+}
+
+/** Process a range, publishing its upper halves as tasks until the remaining lower part is smaller than the grain.
+ \param group the group to add the tasks to
+ \param begin the first index
+ \param end the index after the last one
+ \param grain the maximum number of indices processed by a single call to func
+ \param func the function to call on each chunk
+ */
+static void splitRange(TaskGroup & group, size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)> & func){
+	while(end - begin > grain){
+		const size_t middle = begin + (end - begin) / 2;
+		group.run([&group, middle, end, grain, &func](){
+			splitRange(group, middle, end, grain, func);
+		});
+		end = middle;
+	}
+	func(begin, end);
+}
+
+void TaskScheduler::setup(unsigned int threadCount){
+	if(threadCount == 0){
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+	std::lock_guard<std::mutex> lock(_stateMutex);
+	_current.store(nullptr, std::memory_order_release);
+	_state.reset();
+	_state.reset(new SchedulerState(threadCount));
+	_current.store(_state.get(), std::memory_order_release);
+}
+
+void TaskScheduler::clean(){
+	std::lock_guard<std::mutex> lock(_stateMutex);
+	_current.store(nullptr, std::memory_order_release);
+	_state.reset();
+}
+
+unsigned int TaskScheduler::threadCount(){
+	return (unsigned int)state().queues.size();
+}
+
+void TaskScheduler::parallelFor(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)> & func){
+	if(end <= begin){
+		return;
+	}
+	const size_t count = end - begin;
+	const size_t threads = threadCount();
+	if(grain == 0){
+		grain = std::max(size_t(1), count / (4 * threads));
+	}
+	if(threads == 1 || count <= grain){
+		func(begin, end);
+		return;
+	}
+	TaskGroup group;
+	splitRange(group, begin, end, grain, func);
+	group.wait();
+}
+
+void TaskScheduler::submit(const std::function<void()> & task, TaskGroup * group){
+	SchedulerState & current = state();
+	TaskQueue & queue = *current.queues[std::min(size_t(_queueIndex), current.queues.size() - 1)];
+	// Count the task before publishing it, so that the count never underestimates the queued tasks.
+	++current.queued;
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks.push_back({ task, group });
+	}
+	if(current.sleeping > 0){
+		// Ensure the sleeping thread is waiting on the condition before notifying it.
+		{
+			std::lock_guard<std::mutex> lock(current.sleepMutex);
+		}
+		current.sleepCondition.notify_one();
+	}
+}
+
+bool TaskScheduler::runTask(){
+	SchedulerState & current = state();
+	Task task;
+	if(!current.pop(std::min(size_t(_queueIndex), current.queues.size() - 1), task)){
+		return false;
+	}
+	task.func();
+	task.group->finish();
+	return true;
+}
+
+TaskGroup::TaskGroup() : _pending(0) {
+}
+
+TaskGroup::~TaskGroup(){
+	wait();
+}
+
+void TaskGroup::run(const std::function<void()> & task){
+	++_pending;
+	TaskScheduler::submit(task, this);
+}
+
+void TaskGroup::then(const std::function<void()> & continuation){
+	std::lock_guard<std::mutex> lock(_mutex);
+	if(_pending == 0){
+		++_pending;
+		TaskScheduler::submit(continuation, this);
+		return;
+	}
+	_continuations.push_back(continuation);
+}
+
+void TaskGroup::wait(){
+	while(_pending > 0){
+		if(!TaskScheduler::runTask()){
+			std::this_thread::yield();
+		}
+	}
+	// The last task might still hold the lock right after completing.
+	std::lock_guard<std::mutex> lock(_mutex);
+}
+
+void TaskGroup::finish(){
+	std::vector<std::function<void()>> continuations;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		// The continuations keep the group pending until they are completed.
+		if(_pending == 1 && !_continuations.empty()){
+			continuations.swap(_continuations);
+			_pending += continuations.size();
+		}
+		--_pending;
+	}
+	for(const auto & continuation : continuations){
+		TaskScheduler::submit(continuation, this);
+	}
+}
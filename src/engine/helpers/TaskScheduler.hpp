@@ -0,0 +1,111 @@
+#ifndef TaskScheduler_h
+#define TaskScheduler_h
+
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <cstddef>
+
+/**
+ \brief A set of tasks that can be waited on together, and followed by continuations once they are all completed.
+ \details Tasks and continuations are executed by the threads of the TaskScheduler. A waiting thread executes pending tasks instead of blocking.
+ \ingroup Helpers
+ */
+class TaskGroup {
+public:
+
+	/** Constructor. */
+	TaskGroup();
+	
+	/** Destructor. Waits for all tasks of the group. */
+	~TaskGroup();
+	
+	/** Schedule a task in the group.
+	 \param task the function to execute
+	 */
+	void run(const std::function<void()> & task);
+	
+	/** Schedule a continuation, executed once all tasks of the group are completed. If the group has no pending task, the continuation is scheduled immediately. A continuation can schedule new tasks in its group.
+	 \param continuation the function to execute
+	 */
+	void then(const std::function<void()> & continuation);
+	
+	/** Wait until all tasks and continuations of the group are completed, executing pending tasks in the meantime. */
+	void wait();
+	
+	/** Query if the group is completed.
+	 \return true if no task or continuation of the group is pending
+	 */
+	bool done() const { return _pending == 0; }
+	
+	/** Copy constructor (disabled). */
+	TaskGroup(const TaskGroup &) = delete;
+	
+	/** Copy assignment (disabled).
+	 \return a reference to the object assigned to
+	 */
+	TaskGroup & operator= (const TaskGroup &) = delete;
+
+private:
+
+	friend class TaskScheduler;
+	friend struct SchedulerState;
+	
+	/** Signal the completion of a task, scheduling the continuations if it was the last one. */
+	void finish();
+	
+	std::atomic<size_t> _pending; ///< Number of tasks and continuations scheduled but not completed.
+	std::vector<std::function<void()>> _continuations; ///< Continuations waiting for the completion of the tasks.
+	std::mutex _mutex; ///< Protects the continuations and the transitions of the pending count to zero.
+
+};
+
+/**
+ \brief Execute tasks on a pool of threads. Each thread owns a queue of tasks, executes its most recent tasks first, and steals the oldest tasks of other threads when its own queue is empty.
+ \details The pool contains the requested number of threads minus one: threads waiting on a TaskGroup (such as the main thread) execute tasks too. Tasks submitted from threads outside the pool are placed in a shared queue. The scheduler doesn't rely on any graphics context and can be used by tools. It is set up with the hardware thread count on first use if setup() hasn't been called.
+ \warning The engine functions called from tasks must be thread-safe: GL calls, the resources manager and the Random generator are not.
+ \ingroup Helpers
+ */
+class TaskScheduler {
+public:
+
+	/** Create the pool of threads, replacing the existing one. No task should be pending.
+	 \param threadCount the total number of threads executing tasks, including the waiting thread; 0 to use the hardware thread count
+	 */
+	static void setup(unsigned int threadCount);
+	
+	/** Stop the pool of threads. No task should be pending. */
+	static void clean();
+	
+	/** Query the number of threads executing tasks.
+	 \return the thread count, including the waiting thread
+	 */
+	static unsigned int threadCount();
+	
+	/** Process a range of indices in parallel, by recursively splitting it in halves until they are smaller than the grain. The calling thread participates and returns once the whole range has been processed.
+	 \param begin the first index
+	 \param end the index after the last one
+	 \param grain the maximum number of indices processed by a single call to func; 0 to split the range in a few chunks per thread
+	 \param func the function to call with the first index and the index after the last one of each chunk
+	 */
+	static void parallelFor(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)> & func);
+
+private:
+
+	friend class TaskGroup;
+	
+	/** Place a task in the queue of the calling thread.
+	 \param task the function to execute
+	 \param group the group to notify on completion
+	 */
+	static void submit(const std::function<void()> & task, TaskGroup * group);
+	
+	/** Execute a task from the queue of the calling thread, or stolen from another thread.
+	 \return false if no task was available
+	 */
+	static bool runTask();
+
+};
+
+#endif
@@ -2,6 +2,7 @@
 #define Camera_h
 
 #include "../Common.hpp"
+#include "../resources/MeshUtilities.hpp"
 
 /**
  \brief This class represents a camera as used in real-time rendering APIs.
@@ -63,6 +64,12 @@ public:
 	 */
 	const glm::vec3 & position() const { return _eye; }
 	
+	/**
+	 Obtain the current view frustum, with planes in world space.
+	 \return the frustum
+	 */
+	Frustum frustum() const { return Frustum(_projection * _view); }
+	
 protected:
 	
 	/// Update the projection matrix using the camera parameters.
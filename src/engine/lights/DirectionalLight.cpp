@@ -8,17 +8,12 @@ DirectionalLight::DirectionalLight(const glm::vec3& worldDirection, const glm::v
 
 
 void DirectionalLight::init(const std::vector<GLuint>& textureIds){
-	// Setup the framebuffer.
-	const Framebuffer::Descriptor descriptor = { GL_RG16F, GL_LINEAR, GL_CLAMP_TO_BORDER };
-	_shadowPass = std::make_shared<Framebuffer>(512, 512, descriptor, true);
-	_blur = std::make_shared<BoxBlur>(512, 512, false, descriptor);
-	
 	_textures = textureIds;
-	_textures.emplace_back(_blur->textureId());
 	
 	// Load the shaders
 	_program = Resources::manager().getProgram2D("directional_light");
 	_programDepth = Resources::manager().getProgram("object_depth", "object_basic", "light_shadow");
+	_programDepthInstanced = Resources::manager().getProgram("object_depth_instanced", "object_basic_instanced", "light_shadow");
 
 }
 
@@ -29,67 +24,91 @@ void DirectionalLight::draw(const glm::mat4& viewMatrix, const glm::mat4& projec
 	glm::vec4 projectionVector = glm::vec4(projectionMatrix[0][0], projectionMatrix[1][1], projectionMatrix[2][2], projectionMatrix[3][2]);
 	glm::vec3 lightDirectionViewSpace = glm::vec3(viewMatrix * glm::vec4(_lightDirection, 0.0));
 	
-	glUseProgram(_program->id());
+	GLUtilities::useProgram(_program->id());
 	glUniform3fv(_program->uniform("lightDirection"), 1,  &lightDirectionViewSpace[0]);
 	glUniform3fv(_program->uniform("lightColor"), 1,  &_color[0]);
 	// Projection parameter for position reconstruction.
 	glUniform4fv(_program->uniform("projectionMatrix"), 1, &(projectionVector[0]));
 	glUniformMatrix4fv(_program->uniform("viewToLight"), 1, GL_FALSE, &viewToLight[0][0]);
-	glUniform1i(_program->uniform("castShadow"), _castShadows);
+	glUniform1i(_program->uniform("castShadow"), _castShadows && hasShadowRegion());
+	glUniform4fv(_program->uniform("shadowRegion"), 1, &_shadowRegion[0]);
 
 	ScreenQuad::draw(_textures);
 
 }
 
-void DirectionalLight::drawShadow(const std::vector<Object> & objects) const {
-	if(!_castShadows){
-		return;
+size_t DirectionalLight::drawShadow(RenderQueue & queue, const std::vector<Object> & objects, const BoundingBoxArray & worldBoxes, const std::vector<unsigned int> & candidates, float lodPixelError, Object::ClusterStatistics * clusters) const {
+	if(!_castShadows || !hasShadowRegion()){
+		return 0;
 	}
-	_shadowPass->bind();
-	_shadowPass->setViewport();
-	glClearColor(1.0f,1.0f,1.0f,0.0f);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	// The shadow atlas is already bound, render in the light region.
+	GLUtilities::setViewport(_shadowViewport[0], _shadowViewport[1], _shadowViewport[2], _shadowViewport[3]);
+	
+	// Size of a world unit in shadow map pixels, for levels of detail selection.
+	const float pixelsPerUnit = 0.5f * float(_shadowViewport[3]) * _projectionMatrix[1][1];
 	
-	glUseProgram(_programDepth->id());
-	for(auto& object : objects){
+	queue.clear();
+	size_t casters = 0;
+	for(const unsigned int oid : candidates){
+		const Object & object = objects[oid];
 		if(!object.castsShadow()){
 			continue;
 		}
-		const glm::mat4 lightMVP = _mvp * object.model();
-		glUniformMatrix4fv(_programDepth->uniform("mvp"), 1, GL_FALSE, &lightMVP[0][0]);
-		object.drawGeometry();
+		++casters;
+		const unsigned int level = object.selectLevel(glm::vec3(0.0f), pixelsPerUnit, true, lodPixelError);
+		if(clusters && level == 0 && object.clusterCount() > 0){
+			const size_t drawn = object.cullClusters(_mvp, glm::vec4(-_lightDirection, 0.0f), true, true, queue.ranges());
+			clusters->total += object.clusterCount();
+			clusters->drawn += drawn;
+		} else {
+			object.appendLevel(level, true, queue.ranges());
+		}
+		// Casters are sorted front-to-back along the light direction.
+		const glm::vec3 center = worldBoxes.get(oid).getSphere().center;
+		RenderQueue::Item * item = queue.submit(RenderQueue::Shadow, *_programDepth, object, -(_viewMatrix * glm::vec4(center, 1.0f)).z, true);
+		if(item){
+			item->instancedProgram = _programDepthInstanced.get();
+		}
 	}
-	glUseProgram(0);
-	
-	_shadowPass->unbind();
-	
-	// --- Blur pass --------
-	glDisable(GL_DEPTH_TEST);
-	_blur->process(_shadowPass->textureId());
-	glEnable(GL_DEPTH_TEST);
+	queue.sort();
+	// Successive casters sharing their buffers and transformation are rendered in a single call.
+	queue.execute(RenderQueue::Shadow, [this](const ProgramInfos & program, const RenderQueue::Item & item, bool){
+		const glm::mat4 lightMVP = _mvp * item.object->vertexModel();
+		glUniformMatrix4fv(program.uniform("mvp"), 1, GL_FALSE, &lightMVP[0][0]);
+	}, [this](const ProgramInfos & program, const RenderQueue::Item &, bool programChanged){
+		// Casters sharing their geometry are rendered as instances.
+		if(programChanged){
+			glUniformMatrix4fv(program.uniform("vp"), 1, GL_FALSE, &_mvp[0][0]);
+		}
+	});
+	return casters;
 }
 
-void DirectionalLight::drawDebug(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix) const {
+void DirectionalLight::submitDebug(RenderQueue & queue, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix) const {
 	
 	const std::shared_ptr<ProgramInfos> debugProgram = Resources::manager().getProgram("light_debug", "object_basic", "light_debug");
 	const MeshInfos debugMesh = Resources::manager().getMesh("light_arrow");
 	
-	glm::mat4 vp = projectionMatrix * viewMatrix * glm::inverse(_viewMatrix) * glm::scale(glm::mat4(1.0f), glm::vec3(0.2f));
+	const glm::mat4 vp = projectionMatrix * viewMatrix * glm::inverse(_viewMatrix) * glm::scale(glm::mat4(1.0f), glm::vec3(0.2f));
 	const glm::vec3 colorLow = _color/(std::max)(_color[0], (std::max)(_color[1], _color[2]));
 	
-	glUseProgram(debugProgram->id());
-	glUniformMatrix4fv(debugProgram->uniform("mvp"), 1, GL_FALSE, &vp[0][0]);
-	glUniform3fv(debugProgram->uniform("lightColor"), 1,  &colorLow[0]);
-	
-	glBindVertexArray(debugMesh.vId);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, debugMesh.eId);
-	glDrawElements(GL_TRIANGLES, debugMesh.count, GL_UNSIGNED_INT, (void*)0);
-	glBindVertexArray(0);
-	glUseProgram(0);
+	RenderQueue::Item * item = queue.submit(RenderQueue::Debug, *debugProgram, debugMesh, 0.0f);
+	item->matrix = vp;
+	item->parameters = glm::vec4(colorLow, 1.0f);
 }
 
 void DirectionalLight::update(const glm::vec3 & newDirection){
 	_lightDirection = glm::normalize(newDirection);
+	++_revision;
+	updateProjection();
+}
+
+void DirectionalLight::setShadowBounds(const BoundingBox & box){
+	_sceneBox = box;
+	updateProjection();
+}
+
+void DirectionalLight::updateProjection(){
 	const BoundingSphere sceneSphere = _sceneBox.getSphere();
 	const glm::vec3 lightPosition = sceneSphere.center - sceneSphere.radius*1.1f*_lightDirection;
 	const glm::vec3 lightTarget = sceneSphere.center;
@@ -106,9 +125,3 @@ void DirectionalLight::update(const glm::vec3 & newDirection){
 	_mvp = _projectionMatrix * _viewMatrix;
 	
 }
-
-void DirectionalLight::clean() const {
-	_blur->clean();
-	_shadowPass->clean();
-}
-
@@ -6,11 +6,11 @@
 #include "../graphics/ScreenQuad.hpp"
 #include "../graphics/Framebuffer.hpp"
 #include "../Object.hpp"
-#include "../processing/BoxBlur.hpp"
+#include "../renderers/RenderQueue.hpp"
 
 /**
  \brief A directional light, where all light rays have the same direction.
- \details It can be associated with a shadow 2D map with orthogonal projection, generated using Variance shadow mapping. It is rendered as a fullscreen squad in deferred rendering.
+ \details It can be associated with a shadow 2D map with orthogonal projection, generated using Variance shadow mapping and stored in a region of a ShadowAtlas. It is rendered as a fullscreen squad in deferred rendering.
  \see GLSL::Frag::Directional_light, GLSL::Frag::Light_shadow, GLSL::Frag::Light_debug
  \ingroup Lights
  */
@@ -26,7 +26,7 @@ public:
 	DirectionalLight(const glm::vec3& worldDirection, const glm::vec3& color, const BoundingBox & sceneBox);
 	
 	/** Perform initialization against the graphics API and register textures for deferred rendering.
-	 \param textureIds the IDs of the albedo, normal, depth and effects G-buffer textures
+	 \param textureIds the IDs of the albedo, normal, depth and effects G-buffer textures, followed by the shadow atlas texture
 	 */
 	void init(const std::vector<GLuint>& textureIds);
 	
@@ -36,30 +36,51 @@ public:
 	 */
 	void draw(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix) const;
 	
-	/** Render the light shadow map.
+	/** Render the light shadow map in its region of the bound shadow atlas, skipping the casters outside of the light influence. Casters are sorted and rendered through a queue.
+	 \param queue the queue to submit the casters to, cleared beforehand
 	 \param objects list of shadow casting objects to render
+	 \param worldBoxes the world space bounding boxes of the objects
+	 \param candidates the indices of the objects inside the shadow map volume
+	 \param lodPixelError the maximum projected error allowed when selecting objects levels of detail, in shadow map pixels
+	 \param clusters if non-null, the clusters of objects rendered at full resolution are culled, and their counts accumulated
+	 \return the number of casters rendered
 	 */
-	void drawShadow(const std::vector<Object> & objects) const;
+	size_t drawShadow(RenderQueue & queue, const std::vector<Object> & objects, const BoundingBoxArray & worldBoxes, const std::vector<unsigned int> & candidates, float lodPixelError = 1.0f, Object::ClusterStatistics * clusters = nullptr) const;
 	
-	/** Render the light debug wireframe visualisation
+	/** Submit the light debug wireframe visualisation to a queue, in the debug pass.
+	 \param queue the queue to submit to
 	 \param viewMatrix the current camera view matrix
 	 \param projectionMatrix the current camera projection matrix
+	 \note The queue pass should upload the item matrix and parameters to the "mvp" and "lightColor" uniforms.
 	 */
-	void drawDebug(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix) const;
-	
-	/** Clean internal resources. */
-	void clean() const;
+	void submitDebug(RenderQueue & queue, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix) const;
 	
 	/** Update the light direction. All internal parameters are updated.
 	 \param newDirection the new light direction
 	 */
 	void update(const glm::vec3 & newDirection);
 	
+	/** Fit the shadow map projection to a region of space.
+	 \param box the bounding box of the shadow casters
+	 */
+	void setShadowBounds(const BoundingBox & box);
+	
+	/** Query the current light world space direction.
+	 \return the light direction
+	 */
+	const glm::vec3 & direction() const { return _lightDirection; }
+	
+	/** Query the transformation from world space to the shadow map clip space.
+	 \return the light view projection matrix
+	 */
+	const glm::mat4 & shadowViewProjection() const { return _mvp; }
+	
 private:
 	
-	std::shared_ptr<Framebuffer> _shadowPass; ///< The shadow map framebuffer.
-	std::shared_ptr<BoxBlur> _blur; ///< Blur processing for variance shadow mapping.
-	BoundingBox _sceneBox; ///< The scene bounding box, to fit the shadow map.
+	/** Update the shadow map projection from the light direction and the shadow bounds. */
+	void updateProjection();
+	
+	BoundingBox _sceneBox; ///< The shadow casters bounding box, to fit the shadow map.
 	
 	glm::mat4 _projectionMatrix; ///< Light projection matrix.
 	glm::mat4 _viewMatrix; ///< Light view matrix.
@@ -67,6 +88,7 @@ private:
 	
 	std::shared_ptr<ProgramInfos> _program; ///< Light rendering program.
 	std::shared_ptr<ProgramInfos> _programDepth; ///< Shadow map program.
+	std::shared_ptr<ProgramInfos> _programDepthInstanced; ///< Instanced shadow map program.
 	std::vector<GLuint> _textures; ///< The G-buffer textures.
 };
 
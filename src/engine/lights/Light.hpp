@@ -26,11 +26,45 @@ public:
 	 */
 	void setIntensity(const glm::vec3 & color){ _color = color; }
 	
+	/** Query the light colored intensity.
+	 \return the intensity
+	 */
+	const glm::vec3 & intensity() const { return _color; }
+	
+	/** Query if the light casts shadows.
+	 \return true if a shadow map is used
+	 */
+	bool castsShadow() const { return _castShadows; }
+	
+	/** Query the number of times the light has been moved, to detect changes of its volume.
+	 \return the revision counter
+	 */
+	unsigned int revision() const { return _revision; }
+
+	/** Assign the region of a shadow atlas containing the light shadow map.
+	 \param viewport the region in atlas pixels, as offset and size, with a null size if the light has no shadow map
+	 \param region the same region in atlas texture coordinates
+	 */
+	void setShadowRegion(const glm::ivec4 & viewport, const glm::vec4 & region){ _shadowViewport = viewport; _shadowRegion = region; }
+	
+	/** Query if the light has been assigned a shadow map region.
+	 \return true if the shadow map can be rendered
+	 */
+	bool hasShadowRegion() const { return _shadowViewport[2] > 0; }
+	
+	/** Query the region of the shadow atlas containing the light shadow map.
+	 \return the offset and scale of the region in atlas texture coordinates
+	 */
+	const glm::vec4 & shadowRegion() const { return _shadowRegion; }
+
 protected:
 	
 	glm::mat4 _mvp; ///< MVP matrix for shadow casting.
 	glm::vec3 _color; ///< Colored intensity.
 	bool _castShadows; ///< Is the light casting shadows (and thus use a shadow map).
+	unsigned int _revision; ///< Incremented each time the light is moved.
+	glm::ivec4 _shadowViewport; ///< Region of the shadow atlas containing the shadow map, in pixels.
+	glm::vec4 _shadowRegion; ///< Region of the shadow atlas containing the shadow map, in texture coordinates.
 };
 
 
@@ -38,6 +72,9 @@ inline Light::Light(const glm::vec3& color){
 	_castShadows = false;
 	_color = color;
 	_mvp = glm::mat4(1.0f);
+	_revision = 0;
+	_shadowViewport = glm::ivec4(0);
+	_shadowRegion = glm::vec4(0.0f);
 }
 
 #endif
@@ -0,0 +1,207 @@
+#include "LightClusters.hpp"
+
+
+LightClusters::LightClusters(unsigned int tilesX, unsigned int tilesY, unsigned int slices){
+	_grid = glm::ivec3(std::max(tilesX, 1u), std::max(tilesY, 1u), std::max(slices, 1u));
+	_sliceParameters = glm::vec2(0.0f);
+	_projection = glm::mat4(0.0f);
+	_clusters.resize(2 * _grid.x * _grid.y * _grid.z, 0);
+}
+
+void LightClusters::updateBounds(const glm::mat4 & projection){
+	if(projection == _projection && !_bounds.empty()){
+		return;
+	}
+	_projection = projection;
+	// Recover the near and far planes from the perspective projection.
+	_near = projection[3][2] / (projection[2][2] - 1.0f);
+	_far = projection[3][2] / (projection[2][2] + 1.0f);
+	
+	// Exponential slices keep the clusters roughly cubic in view space.
+	const float logRatio = std::log(_far / _near);
+	_sliceParameters[0] = float(_grid.z) / logRatio;
+	_sliceParameters[1] = - float(_grid.z) * std::log(_near) / logRatio;
+	_sliceBounds.resize(_grid.z + 1);
+	for(int sid = 0; sid <= _grid.z; ++sid){
+		_sliceBounds[sid] = _near * std::pow(_far / _near, float(sid) / float(_grid.z));
+	}
+	for(int axis = 0; axis < 2; ++axis){
+		_tileBounds[axis].resize(_grid[axis] + 1);
+		for(int tid = 0; tid <= _grid[axis]; ++tid){
+			_tileBounds[axis][tid] = 2.0f * float(tid) / float(_grid[axis]) - 1.0f;
+		}
+	}
+	
+	// A point at distance d along the view axis with NDC coordinate x is at x * d / P00 in view space.
+	const glm::vec2 scales(1.0f / projection[0][0], 1.0f / projection[1][1]);
+	_bounds.resize(_grid.x * _grid.y * _grid.z);
+	size_t cid = 0;
+	for(int sid = 0; sid < _grid.z; ++sid){
+		const float dNear = _sliceBounds[sid];
+		const float dFar = _sliceBounds[sid + 1];
+		for(int yid = 0; yid < _grid.y; ++yid){
+			for(int xid = 0; xid < _grid.x; ++xid, ++cid){
+				BoundingBox & box = _bounds[cid];
+				const int tiles[2] = {xid, yid};
+				for(int axis = 0; axis < 2; ++axis){
+					const float low = _tileBounds[axis][tiles[axis]] * scales[axis];
+					const float high = _tileBounds[axis][tiles[axis] + 1] * scales[axis];
+					box.minis[axis] = std::min(low * dNear, low * dFar);
+					box.maxis[axis] = std::max(high * dNear, high * dFar);
+				}
+				box.minis[2] = -dFar;
+				box.maxis[2] = -dNear;
+			}
+		}
+	}
+}
+
+void LightClusters::update(const glm::mat4 & view, const glm::mat4 & projection, const std::vector<PointLight> & pointLights, const std::vector<SpotLight> & spotLights){
+	updateBounds(projection);
+	_lights.clear();
+	_pairs.clear();
+	_lightCount = 0;
+	
+	// Only the lights overlapping at least one cluster are stored.
+	for(const PointLight & light : pointLights){
+		const glm::vec3 center = glm::vec3(view * glm::vec4(light.position(), 1.0f));
+		if(!assign(GLuint(_lightCount), center, light.radius())){
+			continue;
+		}
+		_lights.emplace_back(center, light.radius());
+		_lights.emplace_back(light.intensity(), 0.0f);
+		_lights.emplace_back(0.0f);
+		_lights.emplace_back(0.0f);
+		++_lightCount;
+	}
+	for(const SpotLight & light : spotLights){
+		const glm::vec3 position = glm::vec3(view * glm::vec4(light.position(), 1.0f));
+		const glm::vec3 direction = glm::normalize(glm::mat3(view) * light.direction());
+		const glm::vec2 angles = light.halfAngles();
+		// Bounding sphere of the cone: for narrow cones, the sphere going through the apex and the base circle is smaller than the light sphere.
+		glm::vec3 center = position;
+		float radius = light.radius();
+		if(angles[1] < 0.25f * float(M_PI)){
+			radius = 0.5f * light.radius() / std::cos(angles[1]);
+			center += radius * direction;
+		}
+		if(!assign(GLuint(_lightCount), center, radius)){
+			continue;
+		}
+		_lights.emplace_back(position, light.radius());
+		_lights.emplace_back(light.intensity(), 1.0f);
+		_lights.emplace_back(direction, std::cos(angles[1]));
+		_lights.emplace_back(std::cos(angles[0]), 0.0f, 0.0f, 0.0f);
+		++_lightCount;
+	}
+	
+	// Count the lights of each cluster, then compute the start of each list.
+	const size_t clusterCount = _bounds.size();
+	std::fill(_clusters.begin(), _clusters.end(), 0);
+	for(size_t pid = 0; pid < _pairs.size(); pid += 2){
+		++_clusters[2 * _pairs[pid] + 1];
+	}
+	GLuint offset = 0;
+	_maxClusterLights = 0;
+	for(size_t cid = 0; cid < clusterCount; ++cid){
+		const GLuint count = _clusters[2 * cid + 1];
+		_maxClusterLights = std::max(_maxClusterLights, size_t(count));
+		_clusters[2 * cid] = offset;
+		_clusters[2 * cid + 1] = 0;
+		offset += count;
+	}
+	// Fill the lists, restoring the counts. Lights stay sorted in each list.
+	_indices.resize(offset);
+	for(size_t pid = 0; pid < _pairs.size(); pid += 2){
+		const GLuint cid = _pairs[pid];
+		_indices[_clusters[2 * cid] + _clusters[2 * cid + 1]] = _pairs[pid + 1];
+		++_clusters[2 * cid + 1];
+	}
+}
+
+bool LightClusters::assign(GLuint lightId, const glm::vec3 & center, float radius){
+	// Depth range covered by the sphere.
+	const float dMin = -center.z - radius;
+	const float dMax = -center.z + radius;
+	if(dMax < _near || dMin > _far){
+		return false;
+	}
+	const int sMin = dMin <= _near ? 0 : glm::clamp(int(std::log(dMin) * _sliceParameters[0] + _sliceParameters[1]), 0, _grid.z - 1);
+	const int sMax = glm::clamp(int(std::log(std::min(dMax, _far)) * _sliceParameters[0] + _sliceParameters[1]), 0, _grid.z - 1);
+	
+	// Screen rectangle covered by the sphere bounding box. If it crosses the near plane, use the whole screen.
+	glm::ivec2 tMin(0);
+	glm::ivec2 tMax(_grid.x - 1, _grid.y - 1);
+	if(dMin > _near){
+		for(int axis = 0; axis < 2; ++axis){
+			const float scale = _projection[axis][axis];
+			const float low = center[axis] - radius;
+			const float high = center[axis] + radius;
+			const float ndcMin = scale * std::min(low / dMin, low / dMax);
+			const float ndcMax = scale * std::max(high / dMin, high / dMax);
+			if(ndcMax < -1.0f || ndcMin > 1.0f){
+				return false;
+			}
+			tMin[axis] = glm::clamp(int((0.5f * ndcMin + 0.5f) * float(_grid[axis])), 0, _grid[axis] - 1);
+			tMax[axis] = glm::clamp(int((0.5f * ndcMax + 0.5f) * float(_grid[axis])), 0, _grid[axis] - 1);
+		}
+	}
+	
+	// Refine with the cluster boxes.
+	const float radius2 = radius * radius;
+	const size_t pairCount = _pairs.size();
+	for(int sid = sMin; sid <= sMax; ++sid){
+		for(int yid = tMin.y; yid <= tMax.y; ++yid){
+			for(int xid = tMin.x; xid <= tMax.x; ++xid){
+				const GLuint cid = GLuint((sid * _grid.y + yid) * _grid.x + xid);
+				const BoundingBox & box = _bounds[cid];
+				const glm::vec3 delta = center - glm::clamp(center, box.minis, box.maxis);
+				if(glm::dot(delta, delta) <= radius2){
+					_pairs.push_back(cid);
+					_pairs.push_back(lightId);
+				}
+			}
+		}
+	}
+	return _pairs.size() > pairCount;
+}
+
+void LightClusters::upload(){
+	if(_buffers[0] == 0){
+		glGenBuffers(3, _buffers);
+		glGenTextures(3, _textures);
+	}
+	const GLenum formats[3] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+	const void * datas[3] = { _lights.data(), _clusters.data(), _indices.data() };
+	const size_t sizes[3] = { _lights.size() * sizeof(glm::vec4), _clusters.size() * sizeof(GLuint), _indices.size() * sizeof(GLuint) };
+	for(int bid = 0; bid < 3; ++bid){
+		// Empty buffers are not valid texture buffer storages, keep at least one texel.
+		glBindBuffer(GL_TEXTURE_BUFFER, _buffers[bid]);
+		if(sizes[bid] > 0){
+			glBufferData(GL_TEXTURE_BUFFER, sizes[bid], datas[bid], GL_STREAM_DRAW);
+		} else {
+			glBufferData(GL_TEXTURE_BUFFER, sizeof(glm::vec4), nullptr, GL_STREAM_DRAW);
+		}
+		GLUtilities::bindTexture(0, GL_TEXTURE_BUFFER, _textures[bid]);
+		glTexBuffer(GL_TEXTURE_BUFFER, formats[bid], _buffers[bid]);
+	}
+	GLUtilities::bindTexture(0, GL_TEXTURE_BUFFER, 0);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	checkGLError();
+}
+
+void LightClusters::bind(GLuint firstSlot) const {
+	for(GLuint bid = 0; bid < 3; ++bid){
+		GLUtilities::bindTexture(firstSlot + bid, GL_TEXTURE_BUFFER, _textures[bid]);
+	}
+}
+
+void LightClusters::clean() const {
+	if(_buffers[0] == 0){
+		return;
+	}
+	for(int bid = 0; bid < 3; ++bid){
+		GLUtilities::deleteTexture(_textures[bid]);
+	}
+	glDeleteBuffers(3, _buffers);
+}
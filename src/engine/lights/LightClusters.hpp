@@ -0,0 +1,104 @@
+#ifndef LightClusters_h
+#define LightClusters_h
+#include "PointLight.hpp"
+#include "SpotLight.hpp"
+#include "../Common.hpp"
+
+/**
+ \brief Assign point and spot lights to the cells of a view space grid (clusters), so that each shaded point only evaluates the lights that can reach it.
+ \details The view frustum is divided in regular screen tiles, and in depth slices distributed exponentially between the near and far planes. Each light bounding sphere is tested against the view space bounding box of the clusters it overlaps. The lights parameters, the per-cluster (offset, count) pairs and the lights indices lists are stored in three texture buffers.
+ \see GLSL::Frag::Object_forward, GLSL::Frag::Parallax_forward
+ \ingroup Lights
+ */
+class LightClusters {
+
+public:
+
+	/** Constructor.
+	 \param tilesX the number of tiles along the screen width
+	 \param tilesY the number of tiles along the screen height
+	 \param slices the number of depth slices
+	 */
+	LightClusters(unsigned int tilesX = 16, unsigned int tilesY = 9, unsigned int slices = 24);
+	
+	/** Assign the lights to the clusters of a camera, on the CPU.
+	 \param view the camera view matrix
+	 \param projection the camera perspective projection matrix
+	 \param pointLights the point lights
+	 \param spotLights the spot lights
+	 */
+	void update(const glm::mat4 & view, const glm::mat4 & projection, const std::vector<PointLight> & pointLights, const std::vector<SpotLight> & spotLights);
+	
+	/** Send the result of the last update to the GPU. */
+	void upload();
+	
+	/** Bind the lights, clusters and indices texture buffers to three successive texture slots.
+	 \param firstSlot the slot of the lights buffer
+	 */
+	void bind(GLuint firstSlot) const;
+	
+	/** Query the number of tiles along each axis and of depth slices.
+	 \return the clusters grid size
+	 */
+	const glm::ivec3 & grid() const { return _grid; }
+	
+	/** Query the parameters converting a view space distance d to a depth slice index, as log(d) * scale + bias.
+	 \return the scale and bias
+	 */
+	const glm::vec2 & sliceParameters() const { return _sliceParameters; }
+	
+	/** Query the number of lights assigned during the last update.
+	 \return the number of visible lights
+	 */
+	size_t lightCount() const { return _lightCount; }
+	
+	/** Query the total number of light references stored in the clusters during the last update.
+	 \return the size of the indices lists
+	 */
+	size_t referenceCount() const { return _indices.size(); }
+	
+	/** Query the largest number of lights assigned to a cluster during the last update.
+	 \return the maximum light count
+	 */
+	size_t maxClusterLights() const { return _maxClusterLights; }
+	
+	/** Clean internal resources. */
+	void clean() const;
+
+private:
+
+	/** Recompute the view space bounding boxes of the clusters for a new projection.
+	 \param projection the camera perspective projection matrix
+	 */
+	void updateBounds(const glm::mat4 & projection);
+	
+	/** Register the clusters overlapped by a light view space bounding sphere.
+	 \param lightId the light index
+	 \param center the sphere center in view space
+	 \param radius the sphere radius
+	 \return true if the sphere overlaps at least one cluster
+	 */
+	bool assign(GLuint lightId, const glm::vec3 & center, float radius);
+	
+	glm::ivec3 _grid; ///< Tiles along each axis and depth slices.
+	glm::vec2 _sliceParameters; ///< Scale and bias converting the log of a view space distance to a slice index.
+	glm::mat4 _projection; ///< The projection used to compute the clusters bounds.
+	float _near = 0.0f; ///< The projection near plane distance.
+	float _far = 0.0f; ///< The projection far plane distance.
+	std::vector<float> _tileBounds[2]; ///< Horizontal and vertical NDC coordinates of the tiles borders.
+	std::vector<float> _sliceBounds; ///< View space distances of the slices borders.
+	std::vector<BoundingBox> _bounds; ///< View space bounding box of each cluster.
+	
+	std::vector<glm::vec4> _lights; ///< Parameters of each light, packed in four texels.
+	std::vector<GLuint> _clusters; ///< Offset and count of the lights list of each cluster.
+	std::vector<GLuint> _indices; ///< Lights lists of all clusters.
+	std::vector<GLuint> _pairs; ///< Cluster and light indices of each assignment, reused across frames.
+	size_t _lightCount = 0; ///< Number of lights overlapping at least one cluster.
+	size_t _maxClusterLights = 0; ///< Largest number of lights in a cluster.
+	
+	GLuint _buffers[3] = {0, 0, 0}; ///< The lights, clusters and indices buffers.
+	GLuint _textures[3] = {0, 0, 0}; ///< The lights, clusters and indices texture buffers.
+
+};
+
+#endif
@@ -23,15 +23,21 @@ PointLight::PointLight(const glm::vec3& worldPosition, const glm::vec3& color, f
 void PointLight::init(const std::vector<GLuint>& textureIds){
 	_program = Resources::manager().getProgram("point_light", "object_basic", "point_light");
 	_sphere = Resources::manager().getMesh("light_sphere");
-	// Setup the framebuffer.
-	/// \todo Enable only if the light is a shadow caster.
-	const Framebuffer::Descriptor descriptor = {GL_RG16F, GL_LINEAR, GL_CLAMP_TO_EDGE};
-	_shadowFramebuffer = std::make_shared<FramebufferCube>(512, descriptor, true);
-	
+	// Setup the framebuffer, only for shadow casters as scenes can contain many small lights.
 	_textureIds = textureIds;
-	_textureIds.emplace_back(_shadowFramebuffer->textureId());
+	if(_castShadows){
+		// The light can be shared by multiple renderers.
+		if(!_shadowFramebuffer){
+			const Framebuffer::Descriptor descriptor = {GL_RG16F, GL_LINEAR, GL_CLAMP_TO_EDGE};
+			_shadowFramebuffer = std::make_shared<FramebufferCube>(512, descriptor, true);
+		}
+		_textureIds.emplace_back(_shadowFramebuffer->textureId());
+	} else {
+		_textureIds.emplace_back(0);
+	}
 	// Load the shaders
 	_programDepth = Resources::manager().getProgram("object_layer_depth", "object_layer", "light_shadow_linear", "object_layer");
+	_programDepthInstanced = Resources::manager().getProgram("object_layer_depth_instanced", "object_layer_instanced", "light_shadow_linear", "object_layer");
 	checkGLError();
 }
 
@@ -46,7 +52,7 @@ void PointLight::draw(const glm::mat4& viewMatrix, const glm::mat4& projectionMa
 	const glm::mat4 mvp = projectionMatrix * viewMatrix * modelMatrix;
 	const glm::mat3 viewToLight = glm::mat3(glm::inverse(viewMatrix));
 	
-	glUseProgram(_program->id());
+	GLUtilities::useProgram(_program->id());
 	glUniformMatrix4fv(_program->uniform("mvp"), 1, GL_FALSE, &mvp[0][0]);
 	glUniform3fv(_program->uniform("lightPosition"), 1,  &lightPositionViewSpace[0]);
 	glUniform3fv(_program->uniform("lightColor"), 1,  &_color[0]);
@@ -57,30 +63,27 @@ void PointLight::draw(const glm::mat4& viewMatrix, const glm::mat4& projectionMa
 	glUniform2fv(_program->uniform("inverseScreenSize"), 1, &(invScreenSize[0]));
 	glUniformMatrix3fv(_program->uniform("viewToLight"), 1, GL_FALSE, &viewToLight[0][0]);
 	glUniform1f(_program->uniform("lightFarPlane"), _farPlane);
-	glUniform1i(_program->uniform("castShadow"), _castShadows);
+	glUniform1i(_program->uniform("castShadow"), _castShadows && _shadowFramebuffer);
 	
 	// Active screen texture.
 	for(GLuint i = 0;i < _textureIds.size()-1; ++i){
-		glActiveTexture(GL_TEXTURE0 + i);
-		glBindTexture(GL_TEXTURE_2D, _textureIds[i]);
+		GLUtilities::bindTexture(i, GL_TEXTURE_2D, _textureIds[i]);
 	}
 	// Activate the shadow cubemap.
-	if(_castShadows){
-		glActiveTexture(GL_TEXTURE0 + _textureIds.size()-1);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, _textureIds[_textureIds.size()-1]);
+	if(_castShadows && _shadowFramebuffer){
+		GLUtilities::bindTexture(_textureIds.size()-1, GL_TEXTURE_CUBE_MAP, _textureIds[_textureIds.size()-1]);
 	}
 	// Select the geometry.
-	glBindVertexArray(_sphere.vId);
+	GLUtilities::bindVertexArray(_sphere.vId);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _sphere.eId);
-	glDrawElements(GL_TRIANGLES, _sphere.count, GL_UNSIGNED_INT, (void*)0);
+	glDrawElements(GL_TRIANGLES, _sphere.count, _sphere.indexType, (void*)0);
 	
-	glBindVertexArray(0);
-	glUseProgram(0);
+	GLUtilities::bindVertexArray(0);
 }
 
-void PointLight::drawShadow(const std::vector<Object> & objects) const {
-	if(!_castShadows){
-		return;
+size_t PointLight::drawShadow(RenderQueue & queue, const std::vector<Object> & objects, const BoundingBoxArray & worldBoxes, const std::vector<unsigned int> & candidates, float lodPixelError, Object::ClusterStatistics * clusters) const {
+	if(!_castShadows || !_shadowFramebuffer){
+		return 0;
 	}
 	
 	static const char* uniformNames[6] = {"vps[0]", "vps[1]", "vps[2]", "vps[3]", "vps[4]", "vps[5]"};
@@ -90,30 +93,83 @@ void PointLight::drawShadow(const std::vector<Object> & objects) const {
 	glClearColor(1.0f,1.0f,1.0f,1.0f);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	
-	glUseProgram(_programDepth->id());
-	// Udpate the light mvp matrices.
+	// Size of a world unit at unit distance in shadow map pixels, for levels of detail selection (90 degrees field of view).
+	const float pixelsPerUnit = 0.5f * float(_shadowFramebuffer->side());
+	
+	// Frustum of each face, to only emit casters in the faces they overlap.
+	Frustum faces[6];
 	for(size_t mid = 0; mid < 6; ++mid){
-		glUniformMatrix4fv(_programDepth->uniform(uniformNames[mid]), 1, GL_FALSE, &_mvps[mid][0][0]);
+		faces[mid] = Frustum(_mvps[mid]);
 	}
-	// Pass the world space light position, and the projection matrix far plane.
-	glUniform3fv(_programDepth->uniform("lightPositionWorld"), 1, &_lightPosition[0]);
-	glUniform1f(_programDepth->uniform("lightFarPlane"), _farPlane);
 	
-	for(auto& object : objects){
+	queue.clear();
+	size_t casters = 0;
+	for(const unsigned int oid : candidates){
+		const Object & object = objects[oid];
 		if(!object.castsShadow()){
 			continue;
 		}
-		glUniformMatrix4fv(_programDepth->uniform("model"), 1, GL_FALSE, &(object.model()[0][0]));
-		object.drawGeometry();
+		// Skip the casters outside of the light sphere.
+		const BoundingBox box = worldBoxes.get(oid);
+		if(!intersects(box)){
+			continue;
+		}
+		int faceMask = 0;
+		for(int mid = 0; mid < 6; ++mid){
+			faceMask |= faces[mid].intersects(box) ? (1 << mid) : 0;
+		}
+		if(faceMask == 0){
+			continue;
+		}
+		++casters;
+		const unsigned int level = object.selectLevel(_lightPosition, pixelsPerUnit, false, lodPixelError);
+		if(clusters && level == 0 && object.clusterCount() > 0){
+			// Clusters are only culled against their normal cones, as the six faces are rendered at once.
+			const size_t drawn = object.cullClusters(glm::mat4(1.0f), glm::vec4(_lightPosition, 1.0f), false, true, queue.ranges());
+			clusters->total += object.clusterCount();
+			clusters->drawn += drawn;
+		} else {
+			object.appendLevel(level, true, queue.ranges());
+		}
+		// Casters are sorted front-to-back from the light, and only merged if they cover the same faces.
+		RenderQueue::Item * item = queue.submit(RenderQueue::Shadow, *_programDepth, object, glm::length(box.getSphere().center - _lightPosition), true);
+		if(item){
+			item->mask = faceMask;
+			item->instancedProgram = _programDepthInstanced.get();
+		}
 	}
-	glUseProgram(0);
+	queue.sort();
+	const auto setupLight = [this](const ProgramInfos & program){
+		// Udpate the light mvp matrices.
+		for(size_t mid = 0; mid < 6; ++mid){
+			glUniformMatrix4fv(program.uniform(uniformNames[mid]), 1, GL_FALSE, &_mvps[mid][0][0]);
+		}
+		// Pass the world space light position, and the projection matrix far plane.
+		glUniform3fv(program.uniform("lightPositionWorld"), 1, &_lightPosition[0]);
+		glUniform1f(program.uniform("lightFarPlane"), _farPlane);
+	};
+	queue.execute(RenderQueue::Shadow, [&setupLight](const ProgramInfos & program, const RenderQueue::Item & item, bool programChanged){
+		if(programChanged){
+			setupLight(program);
+		}
+		const glm::mat4 vertexModel = item.object->vertexModel();
+		glUniformMatrix4fv(program.uniform("model"), 1, GL_FALSE, &(vertexModel[0][0]));
+		glUniform1i(program.uniform("faceMask"), item.mask);
+	}, [&setupLight](const ProgramInfos & program, const RenderQueue::Item & item, bool programChanged){
+		// Casters sharing their geometry and covered faces are rendered as instances.
+		if(programChanged){
+			setupLight(program);
+		}
+		glUniform1i(program.uniform("faceMask"), item.mask);
+	});
 	
 	_shadowFramebuffer->unbind();
 	
 	// No blurring pass for now.
+	return casters;
 }
 
-void PointLight::drawDebug(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix) const {
+void PointLight::submitDebug(RenderQueue & queue, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix) const {
 	
 	const std::shared_ptr<ProgramInfos> debugProgram = Resources::manager().getProgram("light_debug", "object_basic", "light_debug");
 	
@@ -122,21 +178,36 @@ void PointLight::drawDebug(const glm::mat4& viewMatrix, const glm::mat4& project
 	const glm::mat4 mvp = projectionMatrix * viewMatrix * modelMatrix;
 	const glm::vec3 colorLow = _color/(std::max)(_color[0], (std::max)(_color[1], _color[2]));
 	
-	glUseProgram(debugProgram->id());
-	glUniformMatrix4fv(debugProgram->uniform("mvp"), 1, GL_FALSE, &mvp[0][0]);
-	glUniform3fv(debugProgram->uniform("lightColor"), 1,  &colorLow[0]);
-	
-	glBindVertexArray(_sphere.vId);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _sphere.eId);
-	glDrawElements(GL_TRIANGLES, _sphere.count, GL_UNSIGNED_INT, (void*)0);
-	glBindVertexArray(0);
-	glUseProgram(0);
-
+	RenderQueue::Item * item = queue.submit(RenderQueue::Debug, *debugProgram, _sphere, 0.0f);
+	item->matrix = mvp;
+	item->parameters = glm::vec4(colorLow, 1.0f);
 }
 
 
 void PointLight::update(const glm::vec3 & newPosition){
 	_lightPosition = newPosition;
+	++_revision;
+	updateProjection();
+}
+
+void PointLight::setShadowBounds(const BoundingBox & box){
+	_sceneBox = box;
+	updateProjection();
+}
+
+BoundingBox PointLight::boundingBox() const {
+	BoundingBox box;
+	box.minis = _lightPosition - glm::vec3(_radius);
+	box.maxis = _lightPosition + glm::vec3(_radius);
+	return box;
+}
+
+bool PointLight::intersects(const BoundingBox & box) const {
+	const glm::vec3 delta = glm::max(glm::max(box.minis - _lightPosition, _lightPosition - box.maxis), glm::vec3(0.0f));
+	return glm::dot(delta, delta) <= _radius * _radius;
+}
+
+void PointLight::updateProjection(){
 	const glm::mat4 model = glm::translate(glm::mat4(1.0f), -_lightPosition);
 	
 	// Compute the projection matrix based on the scene bounding box.
@@ -168,5 +239,7 @@ void PointLight::update(const glm::vec3 & newPosition){
 }
 
 void PointLight::clean() const {
-	_shadowFramebuffer->clean();
+	if(_shadowFramebuffer){
+		_shadowFramebuffer->clean();
+	}
 }
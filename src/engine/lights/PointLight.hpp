@@ -4,6 +4,7 @@
 #include "../resources/ResourcesManager.hpp"
 #include "../graphics/FramebufferCube.hpp"
 #include "../Object.hpp"
+#include "../renderers/RenderQueue.hpp"
 
 /**
  \brief An omnidirectional punctual light, where light is radiating in all directions from a single point in space. Implements distance attenuation.
@@ -35,16 +36,24 @@ public:
 	 */
 	void draw( const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix, const glm::vec2& invScreenSize ) const;
 	
-	/** Render the light shadow map.
+	/** Render the light shadow map, skipping the casters outside of the light influence. Casters are sorted and rendered through a queue.
+	 \param queue the queue to submit the casters to, cleared beforehand
 	 \param objects list of shadow casting objects to render
+	 \param worldBoxes the world space bounding boxes of the objects
+	 \param candidates the indices of the objects overlapping the light volume
+	 \param lodPixelError the maximum projected error allowed when selecting objects levels of detail, in shadow map pixels
+	 \param clusters if non-null, the clusters of objects rendered at full resolution are culled, and their counts accumulated
+	 \return the number of casters rendered
 	 */
-	void drawShadow(const std::vector<Object> & objects) const;
+	size_t drawShadow(RenderQueue & queue, const std::vector<Object> & objects, const BoundingBoxArray & worldBoxes, const std::vector<unsigned int> & candidates, float lodPixelError = 1.0f, Object::ClusterStatistics * clusters = nullptr) const;
 	
-	/** Render the light debug wireframe visualisation
+	/** Submit the light debug wireframe visualisation to a queue, in the debug pass.
+	 \param queue the queue to submit to
 	 \param viewMatrix the current camera view matrix
 	 \param projectionMatrix the current camera projection matrix
+	 \note The queue pass should upload the item matrix and parameters to the "mvp" and "lightColor" uniforms.
 	 */
-	void drawDebug(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix) const;
+	void submitDebug(RenderQueue & queue, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix) const;
 	
 	/** Clean internal resources. */
 	void clean() const;
@@ -54,15 +63,39 @@ public:
 	 */
 	void update(const glm::vec3 & newPosition);
 	
+	/** Fit the shadow map projection to a region of space.
+	 \param box the bounding box of the shadow casters
+	 */
+	void setShadowBounds(const BoundingBox & box);
+	
+	/** Query the bounding box of the light sphere of influence.
+	 \return the world space box
+	 */
+	BoundingBox boundingBox() const;
+	
+	/** Test if a box intersects the light sphere of influence.
+	 \param box the world space box
+	 \return true if the box is at least partially lit
+	 */
+	bool intersects(const BoundingBox & box) const;
+	
 	/** Query the current light world space position.
 	 \return the current position
 	 */
 	glm::vec3 position() const { return _lightPosition; }
 	
+	/** Query the distance at which the light is completely attenuated.
+	 \return the light radius
+	 */
+	float radius() const { return _radius; }
+	
 private:
 	
+	/** Update the shadow map projections from the light position and the shadow bounds. */
+	void updateProjection();
+	
 	std::shared_ptr<FramebufferCube> _shadowFramebuffer;///< The shadow cubemap framebuffer.
-	BoundingBox _sceneBox; ///< The scene bounding box, to fit the shadow map.
+	BoundingBox _sceneBox; ///< The shadow casters bounding box, to fit the shadow map.
 	
 	std::vector<glm::mat4> _mvps; ///< Light mvp matrices for each face.
 	std::vector<glm::mat4> _views; ///< Light view matrices for each face.
@@ -73,6 +106,7 @@ private:
 	MeshInfos _sphere; ///< The supporting geometry.
 	std::shared_ptr<ProgramInfos> _program; ///< Light rendering program.
 	std::shared_ptr<ProgramInfos> _programDepth; ///< Shadow map program.
+	std::shared_ptr<ProgramInfos> _programDepthInstanced; ///< Instanced shadow map program.
 	std::vector<GLuint> _textureIds; ///< The G-buffer textures.
 	
 };
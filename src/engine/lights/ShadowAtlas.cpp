@@ -0,0 +1,133 @@
+#include "ShadowAtlas.hpp"
+#include <algorithm>
+
+/// Margin around each light viewport in pixels, covering the 5x5 blur footprint.
+static const unsigned int ShadowMargin = 2;
+
+/** Extract the even bits of a Z-order index, giving one of the two coordinates.
+ \param index the Z-order index
+ \return the coordinate
+ */
+static unsigned int compactBits(unsigned int index){
+	unsigned int coordinate = 0;
+	for(unsigned int bit = 0; (index >> (2 * bit)) != 0; ++bit){
+		coordinate |= ((index >> (2 * bit)) & 1u) << bit;
+	}
+	return coordinate;
+}
+
+/** Round a size down to a power of two.
+ \param size the size, non zero
+ \return the largest power of two smaller or equal to the size
+ */
+static unsigned int floorPowerOfTwo(unsigned int size){
+	unsigned int power = 1;
+	while(power <= size / 2){
+		power *= 2;
+	}
+	return power;
+}
+
+ShadowAtlas::ShadowAtlas(unsigned int size, unsigned int minResolution, unsigned int maxResolution){
+	_size = floorPowerOfTwo(std::max(size, 1u));
+	_minResolution = floorPowerOfTwo(std::max(minResolution, 4 * ShadowMargin));
+	_maxResolution = std::max(_minResolution, std::min(floorPowerOfTwo(std::max(maxResolution, 1u)), _size));
+	
+	const Framebuffer::Descriptor descriptor = {GL_RG16F, GL_LINEAR, GL_CLAMP_TO_BORDER};
+	_framebuffer = std::make_shared<Framebuffer>(_size, _size, descriptor, true);
+	_blur = std::make_shared<BoxBlur>(_size, _size, false, descriptor);
+	checkGLError();
+}
+
+void ShadowAtlas::clear(){
+	_requests.clear();
+}
+
+void ShadowAtlas::request(Light & light, float importance){
+	_requests.push_back({ &light, glm::clamp(importance, 0.0f, 1.0f), 0 });
+}
+
+void ShadowAtlas::allocate(){
+	// Most important lights first.
+	std::stable_sort(_requests.begin(), _requests.end(), [](const Request & a, const Request & b){
+		return a.importance > b.importance;
+	});
+	size_t area = 0;
+	for(Request & request : _requests){
+		const unsigned int resolution = (unsigned int)(request.importance * float(_maxResolution));
+		request.resolution = glm::clamp(floorPowerOfTwo(std::max(resolution, 1u)), _minResolution, _maxResolution);
+		area += size_t(request.resolution) * size_t(request.resolution);
+	}
+	// Shrink the least important regions until they fit, and then drop them.
+	const size_t capacity = size_t(_size) * size_t(_size);
+	size_t count = _requests.size();
+	while(area > capacity){
+		// Least important region that can still be halved, else the least important one.
+		size_t rid = count;
+		while(rid > 0 && _requests[rid - 1].resolution <= _minResolution){
+			--rid;
+		}
+		Request & shrunk = rid > 0 ? _requests[rid - 1] : _requests[--count];
+		const unsigned int resolution = rid > 0 ? shrunk.resolution / 2 : 0;
+		area -= size_t(shrunk.resolution) * size_t(shrunk.resolution) - size_t(resolution) * size_t(resolution);
+		shrunk.resolution = resolution;
+	}
+	
+	// Placing power-of-two squares by decreasing size along a Z-order curve keeps each one aligned on its own size.
+	std::stable_sort(_requests.begin(), _requests.end(), [](const Request & a, const Request & b){
+		return a.resolution > b.resolution;
+	});
+	_regionCount = 0;
+	_usedSize = glm::uvec2(0);
+	unsigned int cursor = 0;
+	const float invSize = 1.0f / float(_size);
+	for(Request & request : _requests){
+		if(request.resolution == 0){
+			request.light->setShadowRegion(glm::ivec4(0), glm::vec4(0.0f));
+			continue;
+		}
+		const unsigned int x = compactBits(cursor) * _minResolution;
+		const unsigned int y = compactBits(cursor >> 1) * _minResolution;
+		const unsigned int cells = request.resolution / _minResolution;
+		cursor += cells * cells;
+		
+		const glm::ivec4 viewport(x + ShadowMargin, y + ShadowMargin, request.resolution - 2 * ShadowMargin, request.resolution - 2 * ShadowMargin);
+		const glm::vec4 region = glm::vec4(viewport) * invSize;
+		request.light->setShadowRegion(viewport, region);
+		_usedSize = glm::max(_usedSize, glm::uvec2(x + request.resolution, y + request.resolution));
+		++_regionCount;
+	}
+}
+
+void ShadowAtlas::begin() const {
+	_framebuffer->bind();
+	_framebuffer->setViewport();
+	glClearColor(1.0f,1.0f,1.0f,0.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void ShadowAtlas::end() const {
+	_framebuffer->unbind();
+	if(_regionCount == 0){
+		return;
+	}
+	// --- Blur pass --------
+	// Only the part of the atlas covered by regions is processed.
+	GLUtilities::setEnabled(GL_DEPTH_TEST, false);
+	GLUtilities::setEnabled(GL_SCISSOR_TEST, true);
+	glScissor(0, 0, (GLsizei)_usedSize[0], (GLsizei)_usedSize[1]);
+	_blur->process(_framebuffer->textureId());
+	GLUtilities::setEnabled(GL_SCISSOR_TEST, false);
+	GLUtilities::setEnabled(GL_DEPTH_TEST, true);
+}
+
+float ShadowAtlas::importance(const glm::vec3 & center, float radius, const glm::vec3 & viewer){
+	// Ratio of the sphere radius to its distance, close to the tangent of its apparent half angle.
+	const float distance = glm::length(center - viewer);
+	return distance <= radius ? 1.0f : radius / distance;
+}
+
+void ShadowAtlas::clean() const {
+	_blur->clean();
+	_framebuffer->clean();
+}
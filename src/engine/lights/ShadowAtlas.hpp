@@ -0,0 +1,89 @@
+#ifndef ShadowAtlas_h
+#define ShadowAtlas_h
+#include "Light.hpp"
+#include "../Common.hpp"
+#include "../graphics/Framebuffer.hpp"
+#include "../processing/BoxBlur.hpp"
+
+/**
+ \brief Pack the variance shadow maps of multiple lights in the square regions of a single texture. Each frame, the lights request a region sized by their importance, all casters are rendered in a single framebuffer bind and the atlas is blurred once.
+ \details Regions have power-of-two sizes, and are placed by decreasing size along a Z-order curve, which leaves no gap between them. When the atlas is full, the regions of the least important lights are halved first, down to a minimum size, and the remaining lights are not shadowed. A margin covering the blur footprint is kept around each light viewport, so that neighbouring shadow maps don't bleed into each other.
+ \see GLSL::Frag::Spot_light, GLSL::Frag::Directional_light
+ \ingroup Lights
+ */
+class ShadowAtlas {
+
+public:
+
+	/** Constructor.
+	 \param size the atlas width and height in pixels, a power of two
+	 \param minResolution the smallest region size in pixels, a power of two
+	 \param maxResolution the largest region size in pixels, a power of two
+	 */
+	ShadowAtlas(unsigned int size, unsigned int minResolution, unsigned int maxResolution);
+	
+	/** Remove all requests of the previous frame. */
+	void clear();
+	
+	/** Request a region for a light.
+	 \param light the light, its region will be assigned by allocate()
+	 \param importance the light importance, between 0 and 1, scaling the region size
+	 */
+	void request(Light & light, float importance);
+	
+	/** Size and place the regions of all requested lights, and assign them to the lights. */
+	void allocate();
+	
+	/** Bind and clear the atlas, before rendering the lights shadow maps. */
+	void begin() const;
+	
+	/** Unbind the atlas and blur the used part of it. */
+	void end() const;
+	
+	/** Estimate the importance of a local light for a viewer, from the apparent size of its influence sphere.
+	 \param center the light position
+	 \param radius the light radius
+	 \param viewer the viewer position
+	 \return the importance, 1 if the viewer is inside the sphere
+	 */
+	static float importance(const glm::vec3 & center, float radius, const glm::vec3 & viewer);
+	
+	/** Query the filtered atlas texture.
+	 \return the texture ID
+	 */
+	GLuint textureId() const { return _blur->textureId(); }
+	
+	/** Query the number of lights that received a region during the last allocation.
+	 \return the number of regions
+	 */
+	size_t regionCount() const { return _regionCount; }
+	
+	/** Query the size of the part of the atlas covered by regions during the last allocation.
+	 \return the used width and height in pixels
+	 */
+	const glm::uvec2 & usedSize() const { return _usedSize; }
+	
+	/** Clean internal resources. */
+	void clean() const;
+
+private:
+
+	/// \brief A light waiting for a region.
+	struct Request {
+		Light * light; ///< The light.
+		float importance; ///< The light importance.
+		unsigned int resolution; ///< The region size, or 0 if no region is available.
+	};
+	
+	std::shared_ptr<Framebuffer> _framebuffer; ///< The shadow maps of all lights.
+	std::shared_ptr<BoxBlur> _blur; ///< Blur processing for variance shadow mapping.
+	std::vector<Request> _requests; ///< The lights requesting a region this frame.
+	unsigned int _size; ///< The atlas size.
+	unsigned int _minResolution; ///< The smallest region size.
+	unsigned int _maxResolution; ///< The largest region size.
+	size_t _regionCount = 0; ///< Number of regions assigned by the last allocation.
+	glm::uvec2 _usedSize = glm::uvec2(0); ///< Size of the part of the atlas covered by regions.
+
+};
+
+#endif
@@ -15,18 +15,13 @@ SpotLight::SpotLight(const glm::vec3& worldPosition, const glm::vec3& worldDirec
 
 
 void SpotLight::init(const std::vector<GLuint>& textureIds){
-	// Setup the framebuffer.
-	const Framebuffer::Descriptor descriptor = {GL_RG16F, GL_LINEAR, GL_CLAMP_TO_BORDER};
-	_shadowPass = std::make_shared<Framebuffer>(512, 512, descriptor, true);
-	_blur = std::make_shared<BoxBlur>(512, 512, false, descriptor);
-	
 	_cone = Resources::manager().getMesh("light_cone");
 	_textureIds = textureIds;
-	_textureIds.emplace_back(_blur->textureId());
 	
 	// Load the shaders.
 	_program = Resources::manager().getProgram("spot_light", "object_basic", "spot_light");
 	_programDepth = Resources::manager().getProgram("object_depth", "object_basic", "light_shadow");
+	_programDepthInstanced = Resources::manager().getProgram("object_depth_instanced", "object_basic_instanced", "light_shadow");
 	checkGLError();
 }
 
@@ -43,7 +38,7 @@ void SpotLight::draw(const glm::mat4& viewMatrix, const glm::mat4& projectionMat
 	const glm::mat4 mvp = projectionMatrix * viewMatrix * modelMatrix;
 	const glm::mat4 viewToLight = _mvp * glm::inverse(viewMatrix);
 	
-	glUseProgram(_program->id());
+	GLUtilities::useProgram(_program->id());
 	glUniformMatrix4fv(_program->uniform("mvp"), 1, GL_FALSE, &mvp[0][0]);
 	glUniform3fv(_program->uniform("lightPosition"), 1,  &lightPositionViewSpace[0]);
 	glUniform3fv(_program->uniform("lightDirection"), 1,  &lightDirectionViewSpace[0]);
@@ -56,54 +51,75 @@ void SpotLight::draw(const glm::mat4& viewMatrix, const glm::mat4& projectionMat
 	// Inverse screen size uniform.
 	glUniform2fv(_program->uniform("inverseScreenSize"), 1, &(invScreenSize[0]));
 	glUniformMatrix4fv(_program->uniform("viewToLight"), 1, GL_FALSE, &viewToLight[0][0]);
-	glUniform1i(_program->uniform("castShadow"), _castShadows);
+	glUniform1i(_program->uniform("castShadow"), _castShadows && hasShadowRegion());
+	glUniform4fv(_program->uniform("shadowRegion"), 1, &_shadowRegion[0]);
 	
 	// Active screen texture.
 	for(GLuint i = 0;i < _textureIds.size(); ++i){
-		glActiveTexture(GL_TEXTURE0 + i);
-		glBindTexture(GL_TEXTURE_2D, _textureIds[i]);
+		GLUtilities::bindTexture(i, GL_TEXTURE_2D, _textureIds[i]);
 	}
 	
 	// Select the geometry.
-	glBindVertexArray(_cone.vId);
+	GLUtilities::bindVertexArray(_cone.vId);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _cone.eId);
-	glDrawElements(GL_TRIANGLES, _cone.count, GL_UNSIGNED_INT, (void*)0);
+	glDrawElements(GL_TRIANGLES, _cone.count, _cone.indexType, (void*)0);
 	
-	glBindVertexArray(0);
-	glUseProgram(0);
+	GLUtilities::bindVertexArray(0);
 
 }
 
-void SpotLight::drawShadow(const std::vector<Object> & objects) const {
-	if(!_castShadows){
-		return;
+size_t SpotLight::drawShadow(RenderQueue & queue, const std::vector<Object> & objects, const BoundingBoxArray & worldBoxes, const std::vector<unsigned int> & candidates, float lodPixelError, Object::ClusterStatistics * clusters) const {
+	if(!_castShadows || !hasShadowRegion()){
+		return 0;
 	}
-	_shadowPass->bind();
-	_shadowPass->setViewport();
-	glClearColor(1.0f,1.0f,1.0f,0.0f);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	
-	glUseProgram(_programDepth->id());
-	for(auto& object : objects){
-		if(!object.castsShadow()){
+	// The shadow atlas is already bound, render in the light region.
+	GLUtilities::setViewport(_shadowViewport[0], _shadowViewport[1], _shadowViewport[2], _shadowViewport[3]);
+	
+	// Size of a world unit at unit distance in shadow map pixels, for levels of detail selection.
+	const float pixelsPerUnit = 0.5f * float(_shadowViewport[3]) * _projectionMatrix[1][1];
+	
+	// Skip the casters outside the shadow map frustum, and then outside the light cone.
+	const Frustum frustum(_mvp);
+	queue.clear();
+	size_t casters = 0;
+	for(const unsigned int oid : candidates){
+		const Object & object = objects[oid];
+		const BoundingBox box = worldBoxes.get(oid);
+		const BoundingSphere sphere = box.getSphere();
+		if(!object.castsShadow() || !frustum.intersects(box) || !intersectsCone(sphere)){
 			continue;
 		}
-		const glm::mat4 lightMVP = _mvp * object.model();
-		glUniformMatrix4fv(_programDepth->uniform("mvp"), 1, GL_FALSE, &lightMVP[0][0]);
-		object.drawGeometry();
+		++casters;
+		const unsigned int level = object.selectLevel(_lightPosition, pixelsPerUnit, false, lodPixelError);
+		if(clusters && level == 0 && object.clusterCount() > 0){
+			const size_t drawn = object.cullClusters(_mvp, glm::vec4(_lightPosition, 1.0f), true, true, queue.ranges());
+			clusters->total += object.clusterCount();
+			clusters->drawn += drawn;
+		} else {
+			object.appendLevel(level, true, queue.ranges());
+		}
+		// Casters are sorted front-to-back from the light.
+		RenderQueue::Item * item = queue.submit(RenderQueue::Shadow, *_programDepth, object, glm::length(sphere.center - _lightPosition), true);
+		if(item){
+			item->instancedProgram = _programDepthInstanced.get();
+		}
 	}
-	glUseProgram(0);
-	
-	_shadowPass->unbind();
-	
-	// --- Blur pass --------
-	glDisable(GL_DEPTH_TEST);
-	_blur->process(_shadowPass->textureId());
-	glEnable(GL_DEPTH_TEST);
+	queue.sort();
+	// Successive casters sharing their buffers and transformation are rendered in a single call.
+	queue.execute(RenderQueue::Shadow, [this](const ProgramInfos & program, const RenderQueue::Item & item, bool){
+		const glm::mat4 lightMVP = _mvp * item.object->vertexModel();
+		glUniformMatrix4fv(program.uniform("mvp"), 1, GL_FALSE, &lightMVP[0][0]);
+	}, [this](const ProgramInfos & program, const RenderQueue::Item &, bool programChanged){
+		// Casters sharing their geometry are rendered as instances.
+		if(programChanged){
+			glUniformMatrix4fv(program.uniform("vp"), 1, GL_FALSE, &_mvp[0][0]);
+		}
+	});
+	return casters;
 }
 
 
-void SpotLight::drawDebug(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix) const {
+void SpotLight::submitDebug(RenderQueue & queue, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix) const {
 	
 	const std::shared_ptr<ProgramInfos> debugProgram = Resources::manager().getProgram("light_debug", "object_basic", "light_debug");
 	
@@ -113,15 +129,9 @@ void SpotLight::drawDebug(const glm::mat4& viewMatrix, const glm::mat4& projecti
 	const glm::mat4 mvp = projectionMatrix * viewMatrix * modelMatrix;
 	const glm::vec3 colorLow = _color/(std::max)(_color[0], (std::max)(_color[1], _color[2]));
 	
-	glUseProgram(debugProgram->id());
-	glUniformMatrix4fv(debugProgram->uniform("mvp"), 1, GL_FALSE, &mvp[0][0]);
-	glUniform3fv(debugProgram->uniform("lightColor"), 1,  &colorLow[0]);
-	
-	glBindVertexArray(_cone.vId);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _cone.eId);
-	glDrawElements(GL_TRIANGLES, _cone.count, GL_UNSIGNED_INT, (void*)0);
-	glBindVertexArray(0);
-	glUseProgram(0);
+	RenderQueue::Item * item = queue.submit(RenderQueue::Debug, *debugProgram, _cone, 0.0f);
+	item->matrix = mvp;
+	item->parameters = glm::vec4(colorLow, 1.0f);
 }
 
 
@@ -132,20 +142,50 @@ void SpotLight::update(const glm::vec3 & newPosition){
 void SpotLight::update(const glm::vec3 & newPosition, const glm::vec3 & newDirection){
 	_lightPosition = newPosition;
 	_lightDirection = glm::normalize(newDirection);
+	++_revision;
+	updateProjection();
+}
+
+void SpotLight::setShadowBounds(const BoundingBox & box){
+	_sceneBox = box;
+	updateProjection();
+}
+
+BoundingBox SpotLight::boundingBox() const {
+	// Union of the apex and of the disk closing the cone.
+	const glm::vec3 diskCenter = _lightPosition + _radius * _lightDirection;
+	const float diskRadius = _radius * std::tan(_outerHalfAngle);
+	const glm::vec3 diskExtent = diskRadius * glm::sqrt(glm::max(1.0f - _lightDirection * _lightDirection, glm::vec3(0.0f)));
+	BoundingBox box;
+	box.minis = glm::min(_lightPosition, diskCenter - diskExtent);
+	box.maxis = glm::max(_lightPosition, diskCenter + diskExtent);
+	return box;
+}
+
+void SpotLight::updateProjection(){
 	_viewMatrix = glm::lookAt(_lightPosition, _lightPosition+_lightDirection, glm::vec3(0.0f,1.0f,0.0f));
 	// Compute the projection matrix, automatically finding the near and far.
 	const BoundingBox lightSpacebox = _sceneBox.transformed(_viewMatrix);
 	const float absz1 = abs(lightSpacebox.minis[2]);
 	const float absz2 = abs(lightSpacebox.maxis[2]);
-	const float near = (std::min)(absz1, absz2);
+	// If the light is inside the box along its axis, we enforce a small near.
+	const bool isInside = lightSpacebox.minis[2] < 0.0f && lightSpacebox.maxis[2] > 0.0f;
+	const float near = isInside ? 0.01f : (std::min)(absz1, absz2);
 	const float far = (std::max)(absz1, absz2);
 	const float scaleMargin = 1.5f;
 	_projectionMatrix = glm::perspective(2.0f*_outerHalfAngle, 1.0f, (1.0f/scaleMargin)*near, scaleMargin*far);
 	_mvp = _projectionMatrix * _viewMatrix;
 }
 
-void SpotLight::clean() const {
-	_blur->clean();
-	_shadowPass->clean();
+bool SpotLight::intersectsCone(const BoundingSphere & sphere) const {
+	const glm::vec3 toCenter = sphere.center - _lightPosition;
+	const float alongAxis = glm::dot(toCenter, _lightDirection);
+	// Behind the light or beyond its radius.
+	if(alongAxis < -sphere.radius || alongAxis > _radius + sphere.radius){
+		return false;
+	}
+	// Signed distance from the sphere center to the cone side.
+	const float acrossAxis = std::sqrt(std::max(glm::dot(toCenter, toCenter) - alongAxis * alongAxis, 0.0f));
+	const float distanceToCone = std::cos(_outerHalfAngle) * acrossAxis - std::sin(_outerHalfAngle) * alongAxis;
+	return distanceToCone <= sphere.radius;
 }
-
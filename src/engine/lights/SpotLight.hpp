@@ -6,11 +6,11 @@
 #include "../graphics/ScreenQuad.hpp"
 #include "../graphics/Framebuffer.hpp"
 #include "../Object.hpp"
-#include "../processing/BoxBlur.hpp"
+#include "../renderers/RenderQueue.hpp"
 
 /**
  \brief A spotlight, where light rays in a given cone are radiating from a single point in space. Implements distance attenuation and cone soft transition.
- \details It can be associated with a shadow 2D map with perspective projection, generated using Variance shadow mapping. It is rendered as a cone in deferred rendering.
+ \details It can be associated with a shadow 2D map with perspective projection, generated using Variance shadow mapping and stored in a region of a ShadowAtlas. It is rendered as a cone in deferred rendering.
  \see GLSL::Frag::Spot_light, GLSL::Frag::Light_shadow, GLSL::Frag::Light_debug
  \ingroup Lights
  */
@@ -30,7 +30,7 @@ public:
 	SpotLight(const glm::vec3& worldPosition, const glm::vec3& worldDirection, const glm::vec3& color, const float innerAngle, const float outerAngle, const float radius, const BoundingBox & sceneBox);
 	
 	/** Perform initialization against the graphics API and register textures for deferred rendering.
-	 \param textureIds the IDs of the albedo, normal, depth and effects G-buffer textures
+	 \param textureIds the IDs of the albedo, normal, depth and effects G-buffer textures, followed by the shadow atlas texture
 	 */
 	void init(const std::vector<GLuint>& textureIds);
 	
@@ -41,19 +41,24 @@ public:
 	 */
 	void draw(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix, const glm::vec2& invScreenSize) const;
 	
-	/** Render the light shadow map.
+	/** Render the light shadow map in its region of the bound shadow atlas, skipping the casters outside of the light influence. Casters are sorted and rendered through a queue.
+	 \param queue the queue to submit the casters to, cleared beforehand
 	 \param objects list of shadow casting objects to render
+	 \param worldBoxes the world space bounding boxes of the objects
+	 \param candidates the indices of the objects overlapping the light volume
+	 \param lodPixelError the maximum projected error allowed when selecting objects levels of detail, in shadow map pixels
+	 \param clusters if non-null, the clusters of objects rendered at full resolution are culled, and their counts accumulated
+	 \return the number of casters rendered
 	 */
-	void drawShadow(const std::vector<Object> & objects) const;
+	size_t drawShadow(RenderQueue & queue, const std::vector<Object> & objects, const BoundingBoxArray & worldBoxes, const std::vector<unsigned int> & candidates, float lodPixelError = 1.0f, Object::ClusterStatistics * clusters = nullptr) const;
 	
-	/** Render the light debug wireframe visualisation
+	/** Submit the light debug wireframe visualisation to a queue, in the debug pass.
+	 \param queue the queue to submit to
 	 \param viewMatrix the current camera view matrix
 	 \param projectionMatrix the current camera projection matrix
+	 \note The queue pass should upload the item matrix and parameters to the "mvp" and "lightColor" uniforms.
 	 */
-	void drawDebug(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix) const;
-	
-	/** Clean internal resources. */
-	void clean() const;
+	void submitDebug(RenderQueue & queue, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix) const;
 	
 	/** Update the light position. All internal parameters are updated.
 	 \param newPosition the new light position
@@ -66,16 +71,54 @@ public:
 	 */
 	void update(const glm::vec3 & newPosition, const glm::vec3 & newDirection);
 	
+	/** Fit the shadow map projection to a region of space.
+	 \param box the bounding box of the shadow casters
+	 */
+	void setShadowBounds(const BoundingBox & box);
+	
+	/** Query the bounding box of the light cone, limited to the light radius.
+	 \return the world space box
+	 */
+	BoundingBox boundingBox() const;
+	
+	/** Test if a box intersects the light cone, limited to the light radius.
+	 \param box the world space box
+	 \return true if the box is at least partially lit
+	 */
+	bool intersects(const BoundingBox & box) const { return intersectsCone(box.getSphere()); }
+	
 	/** Query the current light world space position.
 	 \return the current position
 	 */
 	glm::vec3 position() const { return _lightPosition; }
 	
+	/** Query the current light world space direction.
+	 \return the cone direction
+	 */
+	const glm::vec3 & direction() const { return _lightDirection; }
+	
+	/** Query the distance at which the light is completely attenuated.
+	 \return the light radius
+	 */
+	float radius() const { return _radius; }
+	
+	/** Query the cone attenuation half angles.
+	 \return the inner and outer half angles
+	 */
+	glm::vec2 halfAngles() const { return glm::vec2(_innerHalfAngle, _outerHalfAngle); }
+
 private:
+
+	/** Update the shadow map projection from the light position and direction and the shadow bounds. */
+	void updateProjection();
+	
+	/** Test if a sphere intersects the light cone, limited to the light radius.
+	 \param sphere the world space sphere
+	 \return true if the sphere is at least partially lit
+	 */
+	bool intersectsCone(const BoundingSphere & sphere) const;
 	
-	std::shared_ptr<Framebuffer> _shadowPass; ///< The shadow map framebuffer.
-	std::shared_ptr<BoxBlur> _blur; ///< Blur processing for variance shadow mapping.
-	BoundingBox _sceneBox; ///< The scene bounding box, to fit the shadow map.
+	BoundingBox _sceneBox; ///< The shadow casters bounding box, to fit the shadow map.
 	
 	glm::mat4 _projectionMatrix; ///< Light projection matrix.
 	glm::mat4 _viewMatrix; ///< Light view matrix.
@@ -88,6 +131,7 @@ private:
 	MeshInfos _cone; ///< The supporting geometry.
 	std::shared_ptr<ProgramInfos> _program; ///< Light rendering program.
 	std::shared_ptr<ProgramInfos> _programDepth; ///< Shadow map program.
+	std::shared_ptr<ProgramInfos> _programDepthInstanced; ///< Instanced shadow map program.
 	std::vector<GLuint> _textureIds; ///< The G-buffer textures.
 	
 };
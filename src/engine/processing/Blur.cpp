@@ -9,7 +9,7 @@ void Blur::process(const GLuint ) {
 }
 
 void Blur::draw() {
-	glUseProgram(_passthroughProgram->id());
+	GLUtilities::useProgram(_passthroughProgram->id());
 	ScreenQuad::draw(_finalTexture);
 }
 
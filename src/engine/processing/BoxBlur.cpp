@@ -38,7 +38,7 @@ void BoxBlur::process(const GLuint textureId){
 	_finalFramebuffer->bind();
 	_finalFramebuffer->setViewport();
 	glClear(GL_COLOR_BUFFER_BIT);
-	glUseProgram(_blurProgram->id());
+	GLUtilities::useProgram(_blurProgram->id());
 	ScreenQuad::draw(textureId);
 	_finalFramebuffer->unbind();
 }
@@ -41,7 +41,7 @@ void GaussianBlur::process(const GLuint textureId) {
 	_frameBuffers[0]->bind();
 	_frameBuffers[0]->setViewport();
 	glClear(GL_COLOR_BUFFER_BIT);
-	glUseProgram(_passthroughProgram->id());
+	GLUtilities::useProgram(_passthroughProgram->id());
 	ScreenQuad::draw(textureId);
 	_frameBuffers[0]->unbind();
 	
@@ -50,7 +50,7 @@ void GaussianBlur::process(const GLuint textureId) {
 		_frameBuffers[i]->bind();
 		_frameBuffers[i]->setViewport();
 		glClear(GL_COLOR_BUFFER_BIT);
-		glUseProgram(_passthroughProgram->id());
+		GLUtilities::useProgram(_passthroughProgram->id());
 		ScreenQuad::draw(_frameBuffers[i-1]->textureId());
 		_frameBuffers[i]->unbind();
 	}
@@ -60,7 +60,7 @@ void GaussianBlur::process(const GLuint textureId) {
 		_frameBuffersBlur[i]->bind();
 		_frameBuffersBlur[i]->setViewport();
 		glClear(GL_COLOR_BUFFER_BIT);
-		glUseProgram(_blurProgram->id());
+		GLUtilities::useProgram(_blurProgram->id());
 		glUniform2f(_blurProgram->uniform("fetchOffset"), 0.0f, 1.2f/(float)_frameBuffersBlur[i]->height());
 		ScreenQuad::draw(_frameBuffers[i]->textureId());
 		_frameBuffersBlur[i]->unbind();
@@ -70,7 +70,7 @@ void GaussianBlur::process(const GLuint textureId) {
 		_frameBuffers[i]->bind();
 		_frameBuffers[i]->setViewport();
 		glClear(GL_COLOR_BUFFER_BIT);
-		glUseProgram(_blurProgram->id());
+		GLUtilities::useProgram(_blurProgram->id());
 		glUniform2f(_blurProgram->uniform("fetchOffset"), 1.2f/(float)_frameBuffers[i]->width(), 0.0f);
 		ScreenQuad::draw(_frameBuffersBlur[i]->textureId());
 		_frameBuffers[i]->unbind();
@@ -84,7 +84,7 @@ void GaussianBlur::process(const GLuint textureId) {
 	_finalFramebuffer->bind();
 	_finalFramebuffer->setViewport();
 	glClear(GL_COLOR_BUFFER_BIT);
-	glUseProgram(_combineProgram->id());
+	GLUtilities::useProgram(_combineProgram->id());
 	ScreenQuad::draw(_textures);
 	_finalFramebuffer->unbind();
 
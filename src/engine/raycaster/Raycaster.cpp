@@ -0,0 +1,521 @@
+#include "Raycaster.hpp"
+#include "../Object.hpp"
+
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_AMD64)
+#define RAYCASTER_SSE
+#include <xmmintrin.h>
+#endif
+
+/// \brief Node of the binary hierarchy, before collapsing it into four-wide nodes.
+struct BuildNode {
+	BoundingBox box; ///< The node bounds.
+	unsigned int first; ///< The first primitive in the order list, for leaves.
+	unsigned int count; ///< The number of primitives, 0 for inner nodes.
+	int left; ///< The first child index, for inner nodes.
+	int right; ///< The second child index, for inner nodes.
+};
+
+/** Create an empty box, that any merge will override.
+ \return the empty box
+ */
+static BoundingBox emptyBox(){
+	BoundingBox box;
+	box.minis = glm::vec3(std::numeric_limits<float>::max());
+	box.maxis = glm::vec3(-std::numeric_limits<float>::max());
+	return box;
+}
+
+/** Compute the half surface area of a box.
+ \param box the box
+ \return the half area
+ */
+static float halfArea(const BoundingBox & box){
+	const glm::vec3 size = glm::max(box.maxis - box.minis, glm::vec3(0.0f));
+	return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+/** Recursively build a binary hierarchy by binning primitives centroids and minimizing the surface area heuristic.
+ \param boxes the primitives boxes
+ \param centroids the primitives boxes centers
+ \param order the primitives order, will be partitioned
+ \param first the first primitive of the current range in the order list
+ \param count the number of primitives in the current range
+ \param maxLeafSize the maximum number of primitives in a leaf
+ \param nodes the nodes list to populate
+ \return the index of the created node
+ */
+static int buildBinary(const std::vector<BoundingBox> & boxes, const std::vector<glm::vec3> & centroids, std::vector<unsigned int> & order, unsigned int first, unsigned int count, unsigned int maxLeafSize, std::vector<BuildNode> & nodes){
+	const int nodeId = int(nodes.size());
+	nodes.emplace_back();
+	
+	BoundingBox box = emptyBox();
+	BoundingBox centroidBox = emptyBox();
+	for(unsigned int pid = first; pid < first + count; ++pid){
+		box.merge(boxes[order[pid]]);
+		centroidBox.minis = glm::min(centroidBox.minis, centroids[order[pid]]);
+		centroidBox.maxis = glm::max(centroidBox.maxis, centroids[order[pid]]);
+	}
+	nodes[nodeId].box = box;
+	nodes[nodeId].first = first;
+	nodes[nodeId].count = count;
+	nodes[nodeId].left = nodes[nodeId].right = -1;
+	if(count == 1){
+		return nodeId;
+	}
+	
+	// Find the best binned split over the three axis.
+	const int binCount = 16;
+	const float traversalCost = 1.0f;
+	float bestCost = std::numeric_limits<float>::max();
+	int bestAxis = -1;
+	int bestBin = 0;
+	const glm::vec3 extent = centroidBox.maxis - centroidBox.minis;
+	for(int axis = 0; axis < 3; ++axis){
+		if(extent[axis] <= 0.0f){
+			continue;
+		}
+		BoundingBox binBoxes[binCount];
+		unsigned int binCounts[binCount];
+		for(int bid = 0; bid < binCount; ++bid){
+			binBoxes[bid] = emptyBox();
+			binCounts[bid] = 0;
+		}
+		const float scale = float(binCount) / extent[axis];
+		for(unsigned int pid = first; pid < first + count; ++pid){
+			const unsigned int prim = order[pid];
+			const int bid = std::min(binCount - 1, int((centroids[prim][axis] - centroidBox.minis[axis]) * scale));
+			binBoxes[bid].merge(boxes[prim]);
+			++binCounts[bid];
+		}
+		// Sweep from the right to accumulate the right side costs, then from the left.
+		float rightCosts[binCount];
+		BoundingBox rightBox = emptyBox();
+		unsigned int rightCount = 0;
+		for(int bid = binCount - 1; bid > 0; --bid){
+			rightBox.merge(binBoxes[bid]);
+			rightCount += binCounts[bid];
+			rightCosts[bid] = rightCount > 0 ? halfArea(rightBox) * float(rightCount) : 0.0f;
+		}
+		BoundingBox leftBox = emptyBox();
+		unsigned int leftCount = 0;
+		for(int bid = 0; bid < binCount - 1; ++bid){
+			leftBox.merge(binBoxes[bid]);
+			leftCount += binCounts[bid];
+			if(leftCount == 0 || leftCount == count){
+				continue;
+			}
+			const float cost = halfArea(leftBox) * float(leftCount) + rightCosts[bid + 1];
+			if(cost < bestCost){
+				bestCost = cost;
+				bestAxis = axis;
+				bestBin = bid;
+			}
+		}
+	}
+	
+	unsigned int split = first + count / 2;
+	if(bestAxis >= 0){
+		// Keep a leaf if splitting is more expensive than intersecting all primitives.
+		const float splitCost = traversalCost + bestCost / std::max(halfArea(box), 1e-20f);
+		if(count <= maxLeafSize && splitCost >= float(count)){
+			return nodeId;
+		}
+		const float scale = float(binCount) / extent[bestAxis];
+		const float minBound = centroidBox.minis[bestAxis];
+		const auto middle = std::partition(order.begin() + first, order.begin() + first + count, [&](unsigned int prim){
+			return std::min(binCount - 1, int((centroids[prim][bestAxis] - minBound) * scale)) <= bestBin;
+		});
+		split = (unsigned int)(middle - order.begin());
+	} else if(count <= maxLeafSize){
+		// All centroids are identical.
+		return nodeId;
+	}
+	
+	const int left = buildBinary(boxes, centroids, order, first, split - first, maxLeafSize, nodes);
+	const int right = buildBinary(boxes, centroids, order, split, first + count - split, maxLeafSize, nodes);
+	nodes[nodeId].left = left;
+	nodes[nodeId].right = right;
+	nodes[nodeId].count = 0;
+	return nodeId;
+}
+
+/** Mark a child of a four-wide node as empty, with bounds that no ray can intersect.
+ \param node the node
+ \param cid the child slot
+ */
+template<typename Node>
+static void setEmptyChild(Node & node, size_t cid){
+	for(int axis = 0; axis < 3; ++axis){
+		node.minis[axis][cid] = std::numeric_limits<float>::infinity();
+		node.maxis[axis][cid] = -std::numeric_limits<float>::infinity();
+	}
+	node.indices[cid] = -1;
+	node.counts[cid] = 0;
+}
+
+/** Collapse a binary hierarchy into four-wide nodes, by repeatedly opening the largest inner child, and store them in depth-first order.
+ \param binary the binary hierarchy nodes
+ \param nodeId the binary node to collapse, an inner node
+ \param depth the depth of the created node
+ \param nodes the four-wide nodes list to populate
+ \param maxDepth will be updated with the maximum depth reached
+ \return the index of the created node
+ */
+template<typename Node>
+static int collapse(const std::vector<BuildNode> & binary, int nodeId, unsigned int depth, std::vector<Node> & nodes, unsigned int & maxDepth){
+	maxDepth = std::max(maxDepth, depth);
+	std::vector<int> children = { binary[nodeId].left, binary[nodeId].right };
+	while(children.size() < 4){
+		int best = -1;
+		float bestArea = -1.0f;
+		for(size_t cid = 0; cid < children.size(); ++cid){
+			const BuildNode & child = binary[children[cid]];
+			const float area = halfArea(child.box);
+			if(child.count == 0 && area > bestArea){
+				bestArea = area;
+				best = int(cid);
+			}
+		}
+		if(best < 0){
+			break;
+		}
+		const BuildNode & opened = binary[children[best]];
+		children[best] = opened.left;
+		children.push_back(opened.right);
+	}
+	
+	const int index = int(nodes.size());
+	nodes.emplace_back();
+	for(size_t cid = 0; cid < 4; ++cid){
+		Node & node = nodes[index];
+		if(cid >= children.size()){
+			setEmptyChild(node, cid);
+			continue;
+		}
+		const BuildNode & child = binary[children[cid]];
+		for(int axis = 0; axis < 3; ++axis){
+			node.minis[axis][cid] = child.box.minis[axis];
+			node.maxis[axis][cid] = child.box.maxis[axis];
+		}
+		node.counts[cid] = child.count;
+		if(child.count > 0){
+			node.indices[cid] = int(child.first);
+		} else {
+			// The recursion can reallocate the nodes list.
+			const int childIndex = collapse(binary, children[cid], depth + 1, nodes, maxDepth);
+			nodes[index].indices[cid] = childIndex;
+		}
+	}
+	return index;
+}
+
+void BVH::build(const std::vector<BoundingBox> & boxes, unsigned int maxLeafSize, std::vector<unsigned int> & order){
+	_nodes.clear();
+	_bounds = BoundingBox();
+	_depth = 0;
+	order.resize(boxes.size());
+	if(boxes.empty()){
+		return;
+	}
+	std::vector<glm::vec3> centroids(boxes.size());
+	for(size_t pid = 0; pid < boxes.size(); ++pid){
+		order[pid] = (unsigned int)pid;
+		centroids[pid] = 0.5f * (boxes[pid].minis + boxes[pid].maxis);
+	}
+	std::vector<BuildNode> binary;
+	binary.reserve(2 * boxes.size());
+	buildBinary(boxes, centroids, order, 0, (unsigned int)boxes.size(), std::max(maxLeafSize, 1u), binary);
+	_bounds = binary[0].box;
+	
+	if(binary[0].count == 0){
+		collapse(binary, 0, 1, _nodes, _depth);
+		return;
+	}
+	// The root is a leaf, store it in a node with a single child.
+	_nodes.emplace_back();
+	for(size_t cid = 1; cid < 4; ++cid){
+		setEmptyChild(_nodes[0], cid);
+	}
+	for(int axis = 0; axis < 3; ++axis){
+		_nodes[0].minis[axis][0] = _bounds.minis[axis];
+		_nodes[0].maxis[axis][0] = _bounds.maxis[axis];
+	}
+	_nodes[0].indices[0] = 0;
+	_nodes[0].counts[0] = binary[0].count;
+	_depth = 1;
+}
+
+template<typename Visitor>
+bool BVH::traverse(const Ray & ray, float mini, float & maxi, Visitor & visitor) const {
+	if(_nodes.empty()){
+		return false;
+	}
+	const glm::vec3 invDir = 1.0f / ray.direction;
+	// For each axis, pick the entry and exit planes based on the direction sign.
+	const bool negative[3] = { invDir.x < 0.0f, invDir.y < 0.0f, invDir.z < 0.0f };
+	
+	/// \brief Node or leaf waiting to be visited.
+	struct Entry {
+		int index; ///< The node index or first primitive.
+		unsigned int count; ///< The number of primitives, 0 for nodes.
+		float dist; ///< The entry distance along the ray.
+	};
+	// Each visited node leaves at most three siblings on the stack.
+	const size_t maxStackSize = 3 * _depth + 1;
+	Entry localStack[256];
+	std::vector<Entry> largeStack(maxStackSize > 256 ? maxStackSize : 0);
+	Entry * stack = maxStackSize > 256 ? largeStack.data() : localStack;
+	int stackSize = 0;
+	stack[stackSize++] = { 0, 0, mini };
+	
+#ifdef RAYCASTER_SSE
+	const __m128 origins[3] = { _mm_set1_ps(ray.origin.x), _mm_set1_ps(ray.origin.y), _mm_set1_ps(ray.origin.z) };
+	const __m128 invDirs[3] = { _mm_set1_ps(invDir.x), _mm_set1_ps(invDir.y), _mm_set1_ps(invDir.z) };
+#endif
+	
+	while(stackSize > 0){
+		const Entry entry = stack[--stackSize];
+		if(entry.dist > maxi){
+			continue;
+		}
+		if(entry.count > 0){
+			if(visitor(entry.index, entry.count, maxi)){
+				return true;
+			}
+			continue;
+		}
+		
+		const Node & node = _nodes[entry.index];
+		float entries[4];
+		int hitMask = 0;
+#ifdef RAYCASTER_SSE
+		// When a product is undefined (0 * inf), min and max return their second argument and the axis is ignored.
+		__m128 tEntry = _mm_set1_ps(mini);
+		__m128 tExit = _mm_set1_ps(maxi);
+		for(int axis = 0; axis < 3; ++axis){
+			const __m128 nearPlanes = _mm_loadu_ps(negative[axis] ? node.maxis[axis] : node.minis[axis]);
+			const __m128 farPlanes = _mm_loadu_ps(negative[axis] ? node.minis[axis] : node.maxis[axis]);
+			tEntry = _mm_max_ps(_mm_mul_ps(_mm_sub_ps(nearPlanes, origins[axis]), invDirs[axis]), tEntry);
+			tExit = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(farPlanes, origins[axis]), invDirs[axis]), tExit);
+		}
+		hitMask = _mm_movemask_ps(_mm_cmple_ps(tEntry, tExit));
+		_mm_storeu_ps(entries, tEntry);
+#else
+		for(int cid = 0; cid < 4; ++cid){
+			float tEntry = mini;
+			float tExit = maxi;
+			for(int axis = 0; axis < 3; ++axis){
+				const float nearPlane = negative[axis] ? node.maxis[axis][cid] : node.minis[axis][cid];
+				const float farPlane = negative[axis] ? node.minis[axis][cid] : node.maxis[axis][cid];
+				const float tNear = (nearPlane - ray.origin[axis]) * invDir[axis];
+				const float tFar = (farPlane - ray.origin[axis]) * invDir[axis];
+				tEntry = tNear > tEntry ? tNear : tEntry;
+				tExit = tFar < tExit ? tFar : tExit;
+			}
+			entries[cid] = tEntry;
+			hitMask |= (tEntry <= tExit ? 1 : 0) << cid;
+		}
+#endif
+		
+		// Push the intersected children, farthest first so that the closest is visited next.
+		Entry children[4];
+		int childCount = 0;
+		for(int cid = 0; cid < 4; ++cid){
+			if((hitMask & (1 << cid)) && node.indices[cid] >= 0){
+				children[childCount++] = { node.indices[cid], node.counts[cid], entries[cid] };
+			}
+		}
+		// Insertion sort, there are at most four children.
+		for(int cid = 1; cid < childCount; ++cid){
+			const Entry child = children[cid];
+			int pos = cid;
+			for(; pos > 0 && children[pos - 1].dist < child.dist; --pos){
+				children[pos] = children[pos - 1];
+			}
+			children[pos] = child;
+		}
+		for(int cid = 0; cid < childCount; ++cid){
+			stack[stackSize++] = children[cid];
+		}
+	}
+	return false;
+}
+
+/** Intersect a ray with a triangle (Moller-Trumbore test), both faces being considered.
+ \param ray the ray
+ \param v0 the first vertex
+ \param e1 the edge from the first to the second vertex
+ \param e2 the edge from the first to the third vertex
+ \param mini the minimum distance along the ray
+ \param maxi the maximum distance along the ray
+ \param dist will contain the intersection distance
+ \param barycentrics will contain the intersection barycentric coordinates
+ \return true if there is an intersection in the distance range
+ */
+static bool intersectTriangle(const Ray & ray, const glm::vec3 & v0, const glm::vec3 & e1, const glm::vec3 & e2, float mini, float maxi, float & dist, glm::vec2 & barycentrics){
+	const glm::vec3 p = glm::cross(ray.direction, e2);
+	const float det = glm::dot(e1, p);
+	if(det == 0.0f){
+		return false;
+	}
+	const float invDet = 1.0f / det;
+	const glm::vec3 s = ray.origin - v0;
+	const float u = glm::dot(s, p) * invDet;
+	if(u < 0.0f || u > 1.0f){
+		return false;
+	}
+	const glm::vec3 q = glm::cross(s, e1);
+	const float v = glm::dot(ray.direction, q) * invDet;
+	if(v < 0.0f || u + v > 1.0f){
+		return false;
+	}
+	const float t = glm::dot(e2, q) * invDet;
+	if(t < mini || t > maxi){
+		return false;
+	}
+	dist = t;
+	barycentrics = glm::vec2(u, v);
+	return true;
+}
+
+MeshBVH::MeshBVH(const Mesh & mesh){
+	const size_t indexCount = mesh.levels.empty() ? mesh.indices.size() : mesh.levels[0].count;
+	const size_t triCount = indexCount / 3;
+	std::vector<BoundingBox> boxes(triCount);
+	for(size_t tid = 0; tid < triCount; ++tid){
+		const glm::vec3 & v0 = mesh.positions[mesh.indices[3*tid]];
+		const glm::vec3 & v1 = mesh.positions[mesh.indices[3*tid+1]];
+		const glm::vec3 & v2 = mesh.positions[mesh.indices[3*tid+2]];
+		boxes[tid].minis = glm::min(v0, glm::min(v1, v2));
+		boxes[tid].maxis = glm::max(v0, glm::max(v1, v2));
+	}
+	std::vector<unsigned int> order;
+	build(boxes, 4, order);
+	
+	_triangles.resize(triCount);
+	for(size_t tid = 0; tid < triCount; ++tid){
+		const unsigned int source = order[tid];
+		const glm::vec3 & v0 = mesh.positions[mesh.indices[3*source]];
+		_triangles[tid].v0 = v0;
+		_triangles[tid].e1 = mesh.positions[mesh.indices[3*source+1]] - v0;
+		_triangles[tid].e2 = mesh.positions[mesh.indices[3*source+2]] - v0;
+		_triangles[tid].id = source;
+	}
+}
+
+RayHit MeshBVH::intersect(const Ray & ray, float mini, float maxi) const {
+	/// \brief Find the closest triangle, shortening the ray at each hit.
+	struct Visitor {
+		const Ray & ray; ///< The ray.
+		const float mini; ///< The minimum distance.
+		const std::vector<Triangle> & triangles; ///< The triangles.
+		RayHit hit; ///< The closest hit.
+		
+		bool operator()(int first, unsigned int count, float & maxi){
+			for(unsigned int tid = first; tid < first + count; ++tid){
+				const Triangle & tri = triangles[tid];
+				if(intersectTriangle(ray, tri.v0, tri.e1, tri.e2, mini, maxi, hit.dist, hit.barycentrics)){
+					hit.hit = true;
+					hit.triangle = tri.id;
+					maxi = hit.dist;
+				}
+			}
+			return false;
+		}
+	};
+	Visitor visitor = { ray, mini, _triangles, RayHit() };
+	traverse(ray, mini, maxi, visitor);
+	return visitor.hit;
+}
+
+bool MeshBVH::intersectsAny(const Ray & ray, float mini, float maxi) const {
+	/// \brief Stop at the first triangle hit.
+	struct Visitor {
+		const Ray & ray; ///< The ray.
+		const float mini; ///< The minimum distance.
+		const std::vector<Triangle> & triangles; ///< The triangles.
+		
+		bool operator()(int first, unsigned int count, float & maxi){
+			float dist;
+			glm::vec2 barycentrics;
+			for(unsigned int tid = first; tid < first + count; ++tid){
+				const Triangle & tri = triangles[tid];
+				if(intersectTriangle(ray, tri.v0, tri.e1, tri.e2, mini, maxi, dist, barycentrics)){
+					return true;
+				}
+			}
+			return false;
+		}
+	};
+	Visitor visitor = { ray, mini, _triangles };
+	return traverse(ray, mini, maxi, visitor);
+}
+
+Raycaster::Raycaster(const std::vector<Object> & objects){
+	std::vector<BoundingBox> boxes;
+	std::vector<Instance> instances;
+	for(size_t oid = 0; oid < objects.size(); ++oid){
+		const Object & object = objects[oid];
+		if(!object.bvh()){
+			continue;
+		}
+		boxes.push_back(object.getBoundingBox());
+		instances.push_back({ object.bvh(), glm::inverse(object.model()), long(oid) });
+	}
+	std::vector<unsigned int> order;
+	build(boxes, 1, order);
+	_instances.resize(instances.size());
+	for(size_t iid = 0; iid < instances.size(); ++iid){
+		_instances[iid] = instances[order[iid]];
+	}
+}
+
+RayHit Raycaster::intersect(const Ray & ray, float mini, float maxi) const {
+	/// \brief Intersect instances in model space. Transforming the direction without normalizing it preserves distances along the ray.
+	struct Visitor {
+		const Ray & ray; ///< The ray.
+		const float mini; ///< The minimum distance.
+		const std::vector<Instance> & instances; ///< The instances.
+		RayHit hit; ///< The closest hit.
+		
+		bool operator()(int first, unsigned int count, float & maxi){
+			for(unsigned int iid = first; iid < first + count; ++iid){
+				const Instance & instance = instances[iid];
+				const Ray localRay(glm::vec3(instance.worldToModel * glm::vec4(ray.origin, 1.0f)), glm::vec3(instance.worldToModel * glm::vec4(ray.direction, 0.0f)));
+				const RayHit localHit = instance.bvh->intersect(localRay, mini, maxi);
+				if(localHit.hit){
+					hit = localHit;
+					hit.object = instance.object;
+					maxi = hit.dist;
+				}
+			}
+			return false;
+		}
+	};
+	Visitor visitor = { ray, mini, _instances, RayHit() };
+	traverse(ray, mini, maxi, visitor);
+	return visitor.hit;
+}
+
+bool Raycaster::intersects(const glm::vec3 & p0, const glm::vec3 & p1) const {
+	/// \brief Stop at the first instance hit.
+	struct Visitor {
+		const Ray & ray; ///< The ray.
+		const std::vector<Instance> & instances; ///< The instances.
+		
+		bool operator()(int first, unsigned int count, float & maxi){
+			for(unsigned int iid = first; iid < first + count; ++iid){
+				const Instance & instance = instances[iid];
+				const Ray localRay(glm::vec3(instance.worldToModel * glm::vec4(ray.origin, 1.0f)), glm::vec3(instance.worldToModel * glm::vec4(ray.direction, 0.0f)));
+				if(instance.bvh->intersectsAny(localRay, 0.0f, maxi)){
+					return true;
+				}
+			}
+			return false;
+		}
+	};
+	const Ray ray(p0, p1 - p0);
+	float maxi = 1.0f;
+	Visitor visitor = { ray, _instances };
+	return traverse(ray, 0.0f, maxi, visitor);
+}
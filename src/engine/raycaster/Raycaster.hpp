@@ -0,0 +1,191 @@
+#ifndef Raycaster_h
+#define Raycaster_h
+
+#include "../Common.hpp"
+#include "../resources/MeshUtilities.hpp"
+#include <limits>
+
+class Object;
+
+/**
+ \defgroup Raycaster Raycaster
+ \brief CPU ray queries against meshes and scenes, accelerated by bounding volume hierarchies.
+ \ingroup Engine
+ */
+
+/**
+ \brief A ray, defined by an origin and a direction. The direction does not have to be normalized, distances along the ray are expressed in multiples of its length.
+ \ingroup Raycaster
+ */
+struct Ray {
+	glm::vec3 origin; ///< The ray origin.
+	glm::vec3 direction; ///< The ray direction.
+	
+	/** Constructor.
+	 \param anOrigin the ray origin
+	 \param aDirection the ray direction
+	 */
+	Ray(const glm::vec3 & anOrigin, const glm::vec3 & aDirection) : origin(anOrigin), direction(aDirection) {}
+};
+
+/**
+ \brief The result of a ray query.
+ \ingroup Raycaster
+ */
+struct RayHit {
+	bool hit; ///< Was an intersection found.
+	float dist; ///< The distance along the ray to the intersection.
+	glm::vec2 barycentrics; ///< The barycentric coordinates of the intersection with respect to the second and third vertices of the triangle.
+	unsigned int triangle; ///< The index of the intersected triangle in the mesh.
+	long object; ///< The index of the intersected object in the scene, or -1.
+	
+	/** Empty hit constructor. */
+	RayHit() : hit(false), dist(std::numeric_limits<float>::max()), barycentrics(0.0f), triangle(0), object(-1) {}
+};
+
+/**
+ \brief Bounding volume hierarchy built with the surface area heuristic, flattened in depth-first order with four children per node so that a ray is tested against four boxes at once.
+ \ingroup Raycaster
+ */
+class BVH {
+	
+public:
+	
+	/** Query the number of nodes of the hierarchy.
+	 \return the node count
+	 */
+	size_t nodeCount() const { return _nodes.size(); }
+	
+	/** Query the bounding box of all the primitives.
+	 \return the bounding box
+	 */
+	const BoundingBox & bounds() const { return _bounds; }
+	
+protected:
+	
+	/**
+	 \brief A node with four children. Bounds are stored per axis for the four children, to be loaded in a single register. A child is either an inner node (count = 0), a leaf covering count consecutive primitives, or empty (index = -1).
+	 */
+	struct Node {
+		float minis[3][4]; ///< The children lower bounds, per axis.
+		float maxis[3][4]; ///< The children upper bounds, per axis.
+		int indices[4]; ///< The children node index, or the first primitive index for leaves.
+		unsigned int counts[4]; ///< The number of primitives of leaf children, 0 for inner nodes.
+	};
+	
+	/** Build the hierarchy.
+	 \param boxes the bounding box of each primitive
+	 \param maxLeafSize the maximum number of primitives in a leaf
+	 \param order will contain the primitives indices in the order they should be stored for leaves to reference them as consecutive ranges
+	 */
+	void build(const std::vector<BoundingBox> & boxes, unsigned int maxLeafSize, std::vector<unsigned int> & order);
+	
+	/** Traverse the hierarchy, visiting leaves in approximate front-to-back order.
+	 \param ray the ray to trace
+	 \param mini the minimum distance along the ray
+	 \param maxi the maximum distance along the ray, can be shortened by the leaf visitor
+	 \param visitor will be called with the first primitive and count of each intersected leaf, should return true to stop the traversal
+	 \return true if the traversal was stopped by the visitor
+	 */
+	template<typename Visitor>
+	bool traverse(const Ray & ray, float mini, float & maxi, Visitor & visitor) const;
+	
+	std::vector<Node> _nodes; ///< The flattened nodes, the root being the first one.
+	BoundingBox _bounds; ///< The bounding box of the whole hierarchy.
+	unsigned int _depth = 0; ///< The number of levels of nodes.
+	
+};
+
+/**
+ \brief Bounding volume hierarchy over the triangles of a mesh, in model space.
+ \ingroup Raycaster
+ */
+class MeshBVH : public BVH {
+	
+public:
+	
+	/** Build the hierarchy of a mesh full resolution level.
+	 \param mesh the mesh to process
+	 */
+	MeshBVH(const Mesh & mesh);
+	
+	/** Find the closest intersection of a ray with the mesh.
+	 \param ray the ray, in model space
+	 \param mini the minimum distance along the ray
+	 \param maxi the maximum distance along the ray
+	 \return the closest intersection, if any
+	 */
+	RayHit intersect(const Ray & ray, float mini = 0.0f, float maxi = std::numeric_limits<float>::max()) const;
+	
+	/** Test if a ray intersects the mesh, stopping at the first intersection found.
+	 \param ray the ray, in model space
+	 \param mini the minimum distance along the ray
+	 \param maxi the maximum distance along the ray
+	 \return true if there is an intersection
+	 */
+	bool intersectsAny(const Ray & ray, float mini = 0.0f, float maxi = std::numeric_limits<float>::max()) const;
+	
+	/** Query the number of triangles.
+	 \return the triangle count
+	 */
+	size_t triangleCount() const { return _triangles.size(); }
+	
+private:
+	
+	/// \brief Triangle data for the intersection test, stored in leaf order.
+	struct Triangle {
+		glm::vec3 v0; ///< The first vertex.
+		glm::vec3 e1; ///< The edge from the first to the second vertex.
+		glm::vec3 e2; ///< The edge from the first to the third vertex.
+		unsigned int id; ///< The triangle index in the mesh.
+	};
+	
+	std::vector<Triangle> _triangles; ///< The triangles, in leaf order.
+	
+};
+
+/**
+ \brief Two-level hierarchy for ray queries against a list of objects: a hierarchy over the instances world space bounding boxes, referencing each mesh hierarchy.
+ \details The top level has to be rebuilt when objects move, which is cheap as meshes hierarchies are shared and expressed in model space.
+ \ingroup Raycaster
+ */
+class Raycaster : public BVH {
+	
+public:
+	
+	/** Build the top level hierarchy over objects. Objects without a mesh hierarchy are ignored.
+	 \param objects the objects to reference
+	 \warning The objects have to outlive the raycaster.
+	 */
+	Raycaster(const std::vector<Object> & objects);
+	
+	/** Find the closest intersection of a ray with the objects.
+	 \param ray the ray, in world space
+	 \param mini the minimum distance along the ray
+	 \param maxi the maximum distance along the ray
+	 \return the closest intersection, if any, with the object index
+	 */
+	RayHit intersect(const Ray & ray, float mini = 0.0f, float maxi = std::numeric_limits<float>::max()) const;
+	
+	/** Test if a segment between two points intersects any object, for instance for visibility queries.
+	 \param p0 the first point, in world space
+	 \param p1 the second point, in world space
+	 \return true if there is an intersection
+	 \note Points lying on a surface should be offset from it to avoid reporting self-intersections.
+	 */
+	bool intersects(const glm::vec3 & p0, const glm::vec3 & p1) const;
+	
+private:
+	
+	/// \brief An object reference.
+	struct Instance {
+		const MeshBVH * bvh; ///< The object mesh hierarchy.
+		glm::mat4 worldToModel; ///< The inverse of the object transformation.
+		long object; ///< The object index.
+	};
+	
+	std::vector<Instance> _instances; ///< The instances, in leaf order.
+	
+};
+
+#endif
@@ -0,0 +1,320 @@
+#include "RenderQueue.hpp"
+#include <cstring>
+#include <cstdint>
+
+
+void RenderQueue::clear(){
+	_items.clear();
+	_keys.clear();
+	_sortedKeys.clear();
+	_order.clear();
+	_ranges.clear();
+	_pendingRanges.clear();
+}
+
+uint64_t RenderQueue::index(std::unordered_map<uint64_t, uint64_t> & indices, uint64_t state, unsigned int bits){
+	const auto existing = indices.find(state);
+	if(existing != indices.end()){
+		return existing->second;
+	}
+	// Once all indices are used, new states share the last one: they are still rendered correctly, only grouped less efficiently.
+	const uint64_t maxIndex = (uint64_t(1) << bits) - 1;
+	const uint64_t newIndex = std::min(uint64_t(indices.size()), maxIndex);
+	indices[state] = newIndex;
+	return newIndex;
+}
+
+/** Quantize a distance to the 24 bits of the key, preserving the ordering of non-negative values.
+ \param depth the distance
+ \return the quantized depth
+ */
+static uint64_t quantizeDepth(float depth){
+	// The bits of positive floats are ordered as the values, keep the exponent and the highest bits of the mantissa.
+	const float clamped = depth > 0.0f ? depth : 0.0f;
+	uint32_t bits;
+	std::memcpy(&bits, &clamped, sizeof(float));
+	return uint64_t(bits >> 7) & 0xFFFFFF;
+}
+
+RenderQueue::Item * RenderQueue::submit(Pass pass, const ProgramInfos & program, const Object & object, float depth, bool positionsOnly){
+	Item * item = submit(pass, program, object, _pendingRanges, depth, positionsOnly);
+	_pendingRanges.clear();
+	return item;
+}
+
+RenderQueue::Item * RenderQueue::submit(Pass pass, const ProgramInfos & program, const Object & object, const Object::DrawRanges & ranges, float depth, bool positionsOnly){
+	if(ranges.counts.empty()){
+		return nullptr;
+	}
+	Item item;
+	item.program = &program;
+	item.object = &object;
+	item.positionsOnly = positionsOnly;
+	item.textured = !positionsOnly;
+	item.indexSize = object.indexSize(positionsOnly);
+	item.firstRange = _ranges.counts.size();
+	item.rangeCount = ranges.counts.size();
+	// Identify the rendered geometry by hashing the ranges (FNV-1a).
+	item.rangesHash = 14695981039346656037ull;
+	for(size_t rid = 0; rid < item.rangeCount; ++rid){
+		item.rangesHash = (item.rangesHash ^ uint64_t(ranges.counts[rid])) * 1099511628211ull;
+		item.rangesHash = (item.rangesHash ^ uint64_t(size_t(ranges.offsets[rid]))) * 1099511628211ull;
+		item.rangesHash = (item.rangesHash ^ uint64_t(uint32_t(ranges.baseVertices[rid]))) * 1099511628211ull;
+	}
+	_ranges.counts.insert(_ranges.counts.end(), ranges.counts.begin(), ranges.counts.end());
+	_ranges.offsets.insert(_ranges.offsets.end(), ranges.offsets.begin(), ranges.offsets.end());
+	_ranges.baseVertices.insert(_ranges.baseVertices.end(), ranges.baseVertices.begin(), ranges.baseVertices.end());
+	
+	// Identify the set of textures by hashing their IDs (FNV-1a).
+	uint64_t texturesHash = 0;
+	if(item.textured){
+		texturesHash = 14695981039346656037ull;
+		for(const TextureInfos & texture : object.textures()){
+			texturesHash = (texturesHash ^ uint64_t(texture.id)) * 1099511628211ull;
+		}
+	}
+	const uint64_t key = (uint64_t(pass) << 56)
+		| (index(_programs, uint64_t(program.id()), 8) << 48)
+		| (index(_textureSets, texturesHash, 12) << 36)
+		| (index(_vertexArrays, uint64_t(object.vertexArray(positionsOnly)), 12) << 24)
+		| quantizeDepth(depth);
+	
+	_items.push_back(item);
+	_keys.push_back(key);
+	++_statistics[pass].items;
+	return &_items.back();
+}
+
+RenderQueue::Item * RenderQueue::submit(Pass pass, const ProgramInfos & program, const MeshInfos & mesh, float depth){
+	Item item;
+	item.program = &program;
+	item.vertexArray = mesh.vId;
+	item.count = GLsizei(mesh.count);
+	item.indexType = mesh.indexType;
+	const uint64_t key = (uint64_t(pass) << 56)
+		| (index(_programs, uint64_t(program.id()), 8) << 48)
+		| (index(_vertexArrays, uint64_t(mesh.vId), 12) << 24)
+		| quantizeDepth(depth);
+	
+	_items.push_back(item);
+	_keys.push_back(key);
+	++_statistics[pass].items;
+	return &_items.back();
+}
+
+void RenderQueue::sort(){
+	const size_t count = _keys.size();
+	_sortedKeys = _keys;
+	_order.resize(count);
+	for(size_t iid = 0; iid < count; ++iid){
+		_order[iid] = uint32_t(iid);
+	}
+	_scratchKeys.resize(count);
+	_scratchOrder.resize(count);
+	
+	// Least significant digit radix sort, one byte at a time. The sort is stable, items with equal keys stay in submission order.
+	for(unsigned int shift = 0; shift < 64; shift += 8){
+		size_t offsets[256] = {0};
+		for(const uint64_t key : _sortedKeys){
+			++offsets[(key >> shift) & 0xFF];
+		}
+		// Skip the bytes shared by all keys, such as the pass or unused state indices.
+		if(count == 0 || offsets[(_sortedKeys[0] >> shift) & 0xFF] == count){
+			continue;
+		}
+		size_t total = 0;
+		for(size_t bid = 0; bid < 256; ++bid){
+			const size_t bucketCount = offsets[bid];
+			offsets[bid] = total;
+			total += bucketCount;
+		}
+		for(size_t kid = 0; kid < count; ++kid){
+			const size_t destination = offsets[(_sortedKeys[kid] >> shift) & 0xFF]++;
+			_scratchKeys[destination] = _sortedKeys[kid];
+			_scratchOrder[destination] = _order[kid];
+		}
+		std::swap(_sortedKeys, _scratchKeys);
+		std::swap(_order, _scratchOrder);
+	}
+}
+
+bool RenderQueue::mergeable(const Item & item, const Item & previous){
+	if(!item.object || !previous.object || item.program != previous.program || item.positionsOnly != previous.positionsOnly){
+		return false;
+	}
+	if(item.mask != previous.mask || item.parameters != previous.parameters || item.matrix != previous.matrix){
+		return false;
+	}
+	return item.object->sharesDrawState(*previous.object, item.positionsOnly);
+}
+
+void RenderQueue::appendRanges(const Item & item){
+	for(size_t rid = item.firstRange; rid < item.firstRange + item.rangeCount; ++rid){
+		const size_t firstIndex = size_t(_ranges.offsets[rid]) / item.indexSize;
+		_mergedRanges.append(firstIndex, size_t(_ranges.counts[rid]), item.indexSize, _ranges.baseVertices[rid]);
+	}
+}
+
+void RenderQueue::flush(const Item & item){
+	if(!item.object){
+		GLUtilities::bindVertexArray(item.vertexArray);
+		GLUtilities::drawElements(item.count, item.indexType, 0, 0);
+		return;
+	}
+	if(item.positionsOnly){
+		item.object->drawPositions(_mergedRanges);
+	} else {
+		item.object->drawGeometry(_mergedRanges);
+	}
+	_mergedRanges.clear();
+}
+
+bool RenderQueue::instanceable(const Item & item, const Item & first) const {
+	if(item.program != first.program || item.instancedProgram != first.instancedProgram || item.positionsOnly != first.positionsOnly){
+		return false;
+	}
+	if(item.mask != first.mask || item.parameters != first.parameters || item.rangeCount != first.rangeCount){
+		return false;
+	}
+	if(item.object->vertexArray(item.positionsOnly) != first.object->vertexArray(first.positionsOnly) || item.indexSize != first.indexSize){
+		return false;
+	}
+	if(item.textured && !item.object->sharesTextures(*first.object)){
+		return false;
+	}
+	for(size_t rid = 0; rid < item.rangeCount; ++rid){
+		const size_t itemRange = item.firstRange + rid;
+		const size_t firstRange = first.firstRange + rid;
+		if(_ranges.counts[itemRange] != _ranges.counts[firstRange] || _ranges.offsets[itemRange] != _ranges.offsets[firstRange] || _ranges.baseVertices[itemRange] != _ranges.baseVertices[firstRange]){
+			return false;
+		}
+	}
+	return true;
+}
+
+void RenderQueue::prepareInstances(size_t begin, size_t end){
+	static const uint32_t noGroup = ~0u;
+	const size_t count = end - begin;
+	_instances.clear();
+	_instanceGroups.clear();
+	_instanced.assign(count, 0);
+	_groupOfItem.assign(count, noGroup);
+	_candidates.clear();
+	_candidateCounts.clear();
+	
+	// Items sharing their program, textures and vertex array are contiguous once sorted, look for items rendering the same geometry in each run.
+	size_t runStart = begin;
+	while(runStart < end){
+		const uint64_t state = _sortedKeys[runStart] >> 24;
+		size_t runEnd = runStart + 1;
+		while(runEnd < end && (_sortedKeys[runEnd] >> 24) == state){
+			++runEnd;
+		}
+		_candidateIndices.clear();
+		for(size_t kid = runStart; kid < runEnd; ++kid){
+			const Item & item = _items[_order[kid]];
+			if(!item.object || !item.instancedProgram){
+				continue;
+			}
+			const uint64_t signature = item.rangesHash ^ (uint64_t(uint32_t(item.mask)) * 0x9E3779B97F4A7C15ull);
+			const auto existing = _candidateIndices.find(signature);
+			if(existing == _candidateIndices.end()){
+				_candidateIndices[signature] = uint32_t(_candidates.size());
+				_groupOfItem[kid - begin] = uint32_t(_candidates.size());
+				_candidates.push_back(uint32_t(kid));
+				_candidateCounts.push_back(1);
+				continue;
+			}
+			// Hash collisions and saturated key indices are detected by comparing with the first item.
+			if(!instanceable(item, _items[_order[_candidates[existing->second]]])){
+				continue;
+			}
+			_groupOfItem[kid - begin] = existing->second;
+			++_candidateCounts[existing->second];
+		}
+		runStart = runEnd;
+	}
+	
+	// Only candidates with several items are instanced. The counts are replaced by the position of the next instance of each group.
+	size_t instanceCount = 0;
+	for(size_t cid = 0; cid < _candidates.size(); ++cid){
+		if(_candidateCounts[cid] < 2){
+			_candidateCounts[cid] = SIZE_MAX;
+			continue;
+		}
+		_instanceGroups.push_back({_order[_candidates[cid]], instanceCount, _candidateCounts[cid]});
+		const size_t groupCount = _candidateCounts[cid];
+		_candidateCounts[cid] = instanceCount;
+		instanceCount += groupCount;
+	}
+	if(instanceCount == 0){
+		return;
+	}
+	_instances.resize(instanceCount);
+	for(size_t kid = begin; kid < end; ++kid){
+		const uint32_t group = _groupOfItem[kid - begin];
+		if(group == noGroup || _candidateCounts[group] == SIZE_MAX){
+			continue;
+		}
+		const Object & object = *_items[_order[kid]].object;
+		Instance & instance = _instances[_candidateCounts[group]++];
+		instance.model = object.vertexModel();
+		instance.normalMatrix = object.normalMatrix();
+		instance.material = int32_t(object.materialLayer());
+		_instanced[kid - begin] = 1;
+	}
+	
+	// Upload all instances of the pass at once, orphaning the previous storage.
+	const size_t size = _instances.size() * sizeof(Instance);
+	if(_instanceBuffer == 0){
+		glGenBuffers(1, &_instanceBuffer);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, _instanceBuffer);
+	_instanceBufferSize = std::max(_instanceBufferSize, size);
+	glBufferData(GL_ARRAY_BUFFER, _instanceBufferSize, nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, size, _instances.data());
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+size_t RenderQueue::drawInstances(const InstanceGroup & group){
+	const Item & item = _items[group.item];
+	GLUtilities::bindVertexArray(item.object->vertexArray(item.positionsOnly));
+	
+	// Point the per-instance attributes of the vertex array to the group instances.
+	const size_t stride = sizeof(Instance);
+	const size_t offset = group.firstInstance * stride;
+	glBindBuffer(GL_ARRAY_BUFFER, _instanceBuffer);
+	for(GLuint cid = 0; cid < 4; ++cid){
+		glEnableVertexAttribArray(3 + cid);
+		glVertexAttribPointer(3 + cid, 4, GL_FLOAT, GL_FALSE, GLsizei(stride), (void*)(offset + cid * sizeof(glm::vec4)));
+		glVertexAttribDivisor(3 + cid, 1);
+	}
+	for(GLuint cid = 0; cid < 3; ++cid){
+		glEnableVertexAttribArray(7 + cid);
+		glVertexAttribPointer(7 + cid, 3, GL_FLOAT, GL_FALSE, GLsizei(stride), (void*)(offset + sizeof(glm::mat4) + cid * sizeof(glm::vec3)));
+		glVertexAttribDivisor(7 + cid, 1);
+	}
+	glEnableVertexAttribArray(10);
+	glVertexAttribIPointer(10, 1, GL_INT, GLsizei(stride), (void*)(offset + sizeof(glm::mat4) + sizeof(glm::mat3)));
+	glVertexAttribDivisor(10, 1);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	
+	// All instances render the ranges of the first item.
+	appendRanges(item);
+	const GLenum indexType = item.indexSize == sizeof(GLushort) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	const size_t calls = GLUtilities::drawElementsInstanced(_mergedRanges.counts, indexType, _mergedRanges.offsets, _mergedRanges.baseVertices, GLsizei(group.count));
+	_mergedRanges.clear();
+	return calls;
+}
+
+void RenderQueue::clean() const {
+	if(_instanceBuffer != 0){
+		glDeleteBuffers(1, &_instanceBuffer);
+	}
+}
+
+void RenderQueue::resetStatistics(){
+	for(Statistics & stats : _statistics){
+		stats = Statistics();
+	}
+}
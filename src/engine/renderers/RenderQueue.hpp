@@ -0,0 +1,311 @@
+#ifndef RenderQueue_h
+#define RenderQueue_h
+#include "../Common.hpp"
+#include "../Object.hpp"
+#include <unordered_map>
+#include <algorithm>
+#include <type_traits>
+
+/**
+ \brief Collect the draws of a frame with packed sort keys, and render them sorted to minimize state changes.
+ \details Each item key packs, from the most to the least significant bits: the pass (8 bits), the program (8 bits), the set of textures (12 bits), the vertex array (12 bits) and the depth (24 bits). Programs, texture sets and vertex arrays are mapped to small indices in the order they are first submitted. Items are sorted with a radix sort on their keys, and successive items sharing their draw state are merged in a single multi-draw call. Redundant program, texture and vertex array binds are skipped.
+
+ When a pass is executed with instancing, objects sharing their program, textures, vertex array and rendered ranges but placed differently are grouped. Their transformations and material layers are written in a shared instance buffer, and each group is rendered in a single instanced call with the item instanced program. Materials stored in the same texture arrays are thus rendered together.
+ \ingroup Renderers
+ */
+class RenderQueue {
+
+public:
+
+	/// \brief Passes of a frame, stored in the highest bits of the keys.
+	enum Pass : unsigned int {
+		Shadow = 0, ///< Depth rendering in shadow maps.
+		Gbuffer = 1, ///< Objects rendering in the G-buffer.
+		Debug = 2, ///< Debug meshes, rendered over the G-buffer.
+		Count = 3 ///< Number of passes.
+	};
+	
+	/// \brief A draw submitted to the queue.
+	struct Item {
+		const ProgramInfos * program = nullptr; ///< The program to render with.
+		const ProgramInfos * instancedProgram = nullptr; ///< The program to render the object with when grouped with other instances, or null.
+		const Object * object = nullptr; ///< The object to render, or null for a raw mesh.
+		GLuint vertexArray = 0; ///< The vertex array of a raw mesh.
+		GLsizei count = 0; ///< The number of indices of a raw mesh.
+		GLenum indexType = GL_UNSIGNED_INT; ///< The type of the indices of a raw mesh.
+		const Object::DrawUniforms * uniforms = nullptr; ///< Transformations of an object prepared ahead of submission, for the pass to upload.
+		glm::mat4 matrix = glm::mat4(1.0f); ///< A per-item transformation, for the pass to upload.
+		glm::vec4 parameters = glm::vec4(0.0f); ///< Per-item parameters, for the pass to upload.
+		int mask = 0; ///< Per-item flags, for the pass to upload.
+		size_t firstRange = 0; ///< The first element buffer range of an object in the queue storage.
+		size_t rangeCount = 0; ///< The number of element buffer ranges of an object.
+		size_t indexSize = 0; ///< The size in bytes of the object indices.
+		uint64_t rangesHash = 0; ///< Hash of the object ranges, to identify instances rendering the same geometry.
+		bool positionsOnly = false; ///< Should the position-only geometry of an object be rendered.
+		bool textured = false; ///< Should the textures of the object be bound.
+	};
+	
+	/// \brief Draws and state changes of a pass.
+	struct Statistics {
+		size_t items = 0; ///< Number of items submitted.
+		size_t drawCalls = 0; ///< Number of draw calls, a multi-draw counting as one.
+		size_t programBinds = 0; ///< Number of programs bound.
+		size_t textureBinds = 0; ///< Number of texture sets bound.
+		size_t vertexArrayBinds = 0; ///< Number of vertex array binds sent to the driver.
+		size_t instances = 0; ///< Number of items rendered in instanced calls.
+	};
+	
+	/// \brief Per-instance data, read by instanced programs from vertex attributes 3 to 10.
+	struct Instance {
+		glm::mat4 model; ///< Model transformation, including the positions dequantization (locations 3 to 6).
+		glm::mat3 normalMatrix; ///< Normal transformation to world space (locations 7 to 9).
+		int32_t material; ///< Layer of the material in the texture arrays (location 10).
+	};
+	
+	/** Remove all items, keeping the mapping of states to key indices. */
+	void clear();
+	
+	/** Query the ranges of the next object to submit, to fill with its levels of detail or visible clusters.
+	 \return the ranges, emptied when the object is submitted
+	 */
+	Object::DrawRanges & ranges(){ return _pendingRanges; }
+	
+	/** Submit an object, along with the ranges filled since the last submission.
+	 \param pass the pass to render the object in
+	 \param program the program to render with
+	 \param object the object to render
+	 \param depth the distance to the viewpoint, for front-to-back sorting
+	 \param positionsOnly should the position-only geometry be rendered, without textures
+	 \return the submitted item, to fill per-item values, valid until the next submission
+	 \note If no ranges were filled, the item is skipped and null is returned.
+	 */
+	Item * submit(Pass pass, const ProgramInfos & program, const Object & object, float depth, bool positionsOnly);
+	
+	/** Submit an object with ranges prepared separately, for instance on another thread.
+	 \param pass the pass to render the object in
+	 \param program the program to render with
+	 \param object the object to render
+	 \param ranges the ranges to render, copied in the queue
+	 \param depth the distance to the viewpoint, for front-to-back sorting
+	 \param positionsOnly should the position-only geometry be rendered, without textures
+	 \return the submitted item, to fill per-item values, valid until the next submission
+	 \note If the ranges are empty, the item is skipped and null is returned.
+	 */
+	Item * submit(Pass pass, const ProgramInfos & program, const Object & object, const Object::DrawRanges & ranges, float depth, bool positionsOnly);
+	
+	/** Submit a raw mesh, rendered in full with no textures.
+	 \param pass the pass to render the mesh in
+	 \param program the program to render with
+	 \param mesh the mesh to render
+	 \param depth the distance to the viewpoint, for front-to-back sorting
+	 \return the submitted item, to fill per-item values, valid until the next submission
+	 */
+	Item * submit(Pass pass, const ProgramInfos & program, const MeshInfos & mesh, float depth);
+	
+	/** Sort the submitted items by key. */
+	void sort();
+	
+	/** Render the sorted items of a pass, skipping redundant binds and merging successive items sharing their draw state.
+	 \param pass the pass to render
+	 \param setup will be called with the program, the item and a flag denoting if the program was just bound, before each draw call, to upload the per-item uniforms
+	 \note The object transformations and textures are not uploaded by the queue.
+	 */
+	template<typename Setup>
+	void execute(Pass pass, const Setup & setup){ execute(pass, setup, NoInstancing()); }
+	
+	/** Render the sorted items of a pass, grouping objects that can be instanced, skipping redundant binds and merging successive items sharing their draw state.
+	 \param pass the pass to render
+	 \param setup will be called with the program, the item and a flag denoting if the program was just bound, before each regular draw call, to upload the per-item uniforms
+	 \param setupInstanced will be called with the instanced program, the first item of a group and a flag denoting if the program was just bound, before each instanced draw call, to upload the uniforms shared by the instances
+	 \note Groups of instances are rendered after the other items of the pass.
+	 */
+	template<typename Setup, typename SetupInstanced>
+	void execute(Pass pass, const Setup & setup, const SetupInstanced & setupInstanced);
+	
+	/** Query the draws and state changes of a pass since the last reset.
+	 \param pass the pass
+	 \return the counters
+	 */
+	const Statistics & statistics(Pass pass) const { return _statistics[pass]; }
+	
+	/** Reset the counters of all passes. */
+	void resetStatistics();
+	
+	/** Enable or disable the grouping of instances when executing passes.
+	 \param enabled should objects be instanced when possible
+	 */
+	void setInstancing(bool enabled){ _instancing = enabled; }
+	
+	/** Clean internal resources. */
+	void clean() const;
+
+private:
+
+	/// \brief Disable instancing when executing a pass.
+	struct NoInstancing {
+		void operator()(const ProgramInfos &, const Item &, bool) const {}
+	};
+	
+	/// \brief Objects rendered in a single instanced call.
+	struct InstanceGroup {
+		uint32_t item; ///< The first item of the group.
+		size_t firstInstance; ///< The position of the first instance in the instance buffer.
+		size_t count; ///< The number of instances.
+	};
+	
+	/** Map a state to a small index, assigned in order of first appearance.
+	 \param indices the indices of the states of the same kind
+	 \param state the state identifier
+	 \param bits the number of bits available in the key
+	 \return the index, saturated to the available bits
+	 */
+	static uint64_t index(std::unordered_map<uint64_t, uint64_t> & indices, uint64_t state, unsigned int bits);
+	
+	/** Test if two successive items can be rendered in a single draw call.
+	 \param item the new item
+	 \param previous the previous item
+	 \return true if both use the same program, per-item values and object draw state
+	 */
+	static bool mergeable(const Item & item, const Item & previous);
+	
+	/** Append the ranges of an object item to the ranges rendered in the next draw call, merging contiguous ones.
+	 \param item the item
+	 */
+	void appendRanges(const Item & item);
+	
+	/** Issue the draw call for the merged ranges of the current items.
+	 \param item the last item
+	 */
+	void flush(const Item & item);
+	
+	/** Test if two items render the same geometry with the same state, and can be instanced in the same call.
+	 \param item the item
+	 \param first the first item of a group
+	 \return true if the item can be added to the group
+	 */
+	bool instanceable(const Item & item, const Item & first) const;
+	
+	/** Group the items of a pass that can be instanced, and upload their instance data.
+	 \param begin the position of the first item of the pass in the sorted keys
+	 \param end the position after the last item of the pass
+	 */
+	void prepareInstances(size_t begin, size_t end);
+	
+	/** Render a group of instances, the program and textures should already be bound.
+	 \param group the group
+	 \return the number of draw calls issued
+	 */
+	size_t drawInstances(const InstanceGroup & group);
+	
+	std::vector<Item> _items; ///< The submitted items.
+	std::vector<uint64_t> _keys; ///< Sort key of each item, in submission order.
+	std::vector<uint64_t> _sortedKeys; ///< The keys in increasing order, after sort().
+	std::vector<uint32_t> _order; ///< Item indices, sorted by key after sort().
+	std::vector<uint64_t> _scratchKeys; ///< Scratch keys for the radix sort.
+	std::vector<uint32_t> _scratchOrder; ///< Scratch indices for the radix sort.
+	Object::DrawRanges _ranges; ///< The ranges of all submitted objects.
+	Object::DrawRanges _pendingRanges; ///< The ranges of the next object to submit.
+	Object::DrawRanges _mergedRanges; ///< The ranges of successive items rendered in a single call.
+	
+	std::vector<Instance> _instances; ///< The instance data of the executed pass.
+	std::vector<InstanceGroup> _instanceGroups; ///< The groups of instances of the executed pass.
+	std::vector<unsigned char> _instanced; ///< Is each sorted item of the executed pass rendered in a group.
+	std::vector<uint32_t> _groupOfItem; ///< Candidate group of each sorted item of the executed pass.
+	std::vector<uint32_t> _candidates; ///< First item of each candidate group, as a sorted position.
+	std::vector<size_t> _candidateCounts; ///< Number of items in each candidate group.
+	std::unordered_map<uint64_t, uint32_t> _candidateIndices; ///< Candidate group of each geometry signature in a run of items.
+	GLuint _instanceBuffer = 0; ///< The buffer storing the instance data.
+	size_t _instanceBufferSize = 0; ///< The size in bytes of the instance buffer.
+	bool _instancing = true; ///< Should objects be instanced when possible.
+	
+	std::unordered_map<uint64_t, uint64_t> _programs; ///< Key index of each program.
+	std::unordered_map<uint64_t, uint64_t> _textureSets; ///< Key index of each set of textures.
+	std::unordered_map<uint64_t, uint64_t> _vertexArrays; ///< Key index of each vertex array.
+	
+	Statistics _statistics[Pass::Count]; ///< Counters of each pass.
+
+};
+
+template<typename Setup, typename SetupInstanced>
+void RenderQueue::execute(Pass pass, const Setup & setup, const SetupInstanced & setupInstanced){
+	Statistics & stats = _statistics[pass];
+	const size_t vertexArrayBinds = GLUtilities::statistics().vertexArrayBinds;
+	const ProgramInfos * currentProgram = nullptr;
+	const Object * currentTextures = nullptr;
+	const Item * pending = nullptr;
+	
+	// The items of the pass are contiguous once sorted.
+	const uint64_t passKey = uint64_t(pass) << 56;
+	const size_t begin = size_t(std::lower_bound(_sortedKeys.begin(), _sortedKeys.end(), passKey) - _sortedKeys.begin());
+	size_t end = begin;
+	while(end < _sortedKeys.size() && (_sortedKeys[end] >> 56) == uint64_t(pass)){
+		++end;
+	}
+	const bool instancing = _instancing && !std::is_same<SetupInstanced, NoInstancing>::value;
+	if(instancing){
+		prepareInstances(begin, end);
+	}
+	
+	for(size_t kid = begin; kid < end; ++kid){
+		if(instancing && _instanced[kid - begin]){
+			continue;
+		}
+		const Item & item = _items[_order[kid]];
+		if(pending && mergeable(item, *pending)){
+			appendRanges(item);
+			pending = &item;
+			continue;
+		}
+		if(pending){
+			flush(*pending);
+			++stats.drawCalls;
+		}
+		pending = &item;
+		
+		// Only bind the states that changed since the previous draw.
+		const bool programChanged = item.program != currentProgram;
+		if(programChanged){
+			GLUtilities::useProgram(item.program->id());
+			currentProgram = item.program;
+			++stats.programBinds;
+		}
+		if(item.textured && !(currentTextures && item.object->sharesTextures(*currentTextures))){
+			item.object->bindTextures();
+			currentTextures = item.object;
+			++stats.textureBinds;
+		}
+		setup(*item.program, item, programChanged);
+		appendRanges(item);
+	}
+	if(pending){
+		flush(*pending);
+		++stats.drawCalls;
+	}
+	
+	if(instancing){
+		for(const InstanceGroup & group : _instanceGroups){
+			const Item & item = _items[group.item];
+			const bool programChanged = item.instancedProgram != currentProgram;
+			if(programChanged){
+				GLUtilities::useProgram(item.instancedProgram->id());
+				currentProgram = item.instancedProgram;
+				++stats.programBinds;
+			}
+			if(item.textured && !(currentTextures && item.object->sharesTextures(*currentTextures))){
+				item.object->bindTextures();
+				currentTextures = item.object;
+				++stats.textureBinds;
+			}
+			setupInstanced(*item.instancedProgram, item, programChanged);
+			stats.drawCalls += drawInstances(group);
+			stats.instances += group.count;
+		}
+	}
+	
+	if(currentProgram){
+		GLUtilities::useProgram(0);
+	}
+	stats.vertexArrayBinds += GLUtilities::statistics().vertexArrayBinds - vertexArrayBinds;
+}
+
+#endif
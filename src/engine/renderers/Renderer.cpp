@@ -13,9 +13,27 @@ Renderer::Renderer(Config & config) : _config(config) {
 }
 
 
+void Renderer::draw(){
+	if(_resizePending){
+		resize(_pendingSize[0], _pendingSize[1]);
+		_resizePending = false;
+	}
+}
+
+
 void Renderer::update(){
 	if(Input::manager().resized()){
-		resize((unsigned int)Input::manager().size()[0], (unsigned int)Input::manager().size()[1]);
+		_requestedSize = glm::uvec2(Input::manager().size());
+		_resizeRequested = true;
+	}
+}
+
+
+void Renderer::exchange(){
+	if(_resizeRequested){
+		_pendingSize = _requestedSize;
+		_resizePending = true;
+		_resizeRequested = false;
 	}
 }
 
@@ -34,13 +52,13 @@ void Renderer::updateResolution(unsigned int width, unsigned int height){
 
 void Renderer::defaultGLSetup(){
 	// Default GL setup.
-	glDisable(GL_DEPTH_TEST);
-	glEnable(GL_CULL_FACE);
+	GLUtilities::setEnabled(GL_DEPTH_TEST, false);
+	GLUtilities::setEnabled(GL_CULL_FACE, true);
 	glFrontFace(GL_CCW);
-	glCullFace(GL_BACK);
+	GLUtilities::setCullFace(GL_BACK);
 	glBlendEquation(GL_FUNC_ADD);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+	GLUtilities::setBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLUtilities::setEnabled(GL_TEXTURE_CUBE_MAP_SEAMLESS, true);
 }
 
 Renderer::~Renderer(){
@@ -16,10 +16,12 @@ public:
 	 */
 	Renderer(Config & config);
 	
-	/** Draw the scene and effects */
-	virtual void draw() = 0;
+	/** Draw the scene and effects, with the GL context. The base implementation applies the resize handed over by exchange().
+	 \note Can be called on a rendering thread, while update() and physics() prepare the next frame: only the state handed over by exchange() should be read.
+	 */
+	virtual void draw();
 	
-	/** Perform once-per-frame update (buttons, GUI,...) */
+	/** Perform once-per-frame update (buttons, GUI,...). No GL call should be performed, window resizes are applied by draw(). */
 	virtual void update();
 	
 	/** Perform physics simulation update.
@@ -29,6 +31,9 @@ public:
 	 */
 	virtual void physics(double fullTime, double frameTime) = 0;
 	
+	/** Hand the state modified by update() and physics() over to draw(), and the statistics of the last frame drawn back to the interface. Called once per frame before draw(), while no frame is being drawn. */
+	virtual void exchange();
+	
 	/** Clean internal resources. */
 	virtual void clean() const;
 	
@@ -57,6 +62,11 @@ private:
 	/** Default OpenGL states setup. */
 	void defaultGLSetup();
 	
+	glm::uvec2 _requestedSize = glm::uvec2(0); ///< Window size received by update().
+	glm::uvec2 _pendingSize = glm::uvec2(0); ///< Window size handed over to draw().
+	bool _resizeRequested = false; ///< Has the window been resized since the last exchange.
+	bool _resizePending = false; ///< Should draw() resize the renderer.
+	
 };
 
 #endif
@@ -59,7 +59,7 @@ GLuint AmbientQuad::setupSSAO(){
 	// Send the texture to the GPU.
 	GLuint textureId;
 	glGenTextures(1, &textureId);
-	glBindTexture(GL_TEXTURE_2D, textureId);
+	GLUtilities::bindTexture(0, GL_TEXTURE_2D, textureId);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, 5 , 5, 0, GL_RGB, GL_FLOAT, &(noise[0]));
 	// Need nearest filtering and repeat.
 	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);
@@ -76,15 +76,13 @@ void AmbientQuad::draw(const glm::mat4& viewMatrix, const glm::mat4& projectionM
 	// Store the four variable coefficients of the projection matrix.
 	glm::vec4 projectionVector = glm::vec4(projectionMatrix[0][0], projectionMatrix[1][1], projectionMatrix[2][2], projectionMatrix[3][2]);
 	
-	glUseProgram(_program->id());
+	GLUtilities::useProgram(_program->id());
 	
 	glUniformMatrix4fv(_program->uniform("inverseV"), 1, GL_FALSE, &invView[0][0]);
 	glUniform4fv(_program->uniform("projectionMatrix"), 1, &(projectionVector[0]));
 	// Cubemaps.
-	glActiveTexture(GL_TEXTURE0 + (unsigned int)_textures.size());
-	glBindTexture(GL_TEXTURE_CUBE_MAP, _textureEnv);
-	glActiveTexture(GL_TEXTURE0 + (unsigned int)_textures.size() + 1);
-	glBindTexture(GL_TEXTURE_2D, _textureBrdf);
+	GLUtilities::bindTexture((unsigned int)_textures.size(), GL_TEXTURE_CUBE_MAP, _textureEnv);
+	GLUtilities::bindTexture((unsigned int)_textures.size() + 1, GL_TEXTURE_2D, _textureBrdf);
 	
 	ScreenQuad::draw(_textures);
 	checkGLError();
@@ -92,7 +90,7 @@ void AmbientQuad::draw(const glm::mat4& viewMatrix, const glm::mat4& projectionM
 
 void AmbientQuad::drawSSAO(const glm::mat4& projectionMatrix) const {
 	
-	glUseProgram(_programSSAO->id());
+	GLUtilities::useProgram(_programSSAO->id());
 	
 	glUniformMatrix4fv(_programSSAO->uniform("projectionMatrix"), 1, GL_FALSE, &projectionMatrix[0][0]);
 	
@@ -4,6 +4,7 @@
 #include "../../lights/PointLight.hpp"
 #include "../../lights/SpotLight.hpp"
 #include "../../helpers/InterfaceUtilities.hpp"
+#include "../../helpers/TaskScheduler.hpp"
 
 
 DeferredRenderer::DeferredRenderer(Config & config) : Renderer(config) {
@@ -36,14 +37,16 @@ DeferredRenderer::DeferredRenderer(Config & config) : Renderer(config) {
 	
 	_blurBuffer = std::make_shared<GaussianBlur>(renderPow2Size, renderPow2Size, 2, GL_RGB16F);
 	_blurSSAOBuffer = std::make_shared<BoxBlur>(renderHalfWidth, renderHalfHeight, true, Framebuffer::Descriptor(GL_R8));
+	// Shadow maps of all directional and spot lights.
+	_shadowAtlas = std::make_shared<ShadowAtlas>(2048, 128, 1024);
 	
 	checkGLError();
 
 	// GL options
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_CULL_FACE);
+	GLUtilities::setEnabled(GL_DEPTH_TEST, true);
+	GLUtilities::setEnabled(GL_CULL_FACE, true);
 	glBlendEquation (GL_FUNC_ADD);
-	glBlendFunc(GL_ONE, GL_ONE);
+	GLUtilities::setBlendFunc(GL_ONE, GL_ONE);
 	
 	_bloomProgram = Resources::manager().getProgram2D("bloom");
 	_toneMappingProgram = Resources::manager().getProgram2D("tonemap");
@@ -68,25 +71,29 @@ void DeferredRenderer::setScene(std::shared_ptr<Scene> scene){
 		return;
 	}
 	_scene->init();
+	_scene->updateBounds();
 	
 	_ambientScreen.setSceneParameters(_scene->backgroundReflection, _scene->backgroundIrradiance);
 	
 	std::vector<GLuint> includedTextures = _gbuffer->textureIds();
 	includedTextures.insert(includedTextures.begin()+2, _gbuffer->depthId());
+	std::vector<GLuint> shadowedTextures = includedTextures;
+	shadowedTextures.push_back(_shadowAtlas->textureId());
 	
 	for(auto& dirLight : _scene->directionalLights){
-		dirLight.init(includedTextures);
+		dirLight.init(shadowedTextures);
 	}
 	for(auto& pointLight : _scene->pointLights){
 		pointLight.init(includedTextures);
 	}
 	for(auto& spotLight : _scene->spotLights){
-		spotLight.init(includedTextures);
+		spotLight.init(shadowedTextures);
 	}
 	checkGLError();
 }
 
 void DeferredRenderer::draw() {
+	Renderer::draw();
 	
 	if(!_scene){
 		glClearColor(0.2f,0.2,0.2f, 1.0f);
@@ -94,26 +101,48 @@ void DeferredRenderer::draw() {
 		return;
 	}
 	
-	// Interface.
-	/// \todo Move to a separate function maybe?
-	if(ImGui::Begin("Renderer")){
-		ImGui::Checkbox("Show debug", &_debugVisualization);
-	}
-	ImGui::End();
-	
 	glm::vec2 invRenderSize = 1.0f / _renderResolution;
 	
 	// --- Light pass -------
 	
+	// World space bounding boxes of all objects, maintained by the scene when objects move.
+	const size_t objectCount = _scene->objects.size();
+	const BoundingBoxArray & objectBoxes = _scene->objectBoxes();
+	
 	// Draw the scene inside the framebuffer.
+	_shadowClusterStats = Object::ClusterStatistics();
+	_renderQueue.resetStatistics();
+	_renderQueue.setInstancing(_frameSettings.instancing);
+	Object::ClusterStatistics * shadowClusters = _frameSettings.cullClusters ? &_shadowClusterStats : nullptr;
+	_shadowCasters = 0;
+	// Directional and spot lights share an atlas, where each light region is sized by its importance for the camera.
+	_shadowAtlas->clear();
 	for(auto& dirLight : _scene->directionalLights){
-		dirLight.drawShadow(_scene->objects);
+		if(dirLight.castsShadow()){
+			_shadowAtlas->request(dirLight, 1.0f);
+		}
 	}
-	for(auto& shadowLight : _scene->spotLights){
-		shadowLight.drawShadow(_scene->objects);
+	for(auto& spotLight : _scene->spotLights){
+		if(spotLight.castsShadow()){
+			_shadowAtlas->request(spotLight, ShadowAtlas::importance(spotLight.position(), spotLight.radius(), _frameCamera.position()));
+		}
 	}
-	for(auto& pointLight : _scene->pointLights){
-		pointLight.drawShadow(_scene->objects);
+	_shadowAtlas->allocate();
+	_shadowAtlas->begin();
+	for(auto& dirLight : _scene->directionalLights){
+		if(!dirLight.castsShadow() || !dirLight.hasShadowRegion()){
+			continue;
+		}
+		_scene->objectsInFrustum(Frustum(dirLight.shadowViewProjection()), _shadowCandidates);
+		_shadowCasters += dirLight.drawShadow(_renderQueue, _scene->objects, objectBoxes, _shadowCandidates, _frameSettings.lodShadowPixelError, shadowClusters);
+	}
+	// Point and spot lights only consider the objects intersecting their volume.
+	for(size_t lid = 0; lid < _scene->spotLights.size(); ++lid){
+		_shadowCasters += _scene->spotLights[lid].drawShadow(_renderQueue, _scene->objects, objectBoxes, _scene->spotLightObjects(lid), _frameSettings.lodShadowPixelError, shadowClusters);
+	}
+	_shadowAtlas->end();
+	for(size_t lid = 0; lid < _scene->pointLights.size(); ++lid){
+		_shadowCasters += _scene->pointLights[lid].drawShadow(_renderQueue, _scene->objects, objectBoxes, _scene->pointLightObjects(lid), _frameSettings.lodShadowPixelError, shadowClusters);
 	}
 	// ----------------------
 	
@@ -126,46 +155,99 @@ void DeferredRenderer::draw() {
 	// Clear the depth buffer (we know we will draw everywhere, no need to clear color.
 	glClear(GL_DEPTH_BUFFER_BIT);
 	
-	for(auto & object : _scene->objects){
-		object.draw(_userCamera.view(), _userCamera.projection());
+	// Size of a world unit at unit distance in pixels, for levels of detail selection.
+	const float pixelsPerUnit = 0.5f * _renderResolution[1] * _frameCamera.projection()[1][1];
+	const glm::mat4 viewProjection = _frameCamera.projection() * _frameCamera.view();
+	// Test the objects against the camera frustum, through the scene hierarchy of bounds.
+	if(_frameSettings.cullObjects){
+		_visibleObjects = _scene->cullObjects(_frameCamera.frustum(), _objectVisibility);
+	} else {
+		_objectVisibility.assign(objectCount, 1);
+		_visibleObjects = objectCount;
 	}
 	
-	if(_debugVisualization){
-		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-		glDisable(GL_CULL_FACE);
+	// Levels of detail, clusters and transformations of the visible objects are prepared on the scheduler threads, and only submitted here.
+	prepare(pixelsPerUnit);
+	
+	_clusterStats = Object::ClusterStatistics();
+	_renderQueue.clear();
+	_impostorCount = 0;
+	const glm::mat4 & view = _frameCamera.view();
+	const glm::mat4 & projection = _frameCamera.projection();
+	for(size_t vid = 0; vid < _visibleList.size(); ++vid){
+		const Object & object = _scene->objects[_visibleList[vid]];
+		const PreparedDraw & prepared = _preparedDraws[vid];
+		// Objects small on screen are replaced by their impostor, rendered directly with its own program.
+		if(prepared.impostor){
+			object.drawImpostor(view, projection);
+			++_impostorCount;
+			continue;
+		}
+		_clusterStats.total += prepared.clusters.total;
+		_clusterStats.drawn += prepared.clusters.drawn;
+		// Objects are grouped by state, and then sorted front-to-back.
+		RenderQueue::Item * item = _renderQueue.submit(RenderQueue::Gbuffer, object.program(), object, prepared.ranges, prepared.depth, false);
+		if(item){
+			item->instancedProgram = object.instancedProgram();
+			item->uniforms = &prepared.uniforms;
+		}
+	}
+	if(_frameSettings.debugVisualization){
 		for(auto& pointLight : _scene->pointLights){
-			pointLight.drawDebug(_userCamera.view(), _userCamera.projection());
+			pointLight.submitDebug(_renderQueue, view, projection);
 		}
 		for(auto& dirLight : _scene->directionalLights){
-			dirLight.drawDebug(_userCamera.view(), _userCamera.projection());
+			dirLight.submitDebug(_renderQueue, view, projection);
 		}
 		for(auto& spotLight : _scene->spotLights){
-			spotLight.drawDebug(_userCamera.view(), _userCamera.projection());
+			spotLight.submitDebug(_renderQueue, view, projection);
+		}
+	}
+	_renderQueue.sort();
+	
+	// Successive objects sharing their buffers, transformation and material are rendered in a single call.
+	// Objects sharing their geometry and material are rendered as instances of a single call.
+	_renderQueue.execute(RenderQueue::Gbuffer, [&projection](const ProgramInfos & program, const RenderQueue::Item & item, bool){
+		item.object->uploadUniforms(program, *item.uniforms, projection);
+	}, [&view, &projection, &viewProjection](const ProgramInfos & program, const RenderQueue::Item &, bool programChanged){
+		if(programChanged){
+			glUniformMatrix4fv(program.uniform("vp"), 1, GL_FALSE, &viewProjection[0][0]);
+			glUniformMatrix4fv(program.uniform("view"), 1, GL_FALSE, &view[0][0]);
+			glUniformMatrix4fv(program.uniform("p"), 1, GL_FALSE, &projection[0][0]);
 		}
-		glEnable(GL_CULL_FACE);
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	});
+	
+	if(_frameSettings.debugVisualization){
+		GLUtilities::setPolygonMode(GL_LINE);
+		GLUtilities::setEnabled(GL_CULL_FACE, false);
+		_renderQueue.execute(RenderQueue::Debug, [](const ProgramInfos & program, const RenderQueue::Item & item, bool){
+			glUniformMatrix4fv(program.uniform("mvp"), 1, GL_FALSE, &item.matrix[0][0]);
+			glUniform3fv(program.uniform("lightColor"), 1, &item.parameters[0]);
+		});
+		GLUtilities::setEnabled(GL_CULL_FACE, true);
+		GLUtilities::setPolygonMode(GL_FILL);
 	}
 	
 	// No need to write the skybox depth to the framebuffer.
-	glDepthMask(GL_FALSE);
+	GLUtilities::setDepthMask(false);
 	// Accept a depth of 1.0 (far plane).
-	glDepthFunc(GL_LEQUAL);
+	GLUtilities::setDepthFunc(GL_LEQUAL);
 	// draw background.
-	_scene->background.draw(_userCamera.view(), _userCamera.projection());
-	glDepthFunc(GL_LESS);
-	glDepthMask(GL_TRUE);
+	_scene->background.draw(_frameCamera.view(), _frameCamera.projection());
+	GLUtilities::setDepthFunc(GL_LESS);
+	GLUtilities::setDepthMask(true);
 	
 	
 	// Unbind the full scene framebuffer.
 	_gbuffer->unbind();
 	// ----------------------
 	
-	glDisable(GL_DEPTH_TEST);
+	GLUtilities::setEnabled(GL_DEPTH_TEST, false);
 	
 	// --- SSAO pass
 	_ssaoFramebuffer->bind();
 	_ssaoFramebuffer->setViewport();
-	_ambientScreen.drawSSAO(_userCamera.projection());
+	_ambientScreen.drawSSAO(_frameCamera.projection());
 	_ssaoFramebuffer->unbind();
 	
 	// --- SSAO blurring pass
@@ -175,28 +257,33 @@ void DeferredRenderer::draw() {
 	_sceneFramebuffer->bind();
 	_sceneFramebuffer->setViewport();
 	
-	_ambientScreen.draw(_userCamera.view(), _userCamera.projection());
+	_ambientScreen.draw(_frameCamera.view(), _frameCamera.projection());
 	
-	glEnable(GL_BLEND);
+	GLUtilities::setEnabled(GL_BLEND, true);
 	for(auto& dirLight : _scene->directionalLights){
-		dirLight.draw(_userCamera.view(), _userCamera.projection());
+		dirLight.draw(_frameCamera.view(), _frameCamera.projection());
 	}
-	glCullFace(GL_FRONT);
-	for(auto& pointLight : _scene->pointLights){
-		pointLight.draw(_userCamera.view(), _userCamera.projection(), invRenderSize);
+	GLUtilities::setCullFace(GL_FRONT);
+	// Lights whose volume is outside the camera frustum don't cover any pixel.
+	for(size_t lid = 0; lid < _scene->pointLights.size(); ++lid){
+		if(_pointLightVisibility[lid]){
+			_scene->pointLights[lid].draw(_frameCamera.view(), _frameCamera.projection(), invRenderSize);
+		}
 	}
-	for(auto& spotLight : _scene->spotLights){
-		spotLight.draw(_userCamera.view(), _userCamera.projection(), invRenderSize);
+	for(size_t lid = 0; lid < _scene->spotLights.size(); ++lid){
+		if(_spotLightVisibility[lid]){
+			_scene->spotLights[lid].draw(_frameCamera.view(), _frameCamera.projection(), invRenderSize);
+		}
 	}
-	glCullFace(GL_BACK);
-	glDisable(GL_BLEND);
+	GLUtilities::setCullFace(GL_BACK);
+	GLUtilities::setEnabled(GL_BLEND, false);
 	
 	_sceneFramebuffer->unbind();
 	
 	// --- Bloom selection pass ------
 	_bloomFramebuffer->bind();
 	_bloomFramebuffer->setViewport();
-	glUseProgram(_bloomProgram->id());
+	GLUtilities::useProgram(_bloomProgram->id());
 	ScreenQuad::draw(_sceneFramebuffer->textureId());
 	_bloomFramebuffer->unbind();
 	
@@ -206,16 +293,16 @@ void DeferredRenderer::draw() {
 	// Draw the blurred bloom back into the scene framebuffer.
 	_sceneFramebuffer->bind();
 	_sceneFramebuffer->setViewport();
-	glEnable(GL_BLEND);
+	GLUtilities::setEnabled(GL_BLEND, true);
 	_blurBuffer->draw();
-	glDisable(GL_BLEND);
+	GLUtilities::setEnabled(GL_BLEND, false);
 	_sceneFramebuffer->unbind();
 	
 	
 	// --- Tonemapping pass ------
 	_toneMappingFramebuffer->bind();
 	_toneMappingFramebuffer->setViewport();
-	glUseProgram(_toneMappingProgram->id());
+	GLUtilities::useProgram(_toneMappingProgram->id());
 	ScreenQuad::draw(_sceneFramebuffer->textureId());
 	_toneMappingFramebuffer->unbind();
 	
@@ -223,37 +310,149 @@ void DeferredRenderer::draw() {
 	// Bind the post-processing framebuffer.
 	_fxaaFramebuffer->bind();
 	_fxaaFramebuffer->setViewport();
-	glUseProgram(_fxaaProgram->id());
+	GLUtilities::useProgram(_fxaaProgram->id());
 	glUniform2fv(_fxaaProgram->uniform("inverseScreenSize"), 1, &(invRenderSize[0]));
 	ScreenQuad::draw(_toneMappingFramebuffer->textureId());
 	_fxaaFramebuffer->unbind();
 	
 	// --- Final pass -------
 	// We now render a full screen quad in the default framebuffer, using sRGB space.
-	glEnable(GL_FRAMEBUFFER_SRGB);
-	glViewport(0, 0, GLsizei(_config.screenResolution[0]), GLsizei(_config.screenResolution[1]));
-	glUseProgram(_finalProgram->id());
+	GLUtilities::setEnabled(GL_FRAMEBUFFER_SRGB, true);
+	GLUtilities::setViewport(0, 0, GLsizei(_config.screenResolution[0]), GLsizei(_config.screenResolution[1]));
+	GLUtilities::useProgram(_finalProgram->id());
 	ScreenQuad::draw(_fxaaFramebuffer->textureId());
-	glDisable(GL_FRAMEBUFFER_SRGB);
-	glEnable(GL_DEPTH_TEST);
+	GLUtilities::setEnabled(GL_FRAMEBUFFER_SRGB, false);
+	GLUtilities::setEnabled(GL_DEPTH_TEST, true);
 	
+	if(_frameSettings.saveFramebuffer){
+		GLUtilities::saveDefaultFramebuffer((unsigned int)_config.screenResolution[0], (unsigned int)_config.screenResolution[1], "./test-default");
+	}
 	checkGLError();
 }
 
+void DeferredRenderer::prepare(float pixelsPerUnit){
+	const size_t objectCount = _scene->objects.size();
+	const BoundingBoxArray & objectBoxes = _scene->objectBoxes();
+	_visibleList.clear();
+	for(size_t oid = 0; oid < objectCount; ++oid){
+		if(_objectVisibility[oid]){
+			_visibleList.push_back((unsigned int)oid);
+		}
+	}
+	// Keep the ranges storage of previous frames.
+	if(_preparedDraws.size() < _visibleList.size()){
+		_preparedDraws.resize(_visibleList.size());
+	}
+	
+	const glm::mat4 & view = _frameCamera.view();
+	const glm::mat4 & projection = _frameCamera.projection();
+	const glm::mat4 viewProjection = projection * view;
+	const glm::vec3 & eye = _frameCamera.position();
+	// Each visible object only writes to its own prepared values.
+	const auto prepareObjects = [&](size_t begin, size_t end){
+		for(size_t vid = begin; vid < end; ++vid){
+			const unsigned int oid = _visibleList[vid];
+			const Object & object = _scene->objects[oid];
+			PreparedDraw & prepared = _preparedDraws[vid];
+			prepared.ranges.clear();
+			prepared.clusters = Object::ClusterStatistics();
+			prepared.impostor = object.showsImpostor(eye, pixelsPerUnit, _frameSettings.impostorPixelSize);
+			if(prepared.impostor){
+				continue;
+			}
+			const unsigned int level = object.selectLevel(eye, pixelsPerUnit, false, _frameSettings.lodPixelError);
+			// Skip the clusters outside the frustum or facing away from the camera.
+			if(_frameSettings.cullClusters && level == 0 && object.clusterCount() > 0){
+				prepared.clusters.total = object.clusterCount();
+				prepared.clusters.drawn = object.cullClusters(viewProjection, glm::vec4(eye, 1.0f), true, false, prepared.ranges);
+			} else {
+				object.appendLevel(level, false, prepared.ranges);
+			}
+			prepared.depth = glm::length(objectBoxes.get(oid).getSphere().center - eye);
+			object.computeUniforms(view, projection, prepared.uniforms);
+		}
+	};
+	if(_frameSettings.parallelPreparation){
+		TaskScheduler::parallelFor(0, _visibleList.size(), 64, prepareObjects);
+	} else {
+		prepareObjects(0, _visibleList.size());
+	}
+	
+	// Cull the light volumes.
+	const Frustum frustum = _frameCamera.frustum();
+	_pointLightVisibility.resize(_scene->pointLights.size());
+	for(size_t lid = 0; lid < _scene->pointLights.size(); ++lid){
+		_pointLightVisibility[lid] = frustum.intersects(_scene->pointLights[lid].boundingBox()) ? 1 : 0;
+	}
+	_spotLightVisibility.resize(_scene->spotLights.size());
+	for(size_t lid = 0; lid < _scene->spotLights.size(); ++lid){
+		_spotLightVisibility[lid] = frustum.intersects(_scene->spotLights[lid].boundingBox()) ? 1 : 0;
+	}
+}
+
 void DeferredRenderer::update(){
 	Renderer::update();
 	_userCamera.update();
 	
 	if(Input::manager().triggered(Input::KeyO)){
-		GLUtilities::saveDefaultFramebuffer((unsigned int)_config.screenResolution[0], (unsigned int)_config.screenResolution[1], "./test-default");
+		_settings.saveFramebuffer = true;
 	}
+	if(!_scene){
+		return;
+	}
+	
+	// Interface.
+	if(ImGui::Begin("Renderer")){
+		ImGui::Checkbox("Show debug", &_settings.debugVisualization);
+		ImGui::SliderFloat("LOD error (px)", &_settings.lodPixelError, 0.0f, 8.0f);
+		ImGui::SliderFloat("Shadow LOD error (px)", &_settings.lodShadowPixelError, 0.0f, 8.0f);
+		ImGui::SliderFloat("Impostor size (px)", &_settings.impostorPixelSize, 0.0f, 256.0f);
+		ImGui::Checkbox("Frustum culling", &_settings.cullObjects);
+		ImGui::Checkbox("Instancing", &_settings.instancing);
+		ImGui::Checkbox("Parallel preparation", &_settings.parallelPreparation);
+		ImGui::Text("Objects: %d visible, %d culled", int(_statistics.visibleObjects), int(_statistics.objects - _statistics.visibleObjects));
+		ImGui::Text("Shadow casters: %d (all lights)", int(_statistics.shadowCasters));
+		ImGui::Text("Shadow atlas: %d regions, %dx%d used", int(_statistics.shadowRegions), int(_statistics.shadowAtlasUsed[0]), int(_statistics.shadowAtlasUsed[1]));
+		ImGui::Checkbox("Cluster culling", &_settings.cullClusters);
+		if(_settings.cullClusters){
+			ImGui::Text("Clusters: %d/%d (scene), %d/%d (shadows)", int(_statistics.clusters.drawn), int(_statistics.clusters.total), int(_statistics.shadowClusters.drawn), int(_statistics.shadowClusters.total));
+		}
+		const char * passNames[RenderQueue::Count] = { "Shadows", "G-buffer", "Debug" };
+		for(unsigned int pid = 0; pid < RenderQueue::Count; ++pid){
+			const RenderQueue::Statistics & stats = _statistics.passes[pid];
+			ImGui::Text("%s: %d items, %d draws", passNames[pid], int(stats.items), int(stats.drawCalls));
+			ImGui::Text("  Binds: %d programs, %d textures, %d vertex arrays", int(stats.programBinds), int(stats.textureBinds), int(stats.vertexArrayBinds));
+			ImGui::Text("  Instanced: %d items", int(stats.instances));
+		}
+		ImGui::Text("Impostors: %d", int(_statistics.impostors));
+	}
+	ImGui::End();
 }
 
 void DeferredRenderer::physics(double fullTime, double frameTime){
 	_userCamera.physics(frameTime);
 	if(_scene){
-		_scene->update(fullTime, frameTime);
+		_scene->animate(fullTime, frameTime);
+	}
+}
+
+void DeferredRenderer::exchange(){
+	Renderer::exchange();
+	_frameCamera = _userCamera;
+	_frameSettings = _settings;
+	_settings.saveFramebuffer = false;
+	
+	_statistics.objects = _scene ? _scene->objects.size() : 0;
+	_statistics.visibleObjects = _visibleObjects;
+	_statistics.shadowCasters = _shadowCasters;
+	_statistics.shadowRegions = _shadowAtlas->regionCount();
+	_statistics.shadowAtlasUsed = _shadowAtlas->usedSize();
+	_statistics.clusters = _clusterStats;
+	_statistics.shadowClusters = _shadowClusterStats;
+	for(unsigned int pid = 0; pid < RenderQueue::Count; ++pid){
+		_statistics.passes[pid] = _renderQueue.statistics(RenderQueue::Pass(pid));
 	}
+	_statistics.impostors = _impostorCount;
 }
 
 
@@ -264,11 +463,13 @@ void DeferredRenderer::clean() const {
 	_gbuffer->clean();
 	_blurBuffer->clean();
 	_blurSSAOBuffer->clean();
+	_shadowAtlas->clean();
 	_ssaoFramebuffer->clean();
 	_bloomFramebuffer->clean();
 	_sceneFramebuffer->clean();
 	_toneMappingFramebuffer->clean();
 	_fxaaFramebuffer->clean();
+	_renderQueue.clean();
 	if(_scene){
 		_scene->clean();
 	}
@@ -5,11 +5,13 @@
 #include "../../graphics/Framebuffer.hpp"
 #include "../../input/ControllableCamera.hpp"
 #include "../../graphics/ScreenQuad.hpp"
+#include "../../lights/ShadowAtlas.hpp"
 
 #include "../../processing/GaussianBlur.hpp"
 #include "../../processing/BoxBlur.hpp"
 
 #include "../Renderer.hpp"
+#include "../RenderQueue.hpp"
 
 
 #include "AmbientQuad.hpp"
@@ -64,6 +66,9 @@ public:
 	 */
 	void physics(double fullTime, double frameTime);
 
+	/** Hand the camera and settings over to draw(), and the statistics of the last frame drawn back to the interface. */
+	void exchange();
+
 	/** Clean internal resources. */
 	void clean() const;
 
@@ -73,14 +78,65 @@ public:
 	 */
 	void resize(unsigned int width, unsigned int height);
 	
+	/** Query the interactive camera.
+	 \return the user camera
+	 */
+	const Camera & camera() const { return _userCamera; }
+
 	
 private:
 	
+	/// \brief Options edited in the interface.
+	struct Settings {
+		bool debugVisualization = false; ///< Toggle the rendering of debug informations.
+		float lodPixelError = 1.0f; ///< Maximum projected simplification error when selecting objects levels of detail, in pixels.
+		float impostorPixelSize = 32.0f; ///< Projected diameter in pixels under which objects are replaced by their impostor.
+		float lodShadowPixelError = 2.0f; ///< Maximum projected simplification error when selecting levels of detail for shadow maps, in pixels.
+		bool cullObjects = true; ///< Skip the objects outside the camera frustum.
+		bool cullClusters = true; ///< Cull the clusters of objects rendered at full resolution.
+		bool instancing = true; ///< Render objects sharing their geometry and material as instances.
+		bool parallelPreparation = true; ///< Prepare the scene pass on the scheduler threads.
+		bool saveFramebuffer = false; ///< Save the final image once the frame is drawn.
+	};
+	
+	/// \brief Statistics of a drawn frame, displayed in the interface.
+	struct Statistics {
+		size_t objects = 0; ///< Number of objects in the scene.
+		size_t visibleObjects = 0; ///< Number of objects in the camera frustum.
+		size_t shadowCasters = 0; ///< Number of casters rendered in all shadow maps.
+		size_t shadowRegions = 0; ///< Number of lights with a region in the shadow atlas.
+		glm::uvec2 shadowAtlasUsed = glm::uvec2(0); ///< Size of the part of the shadow atlas covered by regions.
+		Object::ClusterStatistics clusters; ///< Clusters rendered in the scene pass.
+		Object::ClusterStatistics shadowClusters; ///< Clusters rendered in the shadow passes.
+		RenderQueue::Statistics passes[RenderQueue::Count]; ///< Items, draws and binds of each pass.
+		size_t impostors = 0; ///< Number of impostors rendered.
+	};
+	
+	/// \brief Values of a visible object computed by the preparation phase of a frame, and consumed by the submission phase.
+	struct PreparedDraw {
+		Object::DrawUniforms uniforms; ///< The object transformations for the camera.
+		Object::DrawRanges ranges; ///< The ranges of the selected level of detail or of the visible clusters.
+		Object::ClusterStatistics clusters; ///< The clusters considered and kept.
+		float depth = 0.0f; ///< Distance to the camera, for sorting.
+		bool impostor = false; ///< Is the object replaced by its impostor.
+	};
+	
+	/** Prepare the scene pass on the scheduler threads, without any GL call: select the visible objects levels of detail and clusters, compute their transformations and cull the lights outside the camera frustum.
+	 \param pixelsPerUnit the size of a world unit at unit distance in pixels
+	 \note The object visibility should already be computed.
+	 */
+	void prepare(float pixelsPerUnit);
+	
 	ControllableCamera _userCamera; ///< The interactive camera.
+	Camera _frameCamera; ///< The interactive camera of the frame being drawn.
+	Settings _settings; ///< Options edited in the interface.
+	Settings _frameSettings; ///< Options of the frame being drawn.
+	Statistics _statistics; ///< Statistics of the last frame drawn, displayed in the interface.
 
 	std::shared_ptr<Framebuffer> _gbuffer; ///< G-buffer.
 	std::shared_ptr<GaussianBlur> _blurBuffer; ///< Bloom blur processing.
 	std::shared_ptr<BoxBlur> _blurSSAOBuffer; ///< SSAO blur processing.
+	std::shared_ptr<ShadowAtlas> _shadowAtlas; ///< Shadow maps of the directional and spot lights.
 	
 	std::shared_ptr<Framebuffer> _ssaoFramebuffer; ///< SSAO framebuffer
 	std::shared_ptr<Framebuffer> _sceneFramebuffer; ///< Lighting framebuffer
@@ -96,7 +152,18 @@ private:
 	
 	std::shared_ptr<Scene> _scene; ///< The scene to render
 	
-	bool _debugVisualization = false; ///< Toggle the rendering of debug informations.
+	size_t _impostorCount = 0; ///< Number of impostors rendered during the last frame.
+	std::vector<unsigned int> _shadowCandidates; ///< Objects inside the shadow map volume of the current directional light.
+	std::vector<unsigned char> _objectVisibility; ///< Visibility of each object in the camera frustum.
+	size_t _visibleObjects = 0; ///< Number of objects in the camera frustum during the last frame.
+	size_t _shadowCasters = 0; ///< Number of casters rendered in all shadow maps during the last frame.
+	Object::ClusterStatistics _clusterStats; ///< Clusters rendered in the scene pass during the last frame.
+	Object::ClusterStatistics _shadowClusterStats; ///< Clusters rendered in the shadow passes during the last frame.
+	RenderQueue _renderQueue; ///< Sorted draws of the shadow, G-buffer and debug passes, with their statistics for the last frame.
+	std::vector<unsigned int> _visibleList; ///< Indices of the objects in the camera frustum.
+	std::vector<PreparedDraw> _preparedDraws; ///< Prepared values of each visible object, reused across frames.
+	std::vector<unsigned char> _pointLightVisibility; ///< Visibility of each point light volume in the camera frustum.
+	std::vector<unsigned char> _spotLightVisibility; ///< Visibility of each spot light volume in the camera frustum.
 };
 
 #endif
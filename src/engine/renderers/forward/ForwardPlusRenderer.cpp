@@ -0,0 +1,382 @@
+#include "ForwardPlusRenderer.hpp"
+#include "../../input/Input.hpp"
+#include "../../lights/DirectionalLight.hpp"
+#include "../../lights/PointLight.hpp"
+#include "../../lights/SpotLight.hpp"
+#include "../../helpers/InterfaceUtilities.hpp"
+
+/// Maximum number of directional lights evaluated by the forward programs.
+#define MAX_DIRECTIONAL_LIGHTS 4
+
+ForwardPlusRenderer::ForwardPlusRenderer(Config & config) : Renderer(config) {
+
+	// Setup camera parameters.
+	_userCamera.projection(config.screenResolution[0]/config.screenResolution[1], 1.3f, 0.01f, 200.0f);
+	
+	const int renderWidth = (int)_renderResolution[0];
+	const int renderHeight = (int)_renderResolution[1];
+	// Find the closest power of 2 size.
+	const int renderPow2Size = (int)std::pow(2,(int)floor(log2(_renderResolution[0])));
+	
+	// Lighting is computed directly in the HDR scene framebuffer.
+	_sceneFramebuffer = std::make_shared<Framebuffer>(renderWidth, renderHeight, GL_RGBA16F, true);
+	_bloomFramebuffer = std::make_shared<Framebuffer>(renderPow2Size, renderPow2Size, GL_RGB16F, false);
+	_toneMappingFramebuffer = std::make_shared<Framebuffer>(renderWidth, renderHeight, GL_RGBA8, false);
+	_fxaaFramebuffer = std::make_shared<Framebuffer>(renderWidth, renderHeight, GL_RGBA8, false);
+	_blurBuffer = std::make_shared<GaussianBlur>(renderPow2Size, renderPow2Size, 2, GL_RGB16F);
+	// A single directional light is shadowed, its shadow map fills the atlas.
+	_shadowAtlas = std::make_shared<ShadowAtlas>(512, 512, 512);
+	
+	checkGLError();
+	
+	// GL options
+	GLUtilities::setEnabled(GL_DEPTH_TEST, true);
+	GLUtilities::setEnabled(GL_CULL_FACE, true);
+	glBlendEquation (GL_FUNC_ADD);
+	GLUtilities::setBlendFunc(GL_ONE, GL_ONE);
+	
+	// The forward programs share the vertex shaders of the G-buffer programs.
+	_objectProgram = Resources::manager().getProgram("object_forward", "object_gbuffer", "object_forward");
+	_parallaxProgram = Resources::manager().getProgram("parallax_forward", "parallax_gbuffer", "parallax_forward");
+	_depthProgram = Resources::manager().getProgram("object_depth", "object_basic", "light_shadow");
+	_bloomProgram = Resources::manager().getProgram2D("bloom");
+	_toneMappingProgram = Resources::manager().getProgram2D("tonemap");
+	_fxaaProgram = Resources::manager().getProgram2D("fxaa");
+	_finalProgram = Resources::manager().getProgram2D("final_screenquad");
+	_textureBrdf = Resources::manager().getTexture("brdf-precomputed", false).id;
+	
+	checkGLError();
+
+}
+
+void ForwardPlusRenderer::setScene(std::shared_ptr<Scene> scene){
+	_scene = scene;
+	if(!scene){
+		return;
+	}
+	_scene->init();
+	_scene->updateBounds();
+	
+	_objectProgram->cacheUniformArray("shCoeffs", _scene->backgroundIrradiance);
+	_parallaxProgram->cacheUniformArray("shCoeffs", _scene->backgroundIrradiance);
+	
+	// Lights are not rendered using screen space proxies, they don't need the G-buffer textures.
+	for(auto& dirLight : _scene->directionalLights){
+		dirLight.init({});
+	}
+	for(auto& pointLight : _scene->pointLights){
+		pointLight.init({});
+	}
+	for(auto& spotLight : _scene->spotLights){
+		spotLight.init({});
+	}
+	checkGLError();
+}
+
+void ForwardPlusRenderer::draw() {
+	Renderer::draw();
+
+	if(!_scene){
+		glClearColor(0.2f,0.2,0.2f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		return;
+	}
+	
+	const glm::vec2 invRenderSize = 1.0f / _renderResolution;
+	
+	// --- Light pass -------
+	
+	const size_t objectCount = _scene->objects.size();
+	
+	// Only the first shadow casting directional light is shadowed.
+	int shadowedLight = -1;
+	_shadowCasters = 0;
+	const int directionalCount = std::min(int(_scene->directionalLights.size()), MAX_DIRECTIONAL_LIGHTS);
+	for(int did = 0; did < directionalCount; ++did){
+		DirectionalLight & light = _scene->directionalLights[did];
+		if(light.castsShadow()){
+			_shadowAtlas->clear();
+			_shadowAtlas->request(light, 1.0f);
+			_shadowAtlas->allocate();
+			_shadowAtlas->begin();
+			_scene->objectsInFrustum(Frustum(light.shadowViewProjection()), _shadowCandidates);
+			_shadowCasters = light.drawShadow(_shadowQueue, _scene->objects, _scene->objectBoxes(), _shadowCandidates, _frameSettings.lodShadowPixelError);
+			_shadowAtlas->end();
+			shadowedLight = did;
+			break;
+		}
+	}
+	
+	// Assign the point and spot lights to the camera clusters.
+	_clusters.update(_frameCamera.view(), _frameCamera.projection(), _scene->pointLights, _scene->spotLights);
+	_clusters.upload();
+	// ----------------------
+	
+	// --- Scene pass -------
+	// Test the objects against the camera frustum, through the scene hierarchy of bounds.
+	if(_frameSettings.cullObjects){
+		_visibleObjects = _scene->cullObjects(_frameCamera.frustum(), _objectVisibility);
+	} else {
+		_objectVisibility.assign(objectCount, 1);
+		_visibleObjects = objectCount;
+	}
+	
+	_sceneFramebuffer->bind();
+	_sceneFramebuffer->setViewport();
+	GLUtilities::setEnabled(GL_DEPTH_TEST, true);
+	// The skybox will cover the background, no need to clear color.
+	glClear(GL_DEPTH_BUFFER_BIT);
+	
+	GLUtilities::resetStatistics();
+	if(_frameSettings.depthPrepass){
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		drawObjects(true);
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		// Shade the fragments matching the prepass depth.
+		GLUtilities::setDepthFunc(GL_LEQUAL);
+	}
+	_prepassDrawStats = GLUtilities::statistics();
+	
+	// Per-frame lighting parameters and textures, shared by all objects.
+	setupLighting(*_objectProgram, invRenderSize, shadowedLight);
+	setupLighting(*_parallaxProgram, invRenderSize, shadowedLight);
+	_clusters.bind(4);
+	GLUtilities::bindTexture(7, GL_TEXTURE_CUBE_MAP, _scene->backgroundReflection);
+	GLUtilities::bindTexture(8, GL_TEXTURE_2D, _textureBrdf);
+	GLUtilities::bindTexture(9, GL_TEXTURE_2D, shadowedLight >= 0 ? _shadowAtlas->textureId() : 0);
+	
+	GLUtilities::resetStatistics();
+	drawObjects(false);
+	_drawStats = GLUtilities::statistics();
+	
+	// No need to write the skybox depth to the framebuffer.
+	GLUtilities::setDepthMask(false);
+	// Accept a depth of 1.0 (far plane).
+	GLUtilities::setDepthFunc(GL_LEQUAL);
+	// draw background.
+	_scene->background.draw(_frameCamera.view(), _frameCamera.projection());
+	GLUtilities::setDepthFunc(GL_LESS);
+	GLUtilities::setDepthMask(true);
+	
+	_sceneFramebuffer->unbind();
+	// ----------------------
+	
+	GLUtilities::setEnabled(GL_DEPTH_TEST, false);
+	
+	// --- Bloom selection pass ------
+	_bloomFramebuffer->bind();
+	_bloomFramebuffer->setViewport();
+	GLUtilities::useProgram(_bloomProgram->id());
+	ScreenQuad::draw(_sceneFramebuffer->textureId());
+	_bloomFramebuffer->unbind();
+	
+	// --- Bloom blur pass ------
+	_blurBuffer->process(_bloomFramebuffer->textureId());
+	
+	// Draw the blurred bloom back into the scene framebuffer.
+	_sceneFramebuffer->bind();
+	_sceneFramebuffer->setViewport();
+	GLUtilities::setEnabled(GL_BLEND, true);
+	_blurBuffer->draw();
+	GLUtilities::setEnabled(GL_BLEND, false);
+	_sceneFramebuffer->unbind();
+	
+	// --- Tonemapping pass ------
+	_toneMappingFramebuffer->bind();
+	_toneMappingFramebuffer->setViewport();
+	GLUtilities::useProgram(_toneMappingProgram->id());
+	ScreenQuad::draw(_sceneFramebuffer->textureId());
+	_toneMappingFramebuffer->unbind();
+	
+	// --- FXAA pass -------
+	// Bind the post-processing framebuffer.
+	_fxaaFramebuffer->bind();
+	_fxaaFramebuffer->setViewport();
+	GLUtilities::useProgram(_fxaaProgram->id());
+	glUniform2fv(_fxaaProgram->uniform("inverseScreenSize"), 1, &(invRenderSize[0]));
+	ScreenQuad::draw(_toneMappingFramebuffer->textureId());
+	_fxaaFramebuffer->unbind();
+	
+	// --- Final pass -------
+	// We now render a full screen quad in the default framebuffer, using sRGB space.
+	GLUtilities::setEnabled(GL_FRAMEBUFFER_SRGB, true);
+	GLUtilities::setViewport(0, 0, GLsizei(_config.screenResolution[0]), GLsizei(_config.screenResolution[1]));
+	GLUtilities::useProgram(_finalProgram->id());
+	ScreenQuad::draw(_fxaaFramebuffer->textureId());
+	GLUtilities::setEnabled(GL_FRAMEBUFFER_SRGB, false);
+	GLUtilities::setEnabled(GL_DEPTH_TEST, true);
+	
+	if(_frameSettings.saveFramebuffer){
+		GLUtilities::saveDefaultFramebuffer((unsigned int)_config.screenResolution[0], (unsigned int)_config.screenResolution[1], "./test-default");
+	}
+	checkGLError();
+}
+
+void ForwardPlusRenderer::drawObjects(bool depthOnly){
+	// Size of a world unit at unit distance in pixels, for levels of detail selection.
+	const float pixelsPerUnit = 0.5f * _renderResolution[1] * _frameCamera.projection()[1][1];
+	const glm::mat4 viewProjection = _frameCamera.projection() * _frameCamera.view();
+	
+	if(depthOnly){
+		GLUtilities::useProgram(_depthProgram->id());
+	}
+	// Successive objects sharing their buffers, transformation and material are rendered in a single call.
+	const Object * pending = nullptr;
+	Object::DrawUniforms uniforms;
+	const auto flush = [&](){
+		if(!pending){
+			return;
+		}
+		if(depthOnly){
+			// Same transformation as the shading pass, so that the depths are identical.
+			pending->computeUniforms(_frameCamera.view(), _frameCamera.projection(), uniforms);
+			glUniformMatrix4fv(_depthProgram->uniform("mvp"), 1, GL_FALSE, &uniforms.mvp[0][0]);
+			pending->drawPositions(_clusterRanges);
+		} else {
+			const ProgramInfos & program = pending->type() == Object::Parallax ? *_parallaxProgram : *_objectProgram;
+			pending->draw(program, _frameCamera.view(), _frameCamera.projection(), _clusterRanges);
+		}
+		_clusterRanges.clear();
+		pending = nullptr;
+	};
+	
+	_clusterRanges.clear();
+	for(size_t oid = 0; oid < _scene->objects.size(); ++oid){
+		if(!_objectVisibility[oid]){
+			continue;
+		}
+		const Object & object = _scene->objects[oid];
+		// Parallax mapping displaces the depth of fragments, they are skipped by the prepass.
+		if(depthOnly && object.type() == Object::Parallax){
+			continue;
+		}
+		if(pending && !object.sharesDrawState(*pending, depthOnly)){
+			flush();
+		}
+		pending = &object;
+		// Both passes select the same levels and clusters, so that their depths match.
+		const unsigned int level = object.selectLevel(_frameCamera.position(), pixelsPerUnit, false, _frameSettings.lodPixelError);
+		if(_frameSettings.cullClusters && level == 0 && object.clusterCount() > 0){
+			object.cullClusters(viewProjection, glm::vec4(_frameCamera.position(), 1.0f), true, depthOnly, _clusterRanges);
+		} else {
+			object.appendLevel(level, depthOnly, _clusterRanges);
+		}
+	}
+	flush();
+	GLUtilities::useProgram(0);
+}
+
+void ForwardPlusRenderer::setupLighting(const ProgramInfos & program, const glm::vec2 & invRenderSize, int shadowedLight) const {
+	const glm::mat4 & view = _frameCamera.view();
+	const glm::mat4 & projection = _frameCamera.projection();
+	const glm::mat4 invView = glm::inverse(view);
+	// Store the four variable coefficients of the projection matrix.
+	const glm::vec4 projectionVector = glm::vec4(projection[0][0], projection[1][1], projection[2][2], projection[3][2]);
+	
+	GLUtilities::useProgram(program.id());
+	glUniform2fv(program.uniform("inverseScreenSize"), 1, &(invRenderSize[0]));
+	glUniform4fv(program.uniform("projectionMatrix"), 1, &(projectionVector[0]));
+	glUniformMatrix4fv(program.uniform("inverseV"), 1, GL_FALSE, &invView[0][0]);
+	glUniform3iv(program.uniform("clusterGrid"), 1, &(_clusters.grid()[0]));
+	glUniform2fv(program.uniform("clusterSlices"), 1, &(_clusters.sliceParameters()[0]));
+	
+	// Directional lights, in view space.
+	const int directionalCount = std::min(int(_scene->directionalLights.size()), MAX_DIRECTIONAL_LIGHTS);
+	glm::vec3 directions[MAX_DIRECTIONAL_LIGHTS];
+	glm::vec3 colors[MAX_DIRECTIONAL_LIGHTS];
+	for(int did = 0; did < directionalCount; ++did){
+		const DirectionalLight & light = _scene->directionalLights[did];
+		directions[did] = glm::mat3(view) * light.direction();
+		colors[did] = light.intensity();
+	}
+	glUniform1i(program.uniform("directionalCount"), directionalCount);
+	if(directionalCount > 0){
+		glUniform3fv(program.uniform("directionalDirections[0]"), directionalCount, &(directions[0][0]));
+		glUniform3fv(program.uniform("directionalColors[0]"), directionalCount, &(colors[0][0]));
+	}
+	glUniform1i(program.uniform("shadowedDirectional"), shadowedLight);
+	if(shadowedLight >= 0){
+		const glm::mat4 viewToLight = _scene->directionalLights[shadowedLight].shadowViewProjection() * invView;
+		glUniformMatrix4fv(program.uniform("viewToLight"), 1, GL_FALSE, &viewToLight[0][0]);
+		glUniform4fv(program.uniform("shadowRegion"), 1, &(_scene->directionalLights[shadowedLight].shadowRegion()[0]));
+	}
+	GLUtilities::useProgram(0);
+}
+
+void ForwardPlusRenderer::update(){
+	Renderer::update();
+	_userCamera.update();
+	
+	if(Input::manager().triggered(Input::KeyO)){
+		_settings.saveFramebuffer = true;
+	}
+	if(!_scene){
+		return;
+	}
+	
+	// Interface.
+	if(ImGui::Begin("Renderer")){
+		ImGui::Checkbox("Depth prepass", &_settings.depthPrepass);
+		ImGui::SliderFloat("LOD error (px)", &_settings.lodPixelError, 0.0f, 8.0f);
+		ImGui::SliderFloat("Shadow LOD error (px)", &_settings.lodShadowPixelError, 0.0f, 8.0f);
+		ImGui::Checkbox("Frustum culling", &_settings.cullObjects);
+		ImGui::Checkbox("Cluster culling", &_settings.cullClusters);
+		ImGui::Text("Objects: %d visible, %d culled", int(_statistics.visibleObjects), int(_statistics.objects - _statistics.visibleObjects));
+		ImGui::Text("Shadow casters: %d", int(_statistics.shadowCasters));
+		ImGui::Text("Lights: %d/%d in clusters", int(_statistics.clusteredLights), int(_statistics.lights));
+		ImGui::Text("Light references: %d, max. %d per cluster", int(_statistics.lightReferences), int(_statistics.maxClusterLights));
+		ImGui::Text("Draws: %d (shading), %d (prepass)", int(_statistics.draws.drawCalls), int(_statistics.prepassDraws.drawCalls));
+	}
+	ImGui::End();
+}
+
+void ForwardPlusRenderer::exchange(){
+	Renderer::exchange();
+	_frameCamera = _userCamera;
+	_frameSettings = _settings;
+	_settings.saveFramebuffer = false;
+	
+	_statistics.objects = _scene ? _scene->objects.size() : 0;
+	_statistics.lights = _scene ? (_scene->pointLights.size() + _scene->spotLights.size()) : 0;
+	_statistics.visibleObjects = _visibleObjects;
+	_statistics.shadowCasters = _shadowCasters;
+	_statistics.clusteredLights = _clusters.lightCount();
+	_statistics.lightReferences = _clusters.referenceCount();
+	_statistics.maxClusterLights = _clusters.maxClusterLights();
+	_statistics.draws = _drawStats;
+	_statistics.prepassDraws = _prepassDrawStats;
+}
+
+void ForwardPlusRenderer::physics(double fullTime, double frameTime){
+	_userCamera.physics(frameTime);
+	if(_scene){
+		_scene->animate(fullTime, frameTime);
+	}
+}
+
+
+void ForwardPlusRenderer::clean() const {
+	Renderer::clean();
+	// Clean objects.
+	_clusters.clean();
+	_blurBuffer->clean();
+	_shadowAtlas->clean();
+	_bloomFramebuffer->clean();
+	_sceneFramebuffer->clean();
+	_toneMappingFramebuffer->clean();
+	_fxaaFramebuffer->clean();
+	_shadowQueue.clean();
+	if(_scene){
+		_scene->clean();
+	}
+}
+
+
+void ForwardPlusRenderer::resize(unsigned int width, unsigned int height){
+	Renderer::updateResolution(width, height);
+	// Resize the framebuffers.
+	_sceneFramebuffer->resize(_renderResolution);
+	_toneMappingFramebuffer->resize(_renderResolution);
+	_fxaaFramebuffer->resize(_renderResolution);
+	checkGLError();
+}
@@ -0,0 +1,144 @@
+#ifndef ForwardPlusRenderer_h
+#define ForwardPlusRenderer_h
+
+#include "../../Common.hpp"
+#include "../../graphics/Framebuffer.hpp"
+#include "../../input/ControllableCamera.hpp"
+#include "../../graphics/ScreenQuad.hpp"
+#include "../../lights/LightClusters.hpp"
+#include "../../lights/ShadowAtlas.hpp"
+
+#include "../../processing/GaussianBlur.hpp"
+
+#include "../Renderer.hpp"
+#include "../RenderQueue.hpp"
+
+/**
+ \defgroup ForwardRendering Clustered forward rendering
+ \brief Performs forward rendering, where each object is shaded once with the environment and all the lights of its clusters.
+ \details Point and spot lights are assigned to view space clusters on the CPU, and the shading of each fragment loops over the lights of its cluster. An optional depth prepass avoids shading hidden fragments. Point and spot lights are not shadowed, the first shadow casting directional light uses its shadow map. No screen space ambient occlusion is applied.
+ \see GLSL::Frag::Object_forward, GLSL::Frag::Parallax_forward, GLSL::Frag::Bloom, GLSL::Frag::Tonemap, GLSL::Frag::FXAA, GLSL::Frag::Final_screenquad
+ \ingroup Renderers
+ */
+
+/**
+ \brief Performs clustered forward rendering of a scene.
+ \ingroup ForwardRendering
+ */
+class ForwardPlusRenderer : public Renderer {
+
+public:
+
+	/** Constructor.
+	 \param config the configuration to apply when setting up
+	 */
+	ForwardPlusRenderer(Config & config);
+	
+	/** Set the scene to render.
+	 \param scene the new scene
+	 */
+	void setScene(std::shared_ptr<Scene> scene);
+	
+	/** Draw the scene and effects */
+	void draw();
+	
+	/** Perform once-per-frame update (buttons, GUI,...) */
+	void update();
+	
+	/** Perform physics simulation update.
+	 \param fullTime the time elapsed since the beginning of the render loop
+	 \param frameTime the duration of the last frame
+	 \note This function can be called multiple times per frame.
+	 */
+	void physics(double fullTime, double frameTime);
+	
+	/** Hand the camera and settings over to draw(), and the statistics of the last frame drawn back to the interface. */
+	void exchange();
+	
+	/** Clean internal resources. */
+	void clean() const;
+	
+	/** Handle a window resize event.
+	 \param width the new width
+	 \param height the new height
+	 */
+	void resize(unsigned int width, unsigned int height);
+	
+	/** Query the interactive camera.
+	 \return the user camera
+	 */
+	const Camera & camera() const { return _userCamera; }
+
+private:
+
+	/// \brief Options edited in the interface.
+	struct Settings {
+		bool depthPrepass = true; ///< Render the depth of opaque objects before shading them.
+		float lodPixelError = 1.0f; ///< Maximum projected simplification error when selecting objects levels of detail, in pixels.
+		float lodShadowPixelError = 2.0f; ///< Maximum projected simplification error when selecting levels of detail for shadow maps, in pixels.
+		bool cullObjects = true; ///< Skip the objects outside the camera frustum.
+		bool cullClusters = true; ///< Cull the clusters of objects rendered at full resolution.
+		bool saveFramebuffer = false; ///< Save the final image once the frame is drawn.
+	};
+	
+	/// \brief Statistics of a drawn frame, displayed in the interface.
+	struct Statistics {
+		size_t objects = 0; ///< Number of objects in the scene.
+		size_t visibleObjects = 0; ///< Number of objects in the camera frustum.
+		size_t shadowCasters = 0; ///< Number of casters rendered in the shadow map.
+		size_t lights = 0; ///< Number of point and spot lights in the scene.
+		size_t clusteredLights = 0; ///< Number of lights assigned to at least one cluster.
+		size_t lightReferences = 0; ///< Number of light references in the clusters.
+		size_t maxClusterLights = 0; ///< Largest number of lights in a cluster.
+		DrawStatistics draws; ///< Draw calls and binds of the shading pass.
+		DrawStatistics prepassDraws; ///< Draw calls and binds of the depth prepass.
+	};
+	
+	/** Render the visible objects, merging successive objects sharing their draw state.
+	 \param depthOnly only render the depth of objects with a fixed geometry, for the depth prepass
+	 */
+	void drawObjects(bool depthOnly);
+	
+	/** Upload the per-frame lighting parameters to a forward shading program.
+	 \param program the program to setup
+	 \param invRenderSize the inverse of the rendering resolution
+	 \param shadowedLight the index of the directional light using its shadow map, or -1
+	 */
+	void setupLighting(const ProgramInfos & program, const glm::vec2 & invRenderSize, int shadowedLight) const;
+	
+	ControllableCamera _userCamera; ///< The interactive camera.
+	Camera _frameCamera; ///< The interactive camera of the frame being drawn.
+	Settings _settings; ///< Options edited in the interface.
+	Settings _frameSettings; ///< Options of the frame being drawn.
+	Statistics _statistics; ///< Statistics of the last frame drawn, displayed in the interface.
+	
+	std::shared_ptr<Framebuffer> _sceneFramebuffer; ///< Lighting framebuffer
+	std::shared_ptr<GaussianBlur> _blurBuffer; ///< Bloom blur processing.
+	std::shared_ptr<ShadowAtlas> _shadowAtlas; ///< Shadow map of the shadowed directional light.
+	std::shared_ptr<Framebuffer> _bloomFramebuffer; ///< Bloom framebuffer
+	std::shared_ptr<Framebuffer> _toneMappingFramebuffer; ///< Tonemapping framebuffer
+	std::shared_ptr<Framebuffer> _fxaaFramebuffer; ///< FXAA framebuffer
+	
+	std::shared_ptr<ProgramInfos> _objectProgram; ///< Forward program for regular objects.
+	std::shared_ptr<ProgramInfos> _parallaxProgram; ///< Forward program for parallax mapped objects.
+	std::shared_ptr<ProgramInfos> _depthProgram; ///< Depth prepass program.
+	std::shared_ptr<ProgramInfos> _bloomProgram; ///< Bloom program
+	std::shared_ptr<ProgramInfos> _toneMappingProgram; ///< Tonemapping program
+	std::shared_ptr<ProgramInfos> _fxaaProgram; ///< FXAA program
+	std::shared_ptr<ProgramInfos> _finalProgram; ///< Final output program
+	GLuint _textureBrdf; ///< The preintegrated BRDF lookup table.
+	
+	std::shared_ptr<Scene> _scene; ///< The scene to render
+	LightClusters _clusters; ///< Assignment of the point and spot lights to view space clusters.
+	
+	std::vector<unsigned int> _shadowCandidates; ///< Objects inside the shadow map volume.
+	std::vector<unsigned char> _objectVisibility; ///< Visibility of each object in the camera frustum.
+	size_t _visibleObjects = 0; ///< Number of objects in the camera frustum during the last frame.
+	size_t _shadowCasters = 0; ///< Number of casters rendered in the shadow map during the last frame.
+	Object::DrawRanges _clusterRanges; ///< Visible ranges of the current objects, reused across objects and frames.
+	RenderQueue _shadowQueue; ///< Sorted casters of the shadow map.
+	DrawStatistics _drawStats; ///< Draw calls and binds of the shading pass during the last frame.
+	DrawStatistics _prepassDrawStats; ///< Draw calls and binds of the depth prepass during the last frame.
+};
+
+#endif
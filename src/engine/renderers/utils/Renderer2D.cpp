@@ -5,7 +5,7 @@
 
 
 Renderer2D::Renderer2D(Config & config, const std::string & shaderName, const unsigned int width, const unsigned int height, const GLenum preciseFormat) : Renderer(config) {
-	glDisable(GL_DEPTH_TEST);
+	GLUtilities::setEnabled(GL_DEPTH_TEST, false);
 	_resultFramebuffer = std::make_shared<Framebuffer>(width, height, preciseFormat, false);
 	_resultProgram = Resources::manager().getProgram2D(shaderName);
 	checkGLError();
@@ -13,20 +13,21 @@ Renderer2D::Renderer2D(Config & config, const std::string & shaderName, const un
 
 
 void Renderer2D::draw() {
-	glDisable(GL_DEPTH_TEST);
+	Renderer::draw();
+	GLUtilities::setEnabled(GL_DEPTH_TEST, false);
 	_resultFramebuffer->bind();
 	
-	glViewport(0,0,_resultFramebuffer->width(), _resultFramebuffer->height());
+	GLUtilities::setViewport(0,0,_resultFramebuffer->width(), _resultFramebuffer->height());
 	glClearColor(0.0f,0.0f,0.0f,0.0f);
 	glClear(GL_COLOR_BUFFER_BIT);
-	glUseProgram(_resultProgram->id());
+	GLUtilities::useProgram(_resultProgram->id());
 	ScreenQuad::draw();
 	
 	glFlush();
 	glFinish();
 
 	_resultFramebuffer->unbind();
-	glEnable(GL_DEPTH_TEST);
+	GLUtilities::setEnabled(GL_DEPTH_TEST, true);
 }
 
 void Renderer2D::save(const std::string & outputPath){
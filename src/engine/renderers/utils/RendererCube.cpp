@@ -14,7 +14,7 @@ RendererCube::RendererCube(Config & config, const std::string & cubemapName, con
 	checkGLError();
 
 	// GL options
-	glEnable(GL_DEPTH_TEST);
+	GLUtilities::setEnabled(GL_DEPTH_TEST, true);
 	checkGLError();
 	
 	checkGLError();
@@ -23,15 +23,16 @@ RendererCube::RendererCube(Config & config, const std::string & cubemapName, con
 
 
 void RendererCube::draw() {
+	Renderer::draw();
 	drawCube(_resultFramebuffer->width(), _resultFramebuffer->height(), "cubemap-output-default");
 }
 
 void RendererCube::drawCube(const unsigned int localWidth, const unsigned int localHeight, const std::string & localOutputPath) {
-	glDisable(GL_DEPTH_TEST);
+	GLUtilities::setEnabled(GL_DEPTH_TEST, false);
 	
 	_resultFramebuffer->bind();
 
-	glViewport(0,0,localWidth,localHeight);
+	GLUtilities::setViewport(0,0,localWidth,localHeight);
 	
 	const glm::mat4 projection = glm::perspective(float(M_PI/2.0), (float)_resultFramebuffer->width()/(float)_resultFramebuffer->height(), 0.1f, 200.0f);
 	const glm::vec3 ups[6] = { glm::vec3(0.0,-1.0,0.0), glm::vec3(0.0,-1.0,0.0),glm::vec3(0.0,-1.0,0.0), glm::vec3(0.0,-1.0,0.0), glm::vec3(0.0,0.0,1.0), glm::vec3(0.0,0.0,-1.0) };
@@ -57,7 +58,7 @@ void RendererCube::drawCube(const unsigned int localWidth, const unsigned int lo
 	
 	_resultFramebuffer->unbind();
 	
-	glEnable(GL_DEPTH_TEST);
+	GLUtilities::setEnabled(GL_DEPTH_TEST, true);
 	
 }
 
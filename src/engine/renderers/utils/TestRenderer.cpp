@@ -8,11 +8,11 @@ TestRenderer::TestRenderer(Config & config) : Renderer(config) {
 	checkGLError();
 	
 	// GL options
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_CULL_FACE);
+	GLUtilities::setEnabled(GL_DEPTH_TEST, true);
+	GLUtilities::setEnabled(GL_CULL_FACE, true);
 	glBlendEquation (GL_FUNC_ADD);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glDisable(GL_BLEND);
+	GLUtilities::setBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLUtilities::setEnabled(GL_BLEND, false);
 	checkGLError();
 	
 	_program = Resources::manager().getProgram("passthrough");
@@ -22,23 +22,27 @@ TestRenderer::TestRenderer(Config & config) : Renderer(config) {
 
 
 void TestRenderer::draw() {
+	Renderer::draw();
 	
 	_framebuffer->bind();
 	glClearColor(1.0f,0.0f,0.0f,1.0f);
 	glClear(GL_COLOR_BUFFER_BIT);
-	glDisable(GL_DEPTH_TEST);
+	GLUtilities::setEnabled(GL_DEPTH_TEST, false);
 	_framebuffer->setViewport();
-	glUseProgram(_program->id());
+	GLUtilities::useProgram(_program->id());
 	ScreenQuad::draw(Resources::manager().getTexture("desk_albedo").id);
 	_framebuffer->unbind();
 	
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	glEnable(GL_FRAMEBUFFER_SRGB);
-	glViewport(0, 0, GLsizei(_config.screenResolution[0]), GLsizei(_config.screenResolution[1]));
-	glUseProgram(_program->id());
+	GLUtilities::bindFramebuffer(GL_FRAMEBUFFER, 0);
+	GLUtilities::setEnabled(GL_FRAMEBUFFER_SRGB, true);
+	GLUtilities::setViewport(0, 0, GLsizei(_config.screenResolution[0]), GLsizei(_config.screenResolution[1]));
+	GLUtilities::useProgram(_program->id());
 	ScreenQuad::draw(_framebuffer->textureId());
-	glDisable(GL_FRAMEBUFFER_SRGB);
+	GLUtilities::setEnabled(GL_FRAMEBUFFER_SRGB, false);
 	
+	if(_saveFramebuffer){
+		GLUtilities::saveDefaultFramebuffer((unsigned int)_config.screenResolution[0], (unsigned int)_config.screenResolution[1], "./test-default");
+	}
 }
 
 void TestRenderer::update(){
@@ -46,7 +50,7 @@ void TestRenderer::update(){
 	
 	
 	if(Input::manager().triggered(Input::KeyO)){
-		GLUtilities::saveDefaultFramebuffer((unsigned int)_config.screenResolution[0], (unsigned int)_config.screenResolution[1], "./test-default");
+		_saveRequested = true;
 	}
 }
 
@@ -54,6 +58,12 @@ void TestRenderer::physics(double fullTime, double frameTime){
 	
 }
 
+void TestRenderer::exchange(){
+	Renderer::exchange();
+	_saveFramebuffer = _saveRequested;
+	_saveRequested = false;
+}
+
 
 void TestRenderer::clean() const {
 	Renderer::clean();
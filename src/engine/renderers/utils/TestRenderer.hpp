@@ -38,6 +38,9 @@ public:
 	 */
 	void physics(double fullTime, double frameTime);
 
+	/** Hand the save request over to draw(). */
+	void exchange();
+
 	/** Clean internal resources. */
 	void clean() const;
 
@@ -53,6 +56,8 @@ private:
 	Camera _camera; ///< The user camera.
 	std::shared_ptr<Framebuffer> _framebuffer; ///< The render framebuffer.
 	std::shared_ptr<ProgramInfos> _program; ///< The rendering program.
+	bool _saveRequested = false; ///< Save the final image of the next frame.
+	bool _saveFramebuffer = false; ///< Save the final image once the frame is drawn.
 	
 };
 
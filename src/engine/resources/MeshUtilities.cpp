@@ -1,7 +1,20 @@
 #include "MeshUtilities.hpp"
+#include "helpers/TaskScheduler.hpp"
 #include <sstream>
 #include <cstddef>
 #include <map>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define MESH_SSE
+#include <emmintrin.h>
+#endif
+#if defined(__AVX__)
+#define MESH_AVX
+#include <immintrin.h>
+#endif
 
 using namespace std;
 
@@ -11,6 +24,7 @@ void MeshUtilities::loadObj( std::istream & in, Mesh & mesh, MeshUtilities::Load
 	mesh.indices.clear();
 	mesh.positions.clear();
 	mesh.normals.clear();
+	mesh.tangents.clear();
 	mesh.texcoords.clear();
 	
 	// Init temporary vectors.
@@ -185,96 +199,1246 @@ void MeshUtilities::loadObj( std::istream & in, Mesh & mesh, MeshUtilities::Load
 
 }
 
-BoundingBox MeshUtilities::computeBoundingBox(Mesh & mesh){
+/** Compute the number of chunks to split a range of items in, to process them on multiple threads.
+ \param count the number of items
+ \param minPerChunk the minimum number of items in each chunk
+ \return the number of chunks, at most the number of scheduler threads
+ */
+static size_t chunkCountFor(size_t count, size_t minPerChunk){
+	const size_t maxThreads = TaskScheduler::threadCount();
+	return std::max(size_t(1), std::min(maxThreads, count / std::max(minPerChunk, size_t(1))));
+}
+
+/** Split a range of items in contiguous chunks and process each of them as a task of the scheduler.
+ \param count the number of items
+ \param chunkCount the number of chunks
+ \param func the function to call with the first item, the end of the range and the chunk index
+ */
+template<typename Func>
+static void parallelRanges(size_t count, size_t chunkCount, Func func){
+	if(chunkCount <= 1){
+		func(size_t(0), count, size_t(0));
+		return;
+	}
+	TaskGroup group;
+	for(size_t cid = 1; cid < chunkCount; ++cid){
+		const size_t begin = count * cid / chunkCount;
+		const size_t end = count * (cid + 1) / chunkCount;
+		group.run([&func, begin, end, cid](){
+			func(begin, end, cid);
+		});
+	}
+	// The calling thread processes the first chunk.
+	func(size_t(0), count / chunkCount, size_t(0));
+	group.wait();
+}
+
+/** Compute the bounds of a range of positions. Four positions are processed at once as three registers, each lane always holding the same axis.
+ \param positions the positions
+ \param count the number of positions
+ \param minis will be updated with the lower corner
+ \param maxis will be updated with the upper corner
+ */
+static void computeBounds(const glm::vec3 * positions, size_t count, glm::vec3 & minis, glm::vec3 & maxis){
+	size_t vid = 0;
+#ifdef MESH_SSE
+	static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "Positions must be tightly packed.");
+	if(count >= 4){
+		const float * data = &positions[0][0];
+		__m128 mins[3] = { _mm_loadu_ps(data), _mm_loadu_ps(data + 4), _mm_loadu_ps(data + 8) };
+		__m128 maxs[3] = { mins[0], mins[1], mins[2] };
+		for(; vid + 4 <= count; vid += 4){
+			const float * block = data + 3 * vid;
+			for(int rid = 0; rid < 3; ++rid){
+				const __m128 values = _mm_loadu_ps(block + 4 * rid);
+				mins[rid] = _mm_min_ps(mins[rid], values);
+				maxs[rid] = _mm_max_ps(maxs[rid], values);
+			}
+		}
+		float lanesMin[12];
+		float lanesMax[12];
+		for(int rid = 0; rid < 3; ++rid){
+			_mm_storeu_ps(lanesMin + 4 * rid, mins[rid]);
+			_mm_storeu_ps(lanesMax + 4 * rid, maxs[rid]);
+		}
+		for(int lid = 0; lid < 12; ++lid){
+			minis[lid % 3] = std::min(minis[lid % 3], lanesMin[lid]);
+			maxis[lid % 3] = std::max(maxis[lid % 3], lanesMax[lid]);
+		}
+	}
+#endif
+	for(; vid < count; ++vid){
+		minis = glm::min(minis, positions[vid]);
+		maxis = glm::max(maxis, positions[vid]);
+	}
+}
+
+BoundingBox MeshUtilities::computeBoundingBox(const Mesh & mesh){
 	BoundingBox bbox;
 	if(mesh.positions.empty()){
 		return bbox;
 	}
-	bbox.minis = bbox.maxis = mesh.positions[0];
+	// Per-chunk bounds, merged afterwards.
 	const size_t numVertices = mesh.positions.size();
-	for(size_t vid = 1; vid < numVertices; ++vid){
-		bbox.minis = glm::min(bbox.minis, mesh.positions[vid]);
-		bbox.maxis = glm::max(bbox.maxis, mesh.positions[vid]);
+	const size_t chunkCount = chunkCountFor(numVertices, 1 << 18);
+	std::vector<BoundingBox> chunkBoxes(chunkCount);
+	parallelRanges(numVertices, chunkCount, [&mesh, &chunkBoxes](size_t begin, size_t end, size_t cid){
+		BoundingBox & box = chunkBoxes[cid];
+		box.minis = box.maxis = mesh.positions[begin];
+		computeBounds(&mesh.positions[begin], end - begin, box.minis, box.maxis);
+	});
+	bbox = chunkBoxes[0];
+	for(size_t cid = 1; cid < chunkCount; ++cid){
+		bbox.merge(chunkBoxes[cid]);
 	}
 	return bbox;
 }
 
+#ifdef MESH_AVX
+/** Transform eight consecutive boxes with Arvo's method, each lane processing one box.
+ \param boxes the boxes to transform
+ \param first the first box to process
+ \param matrix the transformation coefficients for each lane: the 3x3 linear part in column major order, followed by the translation
+ \param result will contain the transformed boxes
+ */
+static inline void transformBoxesAVX(const BoundingBoxArray & boxes, size_t first, const __m256 matrix[12], BoundingBoxArray & result){
+	const __m256 half = _mm256_set1_ps(0.5f);
+	const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+	__m256 centers[3];
+	__m256 extents[3];
+	for(int i = 0; i < 3; ++i){
+		const __m256 mins = _mm256_loadu_ps(&boxes.minis[i][first]);
+		const __m256 maxs = _mm256_loadu_ps(&boxes.maxis[i][first]);
+		centers[i] = _mm256_mul_ps(_mm256_add_ps(mins, maxs), half);
+		extents[i] = _mm256_mul_ps(_mm256_sub_ps(maxs, mins), half);
+	}
+	for(int r = 0; r < 3; ++r){
+		__m256 newCenter = matrix[9 + r];
+		__m256 newExtent = _mm256_setzero_ps();
+		for(int c = 0; c < 3; ++c){
+			newCenter = _mm256_add_ps(newCenter, _mm256_mul_ps(matrix[3 * c + r], centers[c]));
+			newExtent = _mm256_add_ps(newExtent, _mm256_mul_ps(_mm256_and_ps(matrix[3 * c + r], absMask), extents[c]));
+		}
+		_mm256_storeu_ps(&result.minis[r][first], _mm256_sub_ps(newCenter, newExtent));
+		_mm256_storeu_ps(&result.maxis[r][first], _mm256_add_ps(newCenter, newExtent));
+	}
+}
+#endif
+
+#ifdef MESH_SSE
+/** Transform four consecutive boxes with Arvo's method, each lane processing one box.
+ \param boxes the boxes to transform
+ \param first the first box to process
+ \param matrix the transformation coefficients for each lane: the 3x3 linear part in column major order, followed by the translation
+ \param result will contain the transformed boxes
+ */
+static inline void transformBoxesSSE(const BoundingBoxArray & boxes, size_t first, const __m128 matrix[12], BoundingBoxArray & result){
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+	__m128 centers[3];
+	__m128 extents[3];
+	for(int i = 0; i < 3; ++i){
+		const __m128 mins = _mm_loadu_ps(&boxes.minis[i][first]);
+		const __m128 maxs = _mm_loadu_ps(&boxes.maxis[i][first]);
+		centers[i] = _mm_mul_ps(_mm_add_ps(mins, maxs), half);
+		extents[i] = _mm_mul_ps(_mm_sub_ps(maxs, mins), half);
+	}
+	for(int r = 0; r < 3; ++r){
+		__m128 newCenter = matrix[9 + r];
+		__m128 newExtent = _mm_setzero_ps();
+		for(int c = 0; c < 3; ++c){
+			newCenter = _mm_add_ps(newCenter, _mm_mul_ps(matrix[3 * c + r], centers[c]));
+			newExtent = _mm_add_ps(newExtent, _mm_mul_ps(_mm_and_ps(matrix[3 * c + r], absMask), extents[c]));
+		}
+		_mm_storeu_ps(&result.minis[r][first], _mm_sub_ps(newCenter, newExtent));
+		_mm_storeu_ps(&result.maxis[r][first], _mm_add_ps(newCenter, newExtent));
+	}
+}
+#endif
+
+void MeshUtilities::transformBoundingBoxes(const BoundingBoxArray & boxes, const glm::mat4 & transformation, BoundingBoxArray & result){
+	const size_t count = boxes.size();
+	result.resize(count);
+	size_t bid = 0;
+#ifdef MESH_AVX
+	__m256 matrix[12];
+	for(int c = 0; c < 4; ++c){
+		for(int r = 0; r < 3; ++r){
+			matrix[3 * c + r] = _mm256_set1_ps(transformation[c][r]);
+		}
+	}
+	for(; bid + 8 <= count; bid += 8){
+		transformBoxesAVX(boxes, bid, matrix, result);
+	}
+#elif defined(MESH_SSE)
+	__m128 matrix[12];
+	for(int c = 0; c < 4; ++c){
+		for(int r = 0; r < 3; ++r){
+			matrix[3 * c + r] = _mm_set1_ps(transformation[c][r]);
+		}
+	}
+	for(; bid + 4 <= count; bid += 4){
+		transformBoxesSSE(boxes, bid, matrix, result);
+	}
+#endif
+	for(; bid < count; ++bid){
+		result.set(bid, boxes.get(bid).transformed(transformation));
+	}
+}
+
+void MeshUtilities::transformBoundingBoxes(const BoundingBoxArray & boxes, const std::vector<glm::mat4> & transformations, BoundingBoxArray & result){
+	const size_t count = std::min(boxes.size(), transformations.size());
+	result.resize(boxes.size());
+	size_t bid = 0;
+#ifdef MESH_AVX
+	for(; bid + 8 <= count; bid += 8){
+		// Gather the coefficients of the eight matrices.
+		const glm::mat4 * m = &transformations[bid];
+		__m256 matrix[12];
+		for(int c = 0; c < 4; ++c){
+			for(int r = 0; r < 3; ++r){
+				matrix[3 * c + r] = _mm256_setr_ps(m[0][c][r], m[1][c][r], m[2][c][r], m[3][c][r], m[4][c][r], m[5][c][r], m[6][c][r], m[7][c][r]);
+			}
+		}
+		transformBoxesAVX(boxes, bid, matrix, result);
+	}
+#elif defined(MESH_SSE)
+	for(; bid + 4 <= count; bid += 4){
+		// Gather the coefficients of the four matrices.
+		const glm::mat4 * m = &transformations[bid];
+		__m128 matrix[12];
+		for(int c = 0; c < 4; ++c){
+			for(int r = 0; r < 3; ++r){
+				matrix[3 * c + r] = _mm_setr_ps(m[0][c][r], m[1][c][r], m[2][c][r], m[3][c][r]);
+			}
+		}
+		transformBoxesSSE(boxes, bid, matrix, result);
+	}
+#endif
+	for(; bid < count; ++bid){
+		result.set(bid, boxes.get(bid).transformed(transformations[bid]));
+	}
+	// Boxes without a transformation are left unchanged.
+	for(; bid < boxes.size(); ++bid){
+		result.set(bid, boxes.get(bid));
+	}
+}
+
+size_t MeshUtilities::cullBoundingBoxes(const BoundingBoxArray & boxes, const Frustum & frustum, std::vector<unsigned char> & visibility){
+	const size_t count = boxes.size();
+	visibility.resize(count);
+	// For each plane, the corner furthest along the normal is picked from the lower or upper coordinates.
+	const float * corners[6][3];
+	for(size_t pid = 0; pid < frustum.count; ++pid){
+		for(int i = 0; i < 3; ++i){
+			corners[pid][i] = frustum.planes[pid][i] >= 0.0f ? boxes.maxis[i].data() : boxes.minis[i].data();
+		}
+	}
+	size_t visibleCount = 0;
+	size_t bid = 0;
+#ifdef MESH_AVX
+	for(; bid + 8 <= count; bid += 8){
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for(size_t pid = 0; pid < frustum.count; ++pid){
+			const glm::vec4 & plane = frustum.planes[pid];
+			__m256 dist = _mm256_set1_ps(plane.w);
+			for(int i = 0; i < 3; ++i){
+				dist = _mm256_add_ps(dist, _mm256_mul_ps(_mm256_set1_ps(plane[i]), _mm256_loadu_ps(corners[pid][i] + bid)));
+			}
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(dist, _mm256_setzero_ps(), _CMP_GE_OQ));
+		}
+		const int mask = _mm256_movemask_ps(inside);
+		for(int lid = 0; lid < 8; ++lid){
+			visibility[bid + lid] = (mask >> lid) & 1;
+			visibleCount += (mask >> lid) & 1;
+		}
+	}
+#elif defined(MESH_SSE)
+	for(; bid + 4 <= count; bid += 4){
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for(size_t pid = 0; pid < frustum.count; ++pid){
+			const glm::vec4 & plane = frustum.planes[pid];
+			__m128 dist = _mm_set1_ps(plane.w);
+			for(int i = 0; i < 3; ++i){
+				dist = _mm_add_ps(dist, _mm_mul_ps(_mm_set1_ps(plane[i]), _mm_loadu_ps(corners[pid][i] + bid)));
+			}
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(dist, _mm_setzero_ps()));
+		}
+		const int mask = _mm_movemask_ps(inside);
+		for(int lid = 0; lid < 4; ++lid){
+			visibility[bid + lid] = (mask >> lid) & 1;
+			visibleCount += (mask >> lid) & 1;
+		}
+	}
+#endif
+	for(; bid < count; ++bid){
+		visibility[bid] = frustum.intersects(boxes.get(bid)) ? 1 : 0;
+		visibleCount += visibility[bid];
+	}
+	return visibleCount;
+}
+
 void MeshUtilities::centerAndUnitMesh(Mesh & mesh){
-	// Compute the centroid.
-	glm::vec3 centroid = glm::vec3(0.0);
-	float maxi = mesh.positions[0].x;
-	for(size_t i = 0; i < mesh.positions.size(); i++){
-		centroid += mesh.positions[i];
-	}
-	centroid /= mesh.positions.size();
-
-	for(size_t i = 0; i < mesh.positions.size(); i++){
-		// Translate  the vertex.
-		mesh.positions[i] -= centroid;
-		// Find the maximal distance from a vertex to the center.
-		maxi = abs(mesh.positions[i].x) > maxi ? abs(mesh.positions[i].x) : maxi;
-		maxi = abs(mesh.positions[i].y) > maxi ? abs(mesh.positions[i].y) : maxi;
-		maxi = abs(mesh.positions[i].z) > maxi ? abs(mesh.positions[i].z) : maxi;
+	const size_t numVertices = mesh.positions.size();
+	if(numVertices == 0){
+		return;
+	}
+	const size_t chunkCount = chunkCountFor(numVertices, 1 << 18);
+
+	// Compute the centroid, from per-chunk sums.
+	std::vector<glm::vec3> chunkSums(chunkCount, glm::vec3(0.0f));
+	parallelRanges(numVertices, chunkCount, [&mesh, &chunkSums](size_t begin, size_t end, size_t cid){
+		glm::vec3 & sum = chunkSums[cid];
+		size_t vid = begin;
+#ifdef MESH_SSE
+		const float * data = &mesh.positions[0][0];
+		__m128 sums[3] = { _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() };
+		for(; vid + 4 <= end; vid += 4){
+			const float * block = data + 3 * vid;
+			for(int rid = 0; rid < 3; ++rid){
+				sums[rid] = _mm_add_ps(sums[rid], _mm_loadu_ps(block + 4 * rid));
+			}
+		}
+		float lanes[12];
+		for(int rid = 0; rid < 3; ++rid){
+			_mm_storeu_ps(lanes + 4 * rid, sums[rid]);
+		}
+		for(int lid = 0; lid < 12; ++lid){
+			sum[lid % 3] += lanes[lid];
+		}
+#endif
+		for(; vid < end; ++vid){
+			sum += mesh.positions[vid];
+		}
+	});
+	glm::vec3 centroid(0.0f);
+	for(size_t cid = 0; cid < chunkCount; ++cid){
+		centroid += chunkSums[cid];
+	}
+	centroid /= float(numVertices);
+	
+	// Translate the vertices and find the maximal distance from a vertex to the center along any axis.
+	std::vector<float> chunkMaxis(chunkCount, 0.0f);
+	parallelRanges(numVertices, chunkCount, [&mesh, &chunkMaxis, &centroid](size_t begin, size_t end, size_t cid){
+		float maxi = 0.0f;
+		size_t vid = begin;
+#ifdef MESH_SSE
+		float * data = &mesh.positions[0][0];
+		// The centroid coordinates, in the order they appear in each register.
+		const __m128 centers[3] = { _mm_setr_ps(centroid.x, centroid.y, centroid.z, centroid.x), _mm_setr_ps(centroid.y, centroid.z, centroid.x, centroid.y), _mm_setr_ps(centroid.z, centroid.x, centroid.y, centroid.z) };
+		const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+		__m128 maxs = _mm_setzero_ps();
+		for(; vid + 4 <= end; vid += 4){
+			float * block = data + 3 * vid;
+			for(int rid = 0; rid < 3; ++rid){
+				const __m128 values = _mm_sub_ps(_mm_loadu_ps(block + 4 * rid), centers[rid]);
+				_mm_storeu_ps(block + 4 * rid, values);
+				maxs = _mm_max_ps(maxs, _mm_and_ps(values, absMask));
+			}
+		}
+		float lanes[4];
+		_mm_storeu_ps(lanes, maxs);
+		maxi = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+#endif
+		for(; vid < end; ++vid){
+			glm::vec3 & position = mesh.positions[vid];
+			position -= centroid;
+			maxi = std::max(maxi, std::max(std::abs(position.x), std::max(std::abs(position.y), std::abs(position.z))));
+		}
+		chunkMaxis[cid] = maxi;
+	});
+	float maxi = 0.0f;
+	for(size_t cid = 0; cid < chunkCount; ++cid){
+		maxi = std::max(maxi, chunkMaxis[cid]);
 	}
 	maxi = maxi == 0.0f ? 1.0f : maxi;
 	
 	// Scale the mesh.
-	for(size_t i = 0; i < mesh.positions.size(); i++){
-		mesh.positions[i] /= maxi;
+	const float scale = 1.0f / maxi;
+	parallelRanges(numVertices, chunkCount, [&mesh, scale](size_t begin, size_t end, size_t){
+		size_t vid = begin;
+#ifdef MESH_SSE
+		float * data = &mesh.positions[0][0];
+		const __m128 scales = _mm_set1_ps(scale);
+		for(; vid + 4 <= end; vid += 4){
+			float * block = data + 3 * vid;
+			for(int rid = 0; rid < 3; ++rid){
+				_mm_storeu_ps(block + 4 * rid, _mm_mul_ps(_mm_loadu_ps(block + 4 * rid), scales));
+			}
+		}
+#endif
+		for(; vid < end; ++vid){
+			mesh.positions[vid] *= scale;
+		}
+	});
+}
+
+/** Accumulate the tangent and bitangent of a range of triangles on their vertices.
+ \param mesh the mesh
+ \param begin the first triangle
+ \param end the end of the triangles range
+ \param frames the tangent and bitangent accumulators, interleaved for each vertex (the w component is unused)
+ */
+static void accumulateTangents(const Mesh & mesh, size_t begin, size_t end, glm::vec4 * frames){
+	const unsigned int * indices = mesh.indices.data();
+#ifdef MESH_SSE
+	// Process each triangle with its vectors in registers, and accumulate with a single addition per vector.
+	const __m128 ones = _mm_set1_ps(1.0f);
+	const __m128 epsilons = _mm_set1_ps(0.001f);
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+	for(size_t tid = begin; tid < end; ++tid){
+		const unsigned int * tri = indices + 3 * tid;
+		const glm::vec3 & p0 = mesh.positions[tri[0]];
+		const glm::vec3 & p1 = mesh.positions[tri[1]];
+		const glm::vec3 & p2 = mesh.positions[tri[2]];
+		const __m128 v0 = _mm_setr_ps(p0.x, p0.y, p0.z, 0.0f);
+		const __m128 dp1 = _mm_sub_ps(_mm_setr_ps(p1.x, p1.y, p1.z, 0.0f), v0);
+		const __m128 dp2 = _mm_sub_ps(_mm_setr_ps(p2.x, p2.y, p2.z, 0.0f), v0);
+		const glm::vec2 & uv0 = mesh.texcoords[tri[0]];
+		const glm::vec2 deltaUv1 = mesh.texcoords[tri[1]] - uv0;
+		const glm::vec2 deltaUv2 = mesh.texcoords[tri[2]] - uv0;
+		// Broadcast (u1, v1, u2, v2) to compute the denominator in all lanes.
+		const __m128 du1 = _mm_set1_ps(deltaUv1.x);
+		const __m128 dv1 = _mm_set1_ps(deltaUv1.y);
+		const __m128 du2 = _mm_set1_ps(deltaUv2.x);
+		const __m128 dv2 = _mm_set1_ps(deltaUv2.y);
+		const __m128 denom = _mm_sub_ps(_mm_mul_ps(du1, dv2), _mm_mul_ps(dv1, du2));
+		// Avoid divide-by-zero if same UVs.
+		const __m128 degenerate = _mm_cmplt_ps(_mm_and_ps(denom, absMask), epsilons);
+		const __m128 det = _mm_or_ps(_mm_and_ps(degenerate, ones), _mm_andnot_ps(degenerate, _mm_div_ps(ones, denom)));
+		const __m128 tangent = _mm_mul_ps(det, _mm_sub_ps(_mm_mul_ps(dp1, dv2), _mm_mul_ps(dp2, dv1)));
+		const __m128 bitangent = _mm_mul_ps(det, _mm_sub_ps(_mm_mul_ps(dp2, du1), _mm_mul_ps(dp1, du2)));
+		// Accumulate them. We don't normalize to get a free weighting based on the size of the face.
+		for(int v = 0; v < 3; ++v){
+			float * frame = &frames[2 * tri[v]][0];
+			_mm_storeu_ps(frame, _mm_add_ps(_mm_loadu_ps(frame), tangent));
+			_mm_storeu_ps(frame + 4, _mm_add_ps(_mm_loadu_ps(frame + 4), bitangent));
+		}
+	}
+#else
+	for(size_t tid = begin; tid < end; ++tid){
+		const unsigned int * tri = indices + 3 * tid;
+		const glm::vec3 & v0 = mesh.positions[tri[0]];
+		const glm::vec2 & uv0 = mesh.texcoords[tri[0]];
+		const glm::vec3 deltaPosition1 = mesh.positions[tri[1]] - v0;
+		const glm::vec3 deltaPosition2 = mesh.positions[tri[2]] - v0;
+		const glm::vec2 deltaUv1 = mesh.texcoords[tri[1]] - uv0;
+		const glm::vec2 deltaUv2 = mesh.texcoords[tri[2]] - uv0;
+		const float denom = deltaUv1.x * deltaUv2.y - deltaUv1.y * deltaUv2.x;
+		// Avoid divide-by-zero if same UVs.
+		const float det = (std::abs(denom) < 0.001f) ? 1.0f : (1.0f / denom);
+		const glm::vec4 tangent(det * (deltaPosition1 * deltaUv2.y - deltaPosition2 * deltaUv1.y), 0.0f);
+		const glm::vec4 bitangent(det * (deltaPosition2 * deltaUv1.x - deltaPosition1 * deltaUv2.x), 0.0f);
+		// Accumulate them. We don't normalize to get a free weighting based on the size of the face.
+		for(int v = 0; v < 3; ++v){
+			frames[2 * tri[v]] += tangent;
+			frames[2 * tri[v] + 1] += bitangent;
+		}
 	}
+#endif
 }
 
-void MeshUtilities::computeTangentsAndBinormals(Mesh & mesh){
-	if(mesh.indices.size() * mesh.positions.size() * mesh.texcoords.size() == 0){
+void MeshUtilities::computeTangents(Mesh & mesh){
+	const size_t vertCount = mesh.positions.size();
+	if(mesh.indices.empty() || vertCount == 0 || mesh.texcoords.size() < vertCount || mesh.normals.size() < vertCount){
 		// Missing data, or not the right mode (Points).
 		return;
 	}
-	// Start by filling everything with 0 (as we want to accumulate tangents and binormals coming from different faces for each vertex).
-	for(size_t pid = 0; pid < mesh.positions.size(); ++pid){
-		mesh.tangents.push_back(glm::vec3(0.0f));
-		mesh.binormals.push_back(glm::vec3(0.0f));
-	}
-	// Then, compute both vectors for each face and accumulate them.
-	for(size_t fid = 0; fid < mesh.indices.size(); fid += 3){
-
-		// Get the vertices of the face.
-		glm::vec3 & v0 = mesh.positions[mesh.indices[fid]];
-		glm::vec3 & v1 = mesh.positions[mesh.indices[fid+1]];
-		glm::vec3 & v2 = mesh.positions[mesh.indices[fid+2]];
-		// Get the uvs of the face.
-		glm::vec2 & uv0 = mesh.texcoords[mesh.indices[fid]];
-		glm::vec2 & uv1 = mesh.texcoords[mesh.indices[fid+1]];
-		glm::vec2 & uv2 = mesh.texcoords[mesh.indices[fid+2]];
-
-		// Delta positions and uvs.
-		glm::vec3 deltaPosition1 = v1 - v0;
-		glm::vec3 deltaPosition2 = v2 - v0;
-		glm::vec2 deltaUv1 = uv1 - uv0;
-		glm::vec2 deltaUv2 = uv2 - uv0;
-
-		// Compute tangent and binormal for the face.
-		const float denom = deltaUv1.x * deltaUv2.y - deltaUv1.y * deltaUv2.x;
-		// Avoid divide-by-zero if same UVs.
-		float det = (abs(denom) < 0.001f) ? 1.0f : (1.0f / denom);
-    	glm::vec3 tangent = det * (deltaPosition1 * deltaUv2.y   - deltaPosition2 * deltaUv1.y);
-    	glm::vec3 binormal = det * (deltaPosition2 * deltaUv1.x   - deltaPosition1 * deltaUv2.x);
-
-    	// Accumulate them. We don't normalize to get a free weighting based on the size of the face.
-    	mesh.tangents[mesh.indices[fid]] += tangent;
-    	mesh.tangents[mesh.indices[fid+1]] += tangent;
-    	mesh.tangents[mesh.indices[fid+2]] += tangent;
-
-    	mesh.binormals[mesh.indices[fid]] += binormal;
-    	mesh.binormals[mesh.indices[fid+1]] += binormal;
-    	mesh.binormals[mesh.indices[fid+2]] += binormal;
-	}
-	// Finally, enforce orthogonality and good orientation of the basis.
-	for(size_t tid = 0; tid < mesh.tangents.size(); ++tid){
-		mesh.tangents[tid] = normalize(mesh.tangents[tid] - mesh.normals[tid] * dot(mesh.normals[tid], mesh.tangents[tid]));
-		if(dot(cross(mesh.normals[tid], mesh.tangents[tid]), mesh.binormals[tid]) < 0.0f){
-			mesh.tangents[tid] *= -1.0f;
- 		}
-	}
-	Log::Verbose() << Log::Resources << "Mesh: " << mesh.tangents.size() << " tangents and binormals computed." << std::endl;
+	// Only the full resolution level is considered.
+	const size_t triCount = (mesh.levels.empty() ? mesh.indices.size() : mesh.levels[0].count) / 3;
+	
+	// Each thread accumulates the contributions of its triangles in its own buffers, that are summed afterwards.
+	const size_t chunkCount = chunkCountFor(triCount, 1 << 15);
+	std::vector<glm::vec4> frames(chunkCount * 2 * vertCount, glm::vec4(0.0f));
+	parallelRanges(triCount, chunkCount, [&](size_t begin, size_t end, size_t cid){
+		accumulateTangents(mesh, begin, end, &frames[cid * 2 * vertCount]);
+	});
+	
+	// Then, sum the contributions, enforce orthogonality and store the orientation of the basis.
+	mesh.tangents.resize(vertCount);
+	parallelRanges(vertCount, chunkCountFor(vertCount, 1 << 16), [&](size_t begin, size_t end, size_t){
+		for(size_t vid = begin; vid < end; ++vid){
+			glm::vec3 tangent(frames[2 * vid]);
+			glm::vec3 bitangent(frames[2 * vid + 1]);
+			for(size_t cid = 1; cid < chunkCount; ++cid){
+				tangent += glm::vec3(frames[2 * (cid * vertCount + vid)]);
+				bitangent += glm::vec3(frames[2 * (cid * vertCount + vid) + 1]);
+			}
+			const glm::vec3 & normal = mesh.normals[vid];
+			tangent -= normal * glm::dot(normal, tangent);
+			const float length = glm::length(tangent);
+			if(length > 0.0f){
+				tangent /= length;
+			} else {
+				// Degenerate uvs, pick any direction orthogonal to the normal.
+				tangent = glm::normalize(std::abs(normal.x) > 0.9f ? glm::cross(normal, glm::vec3(0.0f, 1.0f, 0.0f)) : glm::cross(normal, glm::vec3(1.0f, 0.0f, 0.0f)));
+			}
+			const float handedness = glm::dot(glm::cross(normal, tangent), bitangent) < 0.0f ? -1.0f : 1.0f;
+			mesh.tangents[vid] = glm::vec4(tangent, handedness);
+		}
+	});
+	Log::Verbose() << Log::Resources << "Mesh: " << mesh.tangents.size() << " tangents computed." << std::endl;
+}
+
+
+void MeshUtilities::extractPositions(const Mesh & mesh, Mesh & positionMesh){
+	positionMesh = Mesh();
+	const size_t vertCount = mesh.positions.size();
+	// Sort vertices by position, so that identical positions are contiguous.
+	std::vector<unsigned int> sorted(vertCount);
+	for(size_t vid = 0; vid < vertCount; ++vid){
+		sorted[vid] = (unsigned int)vid;
+	}
+	std::sort(sorted.begin(), sorted.end(), [&mesh](unsigned int a, unsigned int b){
+		const glm::vec3 & pa = mesh.positions[a];
+		const glm::vec3 & pb = mesh.positions[b];
+		return pa.x < pb.x || (pa.x == pb.x && (pa.y < pb.y || (pa.y == pb.y && pa.z < pb.z)));
+	});
+	std::vector<unsigned int> remap(vertCount);
+	for(size_t sid = 0; sid < vertCount; ++sid){
+		const unsigned int vid = sorted[sid];
+		if(sid == 0 || mesh.positions[vid] != positionMesh.positions.back()){
+			positionMesh.positions.push_back(mesh.positions[vid]);
+		}
+		remap[vid] = (unsigned int)(positionMesh.positions.size() - 1);
+	}
+	positionMesh.indices.resize(mesh.indices.size());
+	for(size_t iid = 0; iid < mesh.indices.size(); ++iid){
+		positionMesh.indices[iid] = remap[mesh.indices[iid]];
+	}
+	positionMesh.levels = mesh.levels;
+	positionMesh.meshlets = mesh.meshlets;
+}
+
+MeshUtilities::CacheStatistics MeshUtilities::computeCacheStatistics(const Mesh & mesh, unsigned int cacheSize){
+	CacheStatistics stats;
+	// Only consider the full resolution level.
+	const size_t indexCount = mesh.levels.empty() ? mesh.indices.size() : mesh.levels[0].count;
+	if(indexCount == 0){
+		return stats;
+	}
+	// A vertex is in the cache if it has been transformed less than cacheSize misses ago.
+	std::vector<unsigned int> cacheTime(mesh.positions.size(), 0);
+	std::vector<bool> used(mesh.positions.size(), false);
+	unsigned int timestamp = cacheSize + 1;
+	unsigned int misses = 0;
+	unsigned int usedCount = 0;
+	for(size_t iid = 0; iid < indexCount; ++iid){
+		const unsigned int vid = mesh.indices[iid];
+		if(timestamp - cacheTime[vid] > cacheSize){
+			cacheTime[vid] = timestamp;
+			++timestamp;
+			++misses;
+		}
+		if(!used[vid]){
+			used[vid] = true;
+			++usedCount;
+		}
+	}
+	stats.acmr = float(misses) / float(indexCount / 3);
+	stats.atvr = float(misses) / float(usedCount);
+	return stats;
+}
+
+/** Reorder a list of triangles for the post-transform vertex cache, using Tipsify.
+ \param indices the triangles indices, reordered in place
+ \param vertCount the number of vertices
+ \param cacheSize the number of entries in the target cache
+ \param clusters will contain the index of the first triangle of each cluster
+ */
+static void reorderForVertexCache(std::vector<unsigned int> & indices, size_t vertCount, unsigned int cacheSize, std::vector<unsigned int> & clusters){
+	clusters.clear();
+	const size_t triCount = indices.size() / 3;
+	if(triCount == 0){
+		return;
+	}
+	
+	// Build the vertex-triangle adjacency, as a flat list of triangles with an offset for each vertex.
+	std::vector<unsigned int> liveCount(vertCount, 0);
+	for(const unsigned int vid : indices){
+		++liveCount[vid];
+	}
+	std::vector<unsigned int> offsets(vertCount + 1, 0);
+	for(size_t vid = 0; vid < vertCount; ++vid){
+		offsets[vid+1] = offsets[vid] + liveCount[vid];
+	}
+	std::vector<unsigned int> adjacency(indices.size());
+	std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+	for(size_t iid = 0; iid < indices.size(); ++iid){
+		adjacency[fill[indices[iid]]++] = (unsigned int)(iid / 3);
+	}
+	
+	std::vector<unsigned int> cacheTime(vertCount, 0);
+	std::vector<bool> emitted(triCount, false);
+	std::vector<unsigned int> deadEnd;
+	deadEnd.reserve(indices.size());
+	std::vector<unsigned int> candidates;
+	std::vector<unsigned int> newIndices;
+	newIndices.reserve(indices.size());
+	unsigned int timestamp = cacheSize + 1;
+	size_t cursor = 0;
+	
+	// Find the next vertex with remaining triangles, first in the dead-end stack then in input order.
+	auto skipDeadEnd = [&](unsigned int & vertex) -> bool {
+		while(!deadEnd.empty()){
+			const unsigned int vid = deadEnd.back();
+			deadEnd.pop_back();
+			if(liveCount[vid] > 0){
+				vertex = vid;
+				return true;
+			}
+		}
+		while(cursor < vertCount){
+			if(liveCount[cursor] > 0){
+				vertex = (unsigned int)cursor;
+				return true;
+			}
+			++cursor;
+		}
+		return false;
+	};
+	
+	unsigned int fanning = 0;
+	bool hasFanning = skipDeadEnd(fanning);
+	clusters.push_back(0);
+	
+	while(hasFanning){
+		// Emit all remaining triangles around the fanning vertex.
+		candidates.clear();
+		for(unsigned int aid = offsets[fanning]; aid < offsets[fanning+1]; ++aid){
+			const unsigned int tid = adjacency[aid];
+			if(emitted[tid]){
+				continue;
+			}
+			for(unsigned int k = 0; k < 3; ++k){
+				const unsigned int vid = indices[3*tid+k];
+				newIndices.push_back(vid);
+				deadEnd.push_back(vid);
+				candidates.push_back(vid);
+				--liveCount[vid];
+				if(timestamp - cacheTime[vid] > cacheSize){
+					cacheTime[vid] = timestamp;
+					++timestamp;
+				}
+			}
+			emitted[tid] = true;
+		}
+		
+		// Pick the next fanning vertex: the oldest one that will still be in the cache after emitting all its triangles.
+		int bestPriority = -1;
+		for(const unsigned int vid : candidates){
+			if(liveCount[vid] == 0){
+				continue;
+			}
+			int priority = 0;
+			if(timestamp - cacheTime[vid] + 2 * liveCount[vid] <= cacheSize){
+				priority = int(timestamp - cacheTime[vid]);
+			}
+			if(priority > bestPriority){
+				bestPriority = priority;
+				fanning = vid;
+			}
+		}
+		if(bestPriority < 0){
+			// Dead-end, jump to another region of the mesh.
+			hasFanning = skipDeadEnd(fanning);
+			if(hasFanning){
+				clusters.push_back((unsigned int)(newIndices.size() / 3));
+			}
+		}
+	}
+	indices.swap(newIndices);
+}
+
+void MeshUtilities::optimizeVertexCache(Mesh & mesh, unsigned int cacheSize, std::vector<unsigned int> & clusters){
+	clusters.clear();
+	if(mesh.levels.empty() && mesh.meshlets.empty()){
+		reorderForVertexCache(mesh.indices, mesh.positions.size(), cacheSize, clusters);
+		return;
+	}
+	// Reorder each range separately, keeping their bounds.
+	std::vector<std::pair<unsigned int, unsigned int>> ranges;
+	for(const Meshlet & meshlet : mesh.meshlets){
+		ranges.emplace_back(meshlet.firstIndex, meshlet.count);
+	}
+	if(mesh.meshlets.empty()){
+		ranges.emplace_back(0, mesh.levels.empty() ? (unsigned int)mesh.indices.size() : mesh.levels[0].count);
+	}
+	for(size_t lid = 1; lid < mesh.levels.size(); ++lid){
+		ranges.emplace_back(mesh.levels[lid].firstIndex, mesh.levels[lid].count);
+	}
+	std::vector<unsigned int> rangeClusters;
+	for(size_t rid = 0; rid < ranges.size(); ++rid){
+		const auto begin = mesh.indices.begin() + ranges[rid].first;
+		std::vector<unsigned int> rangeIndices(begin, begin + ranges[rid].second);
+		// Clusters are only reported for the full resolution level, if it was processed as a whole.
+		const bool report = (rid == 0 && mesh.meshlets.empty());
+		reorderForVertexCache(rangeIndices, mesh.positions.size(), cacheSize, report ? clusters : rangeClusters);
+		std::copy(rangeIndices.begin(), rangeIndices.end(), begin);
+	}
+}
+
+void MeshUtilities::optimizeOverdraw(Mesh & mesh, const std::vector<unsigned int> & clusters, unsigned int cacheSize, float threshold){
+	// Only the full resolution level is reordered.
+	const size_t triCount = (mesh.levels.empty() ? mesh.indices.size() : mesh.levels[0].count) / 3;
+	if(triCount == 0 || clusters.empty()){
+		return;
+	}
+
+	// Split the clusters further, where the cache miss ratio from a cold cache gets close to the one of the whole cluster.
+	std::vector<unsigned int> cacheTime(mesh.positions.size(), 0);
+	unsigned int timestamp = cacheSize + 1;
+	// Simulate a cold cache on a range of triangles, return the number of misses.
+	auto countMisses = [&](unsigned int begin, unsigned int end){
+		timestamp += cacheSize + 1;
+		unsigned int misses = 0;
+		for(unsigned int iid = 3 * begin; iid < 3 * end; ++iid){
+			const unsigned int vid = mesh.indices[iid];
+			if(timestamp - cacheTime[vid] > cacheSize){
+				cacheTime[vid] = timestamp;
+				++timestamp;
+				++misses;
+			}
+		}
+		return misses;
+	};
+	
+	std::vector<unsigned int> starts;
+	for(size_t cid = 0; cid < clusters.size(); ++cid){
+		const unsigned int begin = clusters[cid];
+		const unsigned int end = (cid + 1 < clusters.size()) ? clusters[cid+1] : (unsigned int)triCount;
+		const float targetMisses = threshold * float(countMisses(begin, end)) / float(end - begin);
+		starts.push_back(begin);
+		unsigned int subBegin = begin;
+		unsigned int misses = 0;
+		// Reset the cache.
+		timestamp += cacheSize + 1;
+		for(unsigned int tid = begin; tid < end; ++tid){
+			for(unsigned int k = 0; k < 3; ++k){
+				const unsigned int vid = mesh.indices[3*tid+k];
+				if(timestamp - cacheTime[vid] > cacheSize){
+					cacheTime[vid] = timestamp;
+					++timestamp;
+					++misses;
+				}
+			}
+			if(tid + 1 < end && float(misses) <= targetMisses * float(tid + 1 - subBegin)){
+				subBegin = tid + 1;
+				starts.push_back(subBegin);
+				misses = 0;
+				timestamp += cacheSize + 1;
+			}
+		}
+	}
+
+	// Compute the mesh centroid.
+	glm::vec3 meshCentroid(0.0f);
+	for(const glm::vec3 & pos : mesh.positions){
+		meshCentroid += pos;
+	}
+	meshCentroid /= float(std::max(mesh.positions.size(), size_t(1)));
+
+	// Sort clusters by decreasing dot(cluster centroid - mesh centroid, cluster normal): outward facing clusters first.
+	std::vector<float> sortKeys(starts.size());
+	for(size_t cid = 0; cid < starts.size(); ++cid){
+		const unsigned int begin = starts[cid];
+		const unsigned int end = (cid + 1 < starts.size()) ? starts[cid+1] : (unsigned int)triCount;
+		glm::vec3 centroid(0.0f);
+		glm::vec3 normal(0.0f);
+		float area = 0.0f;
+		for(unsigned int tid = begin; tid < end; ++tid){
+			const glm::vec3 & v0 = mesh.positions[mesh.indices[3*tid]];
+			const glm::vec3 & v1 = mesh.positions[mesh.indices[3*tid+1]];
+			const glm::vec3 & v2 = mesh.positions[mesh.indices[3*tid+2]];
+			// Weight by the triangle area.
+			const glm::vec3 faceNormal = glm::cross(v1 - v0, v2 - v0);
+			const float faceArea = glm::length(faceNormal);
+			centroid += faceArea * (v0 + v1 + v2) / 3.0f;
+			normal += faceNormal;
+			area += faceArea;
+		}
+		centroid = area > 0.0f ? centroid / area : mesh.positions[mesh.indices[3*begin]];
+		const float normalLength = glm::length(normal);
+		sortKeys[cid] = normalLength > 0.0f ? glm::dot(centroid - meshCentroid, normal / normalLength) : 0.0f;
+	}
+	std::vector<unsigned int> order(starts.size());
+	for(size_t cid = 0; cid < order.size(); ++cid){
+		order[cid] = (unsigned int)cid;
+	}
+	std::stable_sort(order.begin(), order.end(), [&sortKeys](unsigned int a, unsigned int b){
+		return sortKeys[a] > sortKeys[b];
+	});
+	
+	std::vector<unsigned int> newIndices;
+	newIndices.reserve(mesh.indices.size());
+	for(const unsigned int cid : order){
+		const unsigned int begin = starts[cid];
+		const unsigned int end = (cid + 1 < starts.size()) ? starts[cid+1] : (unsigned int)triCount;
+		newIndices.insert(newIndices.end(), mesh.indices.begin() + 3 * begin, mesh.indices.begin() + 3 * end);
+	}
+	newIndices.insert(newIndices.end(), mesh.indices.begin() + 3 * triCount, mesh.indices.end());
+	mesh.indices.swap(newIndices);
+}
+
+/** Move each element of an attribute array to its new position.
+ \param attribs the attribute array, ignored if empty
+ \param remap the new position of each element
+ */
+template<typename T>
+static void permuteAttribute(std::vector<T> & attribs, const std::vector<unsigned int> & remap){
+	if(attribs.size() != remap.size()){
+		return;
+	}
+	std::vector<T> newAttribs(attribs.size());
+	for(size_t vid = 0; vid < remap.size(); ++vid){
+		newAttribs[remap[vid]] = attribs[vid];
+	}
+	attribs.swap(newAttribs);
+}
+
+void MeshUtilities::optimizeVertexFetch(Mesh & mesh){
+	const size_t vertCount = mesh.positions.size();
+	if(vertCount == 0){
+		return;
+	}
+	// Assign new indices in order of first use.
+	const unsigned int unassigned = 0xFFFFFFFF;
+	std::vector<unsigned int> remap(vertCount, unassigned);
+	unsigned int nextId = 0;
+	for(unsigned int & vid : mesh.indices){
+		if(remap[vid] == unassigned){
+			remap[vid] = nextId++;
+		}
+		vid = remap[vid];
+	}
+	for(size_t vid = 0; vid < vertCount; ++vid){
+		if(remap[vid] == unassigned){
+			remap[vid] = nextId++;
+		}
+	}
+	
+	// Permute each existing attribute.
+	permuteAttribute(mesh.positions, remap);
+	permuteAttribute(mesh.normals, remap);
+	permuteAttribute(mesh.tangents, remap);
+	permuteAttribute(mesh.texcoords, remap);
 }
 
+void MeshUtilities::buildMeshlets(Mesh & mesh, unsigned int maxVertices, unsigned int maxTriangles){
+	mesh.meshlets.clear();
+	const size_t indexCount = mesh.levels.empty() ? mesh.indices.size() : mesh.levels[0].count;
+	const size_t triCount = indexCount / 3;
+	const size_t vertCount = mesh.positions.size();
+	if(triCount == 0 || maxVertices < 3 || maxTriangles == 0){
+		return;
+	}
+	
+	// Triangles centroids and normals.
+	std::vector<glm::vec3> centroids(triCount);
+	std::vector<glm::vec3> normals(triCount);
+	for(size_t tid = 0; tid < triCount; ++tid){
+		const glm::vec3 & v0 = mesh.positions[mesh.indices[3*tid]];
+		const glm::vec3 & v1 = mesh.positions[mesh.indices[3*tid+1]];
+		const glm::vec3 & v2 = mesh.positions[mesh.indices[3*tid+2]];
+		centroids[tid] = (v0 + v1 + v2) / 3.0f;
+		const glm::vec3 normal = glm::cross(v1 - v0, v2 - v0);
+		const float area = glm::length(normal);
+		normals[tid] = area > 0.0f ? normal / area : glm::vec3(0.0f);
+	}
+	
+	// Vertex to triangles adjacency.
+	std::vector<unsigned int> offsets(vertCount + 1, 0);
+	for(size_t iid = 0; iid < indexCount; ++iid){
+		++offsets[mesh.indices[iid]+1];
+	}
+	for(size_t vid = 0; vid < vertCount; ++vid){
+		offsets[vid+1] += offsets[vid];
+	}
+	std::vector<unsigned int> adjacency(indexCount);
+	std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+	for(size_t iid = 0; iid < indexCount; ++iid){
+		adjacency[fill[mesh.indices[iid]]++] = (unsigned int)(iid / 3);
+	}
+	
+	std::vector<bool> assigned(triCount, false);
+	// Index of the last cluster each vertex was added to, to test membership.
+	std::vector<unsigned int> vertexCluster(vertCount, 0xFFFFFFFF);
+	std::vector<unsigned int> newIndices;
+	newIndices.reserve(mesh.indices.size());
+	std::vector<unsigned int> clusterTriangles;
+	std::vector<unsigned int> clusterVertices;
+	std::vector<unsigned int> cacheClusters;
+	
+	for(size_t seed = 0; seed < triCount; ++seed){
+		if(assigned[seed]){
+			continue;
+		}
+		const unsigned int clusterId = (unsigned int)mesh.meshlets.size();
+		clusterTriangles.clear();
+		clusterVertices.clear();
+		glm::vec3 centroidSum(0.0f);
+		glm::vec3 normalSum(0.0f);
+		
+		auto addTriangle = [&](unsigned int tid){
+			assigned[tid] = true;
+			clusterTriangles.push_back(tid);
+			centroidSum += centroids[tid];
+			normalSum += normals[tid];
+			for(size_t k = 0; k < 3; ++k){
+				const unsigned int vid = mesh.indices[3*tid+k];
+				if(vertexCluster[vid] != clusterId){
+					vertexCluster[vid] = clusterId;
+					clusterVertices.push_back(vid);
+				}
+			}
+		};
+		addTriangle((unsigned int)seed);
+		
+		// Grow the cluster with adjacent triangles, preferring the ones that add few vertices, are close and share the cluster orientation.
+		while(clusterTriangles.size() < maxTriangles){
+			const glm::vec3 center = centroidSum / float(clusterTriangles.size());
+			const float normalLength = glm::length(normalSum);
+			const glm::vec3 axis = normalLength > 0.0f ? normalSum / normalLength : glm::vec3(0.0f);
+			float radius = 0.0f;
+			for(const unsigned int vid : clusterVertices){
+				radius = std::max(radius, glm::length(mesh.positions[vid] - center));
+			}
+			radius = std::max(radius, 1e-6f);
+			
+			unsigned int best = 0xFFFFFFFF;
+			float bestScore = std::numeric_limits<float>::max();
+			for(const unsigned int vid : clusterVertices){
+				for(unsigned int aid = offsets[vid]; aid < offsets[vid+1]; ++aid){
+					const unsigned int tid = adjacency[aid];
+					if(assigned[tid]){
+						continue;
+					}
+					unsigned int newVertices = 0;
+					for(size_t k = 0; k < 3; ++k){
+						newVertices += (vertexCluster[mesh.indices[3*tid+k]] != clusterId) ? 1 : 0;
+					}
+					if(clusterVertices.size() + newVertices > maxVertices){
+						continue;
+					}
+					const float score = float(newVertices) + glm::length(centroids[tid] - center) / radius + (1.0f - glm::dot(normals[tid], axis));
+					if(score < bestScore){
+						bestScore = score;
+						best = tid;
+					}
+				}
+			}
+			if(best == 0xFFFFFFFF){
+				break;
+			}
+			addTriangle(best);
+		}
+		
+		// Emit the cluster triangles, reordered for the vertex cache.
+		std::vector<unsigned int> clusterIndices;
+		clusterIndices.reserve(3 * clusterTriangles.size());
+		for(const unsigned int tid : clusterTriangles){
+			clusterIndices.insert(clusterIndices.end(), mesh.indices.begin() + 3 * tid, mesh.indices.begin() + 3 * tid + 3);
+		}
+		reorderForVertexCache(clusterIndices, vertCount, 16, cacheClusters);
+		
+		Meshlet meshlet;
+		meshlet.firstIndex = (unsigned int)newIndices.size();
+		meshlet.count = (unsigned int)clusterIndices.size();
+		newIndices.insert(newIndices.end(), clusterIndices.begin(), clusterIndices.end());
+		
+		// Bounding sphere centered on the vertices bounding box.
+		glm::vec3 minis = mesh.positions[clusterVertices[0]];
+		glm::vec3 maxis = minis;
+		for(const unsigned int vid : clusterVertices){
+			minis = glm::min(minis, mesh.positions[vid]);
+			maxis = glm::max(maxis, mesh.positions[vid]);
+		}
+		meshlet.bounds.center = 0.5f * (minis + maxis);
+		meshlet.bounds.radius = 0.0f;
+		for(const unsigned int vid : clusterVertices){
+			meshlet.bounds.radius = std::max(meshlet.bounds.radius, glm::length(mesh.positions[vid] - meshlet.bounds.center));
+		}
+		
+		// Normal cone: average normal, and widest deviation from it.
+		const float normalLength = glm::length(normalSum);
+		meshlet.coneAxis = normalLength > 0.0f ? normalSum / normalLength : glm::vec3(0.0f, 0.0f, 1.0f);
+		float minDot = 1.0f;
+		for(const unsigned int tid : clusterTriangles){
+			minDot = std::min(minDot, glm::dot(normals[tid], meshlet.coneAxis));
+		}
+		// Degenerate normals have a zero dot product and disable the cone.
+		meshlet.coneCutoff = (normalLength == 0.0f || minDot <= 0.0f) ? 1.0f : std::sqrt(1.0f - minDot * minDot);
+		mesh.meshlets.push_back(meshlet);
+	}
+	
+	newIndices.insert(newIndices.end(), mesh.indices.begin() + indexCount, mesh.indices.end());
+	mesh.indices.swap(newIndices);
+	Log::Verbose() << Log::Resources << "Mesh: " << mesh.meshlets.size() << " clusters, " << (float(triCount) / float(mesh.meshlets.size())) << " faces on average." << std::endl;
+}
+
+/**
+ \brief Symmetric 4x4 quadric, accumulating squared distances to a set of planes, weighted by area.
+ */
+struct Quadric {
+	double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0; ///< Plane normals outer products.
+	double b0 = 0.0, b1 = 0.0, b2 = 0.0; ///< Normals scaled by the plane offsets.
+	double c = 0.0; ///< Squared plane offsets.
+	double weight = 0.0; ///< Total weight.
+	
+	/** Accumulate the quadric of a plane.
+	 \param n the unit plane normal
+	 \param d the plane offset
+	 \param w the plane weight
+	 */
+	void addPlane(const glm::dvec3 & n, double d, double w){
+		a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z;
+		a11 += w * n.y * n.y; a12 += w * n.y * n.z; a22 += w * n.z * n.z;
+		b0 += w * n.x * d; b1 += w * n.y * d; b2 += w * n.z * d;
+		c += w * d * d;
+		weight += w;
+	}
+	
+	/** Accumulate another quadric.
+	 \param q the quadric to add
+	 */
+	void add(const Quadric & q){
+		a00 += q.a00; a01 += q.a01; a02 += q.a02; a11 += q.a11; a12 += q.a12; a22 += q.a22;
+		b0 += q.b0; b1 += q.b1; b2 += q.b2;
+		c += q.c; weight += q.weight;
+	}
+	
+	/** Evaluate the mean squared distance from a point to the planes.
+	 \param p the point
+	 \return the mean squared distance
+	 */
+	double evaluate(const glm::vec3 & p) const {
+		const double x = p.x, y = p.y, z = p.z;
+		const double value = a00 * x * x + a11 * y * y + a22 * z * z + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z) + 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+		return weight > 0.0 ? std::max(value / weight, 0.0) : 0.0;
+	}
+};
+
+float MeshUtilities::simplify(const Mesh & mesh, std::vector<unsigned int> & indices, size_t targetCount, float maxError){
+	const size_t vertCount = mesh.positions.size();
+	const float radius = computeBoundingBox(mesh).getSphere().radius;
+	if(indices.size() <= targetCount || vertCount == 0 || radius <= 0.0f){
+		return 0.0f;
+	}
+	const double maxSquaredError = double(maxError * radius) * double(maxError * radius);
+	
+	// Lock vertices sharing their position with others (attribute seams).
+	std::vector<bool> locked(vertCount, false);
+	{
+		std::vector<unsigned int> sorted(vertCount);
+		for(size_t vid = 0; vid < vertCount; ++vid){
+			sorted[vid] = (unsigned int)vid;
+		}
+		std::sort(sorted.begin(), sorted.end(), [&mesh](unsigned int a, unsigned int b){
+			const glm::vec3 & pa = mesh.positions[a];
+			const glm::vec3 & pb = mesh.positions[b];
+			return pa.x < pb.x || (pa.x == pb.x && (pa.y < pb.y || (pa.y == pb.y && pa.z < pb.z)));
+		});
+		for(size_t sid = 1; sid < vertCount; ++sid){
+			if(mesh.positions[sorted[sid]] == mesh.positions[sorted[sid-1]]){
+				locked[sorted[sid]] = locked[sorted[sid-1]] = true;
+			}
+		}
+	}
+	// Lock vertices on borders: half-edges without an opposite half-edge.
+	{
+		std::vector<uint64_t> halfEdges;
+		halfEdges.reserve(indices.size());
+		for(size_t iid = 0; iid < indices.size(); iid += 3){
+			for(size_t k = 0; k < 3; ++k){
+				halfEdges.push_back((uint64_t(indices[iid+k]) << 32) | uint64_t(indices[iid+(k+1)%3]));
+			}
+		}
+		std::sort(halfEdges.begin(), halfEdges.end());
+		for(const uint64_t edge : halfEdges){
+			const uint64_t opposite = (edge << 32) | (edge >> 32);
+			if(!std::binary_search(halfEdges.begin(), halfEdges.end(), opposite)){
+				locked[size_t(edge >> 32)] = locked[size_t(edge & 0xFFFFFFFF)] = true;
+			}
+		}
+	}
+	
+	// Accumulate the planes of the triangles around each vertex.
+	std::vector<Quadric> quadrics(vertCount);
+	for(size_t iid = 0; iid < indices.size(); iid += 3){
+		const glm::dvec3 v0(mesh.positions[indices[iid]]);
+		const glm::dvec3 v1(mesh.positions[indices[iid+1]]);
+		const glm::dvec3 v2(mesh.positions[indices[iid+2]]);
+		const glm::dvec3 normal = glm::cross(v1 - v0, v2 - v0);
+		const double area = glm::length(normal);
+		if(area == 0.0){
+			continue;
+		}
+		const glm::dvec3 n = normal / area;
+		const double d = -glm::dot(n, v0);
+		for(size_t k = 0; k < 3; ++k){
+			quadrics[indices[iid+k]].addPlane(n, d, area);
+		}
+	}
+	
+	/// \brief An edge collapse, moving a vertex onto one of its neighbours.
+	struct Collapse {
+		unsigned int from; ///< The removed vertex.
+		unsigned int to; ///< The vertex it is merged with.
+		double error; ///< The resulting squared error.
+	};
+	std::vector<Collapse> collapses;
+	std::vector<unsigned int> remap(vertCount);
+	std::vector<bool> touched(vertCount);
+	std::vector<unsigned int> offsets(vertCount + 1);
+	std::vector<unsigned int> adjacency;
+	double reachedError = 0.0;
+	
+	// Apply batches of independent collapses until the target is reached.
+	while(indices.size() > targetCount){
+	
+		// Vertex to triangles adjacency.
+		std::fill(offsets.begin(), offsets.end(), 0);
+		for(const unsigned int vid : indices){
+			++offsets[vid+1];
+		}
+		for(size_t vid = 0; vid < vertCount; ++vid){
+			offsets[vid+1] += offsets[vid];
+		}
+		adjacency.resize(indices.size());
+		std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+		for(size_t iid = 0; iid < indices.size(); ++iid){
+			adjacency[fill[indices[iid]]++] = (unsigned int)(iid / 3);
+		}
+		
+		// Evaluate all half-edges collapses.
+		collapses.clear();
+		for(size_t iid = 0; iid < indices.size(); iid += 3){
+			for(size_t k = 0; k < 3; ++k){
+				const unsigned int from = indices[iid+k];
+				const unsigned int to = indices[iid+(k+1)%3];
+				if(locked[from]){
+					continue;
+				}
+				Quadric q = quadrics[from];
+				q.add(quadrics[to]);
+				const double error = q.evaluate(mesh.positions[to]);
+				if(error <= maxSquaredError){
+					collapses.push_back({from, to, error});
+				}
+			}
+		}
+		if(collapses.empty()){
+			break;
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse & a, const Collapse & b){
+			return a.error < b.error;
+		});
+		
+		for(size_t vid = 0; vid < vertCount; ++vid){
+			remap[vid] = (unsigned int)vid;
+		}
+		std::fill(touched.begin(), touched.end(), false);
+		// Each collapse removes two triangles on a manifold.
+		const size_t collapsesBudget = std::max(size_t(1), (indices.size() - targetCount) / 6);
+		size_t applied = 0;
+		
+		for(const Collapse & collapse : collapses){
+			if(applied >= collapsesBudget){
+				break;
+			}
+			if(touched[collapse.from] || remap[collapse.to] != collapse.to){
+				continue;
+			}
+			// Reject collapses that would flip a triangle.
+			bool valid = true;
+			for(unsigned int aid = offsets[collapse.from]; aid < offsets[collapse.from+1] && valid; ++aid){
+				const unsigned int tid = adjacency[aid];
+				const unsigned int * tri = &indices[3*tid];
+				if(tri[0] == collapse.to || tri[1] == collapse.to || tri[2] == collapse.to){
+					continue;
+				}
+				glm::vec3 v[3] = { mesh.positions[tri[0]], mesh.positions[tri[1]], mesh.positions[tri[2]] };
+				const glm::vec3 n0 = glm::cross(v[1] - v[0], v[2] - v[0]);
+				for(size_t k = 0; k < 3; ++k){
+					if(tri[k] == collapse.from){
+						v[k] = mesh.positions[collapse.to];
+					}
+				}
+				const glm::vec3 n1 = glm::cross(v[1] - v[0], v[2] - v[0]);
+				valid = glm::dot(n0, n1) > 0.0f;
+			}
+			if(!valid){
+				continue;
+			}
+			// Lock the neighbourhood of the removed vertex for this batch.
+			for(unsigned int aid = offsets[collapse.from]; aid < offsets[collapse.from+1]; ++aid){
+				const unsigned int tid = adjacency[aid];
+				touched[indices[3*tid]] = touched[indices[3*tid+1]] = touched[indices[3*tid+2]] = true;
+			}
+			remap[collapse.from] = collapse.to;
+			quadrics[collapse.to].add(quadrics[collapse.from]);
+			reachedError = std::max(reachedError, collapse.error);
+			++applied;
+		}
+		if(applied == 0){
+			break;
+		}
+		
+		// Update the triangles, removing degenerate ones.
+		size_t writeId = 0;
+		for(size_t iid = 0; iid < indices.size(); iid += 3){
+			const unsigned int i0 = remap[indices[iid]];
+			const unsigned int i1 = remap[indices[iid+1]];
+			const unsigned int i2 = remap[indices[iid+2]];
+			if(i0 == i1 || i1 == i2 || i2 == i0){
+				continue;
+			}
+			indices[writeId++] = i0;
+			indices[writeId++] = i1;
+			indices[writeId++] = i2;
+		}
+		indices.resize(writeId);
+	}
+	return float(std::sqrt(reachedError)) / radius;
+}
+
+void MeshUtilities::generateLevelsOfDetail(Mesh & mesh, unsigned int maxLevels, float maxError){
+	if(!mesh.levels.empty() || mesh.indices.empty()){
+		return;
+	}
+	mesh.levels.push_back({0, (unsigned int)mesh.indices.size(), 0.0f});
+	std::vector<unsigned int> current = mesh.indices;
+	std::vector<unsigned int> clusters;
+	float error = 0.0f;
+	
+	for(unsigned int lid = 1; lid < maxLevels; ++lid){
+		const size_t target = (current.size() / 6) * 3;
+		// Don't go below a few dozen triangles.
+		if(target < 3 * 32){
+			break;
+		}
+		std::vector<unsigned int> next = current;
+		error = std::max(error, simplify(mesh, next, target, maxError));
+		// Stop if the simplification stalls.
+		if(next.size() * 10 > current.size() * 9){
+			break;
+		}
+		reorderForVertexCache(next, mesh.positions.size(), 16, clusters);
+		mesh.levels.push_back({(unsigned int)mesh.indices.size(), (unsigned int)next.size(), error});
+		mesh.indices.insert(mesh.indices.end(), next.begin(), next.end());
+		current.swap(next);
+	}
+	
+	if(mesh.levels.size() == 1){
+		mesh.levels.clear();
+		return;
+	}
+	Log::Verbose() << Log::Resources << "Mesh: " << mesh.levels.size() << " levels of detail, down to " << mesh.levels.back().count / 3 << " faces." << std::endl;
+}
+
+void MeshUtilities::optimize(Mesh & mesh, unsigned int cacheSize){
+	std::vector<unsigned int> clusters;
+	optimizeVertexCache(mesh, cacheSize, clusters);
+	optimizeOverdraw(mesh, clusters, cacheSize);
+	optimizeVertexFetch(mesh);
+}
@@ -73,24 +73,169 @@ struct BoundingBox {
 		};
 	}
 	
-	/** Compute the bounding box of the transformed current box.
-	 \param trans the transformation to apply
+	/** Compute the bounding box of the transformed current box, without enumerating its corners (Arvo's method): the center is transformed, and the extent is transformed by the absolute value of the linear part.
+	 \param trans the transformation to apply, the projective row is ignored
 	 \return the bounding box of the transformed box
 	 */
 	BoundingBox transformed(const glm::mat4 & trans) const {
-		BoundingBox newBox;
-		const std::vector<glm::vec3> corners = getCorners();
-		newBox.minis = glm::vec3(trans * glm::vec4(corners[0],1.0f));
-		newBox.maxis = newBox.minis;
-		for(size_t i = 0; i < 8; ++i){
-			const glm::vec3 transformedCorner = glm::vec3(trans * glm::vec4(corners[i],1.0f));
-			newBox.minis = glm::min(newBox.minis, transformedCorner);
-			newBox.maxis = glm::max(newBox.maxis, transformedCorner);
+		const glm::vec3 center = 0.5f*(minis+maxis);
+		const glm::vec3 extent = 0.5f*(maxis-minis);
+		glm::vec3 newCenter = glm::vec3(trans[3]);
+		glm::vec3 newExtent = glm::vec3(0.0f);
+		for(int i = 0; i < 3; ++i){
+			newCenter += glm::vec3(trans[i]) * center[i];
+			newExtent += glm::abs(glm::vec3(trans[i])) * extent[i];
 		}
+		BoundingBox newBox;
+		newBox.minis = newCenter - newExtent;
+		newBox.maxis = newCenter + newExtent;
 		return newBox;
 	}
 };
 
+/**
+ \brief A list of axis-aligned boxes, stored as one array per corner coordinate for batched processing.
+ \ingroup Resources
+ */
+struct BoundingBoxArray {
+	std::vector<float> minis[3]; ///< Lower corners coordinates, one array per axis.
+	std::vector<float> maxis[3]; ///< Upper corners coordinates, one array per axis.
+	
+	/** Query the number of boxes.
+	 \return the box count
+	 */
+	size_t size() const { return minis[0].size(); }
+	
+	/** Resize the list.
+	 \param count the new box count
+	 */
+	void resize(size_t count){
+		for(int i = 0; i < 3; ++i){
+			minis[i].resize(count);
+			maxis[i].resize(count);
+		}
+	}
+	
+	/** Store a box in the list.
+	 \param id the box position
+	 \param box the box to store
+	 */
+	void set(size_t id, const BoundingBox & box){
+		for(int i = 0; i < 3; ++i){
+			minis[i][id] = box.minis[i];
+			maxis[i][id] = box.maxis[i];
+		}
+	}
+	
+	/** Retrieve a box from the list.
+	 \param id the box position
+	 \return the box
+	 */
+	BoundingBox get(size_t id) const {
+		BoundingBox box;
+		for(int i = 0; i < 3; ++i){
+			box.minis[i] = minis[i][id];
+			box.maxis[i] = maxis[i][id];
+		}
+		return box;
+	}
+};
+
+/**
+ \brief Represent a view frustum as a set of inward-facing planes, extracted from a projection matrix.
+ \ingroup Resources
+ */
+struct Frustum {
+	glm::vec4 planes[6]; ///< The planes equations (normal, offset), normalized.
+	unsigned int count; ///< The number of planes, a frustum with no planes contains everything.
+	
+	/** Unbounded frustum constructor. */
+	Frustum(){
+		count = 0;
+	}
+	
+	/** Extract the frustum planes from a transformation matrix (Gribb and Hartmann method). The planes are expressed in the space the matrix transforms from.
+	 \param mvp the transformation to clip space
+	 */
+	Frustum(const glm::mat4 & mvp){
+		const glm::mat4 m = glm::transpose(mvp);
+		planes[0] = m[3] + m[0]; planes[1] = m[3] - m[0];
+		planes[2] = m[3] + m[1]; planes[3] = m[3] - m[1];
+		planes[4] = m[3] + m[2]; planes[5] = m[3] - m[2];
+		for(size_t pid = 0; pid < 6; ++pid){
+			planes[pid] /= glm::length(glm::vec3(planes[pid]));
+		}
+		count = 6;
+	}
+	
+	/** Test if a sphere is at least partially inside the frustum.
+	 \param sphere the sphere to test
+	 \return false if the sphere is fully outside
+	 */
+	bool intersects(const BoundingSphere & sphere) const {
+		for(size_t pid = 0; pid < count; ++pid){
+			if(glm::dot(glm::vec3(planes[pid]), sphere.center) + planes[pid].w < -sphere.radius){
+				return false;
+			}
+		}
+		return true;
+	}
+	
+	/** Test if a box is at least partially inside the frustum, using the box corner furthest along each plane normal. Boxes close to the frustum corners can be reported as visible.
+	 \param box the box to test
+	 \return false if the box is fully outside
+	 */
+	bool intersects(const BoundingBox & box) const {
+		for(size_t pid = 0; pid < count; ++pid){
+			const glm::vec3 normal = glm::vec3(planes[pid]);
+			const glm::vec3 corner = glm::mix(box.minis, box.maxis, glm::greaterThanEqual(normal, glm::vec3(0.0f)));
+			if(planes[pid].w + normal.x * corner.x + normal.y * corner.y + normal.z * corner.z < 0.0f){
+				return false;
+			}
+		}
+		return true;
+	}
+};
+
+/**
+ \brief A small cluster of triangles of a mesh, with bounds used for culling.
+ \ingroup Resources
+ */
+struct Meshlet {
+	unsigned int firstIndex; ///< The position of the cluster first index.
+	unsigned int count; ///< The number of indices in the cluster.
+	BoundingSphere bounds; ///< The cluster bounding sphere.
+	glm::vec3 coneAxis; ///< The average normal of the cluster triangles.
+	float coneCutoff; ///< Sine of the normal cone half-angle, 1.0 if the cone is too wide to be used.
+	
+	/** Test if the cluster is potentially visible: intersecting the frustum and with some triangles facing the viewpoint.
+	 \param frustum the view frustum, in the same space as the cluster
+	 \param viewPoint the homogeneous viewpoint position in the same space, w = 0 for a viewpoint at infinity in the given direction
+	 \return false if the cluster is certainly invisible
+	 */
+	bool visible(const Frustum & frustum, const glm::vec4 & viewPoint) const {
+		if(!frustum.intersects(bounds)){
+			return false;
+		}
+		// All triangles of the cluster are back-facing if the viewpoint is in the negative cone.
+		if(viewPoint.w == 0.0f){
+			return glm::dot(-glm::vec3(viewPoint), coneAxis) < coneCutoff * glm::length(glm::vec3(viewPoint));
+		}
+		const glm::vec3 direction = bounds.center - glm::vec3(viewPoint) / viewPoint.w;
+		return glm::dot(direction, coneAxis) < coneCutoff * glm::length(direction) + bounds.radius;
+	}
+};
+
+/**
+ \brief A level of detail of a mesh, stored as a range of its indices.
+ \ingroup Resources
+ */
+struct LevelOfDetail {
+	unsigned int firstIndex; ///< The position of the level first index.
+	unsigned int count; ///< The number of indices in the level.
+	float error; ///< The simplification error, relative to the radius of the mesh bounding sphere.
+};
+
 /**
  \brief Represents a geometric mesh composed of vertices and triangles. For now, material information and elements/groups are not represented.
  \ingroup Resources
@@ -98,10 +243,11 @@ struct BoundingBox {
 struct Mesh {
 	std::vector<glm::vec3> positions; ///< The 3D positions.
 	std::vector<glm::vec3> normals; ///< The surface normals.
-	std::vector<glm::vec3> tangents; ///< The surface tangents.
-	std::vector<glm::vec3> binormals;  ///< The surface binormals.
+	std::vector<glm::vec4> tangents; ///< The surface tangents, with the handedness of the tangent frame in w: the bitangent is w * cross(normal, tangent).
 	std::vector<glm::vec2> texcoords;  ///< The texture coordinates.
-	std::vector<unsigned int> indices; ///< The triangular faces indices.
+	std::vector<unsigned int> indices; ///< The triangular faces indices, followed by the indices of each coarser level of detail.
+	std::vector<LevelOfDetail> levels; ///< The levels of detail, from the full resolution one. Empty if the mesh has no coarser levels.
+	std::vector<Meshlet> meshlets; ///< The clusters of the full resolution level, covering contiguous ranges of its indices. Can be empty.
 };
 
 
@@ -120,6 +266,12 @@ public:
 		Indexed ///< Duplicate only vertices that are shared between faces with attributes with different values.
 	};
 
+	/// \brief Post-transform vertex cache efficiency of an indexed mesh, for a FIFO cache.
+	struct CacheStatistics {
+		float acmr = 0.0f; ///< Average cache miss ratio: number of vertex shader invocations per triangle (between 0.5 and 3.0).
+		float atvr = 0.0f; ///< Average transformed vertex ratio: number of vertex shader invocations per referenced vertex (1.0 is optimal).
+	};
+	
 	/** Load an .obj file from disk into a mesh structure.
 	 \param in the input string stream from which the geometry will be loaded
 	 \param mesh will be populated with the loaded geometry
@@ -127,21 +279,108 @@ public:
 	 */
 	static void loadObj(std::istream & in, Mesh & mesh, LoadMode mode);
 	
-	/** Compute the axi-aligned bounding box of a mesh.
+	/** Compute the axi-aligned bounding box of a mesh. Large meshes are processed on multiple threads.
 	 \param mesh the mesh
 	 \return the bounding box
 	 */
-	static BoundingBox computeBoundingBox(Mesh & mesh);
+	static BoundingBox computeBoundingBox(const Mesh & mesh);
 	
-	/** Center a mesh and scale it to fit in a sphere of radius 1.0.
+	/** Transform a list of boxes by the same matrix, eight (AVX) or four (SSE) boxes at a time. This is equivalent to calling BoundingBox::transformed on each box.
+	 \param boxes the boxes to transform
+	 \param transformation the transformation to apply
+	 \param result will contain the transformed boxes, can be the input list
+	 */
+	static void transformBoundingBoxes(const BoundingBoxArray & boxes, const glm::mat4 & transformation, BoundingBoxArray & result);
+	
+	/** Transform each box of a list by its own matrix, eight (AVX) or four (SSE) boxes at a time. This is equivalent to calling BoundingBox::transformed on each box.
+	 \param boxes the boxes to transform
+	 \param transformations the transformation of each box, boxes without a transformation are copied unchanged
+	 \param result will contain the transformed boxes, can be the input list
+	 */
+	static void transformBoundingBoxes(const BoundingBoxArray & boxes, const std::vector<glm::mat4> & transformations, BoundingBoxArray & result);
+	
+	/** Test a list of boxes against a frustum, eight (AVX) or four (SSE) boxes at a time. This is equivalent to calling Frustum::intersects on each box.
+	 \param boxes the boxes to test, in the frustum space
+	 \param frustum the frustum
+	 \param visibility will contain 1 for each box at least partially inside the frustum, 0 otherwise
+	 \return the number of visible boxes
+	 */
+	static size_t cullBoundingBoxes(const BoundingBoxArray & boxes, const Frustum & frustum, std::vector<unsigned char> & visibility);
+	
+	/** Center a mesh and scale it to fit in a sphere of radius 1.0. Large meshes are processed on multiple threads.
 	 \param mesh the mesh to process
 	 */
 	static void centerAndUnitMesh(Mesh & mesh);
 
-	/** Compute the tangent and binormal vectors for each vertex of a mesh.
+	/** Compute the tangent vector and the handedness of the tangent frame for each vertex of a mesh, from its full resolution level. Large meshes are processed on multiple threads.
+	 \param mesh the mesh to process
+	 \note Normals and texture coordinates are required.
+	 */
+	static void computeTangents(Mesh & mesh);
+	
+	/** Build a position-only copy of a mesh, merging vertices that have identical positions.
+	 \param mesh the mesh to process
+	 \param positionMesh will contain the merged positions and the corresponding triangles
+	 */
+	static void extractPositions(const Mesh & mesh, Mesh & positionMesh);
+	
+	/** Simulate a FIFO post-transform vertex cache while processing the mesh full resolution triangles in order.
+	 \param mesh the mesh to evaluate
+	 \param cacheSize the number of entries in the simulated cache
+	 \return the cache statistics
+	 */
+	static CacheStatistics computeCacheStatistics(const Mesh & mesh, unsigned int cacheSize = 16);
+	
+	/** Reorder the mesh triangles to improve post-transform vertex cache reuse, using the Tipsify algorithm. Each level of detail, and each cluster of the full resolution level, is reordered separately.
+	 \param mesh the mesh to process
+	 \param cacheSize the number of entries in the target cache
+	 \param clusters will contain the index of the first triangle of each cluster of the full resolution level, delimited where the algorithm had to jump to a non-adjacent region of the mesh
+	 \note See Sander, Nehab and Barczak, "Fast triangle reordering for vertex locality and reduced overdraw", ACM Transactions on Graphics, 2007.
+	 */
+	static void optimizeVertexCache(Mesh & mesh, unsigned int cacheSize, std::vector<unsigned int> & clusters);
+	
+	/** Reorder clusters of triangles so that outward-facing regions are drawn first, reducing overdraw from most viewpoints. Only the full resolution level is reordered.
+	 \param mesh the mesh to process, with triangles already ordered for the vertex cache
+	 \param clusters the index of the first triangle of each cluster
+	 \param cacheSize the number of entries in the target cache
+	 \param threshold clusters are further split where their miss ratio from a cold cache goes below threshold times the miss ratio of the whole cluster, limiting the cache efficiency loss
+	 */
+	static void optimizeOverdraw(Mesh & mesh, const std::vector<unsigned int> & clusters, unsigned int cacheSize, float threshold = 1.05f);
+	
+	/** Reorder the mesh vertices in the order of their first use by the triangles, improving the locality of vertex fetches. Unreferenced vertices are moved at the end.
+	 \param mesh the mesh to process
+	 */
+	static void optimizeVertexFetch(Mesh & mesh);
+	
+	/** Split the full resolution triangles in small spatially coherent clusters, with bounding spheres and normal cones for culling. Triangles are reordered so that each cluster is a contiguous range of indices, and reordered for the vertex cache inside each cluster.
+	 \param mesh the mesh to process
+	 \param maxVertices the maximum number of unique vertices per cluster
+	 \param maxTriangles the maximum number of triangles per cluster
+	 */
+	static void buildMeshlets(Mesh & mesh, unsigned int maxVertices = 64, unsigned int maxTriangles = 124);
+	
+	/** Simplify a list of triangles by collapsing edges, in order of increasing quadric error. Vertices are never moved, collapsed vertices are merged into one of their neighbours so that the vertex data can be shared by all levels. Vertices on borders and attribute seams are kept.
+	 \param mesh the mesh providing the vertex positions
+	 \param indices the triangles to simplify, updated in place
+	 \param targetCount the number of indices to reach
+	 \param maxError the maximum error allowed, relative to the radius of the mesh bounding sphere
+	 \return the error reached, relative to the radius of the mesh bounding sphere
+	 \note See Garland and Heckbert, "Surface simplification using quadric error metrics", SIGGRAPH 1997.
+	 */
+	static float simplify(const Mesh & mesh, std::vector<unsigned int> & indices, size_t targetCount, float maxError);
+	
+	/** Generate a chain of coarser levels of detail, each one halving the triangle count of the previous one. The new levels are appended to the mesh indices and reordered for the vertex cache. The chain stops early when the maximum error is reached or the simplification stalls.
+	 \param mesh the mesh to process
+	 \param maxLevels the maximum number of levels, including the full resolution one
+	 \param maxError the maximum error allowed, relative to the radius of the mesh bounding sphere
+	 */
+	static void generateLevelsOfDetail(Mesh & mesh, unsigned int maxLevels = 5, float maxError = 0.05f);
+	
+	/** Apply the vertex cache, overdraw and vertex fetch optimizations to a mesh.
 	 \param mesh the mesh to process
+	 \param cacheSize the number of entries in the target cache
 	 */
-	static void computeTangentsAndBinormals(Mesh & mesh);
+	static void optimize(Mesh & mesh, unsigned int cacheSize = 16);
 	
 };
 
@@ -1,5 +1,7 @@
 #include "ResourcesManager.hpp"
 #include "MeshUtilities.hpp"
+#include "ImageUtilities.hpp"
+#include "../raycaster/Raycaster.hpp"
 #include <fstream>
 #include <sstream>
 #include <tinydir/tinydir.h>
@@ -231,9 +233,10 @@ const std::string Resources::getString(const std::string & filename){
 
 // Mesh method.
 
-const MeshInfos Resources::getMesh(const std::string & name){
-	if(_meshes.count(name) > 0){
-		return _meshes[name];
+const MeshInfos Resources::getMesh(const std::string & name, unsigned int processing){
+	const std::string key = processing == NoProcessing ? name : (name + "#" + std::to_string(processing));
+	if(_meshes.count(key) > 0){
+		return _meshes[key];
 	}
 
 	MeshInfos infos;
@@ -246,8 +249,20 @@ const MeshInfos Resources::getMesh(const std::string & name){
 		std::stringstream meshStream(meshText);
 	
 		MeshUtilities::loadObj(meshStream, mesh, MeshUtilities::Indexed);
-		// If uv or positions are missing, tangent/binormals won't be computed.
-		MeshUtilities::computeTangentsAndBinormals(mesh);
+		// If uvs or normals are missing, tangents won't be computed.
+		MeshUtilities::computeTangents(mesh);
+		
+		if(processing & OptimizeCache){
+			MeshUtilities::optimize(mesh);
+		}
+		if(processing & GenerateLevels){
+			MeshUtilities::generateLevelsOfDetail(mesh);
+		}
+		if(processing & BuildMeshlets){
+			MeshUtilities::buildMeshlets(mesh);
+			// Clusters reorder triangles, restore vertex fetch locality.
+			MeshUtilities::optimizeVertexFetch(mesh);
+		}
 		
 	} else {
 		Log::Error() << Log::Resources << "Unable to load mesh named " << name << "." << std::endl;
@@ -255,10 +270,17 @@ const MeshInfos Resources::getMesh(const std::string & name){
 	}
 	
 	// Setup GL buffers and attributes.
-	infos = GLUtilities::setupBuffers(mesh);
+	if(processing & (CompactLayout | QuantizePositions)){
+		infos = GLUtilities::setupCompactBuffers(mesh, (processing & QuantizePositions) != 0);
+	} else {
+		infos = GLUtilities::setupBuffers(mesh);
+	}
 	// Compute bounding box.
 	infos.bbox = MeshUtilities::computeBoundingBox(mesh);
-	_meshes[name] = infos;
+	if(processing & BuildBVH){
+		infos.bvh = std::make_shared<const MeshBVH>(mesh);
+	}
+	_meshes[key] = infos;
 	return infos;
 }
 
@@ -308,6 +330,77 @@ const TextureInfos Resources::getTexture(const std::string & name, bool srgb){
 }
 
 
+const MaterialInfos Resources::getMaterial(const std::vector<std::pair<std::string, bool>> & textures){
+
+	// If the material is already loaded, return it.
+	std::string key;
+	for(const auto & texture : textures){
+		key += texture.first + (texture.second ? ":srgb;" : ";");
+	}
+	if(_materials.count(key) > 0){
+		return _materials[key];
+	}
+	
+	// Load all images, their sizes and formats determine the arrays to use.
+	std::vector<void *> images(textures.size(), nullptr);
+	std::vector<unsigned int> layout;
+	// Missing images are replaced by a single black texel, as unbound textures.
+	static unsigned char missingImage[4] = {0, 0, 0, 255};
+	for(size_t tid = 0; tid < textures.size(); ++tid){
+		const std::string & name = textures[tid].first;
+		std::string path = getImagePath(name);
+		if(path.empty()){
+			// Use the first level of custom mipmaps.
+			path = getImagePath(name + "_0");
+		}
+		unsigned int width = 1;
+		unsigned int height = 1;
+		unsigned int channels = 4;
+		if(path.empty()){
+			Log::Error() << Log::Resources << "Unable to find texture named \"" << name << "\"." << std::endl;
+		} else if(ImageUtilities::isHDR(path)){
+			Log::Error() << Log::Resources << "HDR texture \"" << name << "\" can't be used in a material." << std::endl;
+		} else if(ImageUtilities::loadImage(path, width, height, channels, &images[tid], true) != 0){
+			Log::Error() << Log::Resources << "Unable to load the texture at path " << path << "." << std::endl;
+			if(images[tid] != nullptr){
+				free(images[tid]);
+				images[tid] = nullptr;
+			}
+			width = height = 1;
+		}
+		layout.push_back(width);
+		layout.push_back(height);
+		layout.push_back(textures[tid].second ? 1 : 0);
+	}
+	
+	// Allocate a new layer in the arrays, doubling their capacity if they are full.
+	MaterialArrays & arrays = _materialArrays[layout];
+	if(arrays.capacity == 0){
+		arrays.capacity = 4;
+		for(size_t tid = 0; tid < textures.size(); ++tid){
+			arrays.textures.push_back(GLUtilities::createTextureArray(layout[3 * tid], layout[3 * tid + 1], arrays.capacity, textures[tid].second));
+			arrays.srgb.push_back(textures[tid].second);
+		}
+	} else if(arrays.count == arrays.capacity){
+		for(size_t tid = 0; tid < textures.size(); ++tid){
+			GLUtilities::resizeTextureArray(arrays.textures[tid], arrays.capacity, 2 * arrays.capacity, arrays.srgb[tid]);
+		}
+		arrays.capacity *= 2;
+	}
+	MaterialInfos infos;
+	infos.textures = arrays.textures;
+	infos.layer = arrays.count++;
+	for(size_t tid = 0; tid < textures.size(); ++tid){
+		const unsigned char * image = images[tid] ? (const unsigned char *)images[tid] : missingImage;
+		GLUtilities::uploadTextureLayer(arrays.textures[tid], infos.layer, image, textures[tid].second);
+		if(images[tid] != nullptr){
+			free(images[tid]);
+		}
+	}
+	_materials[key] = infos;
+	return infos;
+}
+
 const TextureInfos Resources::getCubemap(const std::string & name, bool srgb){
 	// If texture already loaded, return it.
 	if(_textures.count(name) > 0){
@@ -374,7 +467,7 @@ const std::shared_ptr<ProgramInfos> Resources::getProgram(const std::string & na
 	
 	_programs.emplace(std::piecewise_construct,
 					  std::forward_as_tuple(name),
-					  std::forward_as_tuple(new ProgramInfos(vertexName, fragmentName, geometryName)));
+					  std::forward_as_tuple(new ProgramInfos(vertexName, fragmentName, geometryName, _lazyPrograms)));
 	
 	return _programs[name];
 }
@@ -391,6 +484,55 @@ void Resources::reload() {
 	Log::Info() << Log::Resources << "Shader programs reloaded." << std::endl;
 }
 
+void Resources::loadProgramsWarmup(const std::string & path){
+	// No list on the first launch, nothing to do.
+	std::ifstream inputFile(widen(path));
+	if(inputFile.bad() || inputFile.fail()){
+		Log::Info() << Log::Resources << "No shader warm-up list at path \"" << path << "\"." << std::endl;
+		return;
+	}
+	GLUtilities::setupParallelShaderCompilation();
+	// Each line is: name vertex fragment [geometry]
+	std::string line;
+	size_t count = 0;
+	while(std::getline(inputFile, line)){
+		std::stringstream tokens(line);
+		std::string name, vertexName, fragmentName, geometryName;
+		tokens >> name >> vertexName >> fragmentName >> geometryName;
+		if(name.empty() || fragmentName.empty()){
+			continue;
+		}
+		const bool wasLazy = _lazyPrograms;
+		_lazyPrograms = true;
+		getProgram(name, vertexName, fragmentName, geometryName)->compile();
+		_lazyPrograms = wasLazy;
+		++count;
+	}
+	inputFile.close();
+	Log::Info() << Log::Resources << "Submitted " << count << " programs from warm-up list." << std::endl;
+}
+
+void Resources::pollPrograms(){
+	for(auto & prog : _programs){
+		prog.second->poll();
+	}
+}
+
+void Resources::saveProgramsWarmup(const std::string & path) const {
+	std::stringstream list;
+	for(const auto & prog : _programs){
+		if(!prog.second->used()){
+			continue;
+		}
+		list << prog.first << " " << prog.second->vertexName() << " " << prog.second->fragmentName();
+		if(!prog.second->geometryName().empty()){
+			list << " " << prog.second->geometryName();
+		}
+		list << std::endl;
+	}
+	Resources::saveStringToExternalFile(path, list.str());
+}
+
 void Resources::getFiles(const std::string & extension, std::map<std::string, std::string> & files) const {
 	files.clear();
 	for(const auto & file : _files){
@@ -20,6 +20,17 @@ public:
 		Vertex, Fragment, Geometry
 	};
 	
+	/// \brief Optional mesh preprocessing steps, can be combined.
+	enum MeshProcessing : unsigned int {
+		NoProcessing = 0, ///< Upload the mesh as loaded.
+		OptimizeCache = 1 << 0, ///< Reorder triangles and vertices for vertex cache and fetch locality, and reduced overdraw.
+		CompactLayout = 1 << 1, ///< Use the compact interleaved vertex layout. \see GLUtilities::setupCompactBuffers
+		QuantizePositions = 1 << 2, ///< Store positions as 16-bits integers in the compact layout, implies CompactLayout.
+		GenerateLevels = 1 << 3, ///< Generate coarser levels of detail by simplification. \see MeshUtilities::generateLevelsOfDetail
+		BuildMeshlets = 1 << 4, ///< Split the full resolution level in small clusters with culling data. \see MeshUtilities::buildMeshlets
+		BuildBVH = 1 << 5 ///< Keep a bounding volume hierarchy over the triangles for CPU ray queries. \see MeshBVH
+	};
+	
 	/** Singleton accessor.
 	 \return the resources manager singleton
 	 */
@@ -75,9 +86,11 @@ public:
 	
 	/** Get a geometric mesh resource.
 	 \param name the mesh file name
+	 \param processing a combination of MeshProcessing flags to apply at loading
 	 \return the mesh informations
+	 \note The same mesh requested with different processing flags will be loaded twice.
 	 */
-	const MeshInfos getMesh(const std::string & name);
+	const MeshInfos getMesh(const std::string & name, unsigned int processing = NoProcessing);
 	
 	/** Get a 2D texture resource. Automatically handle custom mipmaps if present.
 	 \param name the texture base name
@@ -86,6 +99,13 @@ public:
 	 */
 	const TextureInfos getTexture(const std::string & name, bool srgb = true);
 	
+	/** Get a material resource, whose textures are packed in texture arrays along with other materials with the same texture formats and sizes.
+	 \param textures names and sRGB flags of the material 2D textures
+	 \return the material informations, shared texture arrays and layer
+	 \note Mipmaps are always generated, custom mipmap levels are ignored.
+	 */
+	const MaterialInfos getMaterial(const std::vector<std::pair<std::string, bool>> & textures);
+	
 	/** Get a cubemap texture resource. Automatically handle custom mipmaps if present.
 	 \param name the texture base name
 	 \param srgb should the texture be gamma corrected
@@ -127,6 +147,28 @@ public:
 	 */
 	void reload();
 	
+	/** Toggle lazy program loading: programs returned by getProgram will only be compiled when first bound.
+	 \param lazy should programs be compiled lazily
+	 */
+	void setLazyPrograms(bool lazy){ _lazyPrograms = lazy; }
+	
+	/** Load a list of programs recorded during a previous session and submit them all for compilation, without waiting for the results.
+	 \param path the path to the warm-up list on disk
+	 \note If the driver supports parallel shader compilation, it will be enabled beforehand.
+	 \see Resources::saveProgramsWarmup
+	 */
+	void loadProgramsWarmup(const std::string & path);
+	
+	/** Finish the submitted programs that the driver has completed in the background, without blocking, so that their first bind doesn't stall.
+	 \see ProgramInfos::poll
+	 */
+	void pollPrograms();
+	
+	/** Save the list of programs that have been used in the current session.
+	 \param path the path to the warm-up list on disk
+	 */
+	void saveProgramsWarmup(const std::string & path) const;
+	
 	/** Load raw binary data from an external file
 	 \param path the path to the file on disk
 	 \param size will contain the number of bytes loaded from the file
@@ -169,6 +211,14 @@ public:
 	
 private:
 	
+	/// \brief Texture arrays storing the materials with the same texture formats and sizes, in the same layers.
+	struct MaterialArrays {
+		std::vector<TextureInfos> textures; ///< One texture array for each texture of the materials.
+		std::vector<bool> srgb; ///< Is each texture array gamma encoded.
+		unsigned int count = 0; ///< Number of layers used.
+		unsigned int capacity = 0; ///< Number of layers allocated.
+	};
+	
 	/** Destructor (disabled). */
 	~Resources(){};
 	
@@ -182,8 +232,11 @@ private:
 	const std::string _rootPath; ///< The resources root path.
 	std::map<std::string, std::string> _files; ///< Listing of available files and their paths.
 	std::map<std::string, TextureInfos> _textures; ///< Loaded textures, identified by name.
+	std::map<std::string, MaterialInfos> _materials; ///< Loaded materials, identified by their textures names.
+	std::map<std::vector<unsigned int>, MaterialArrays> _materialArrays; ///< Texture arrays storing materials, identified by the size and format of each texture.
 	std::map<std::string, MeshInfos> _meshes; ///< Loaded meshes, identified by name.
 	std::map<std::string, std::shared_ptr<ProgramInfos>> _programs; ///< Loaded shader programs, identified by name.
+	bool _lazyPrograms = false; ///< Should programs be compiled on first use.
 	
 };
 
@@ -0,0 +1,334 @@
+#include "SceneDescription.hpp"
+#include <sstream>
+#include <cstring>
+
+const char SceneDescription::Magic[4] = {'S', 'C', 'N', 'B'};
+
+/** Read a number of floats from a stream.
+ \param tokens the stream
+ \param values will contain the values
+ \param count the number of values to read
+ \return false if a value is missing
+ */
+static bool readFloats(std::stringstream & tokens, float * values, int count){
+	for(int i = 0; i < count; ++i){
+		if(!(tokens >> values[i])){
+			return false;
+		}
+	}
+	return true;
+}
+
+/** Append an array of records to a buffer.
+ \param records the records
+ \param data the buffer
+ */
+template<typename T>
+static void appendRecords(const std::vector<T> & records, std::vector<char> & data){
+	const size_t size = records.size() * sizeof(T);
+	if(size == 0){
+		return;
+	}
+	const size_t offset = data.size();
+	data.resize(offset + size);
+	std::memcpy(&data[offset], records.data(), size);
+}
+
+/** Copy an array of records from a buffer, checking its bounds.
+ \param data the buffer
+ \param size the size of the buffer
+ \param offset the position of the records, moved after them
+ \param count the number of records
+ \param records will contain the records
+ \return false if the buffer is too small
+ */
+template<typename T>
+static bool readRecords(const char * data, size_t size, size_t & offset, uint32_t count, std::vector<T> & records){
+	const size_t recordsSize = size_t(count) * sizeof(T);
+	if(offset + recordsSize > size){
+		return false;
+	}
+	records.resize(count);
+	if(recordsSize > 0){
+		std::memcpy(records.data(), data + offset, recordsSize);
+	}
+	offset += recordsSize;
+	return true;
+}
+
+SceneDescription::SceneDescription(){
+	clear();
+}
+
+void SceneDescription::clear(){
+	std::memcpy(_header.magic, Magic, sizeof(Magic));
+	_header.version = Version;
+	_header.flags = 0;
+	_header.background = None;
+	_header.irradiance = None;
+	_header.nodeCount = 0;
+	_header.materialCount = 0;
+	_header.objectCount = 0;
+	_header.lightCount = 0;
+	_header.stringsSize = 0;
+	_nodes.clear();
+	_materials.clear();
+	_instances.clear();
+	_lights.clear();
+	_strings.clear();
+	_stringOffsets.clear();
+}
+
+uint32_t SceneDescription::addString(const std::string & name){
+	const auto existing = _stringOffsets.find(name);
+	if(existing != _stringOffsets.end()){
+		return existing->second;
+	}
+	const uint32_t offset = uint32_t(_strings.size());
+	_strings.insert(_strings.end(), name.begin(), name.end());
+	_strings.push_back('\0');
+	_stringOffsets[name] = offset;
+	return offset;
+}
+
+bool SceneDescription::parse(const std::string & text){
+	clear();
+	std::map<std::string, uint32_t> nodeNames;
+	std::map<std::string, uint32_t> materialNames;
+	std::stringstream lines(text);
+	std::string line;
+	size_t lineId = 0;
+	bool valid = true;
+	
+	while(valid && std::getline(lines, line)){
+		++lineId;
+		// Skip empty lines and comments.
+		const size_t keyStart = line.find_first_not_of(" \t\r");
+		if(keyStart == std::string::npos || line[keyStart] == '#'){
+			continue;
+		}
+		const size_t separator = line.find(':', keyStart);
+		if(separator == std::string::npos){
+			valid = false;
+			break;
+		}
+		const std::string key = line.substr(keyStart, separator - keyStart);
+		std::stringstream tokens(line.substr(separator + 1));
+		
+		if(key == "environment"){
+			std::string cubemap, coefficients;
+			valid = bool(tokens >> cubemap >> coefficients);
+			if(valid){
+				_header.background = addString(cubemap);
+				_header.irradiance = addString(coefficients);
+			}
+		
+		} else if(key == "batch"){
+			_header.flags |= Batch;
+		
+		} else if(key == "material"){
+			std::string name, texture;
+			valid = bool(tokens >> name) && materialNames.count(name) == 0;
+			Material material;
+			std::fill(material.textures, material.textures + MaxTextures, None);
+			material.count = 0;
+			material.srgb = 0;
+			while(valid && tokens >> texture){
+				valid = material.count < MaxTextures;
+				const size_t suffix = texture.rfind(":srgb");
+				if(suffix != std::string::npos && suffix + 5 == texture.size()){
+					material.srgb |= 1u << material.count;
+					texture = texture.substr(0, suffix);
+				}
+				if(valid){
+					material.textures[material.count++] = addString(texture);
+				}
+			}
+			if(valid){
+				materialNames[name] = uint32_t(_materials.size());
+				_materials.push_back(material);
+			}
+		
+		} else if(key == "node" || key == "object"){
+			// Header of the entry: node name, or object type, mesh and material.
+			std::string name, type, mesh, material;
+			Instance instance;
+			instance.flags = CastShadow;
+			if(key == "node"){
+				valid = bool(tokens >> name) && nodeNames.count(name) == 0;
+			} else {
+				valid = bool(tokens >> type >> mesh >> material) && (type == "regular" || type == "parallax") && materialNames.count(material) > 0;
+				if(valid){
+					// Same values as Object::Regular and Object::Parallax.
+					instance.type = type == "regular" ? 1 : 2;
+					instance.mesh = addString(mesh);
+					instance.material = materialNames[material];
+				}
+			}
+			// Options.
+			Node node;
+			node.parent = None;
+			glm::vec3 translation(0.0f);
+			glm::vec4 rotation(0.0f, 1.0f, 0.0f, 0.0f);
+			float scale = 1.0f;
+			std::string option;
+			while(valid && tokens >> option){
+				if(option == "parent"){
+					std::string parent;
+					valid = bool(tokens >> parent) && nodeNames.count(parent) > 0;
+					node.parent = valid ? nodeNames[parent] : None;
+				} else if(option == "translation"){
+					valid = readFloats(tokens, &translation[0], 3);
+				} else if(option == "rotation"){
+					valid = readFloats(tokens, &rotation[0], 4) && glm::length(glm::vec3(rotation)) > 0.0f;
+				} else if(option == "scale"){
+					valid = readFloats(tokens, &scale, 1);
+				} else if(option == "noshadow" && key == "object"){
+					instance.flags &= ~uint32_t(CastShadow);
+				} else if(option == "impostor" && key == "object"){
+					instance.flags |= UseImpostor;
+				} else {
+					valid = false;
+				}
+			}
+			if(valid){
+				const glm::mat4 rotationMatrix = glm::rotate(glm::mat4(1.0f), glm::radians(rotation[3]), glm::normalize(glm::vec3(rotation)));
+				node.local = glm::scale(glm::translate(glm::mat4(1.0f), translation) * rotationMatrix, glm::vec3(scale));
+				const uint32_t nodeId = uint32_t(_nodes.size());
+				_nodes.push_back(node);
+				if(key == "node"){
+					nodeNames[name] = nodeId;
+				} else {
+					instance.node = nodeId;
+					_instances.push_back(instance);
+				}
+			}
+		
+		} else if(key == "directional" || key == "point" || key == "spot"){
+			Light light;
+			light.type = key == "directional" ? LightType::Directional : (key == "point" ? LightType::Point : LightType::Spot);
+			light.flags = 0;
+			light.position = glm::vec3(0.0f);
+			light.direction = glm::vec3(0.0f, -1.0f, 0.0f);
+			light.color = glm::vec3(1.0f);
+			light.radius = 1.0f;
+			light.innerAngle = 0.5f;
+			light.outerAngle = 0.6f;
+			std::string option;
+			while(valid && tokens >> option){
+				if(option == "position"){
+					valid = readFloats(tokens, &light.position[0], 3);
+				} else if(option == "direction"){
+					valid = readFloats(tokens, &light.direction[0], 3);
+				} else if(option == "color"){
+					valid = readFloats(tokens, &light.color[0], 3);
+				} else if(option == "radius"){
+					valid = readFloats(tokens, &light.radius, 1);
+				} else if(option == "angles"){
+					valid = readFloats(tokens, &light.innerAngle, 1) && readFloats(tokens, &light.outerAngle, 1);
+				} else if(option == "shadow"){
+					light.flags |= CastShadow;
+				} else {
+					valid = false;
+				}
+			}
+			if(valid){
+				_lights.push_back(light);
+			}
+		
+		} else {
+			valid = false;
+		}
+	}
+	
+	if(!valid){
+		Log::Error() << Log::Resources << "Invalid scene description at line " << lineId << ": \"" << line << "\"." << std::endl;
+		clear();
+		return false;
+	}
+	_header.nodeCount = uint32_t(_nodes.size());
+	_header.materialCount = uint32_t(_materials.size());
+	_header.objectCount = uint32_t(_instances.size());
+	_header.lightCount = uint32_t(_lights.size());
+	_header.stringsSize = uint32_t(_strings.size());
+	_stringOffsets.clear();
+	return true;
+}
+
+bool SceneDescription::read(const char * data, size_t size){
+	clear();
+	if(size < sizeof(Header)){
+		Log::Error() << Log::Resources << "Compiled scene description is too small." << std::endl;
+		return false;
+	}
+	std::memcpy(&_header, data, sizeof(Header));
+	if(std::memcmp(_header.magic, Magic, sizeof(Magic)) != 0 || _header.version != Version){
+		Log::Error() << Log::Resources << "Unsupported compiled scene description." << std::endl;
+		clear();
+		return false;
+	}
+	// Records are copied in bulk, without any conversion.
+	size_t offset = sizeof(Header);
+	const bool complete = readRecords(data, size, offset, _header.nodeCount, _nodes)
+		&& readRecords(data, size, offset, _header.materialCount, _materials)
+		&& readRecords(data, size, offset, _header.objectCount, _instances)
+		&& readRecords(data, size, offset, _header.lightCount, _lights)
+		&& readRecords(data, size, offset, _header.stringsSize, _strings);
+	// Strings should be null-terminated.
+	if(!complete || (!_strings.empty() && _strings.back() != '\0')){
+		Log::Error() << Log::Resources << "Truncated compiled scene description." << std::endl;
+		clear();
+		return false;
+	}
+	if(!validate()){
+		Log::Error() << Log::Resources << "Corrupted compiled scene description." << std::endl;
+		clear();
+		return false;
+	}
+	return true;
+}
+
+bool SceneDescription::validate() const {
+	const uint32_t stringsSize = uint32_t(_strings.size());
+	if((_header.background != None && _header.background >= stringsSize) || (_header.irradiance != None && _header.irradiance >= stringsSize)){
+		return false;
+	}
+	// Parents come before their children.
+	for(size_t nid = 0; nid < _nodes.size(); ++nid){
+		if(_nodes[nid].parent != None && _nodes[nid].parent >= nid){
+			return false;
+		}
+	}
+	for(const Material & material : _materials){
+		if(material.count > MaxTextures){
+			return false;
+		}
+		for(uint32_t tid = 0; tid < material.count; ++tid){
+			if(material.textures[tid] >= stringsSize){
+				return false;
+			}
+		}
+	}
+	for(const Instance & instance : _instances){
+		// Regular or parallax objects.
+		if((instance.type != 1 && instance.type != 2) || instance.mesh >= stringsSize || instance.material >= _materials.size() || instance.node >= _nodes.size()){
+			return false;
+		}
+	}
+	for(const Light & light : _lights){
+		if(uint32_t(light.type) > uint32_t(LightType::Spot)){
+			return false;
+		}
+	}
+	return true;
+}
+
+void SceneDescription::write(std::vector<char> & data) const {
+	data.resize(sizeof(Header));
+	std::memcpy(data.data(), &_header, sizeof(Header));
+	appendRecords(_nodes, data);
+	appendRecords(_materials, data);
+	appendRecords(_instances, data);
+	appendRecords(_lights, data);
+	appendRecords(_strings, data);
+}
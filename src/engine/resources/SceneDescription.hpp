@@ -0,0 +1,188 @@
+#ifndef SceneDescription_h
+#define SceneDescription_h
+#include "Common.hpp"
+#include <map>
+#include <cstdint>
+
+/**
+ \brief Description of the content of a scene: transformation nodes, materials, objects, lights and environment, stored in flat arrays of fixed-size records. Names are stored as offsets in a shared block of null-terminated strings, where each name appears once.
+ \details A description can be parsed from a text file, or read from a compiled binary file containing the same arrays, which loads without any parsing. The binary file starts with a Header, followed by the nodes, materials, objects and lights records and the strings block, in native endianness.
+
+ The text format contains one entry per line, as "key: values", and lines starting with # are ignored:
+ - "environment: cubemap coefficients" the background cubemap, also used for ambient reflections, and the text file of its irradiance SH coefficients.
+ - "batch:" pack the meshes of all objects in shared buffers, for static scenes.
+ - "material: name texture0 texture1 ..." a material, each texture name followed by ":srgb" if it is gamma encoded.
+ - "node: name [options]" a named transformation node.
+ - "object: type mesh material [options]" an object of type "regular" or "parallax", with the options "noshadow" and "impostor".
+ - "directional: direction x y z color r g b [shadow]" a directional light.
+ - "point: position x y z color r g b radius r [shadow]" a point light.
+ - "spot: position x y z direction x y z color r g b angles inner outer radius r [shadow]" a spot light.
+
+ Nodes and objects are placed by the options "parent name", referencing a previous node, "translation x y z", "rotation x y z degrees" around an axis and "scale s", combined as translation * rotation * scale.
+ \ingroup Resources
+ */
+class SceneDescription {
+
+public:
+
+	/// Index of a missing node or string.
+	static const uint32_t None = ~0u;
+	
+	/// \brief Flags of objects and lights.
+	enum Flags : uint32_t {
+		CastShadow = 1 << 0, ///< The object or light casts shadows.
+		UseImpostor = 1 << 1, ///< Distant views of the object are replaced by an impostor.
+		Batch = 1 << 2 ///< Scene flag: the meshes of all objects are packed in shared buffers.
+	};
+	
+	/// \brief Type of a light.
+	enum class LightType : uint32_t {
+		Directional = 0, Point = 1, Spot = 2
+	};
+	
+	/// \brief A transformation node.
+	struct Node {
+		glm::mat4 local; ///< Transformation relative to the parent.
+		uint32_t parent; ///< Index of the parent node, or None.
+	};
+	
+	/// Maximum number of textures in a material.
+	static const uint32_t MaxTextures = 4;
+	
+	/// \brief A set of textures, stored in shared texture arrays.
+	struct Material {
+		uint32_t textures[MaxTextures]; ///< Offset of each texture name.
+		uint32_t count; ///< Number of textures.
+		uint32_t srgb; ///< Bit mask of the gamma encoded textures.
+	};
+	
+	/// \brief An object, instance of a mesh and a material placed by its own node.
+	struct Instance {
+		uint32_t type; ///< Object type, as in Object::Type.
+		uint32_t mesh; ///< Offset of the mesh name.
+		uint32_t material; ///< Index of the material.
+		uint32_t node; ///< Index of the node placing the object.
+		uint32_t flags; ///< Combination of CastShadow and UseImpostor.
+	};
+	
+	/// \brief A light, some parameters are unused depending on its type.
+	struct Light {
+		LightType type; ///< The light type.
+		uint32_t flags; ///< CastShadow or nothing.
+		glm::vec3 position; ///< World space position of point and spot lights.
+		glm::vec3 direction; ///< World space direction of directional and spot lights.
+		glm::vec3 color; ///< Light color and intensity.
+		float radius; ///< Radius of point and spot lights.
+		float innerAngle; ///< Inner cone half angle of spot lights.
+		float outerAngle; ///< Outer cone half angle of spot lights.
+	};
+	
+	/// \brief Header of a compiled description, followed by the records and strings.
+	struct Header {
+		char magic[4]; ///< Always "SCNB".
+		uint32_t version; ///< Format version.
+		uint32_t flags; ///< Scene flags.
+		uint32_t background; ///< Offset of the background cubemap name, or None.
+		uint32_t irradiance; ///< Offset of the SH coefficients file name, or None.
+		uint32_t nodeCount; ///< Number of nodes.
+		uint32_t materialCount; ///< Number of materials.
+		uint32_t objectCount; ///< Number of objects.
+		uint32_t lightCount; ///< Number of lights.
+		uint32_t stringsSize; ///< Size of the strings block in bytes.
+	};
+	
+	/** Constructor. Creates an empty description. */
+	SceneDescription();
+	
+	/** Parse a description in the text format, replacing the current content.
+	 \param text the description text
+	 \return false if the text is invalid
+	 */
+	bool parse(const std::string & text);
+	
+	/** Read a compiled description, replacing the current content.
+	 \param data the compiled data
+	 \param size the size of the data in bytes
+	 \return false if the data is invalid
+	 */
+	bool read(const char * data, size_t size);
+	
+	/** Compile the description in the binary format.
+	 \param data will contain the compiled data
+	 */
+	void write(std::vector<char> & data) const;
+	
+	/** Query a name.
+	 \param offset the offset of the name
+	 \return the null-terminated name, empty if the offset is None
+	 */
+	const char * string(uint32_t offset) const { return offset == None ? "" : &_strings[offset]; }
+	
+	/** Query the scene flags.
+	 \return a combination of scene flags
+	 */
+	uint32_t flags() const { return _header.flags; }
+	
+	/** Query the background cubemap.
+	 \return the offset of the cubemap name, or None
+	 */
+	uint32_t background() const { return _header.background; }
+	
+	/** Query the background irradiance.
+	 \return the offset of the SH coefficients file name, or None
+	 */
+	uint32_t irradiance() const { return _header.irradiance; }
+	
+	/** Query the transformation nodes.
+	 \return the nodes, parents come before their children
+	 */
+	const std::vector<Node> & nodes() const { return _nodes; }
+	
+	/** Query the materials.
+	 \return the materials
+	 */
+	const std::vector<Material> & materials() const { return _materials; }
+	
+	/** Query the objects.
+	 \return the objects instances
+	 */
+	const std::vector<Instance> & instances() const { return _instances; }
+	
+	/** Query the lights.
+	 \return the lights
+	 */
+	const std::vector<Light> & lights() const { return _lights; }
+	
+	/// Magic number at the start of compiled files.
+	static const char Magic[4];
+	
+	/// Version of the binary format.
+	static const uint32_t Version = 1;
+
+private:
+
+	/** Remove all content. */
+	void clear();
+	
+	/** Check that all indices and offsets are in range.
+	 \return false if a record references missing data
+	 */
+	bool validate() const;
+	
+	/** Store a name once in the strings block.
+	 \param name the name
+	 \return the offset of the name
+	 */
+	uint32_t addString(const std::string & name);
+	
+	Header _header; ///< Scene flags, environment and counts.
+	std::vector<Node> _nodes; ///< Transformation nodes.
+	std::vector<Material> _materials; ///< Materials.
+	std::vector<Instance> _instances; ///< Objects instances.
+	std::vector<Light> _lights; ///< Lights.
+	std::vector<char> _strings; ///< Null-terminated names.
+	std::map<std::string, uint32_t> _stringOffsets; ///< Offset of each name, while parsing.
+
+};
+
+#endif
@@ -1,6 +1,7 @@
 #include "Common.hpp"
 #include "Config.hpp"
 #include "resources/ImageUtilities.hpp"
+#include "helpers/TaskScheduler.hpp"
 
 /**
  	\defgroup AtmosphericScattering Atmospheric Scattering
@@ -92,6 +93,7 @@ int main(int argc, char** argv) {
 		Log::setDefaultFile(config.logPath);
 	}
 	Log::setDefaultVerbose(config.logVerbose);
+	TaskScheduler::setup(config.threadCount);
 	
 	if(config.outputPath.empty()){
 		Log::Error() << Log::Utilities << "Need an output path." << std::endl;
@@ -111,48 +113,51 @@ int main(int argc, char** argv) {
 	std::vector<glm::vec3> transmittanceTable(config.initialWidth * config.initialHeight);
 	const unsigned int samplesCount = config.samples;
 	
-	for(size_t y = 0; y < config.initialHeight; ++y){
-		for(size_t x = 0; x < config.initialWidth; ++x){
-			// Move to 0,1.
-			// No need to take care of the 0.5 shift as we are working with indices
-			const float xf = float(x) / (config.initialWidth - 1.0);
-			const float yf = float(y) / (config.initialHeight - 1.0);
-			// Position and ray direction.
-			// x becomes the height
-			// y become the cosine
-			const glm::vec3 currPos = glm::vec3(0.0f, (topRadius - groundRadius) * xf + groundRadius, 0.0f);
-			const float cosA = 2.0f * yf - 1.0f;
-			const float sinA = sqrt(1.0 - cosA*cosA);
-			const glm::vec3 sunDir = -glm::normalize(glm::vec3(sinA, cosA, 0.0f));
-			// Check when the ray leaves the atmosphere.
-			glm::vec2 interSecondTop;
-			const bool didHitSecondTop = intersects(currPos, sunDir, topRadius, interSecondTop);
-			// Divide the distance traveled through the atmosphere in samplesCount parts.
-			const float secondStepSize = didHitSecondTop ? interSecondTop.y/samplesCount : 0.0f;
+	// Rows are independent.
+	TaskScheduler::parallelFor(0, config.initialHeight, 0, [&](size_t firstRow, size_t endRow){
+		for(size_t y = firstRow; y < endRow; ++y){
+			for(size_t x = 0; x < config.initialWidth; ++x){
+				// Move to 0,1.
+				// No need to take care of the 0.5 shift as we are working with indices
+				const float xf = float(x) / (config.initialWidth - 1.0);
+				const float yf = float(y) / (config.initialHeight - 1.0);
+				// Position and ray direction.
+				// x becomes the height
+				// y become the cosine
+				const glm::vec3 currPos = glm::vec3(0.0f, (topRadius - groundRadius) * xf + groundRadius, 0.0f);
+				const float cosA = 2.0f * yf - 1.0f;
+				const float sinA = sqrt(1.0 - cosA*cosA);
+				const glm::vec3 sunDir = -glm::normalize(glm::vec3(sinA, cosA, 0.0f));
+				// Check when the ray leaves the atmosphere.
+				glm::vec2 interSecondTop;
+				const bool didHitSecondTop = intersects(currPos, sunDir, topRadius, interSecondTop);
+				// Divide the distance traveled through the atmosphere in samplesCount parts.
+				const float secondStepSize = didHitSecondTop ? interSecondTop.y/samplesCount : 0.0f;
 				
-			// Accumulate optical distance for both scatterings.
-			float rayleighSecondDist = 0.0;
-			float mieSecondDist = 0.0;
+				// Accumulate optical distance for both scatterings.
+				float rayleighSecondDist = 0.0;
+				float mieSecondDist = 0.0;
 			
-			// March along the secondary ray.
-			for(int j = 0; j < samplesCount; ++j){
-				// Compute the current position along the ray, ...
-				const glm::vec3 currSecondPos = currPos + (j+0.5f) * secondStepSize * sunDir;
-				// ...and its distance to the ground (as we are in planet space).
-				const float currSecondHeight = glm::length(currSecondPos) - groundRadius;
-				// Compute density based on the characteristic height of Rayleigh and Mie.
-				const float rayleighSecondStep = exp(-currSecondHeight/heightRayleigh) * secondStepSize;
-				const float mieSecondStep = exp(-currSecondHeight/heightMie) * secondStepSize;
-				// Accumulate optical distances.
-				rayleighSecondDist += rayleighSecondStep;
-				mieSecondDist += mieSecondStep;
-			}
+				// March along the secondary ray.
+				for(int j = 0; j < samplesCount; ++j){
+					// Compute the current position along the ray, ...
+					const glm::vec3 currSecondPos = currPos + (j+0.5f) * secondStepSize * sunDir;
+					// ...and its distance to the ground (as we are in planet space).
+					const float currSecondHeight = glm::length(currSecondPos) - groundRadius;
+					// Compute density based on the characteristic height of Rayleigh and Mie.
+					const float rayleighSecondStep = exp(-currSecondHeight/heightRayleigh) * secondStepSize;
+					const float mieSecondStep = exp(-currSecondHeight/heightMie) * secondStepSize;
+					// Accumulate optical distances.
+					rayleighSecondDist += rayleighSecondStep;
+					mieSecondDist += mieSecondStep;
+				}
 			
-			// Compute associated attenuation.
-			const glm::vec3 secondaryAttenuation = exp(-(kMie * (mieSecondDist) + kRayleigh * (rayleighSecondDist)));
-			transmittanceTable[config.initialWidth*y+x] = secondaryAttenuation;
+				// Compute associated attenuation.
+				const glm::vec3 secondaryAttenuation = exp(-(kMie * (mieSecondDist) + kRayleigh * (rayleighSecondDist)));
+				transmittanceTable[config.initialWidth*y+x] = secondaryAttenuation;
+			}
 		}
-	}
+	});
 	
 	ImageUtilities::saveHDRImage(config.outputPath, config.initialWidth, config.initialHeight, 3, reinterpret_cast<float*>(&transmittanceTable[0]), false);
 	
@@ -154,9 +154,9 @@ int main(int argc, char** argv) {
 		// Generate convolution map for increments of roughness.
 		unsigned int count = 0;
 		for(float rr = 0.0f; rr < 1.1f; rr += 0.2f){
-			glUseProgram(Resources::manager().getProgram("cubemap_convo")->id());
+			GLUtilities::useProgram(Resources::manager().getProgram("cubemap_convo")->id());
 			glUniform1f(Resources::manager().getProgram("cubemap_convo")->uniform("mimapRoughness"), rr);
-			glUseProgram(0);
+			GLUtilities::useProgram(0);
 			
 			const unsigned int powe = (unsigned int)std::pow(2, count);
 			const unsigned int localWidth = outputWidth/powe;
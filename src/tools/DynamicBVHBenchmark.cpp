@@ -0,0 +1,189 @@
+#include "Common.hpp"
+#include "Config.hpp"
+#include "DynamicBVH.hpp"
+#include "helpers/GenerationUtilities.hpp"
+#include <map>
+#include <chrono>
+#include <functional>
+
+/**
+ \defgroup DynamicBVHBenchmark Dynamic BVH Benchmark
+ \brief Measure the update and query throughput of a dynamic bounding volume hierarchy over moving boxes, and check the queries results against a brute force traversal, without any GPU work.
+ \ingroup Tools
+ */
+
+/** Measure the duration of a function.
+ \param func the function to run
+ \return the duration in microseconds
+ \ingroup DynamicBVHBenchmark
+ */
+template<typename Function>
+double timeRun(const Function & func){
+	const auto start = std::chrono::steady_clock::now();
+	func();
+	const auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / 1000.0;
+}
+
+/** Test if two boxes overlap.
+ \param a the first box
+ \param b the second box
+ \return true if the boxes share at least a point
+ \ingroup DynamicBVHBenchmark
+ */
+bool overlaps(const BoundingBox & a, const BoundingBox & b){
+	return glm::all(glm::lessThanEqual(a.minis, b.maxis)) && glm::all(glm::lessThanEqual(b.minis, a.maxis));
+}
+
+/** Generate a random box.
+ \param center the box center
+ \return a box with random sizes
+ \ingroup DynamicBVHBenchmark
+ */
+BoundingBox randomBox(const glm::vec3 & center){
+	const glm::vec3 extent(Random::Float(0.05f, 0.5f), Random::Float(0.05f, 0.5f), Random::Float(0.05f, 0.5f));
+	BoundingBox box;
+	box.minis = center - extent;
+	box.maxis = center + extent;
+	return box;
+}
+
+/** Dynamic BVH benchmark: optionally expects "-boxes count" (100000 by default), "-frames count" (100 by default) and "-queries count" (1000 by default).
+ \param argc the number of input arguments.
+ \param argv a pointer to the raw input arguments.
+ \return a general error code.
+ \ingroup DynamicBVHBenchmark
+ */
+int main(int argc, char** argv) {
+
+	// Arguments parsing.
+	std::map<std::string, std::vector<std::string>> arguments;
+	Config::parseFromArgs(argc, argv, arguments);
+	const size_t boxCount = arguments.count("boxes") > 0 ? (size_t)std::stoi(arguments["boxes"][0]) : 100000;
+	const size_t frameCount = arguments.count("frames") > 0 ? (size_t)std::stoi(arguments["frames"][0]) : 100;
+	const size_t queryCount = arguments.count("queries") > 0 ? (size_t)std::stoi(arguments["queries"][0]) : 1000;
+	if(boxCount == 0 || frameCount == 0){
+		Log::Error() << Log::Utilities << "Specify a non-zero number of boxes and frames." << std::endl;
+		return 3;
+	}
+	
+	// Boxes spread in a cube with a density independent of their count, each moving with a constant velocity.
+	Random::seed(42);
+	const float worldSize = 2.0f * std::cbrt(float(boxCount));
+	std::vector<BoundingBox> boxes(boxCount);
+	std::vector<glm::vec3> velocities(boxCount);
+	for(size_t bid = 0; bid < boxCount; ++bid){
+		boxes[bid] = randomBox(glm::vec3(Random::Float(0.0f, worldSize), Random::Float(0.0f, worldSize), Random::Float(0.0f, worldSize)));
+		velocities[bid] = 0.02f * glm::vec3(Random::Float(-1.0f, 1.0f), Random::Float(-1.0f, 1.0f), Random::Float(-1.0f, 1.0f));
+	}
+	
+	// Insertion.
+	DynamicBVH tree(0.1f);
+	std::vector<DynamicBVH::Proxy> proxies(boxCount);
+	const double durationInsert = timeRun([&](){
+		for(size_t bid = 0; bid < boxCount; ++bid){
+			proxies[bid] = tree.insert(boxes[bid], (unsigned int)bid);
+		}
+	});
+	Log::Info() << Log::Utilities << "Insertion: " << (durationInsert / 1000.0) << "ms for " << boxCount << " boxes, height " << tree.height() << ", relative cost " << tree.cost() << "." << std::endl;
+	
+	// Updates, boxes bounce on the world bounds.
+	size_t reinserted = 0;
+	double durationUpdate = 0.0;
+	for(size_t fid = 0; fid < frameCount; ++fid){
+		for(size_t bid = 0; bid < boxCount; ++bid){
+			const glm::vec3 center = 0.5f * (boxes[bid].minis + boxes[bid].maxis);
+			for(int i = 0; i < 3; ++i){
+				if((center[i] < 0.0f && velocities[bid][i] < 0.0f) || (center[i] > worldSize && velocities[bid][i] > 0.0f)){
+					velocities[bid][i] = -velocities[bid][i];
+				}
+			}
+			boxes[bid].minis += velocities[bid];
+			boxes[bid].maxis += velocities[bid];
+		}
+		durationUpdate += timeRun([&](){
+			for(size_t bid = 0; bid < boxCount; ++bid){
+				reinserted += tree.update(proxies[bid], boxes[bid]) ? 1 : 0;
+			}
+		});
+	}
+	Log::Info() << Log::Utilities << "Update: " << (durationUpdate / double(frameCount) / 1000.0) << "ms per frame, " << (reinserted / frameCount) << " boxes reinserted per frame, height " << tree.height() << ", relative cost " << tree.cost() << "." << std::endl;
+	
+	// Queries, checked against a brute force traversal of the exact boxes.
+	std::vector<BoundingBox> queryBoxes(queryCount);
+	std::vector<Frustum> queryFrustums(queryCount);
+	std::vector<glm::vec3> rayOrigins(queryCount);
+	std::vector<glm::vec3> rayDirections(queryCount);
+	for(size_t qid = 0; qid < queryCount; ++qid){
+		const glm::vec3 center(Random::Float(0.0f, worldSize), Random::Float(0.0f, worldSize), Random::Float(0.0f, worldSize));
+		queryBoxes[qid] = randomBox(center);
+		queryBoxes[qid].minis -= glm::vec3(1.0f);
+		queryBoxes[qid].maxis += glm::vec3(1.0f);
+		const glm::vec3 target(Random::Float(0.0f, worldSize), Random::Float(0.0f, worldSize), Random::Float(0.0f, worldSize));
+		const glm::mat4 view = glm::lookAt(center, target, glm::vec3(0.0f, 1.0f, 0.0f));
+		queryFrustums[qid] = Frustum(glm::perspective(0.3f, 1.0f, 0.1f, 0.25f * worldSize) * view);
+		rayOrigins[qid] = center;
+		rayDirections[qid] = glm::normalize(target - center);
+	}
+	
+	std::vector<unsigned int> results;
+	size_t missed = 0;
+	size_t overlapResults = 0;
+	size_t frustumResults = 0;
+	size_t rayResults = 0;
+	std::vector<unsigned char> found(boxCount, 0);
+	// Every box reported by the brute force traversal should be reported by the hierarchy.
+	auto checkResults = [&](const std::function<bool(const BoundingBox &)> & test){
+		for(const unsigned int bid : results){
+			found[bid] = 1;
+		}
+		for(size_t bid = 0; bid < boxCount; ++bid){
+			missed += (test(boxes[bid]) && !found[bid]) ? 1 : 0;
+		}
+		for(const unsigned int bid : results){
+			found[bid] = 0;
+		}
+	};
+	
+	double durationOverlap = 0.0;
+	double durationFrustum = 0.0;
+	double durationRay = 0.0;
+	for(size_t qid = 0; qid < queryCount; ++qid){
+		durationOverlap += timeRun([&](){ tree.queryOverlap(queryBoxes[qid], results); });
+		overlapResults += results.size();
+		checkResults([&](const BoundingBox & box){ return overlaps(box, queryBoxes[qid]); });
+		
+		durationFrustum += timeRun([&](){ tree.queryFrustum(queryFrustums[qid], results); });
+		frustumResults += results.size();
+		checkResults([&](const BoundingBox & box){ return queryFrustums[qid].intersects(box); });
+		
+		durationRay += timeRun([&](){ tree.queryRay(rayOrigins[qid], rayDirections[qid], 0.25f * worldSize, results); });
+		rayResults += results.size();
+		checkResults([&](const BoundingBox & box){
+			const glm::vec3 t0 = (box.minis - rayOrigins[qid]) / rayDirections[qid];
+			const glm::vec3 t1 = (box.maxis - rayOrigins[qid]) / rayDirections[qid];
+			const glm::vec3 tNear = glm::min(t0, t1);
+			const glm::vec3 tFar = glm::max(t0, t1);
+			const float tEnter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+			const float tExit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, 0.25f * worldSize));
+			return tEnter <= tExit;
+		});
+	}
+	
+	// Brute force reference timing, on the overlap queries.
+	size_t bruteResults = 0;
+	const double durationBrute = timeRun([&](){
+		for(size_t qid = 0; qid < queryCount; ++qid){
+			for(size_t bid = 0; bid < boxCount; ++bid){
+				bruteResults += overlaps(boxes[bid], queryBoxes[qid]) ? 1 : 0;
+			}
+		}
+	});
+	
+	const double queries = double(std::max(queryCount, size_t(1)));
+	Log::Info() << Log::Utilities << "Overlap queries: " << (durationOverlap / queries) << "us per query, " << (overlapResults / queries) << " results (brute force: " << (durationBrute / queries) << "us, " << (bruteResults / queries) << " results)." << std::endl;
+	Log::Info() << Log::Utilities << "Frustum queries: " << (durationFrustum / queries) << "us per query, " << (frustumResults / queries) << " results." << std::endl;
+	Log::Info() << Log::Utilities << "Ray queries: " << (durationRay / queries) << "us per query, " << (rayResults / queries) << " results." << std::endl;
+	Log::Info() << Log::Utilities << "Boxes missed by the hierarchy: " << missed << "." << std::endl;
+	return missed == 0 ? 0 : 1;
+}
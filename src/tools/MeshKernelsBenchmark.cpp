@@ -0,0 +1,275 @@
+#include "Common.hpp"
+#include "Config.hpp"
+#include "resources/MeshUtilities.hpp"
+#include "resources/ResourcesManager.hpp"
+#include "helpers/GenerationUtilities.hpp"
+#include <map>
+#include <sstream>
+#include <chrono>
+#include <thread>
+
+/**
+ \defgroup MeshKernelsBenchmark Mesh Kernels Benchmark
+ \brief Compare the mesh processing kernels (tangents, bounding box, centering, boxes transformation) against straightforward scalar implementations, for speed and accuracy.
+ \ingroup Tools
+ */
+
+/** Scalar reference for the tangents computation, accumulating all triangles sequentially.
+ \param mesh the mesh to process
+ \ingroup MeshKernelsBenchmark
+ */
+void referenceTangents(Mesh & mesh){
+	std::vector<glm::vec3> tangents(mesh.positions.size(), glm::vec3(0.0f));
+	std::vector<glm::vec3> bitangents(mesh.positions.size(), glm::vec3(0.0f));
+	for(size_t fid = 0; fid + 2 < mesh.indices.size(); fid += 3){
+		const unsigned int i0 = mesh.indices[fid];
+		const unsigned int i1 = mesh.indices[fid+1];
+		const unsigned int i2 = mesh.indices[fid+2];
+		const glm::vec3 deltaPosition1 = mesh.positions[i1] - mesh.positions[i0];
+		const glm::vec3 deltaPosition2 = mesh.positions[i2] - mesh.positions[i0];
+		const glm::vec2 deltaUv1 = mesh.texcoords[i1] - mesh.texcoords[i0];
+		const glm::vec2 deltaUv2 = mesh.texcoords[i2] - mesh.texcoords[i0];
+		const float denom = deltaUv1.x * deltaUv2.y - deltaUv1.y * deltaUv2.x;
+		const float det = (std::abs(denom) < 0.001f) ? 1.0f : (1.0f / denom);
+		const glm::vec3 tangent = det * (deltaPosition1 * deltaUv2.y - deltaPosition2 * deltaUv1.y);
+		const glm::vec3 bitangent = det * (deltaPosition2 * deltaUv1.x - deltaPosition1 * deltaUv2.x);
+		for(const unsigned int vid : {i0, i1, i2}){
+			tangents[vid] += tangent;
+			bitangents[vid] += bitangent;
+		}
+	}
+	mesh.tangents.resize(mesh.positions.size());
+	for(size_t vid = 0; vid < mesh.positions.size(); ++vid){
+		const glm::vec3 & n = mesh.normals[vid];
+		glm::vec3 t = tangents[vid] - n * glm::dot(n, tangents[vid]);
+		t = glm::length(t) > 0.0f ? glm::normalize(t) : glm::vec3(0.0f);
+		mesh.tangents[vid] = glm::vec4(t, glm::dot(glm::cross(n, t), bitangents[vid]) < 0.0f ? -1.0f : 1.0f);
+	}
+}
+
+/** Scalar reference for the bounding box computation.
+ \param mesh the mesh
+ \return the bounding box
+ \ingroup MeshKernelsBenchmark
+ */
+BoundingBox referenceBoundingBox(const Mesh & mesh){
+	BoundingBox bbox;
+	bbox.minis = bbox.maxis = mesh.positions[0];
+	for(const glm::vec3 & position : mesh.positions){
+		bbox.minis = glm::min(bbox.minis, position);
+		bbox.maxis = glm::max(bbox.maxis, position);
+	}
+	return bbox;
+}
+
+/** Scalar reference for the mesh centering and scaling.
+ \param mesh the mesh to process
+ \ingroup MeshKernelsBenchmark
+ */
+void referenceCenterAndUnit(Mesh & mesh){
+	glm::vec3 centroid(0.0f);
+	for(const glm::vec3 & position : mesh.positions){
+		centroid += position;
+	}
+	centroid /= float(mesh.positions.size());
+	float maxi = 0.0f;
+	for(glm::vec3 & position : mesh.positions){
+		position -= centroid;
+		maxi = std::max(maxi, std::max(std::abs(position.x), std::max(std::abs(position.y), std::abs(position.z))));
+	}
+	maxi = maxi == 0.0f ? 1.0f : maxi;
+	for(glm::vec3 & position : mesh.positions){
+		position /= maxi;
+	}
+}
+
+/** Reference for the box transformation, transforming all corners of the box.
+ \param box the box to transform
+ \param trans the transformation
+ \return the bounding box of the transformed corners
+ \ingroup MeshKernelsBenchmark
+ */
+BoundingBox referenceTransformed(const BoundingBox & box, const glm::mat4 & trans){
+	const std::vector<glm::vec3> corners = box.getCorners();
+	BoundingBox newBox;
+	newBox.minis = newBox.maxis = glm::vec3(trans * glm::vec4(corners[0], 1.0f));
+	for(const glm::vec3 & corner : corners){
+		const glm::vec3 transformedCorner = glm::vec3(trans * glm::vec4(corner, 1.0f));
+		newBox.minis = glm::min(newBox.minis, transformedCorner);
+		newBox.maxis = glm::max(newBox.maxis, transformedCorner);
+	}
+	return newBox;
+}
+
+/** Compute the largest corner difference between two lists of boxes.
+ \param a the first list
+ \param b the second list
+ \return the maximum distance between corresponding corners
+ \ingroup MeshKernelsBenchmark
+ */
+float boxesError(const std::vector<BoundingBox> & a, const BoundingBoxArray & b){
+	float error = 0.0f;
+	for(size_t bid = 0; bid < a.size(); ++bid){
+		const BoundingBox box = b.get(bid);
+		error = std::max(error, std::max(glm::length(a[bid].minis - box.minis), glm::length(a[bid].maxis - box.maxis)));
+	}
+	return error;
+}
+
+/** Measure the average duration of a function.
+ \param repeat the number of runs
+ \param func the function to run
+ \return the average duration in milliseconds
+ \ingroup MeshKernelsBenchmark
+ */
+template<typename Func>
+double timeRuns(int repeat, Func func){
+	const auto start = std::chrono::steady_clock::now();
+	for(int rid = 0; rid < repeat; ++rid){
+		func();
+	}
+	const auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.0 / double(repeat);
+}
+
+/** Log the durations of a kernel and its reference.
+ \param label the kernel name
+ \param reference the reference duration
+ \param optimized the optimized duration
+ \param error the maximum difference between results
+ \ingroup MeshKernelsBenchmark
+ */
+void logKernel(const std::string & label, double reference, double optimized, float error){
+	Log::Info() << Log::Utilities << label << ": " << reference << "ms (scalar), " << optimized << "ms (optimized), x" << (reference / optimized) << ", max error " << error << "." << std::endl;
+}
+
+/** Mesh kernels benchmark: expects "-mesh path/to/mesh.obj" and optionally "-copies count" (1 by default) to duplicate the mesh, "-boxes count" (100000 by default) boxes to transform and "-repeat count" (10 by default).
+ \param argc the number of input arguments.
+ \param argv a pointer to the raw input arguments.
+ \return a general error code.
+ \ingroup MeshKernelsBenchmark
+ */
+int main(int argc, char** argv) {
+
+	// Arguments parsing.
+	std::map<std::string, std::vector<std::string>> arguments;
+	Config::parseFromArgs(argc, argv, arguments);
+	if(arguments.count("mesh") == 0){
+		Log::Error() << Log::Utilities << "Specify path to mesh." << std::endl;
+		return 3;
+	}
+	const std::string meshPath = arguments["mesh"][0];
+	const int copies = arguments.count("copies") > 0 ? std::max(1, std::stoi(arguments["copies"][0])) : 1;
+	const int repeat = arguments.count("repeat") > 0 ? std::max(1, std::stoi(arguments["repeat"][0])) : 10;
+	const size_t boxCount = arguments.count("boxes") > 0 ? size_t(std::max(1, std::stoi(arguments["boxes"][0]))) : 100000;
+	
+	const std::string meshText = Resources::loadStringFromExternalFile(meshPath);
+	if(meshText.empty()){
+		Log::Error() << Log::Resources << "Unable to load mesh at path " << meshPath << "." << std::endl;
+		return 1;
+	}
+	Mesh source;
+	std::stringstream meshStream(meshText);
+	MeshUtilities::loadObj(meshStream, source, MeshUtilities::Indexed);
+	if(source.indices.empty() || source.texcoords.size() != source.positions.size() || source.normals.size() != source.positions.size()){
+		Log::Error() << Log::Resources << "Mesh at path " << meshPath << " should have faces, normals and texture coordinates." << std::endl;
+		return 1;
+	}
+	
+	// Duplicate the mesh, with an offset, to evaluate larger inputs.
+	Mesh mesh;
+	for(int cid = 0; cid < copies; ++cid){
+		const unsigned int offset = (unsigned int)mesh.positions.size();
+		for(const glm::vec3 & position : source.positions){
+			mesh.positions.push_back(position + glm::vec3(float(cid), 0.0f, 0.0f));
+		}
+		mesh.normals.insert(mesh.normals.end(), source.normals.begin(), source.normals.end());
+		mesh.texcoords.insert(mesh.texcoords.end(), source.texcoords.begin(), source.texcoords.end());
+		for(const unsigned int index : source.indices){
+			mesh.indices.push_back(index + offset);
+		}
+	}
+	Log::Info() << Log::Utilities << "Mesh with " << mesh.indices.size() / 3 << " triangles, " << mesh.positions.size() << " vertices, " << std::thread::hardware_concurrency() << " hardware threads." << std::endl;
+	
+	// Tangents.
+	Mesh reference = mesh;
+	Mesh optimized = mesh;
+	const double tangentsReference = timeRuns(repeat, [&reference](){ referenceTangents(reference); });
+	const double tangentsOptimized = timeRuns(repeat, [&optimized](){ MeshUtilities::computeTangents(optimized); });
+	float tangentsError = 0.0f;
+	size_t signMismatches = 0;
+	for(size_t vid = 0; vid < mesh.positions.size(); ++vid){
+		// Skip degenerate frames, the reference leaves them null.
+		if(glm::length(glm::vec3(reference.tangents[vid])) == 0.0f){
+			continue;
+		}
+		tangentsError = std::max(tangentsError, glm::length(glm::vec3(reference.tangents[vid]) - glm::vec3(optimized.tangents[vid])));
+		signMismatches += (reference.tangents[vid].w != optimized.tangents[vid].w) ? 1 : 0;
+	}
+	logKernel("Tangents", tangentsReference, tangentsOptimized, tangentsError);
+	Log::Info() << Log::Utilities << signMismatches << " handedness mismatches." << std::endl;
+	
+	// Bounding box.
+	BoundingBox boxReference;
+	BoundingBox boxOptimized;
+	const double boxTimeReference = timeRuns(repeat, [&](){ boxReference = referenceBoundingBox(mesh); });
+	const double boxTimeOptimized = timeRuns(repeat, [&](){ boxOptimized = MeshUtilities::computeBoundingBox(mesh); });
+	const float boxError = std::max(glm::length(boxReference.minis - boxOptimized.minis), glm::length(boxReference.maxis - boxOptimized.maxis));
+	logKernel("Bounding box", boxTimeReference, boxTimeOptimized, boxError);
+	
+	// Centering, applied once on fresh copies for the accuracy check.
+	reference = mesh;
+	optimized = mesh;
+	referenceCenterAndUnit(reference);
+	MeshUtilities::centerAndUnitMesh(optimized);
+	float centerError = 0.0f;
+	for(size_t vid = 0; vid < mesh.positions.size(); ++vid){
+		centerError = std::max(centerError, glm::length(reference.positions[vid] - optimized.positions[vid]));
+	}
+	// Successive runs are idempotent up to rounding.
+	const double centerReference = timeRuns(repeat, [&reference](){ referenceCenterAndUnit(reference); });
+	const double centerOptimized = timeRuns(repeat, [&optimized](){ MeshUtilities::centerAndUnitMesh(optimized); });
+	logKernel("Center and unit", centerReference, centerOptimized, centerError);
+	
+	// Boxes transformation, with random boxes and affine transformations.
+	Random::seed(42);
+	std::vector<BoundingBox> boxes(boxCount);
+	std::vector<glm::mat4> transformations(boxCount);
+	BoundingBoxArray boxesArray;
+	boxesArray.resize(boxCount);
+	for(size_t bid = 0; bid < boxCount; ++bid){
+		const glm::vec3 center(Random::Float(-10.0f, 10.0f), Random::Float(-10.0f, 10.0f), Random::Float(-10.0f, 10.0f));
+		const glm::vec3 extent(Random::Float(0.0f, 2.0f), Random::Float(0.0f, 2.0f), Random::Float(0.0f, 2.0f));
+		boxes[bid].minis = center - extent;
+		boxes[bid].maxis = center + extent;
+		boxesArray.set(bid, boxes[bid]);
+		const glm::vec3 axis = glm::normalize(glm::vec3(Random::Float(-1.0f, 1.0f), Random::Float(-1.0f, 1.0f), 1.0f));
+		transformations[bid] = glm::scale(glm::rotate(glm::translate(glm::mat4(1.0f), center), Random::Float(0.0f, 6.28f), axis), glm::vec3(Random::Float(0.1f, 2.0f)));
+	}
+	std::vector<BoundingBox> boxesReference(boxCount);
+	std::vector<BoundingBox> boxesScalar(boxCount);
+	BoundingBoxArray boxesBatched;
+	const double transformReference = timeRuns(repeat, [&](){
+		for(size_t bid = 0; bid < boxCount; ++bid){
+			boxesReference[bid] = referenceTransformed(boxes[bid], transformations[bid]);
+		}
+	});
+	const double transformScalar = timeRuns(repeat, [&](){
+		for(size_t bid = 0; bid < boxCount; ++bid){
+			boxesScalar[bid] = boxes[bid].transformed(transformations[bid]);
+		}
+	});
+	const double transformBatched = timeRuns(repeat, [&](){ MeshUtilities::transformBoundingBoxes(boxesArray, transformations, boxesBatched); });
+	BoundingBoxArray boxesScalarArray;
+	boxesScalarArray.resize(boxCount);
+	for(size_t bid = 0; bid < boxCount; ++bid){
+		boxesScalarArray.set(bid, boxesScalar[bid]);
+	}
+	const float transformScalarError = boxesError(boxesReference, boxesScalarArray);
+	const float transformBatchedError = boxesError(boxesReference, boxesBatched);
+	logKernel("Boxes transformation (Arvo)", transformReference, transformScalar, transformScalarError);
+	logKernel("Boxes transformation (batched)", transformReference, transformBatched, transformBatchedError);
+	
+	const bool valid = tangentsError < 1e-3f && signMismatches == 0 && boxError == 0.0f && centerError < 1e-4f && transformScalarError < 1e-4f && transformBatchedError < 1e-4f;
+	return valid ? 0 : 1;
+}
@@ -0,0 +1,139 @@
+#include "Common.hpp"
+#include "Config.hpp"
+#include "resources/MeshUtilities.hpp"
+#include "resources/ResourcesManager.hpp"
+#include <map>
+#include <sstream>
+#include <chrono>
+
+/**
+ \defgroup MeshOptimizer Mesh Optimization
+ \brief Evaluate the vertex cache, overdraw and vertex fetch optimizations, the levels of detail generation and the clusters decomposition on a mesh, without any GPU work.
+ \details Reports the average cache miss ratio (ACMR) and average transformed vertex ratio (ATVR) of a simulated FIFO post-transform cache, before and after each step.
+ \ingroup Tools
+ */
+
+/** Print the cache statistics of a mesh.
+ \param label the step name
+ \param mesh the mesh to evaluate
+ \param cacheSize the simulated cache size
+ \ingroup MeshOptimizer
+ */
+void logStatistics(const std::string & label, const Mesh & mesh, unsigned int cacheSize){
+	const MeshUtilities::CacheStatistics stats = MeshUtilities::computeCacheStatistics(mesh, cacheSize);
+	Log::Info() << Log::Utilities << label << ": ACMR " << stats.acmr << ", ATVR " << stats.atvr << "." << std::endl;
+}
+
+/** Estimate the ratio of clusters and triangles culled by normal cones, averaged over viewpoints placed around the mesh.
+ \param mesh the mesh, split in clusters
+ \param distance the distance of the viewpoints to the mesh center, relative to its bounding sphere radius
+ \ingroup MeshOptimizer
+ */
+void logConeCulling(const Mesh & mesh, float distance){
+	const BoundingSphere sphere = MeshUtilities::computeBoundingBox(mesh).getSphere();
+	const Frustum frustum;
+	const int steps = 16;
+	size_t culledClusters = 0;
+	size_t culledTriangles = 0;
+	size_t totalTriangles = 0;
+	size_t viewCount = 0;
+	// Viewpoints on a latitude-longitude grid.
+	for(int y = 0; y < steps; ++y){
+		const float theta = M_PI * (float(y) + 0.5f) / float(steps);
+		for(int x = 0; x < 2 * steps; ++x){
+			const float phi = M_PI * float(x) / float(steps);
+			const glm::vec3 direction(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+			const glm::vec4 viewPoint = distance > 0.0f ? glm::vec4(sphere.center + distance * sphere.radius * direction, 1.0f) : glm::vec4(direction, 0.0f);
+			for(const Meshlet & meshlet : mesh.meshlets){
+				totalTriangles += meshlet.count / 3;
+				if(!meshlet.visible(frustum, viewPoint)){
+					++culledClusters;
+					culledTriangles += meshlet.count / 3;
+				}
+			}
+			++viewCount;
+		}
+	}
+	const float clusterRatio = float(culledClusters) / float(viewCount * mesh.meshlets.size());
+	const float triangleRatio = float(culledTriangles) / float(totalTriangles);
+	Log::Info() << Log::Utilities << "Cone culling " << (distance > 0.0f ? "at distance " + std::to_string(distance) : "orthographic") << ": " << 100.0f * clusterRatio << "% clusters, " << 100.0f * triangleRatio << "% triangles." << std::endl;
+}
+
+/** Mesh optimizer: expects "-mesh path/to/mesh.obj" and optionally "-cache size" (16 by default), "-threshold ratio" (1.05 by default), "-lods" to also generate levels of detail and "-meshlets" to split the mesh in clusters.
+ \param argc the number of input arguments.
+ \param argv a pointer to the raw input arguments.
+ \return a general error code.
+ \ingroup MeshOptimizer
+ */
+int main(int argc, char** argv) {
+
+	// Arguments parsing.
+	std::map<std::string, std::vector<std::string>> arguments;
+	Config::parseFromArgs(argc, argv, arguments);
+	if(arguments.count("mesh") == 0){
+		Log::Error() << Log::Utilities << "Specify path to mesh." << std::endl;
+		return 3;
+	}
+	const std::string meshPath = arguments["mesh"][0];
+	const unsigned int cacheSize = arguments.count("cache") > 0 ? (unsigned int)std::stoi(arguments["cache"][0]) : 16;
+	const float threshold = arguments.count("threshold") > 0 ? std::stof(arguments["threshold"][0]) : 1.05f;
+
+	// Load the mesh as the resources manager would.
+	const std::string meshText = Resources::loadStringFromExternalFile(meshPath);
+	if(meshText.empty()){
+		Log::Error() << Log::Resources << "Unable to load mesh at path " << meshPath << "." << std::endl;
+		return 1;
+	}
+	Mesh mesh;
+	std::stringstream meshStream(meshText);
+	MeshUtilities::loadObj(meshStream, mesh, MeshUtilities::Indexed);
+	if(mesh.indices.empty()){
+		Log::Error() << Log::Resources << "Mesh at path " << meshPath << " has no faces." << std::endl;
+		return 1;
+	}
+	Log::Info() << Log::Utilities << "Mesh with " << mesh.indices.size()/3 << " triangles, " << mesh.positions.size() << " vertices, cache of size " << cacheSize << "." << std::endl;
+	logStatistics("Original", mesh, cacheSize);
+
+	const auto start = std::chrono::steady_clock::now();
+
+	std::vector<unsigned int> clusters;
+	MeshUtilities::optimizeVertexCache(mesh, cacheSize, clusters);
+	logStatistics("Vertex cache", mesh, cacheSize);
+	Log::Info() << Log::Utilities << clusters.size() << " clusters." << std::endl;
+
+	MeshUtilities::optimizeOverdraw(mesh, clusters, cacheSize, threshold);
+	logStatistics("Overdraw", mesh, cacheSize);
+
+	MeshUtilities::optimizeVertexFetch(mesh);
+	logStatistics("Vertex fetch", mesh, cacheSize);
+
+	const auto end = std::chrono::steady_clock::now();
+	const double duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.0;
+	Log::Info() << Log::Utilities << "Done in " << duration << "ms." << std::endl;
+
+	if(arguments.count("lods") > 0){
+		const auto startLods = std::chrono::steady_clock::now();
+		MeshUtilities::generateLevelsOfDetail(mesh);
+		const auto endLods = std::chrono::steady_clock::now();
+		for(size_t lid = 0; lid < mesh.levels.size(); ++lid){
+			Log::Info() << Log::Utilities << "Level " << lid << ": " << mesh.levels[lid].count / 3 << " triangles, error " << mesh.levels[lid].error << "." << std::endl;
+		}
+		const double durationLods = std::chrono::duration_cast<std::chrono::microseconds>(endLods - startLods).count() / 1000.0;
+		Log::Info() << Log::Utilities << "Levels of detail generated in " << durationLods << "ms." << std::endl;
+	}
+
+	if(arguments.count("meshlets") > 0){
+		const auto startMeshlets = std::chrono::steady_clock::now();
+		MeshUtilities::buildMeshlets(mesh);
+		const auto endMeshlets = std::chrono::steady_clock::now();
+		const double durationMeshlets = std::chrono::duration_cast<std::chrono::microseconds>(endMeshlets - startMeshlets).count() / 1000.0;
+		const size_t triCount = (mesh.levels.empty() ? mesh.indices.size() : mesh.levels[0].count) / 3;
+		Log::Info() << Log::Utilities << mesh.meshlets.size() << " clusters, " << float(triCount) / float(mesh.meshlets.size()) << " triangles on average, built in " << durationMeshlets << "ms." << std::endl;
+		logStatistics("Clusters", mesh, cacheSize);
+		logConeCulling(mesh, 0.0f);
+		logConeCulling(mesh, 2.0f);
+		logConeCulling(mesh, 1.2f);
+	}
+
+	return 0;
+}
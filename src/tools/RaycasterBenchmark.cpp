@@ -0,0 +1,144 @@
+#include "Common.hpp"
+#include "Config.hpp"
+#include "resources/MeshUtilities.hpp"
+#include "resources/ResourcesManager.hpp"
+#include "raycaster/Raycaster.hpp"
+#include "helpers/GenerationUtilities.hpp"
+#include <map>
+#include <sstream>
+#include <chrono>
+
+/**
+ \defgroup RaycasterBenchmark Raycaster Benchmark
+ \brief Measure the build time and ray throughput of a mesh bounding volume hierarchy, without any GPU work.
+ \details Rays start on a sphere around the mesh and aim at random points of its bounding box. A subset of the results is compared against a brute force intersection of all triangles.
+ \ingroup Tools
+ */
+
+/** Intersect a ray with all triangles of a mesh, as a reference.
+ \param mesh the mesh
+ \param ray the ray
+ \return the closest intersection distance, or the maximum float if there is none
+ \ingroup RaycasterBenchmark
+ */
+float bruteForceIntersection(const Mesh & mesh, const Ray & ray){
+	float closest = std::numeric_limits<float>::max();
+	for(size_t tid = 0; tid + 2 < mesh.indices.size(); tid += 3){
+		const glm::vec3 & v0 = mesh.positions[mesh.indices[tid]];
+		const glm::vec3 e1 = mesh.positions[mesh.indices[tid+1]] - v0;
+		const glm::vec3 e2 = mesh.positions[mesh.indices[tid+2]] - v0;
+		const glm::vec3 p = glm::cross(ray.direction, e2);
+		const float det = glm::dot(e1, p);
+		if(det == 0.0f){
+			continue;
+		}
+		const glm::vec3 s = ray.origin - v0;
+		const float u = glm::dot(s, p) / det;
+		const glm::vec3 q = glm::cross(s, e1);
+		const float v = glm::dot(ray.direction, q) / det;
+		const float t = glm::dot(e2, q) / det;
+		if(u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t >= 0.0f){
+			closest = std::min(closest, t);
+		}
+	}
+	return closest;
+}
+
+/** Raycaster benchmark: expects "-mesh path/to/mesh.obj" and optionally "-rays count" (1000000 by default) and "-validate count" (1000 by default).
+ \param argc the number of input arguments.
+ \param argv a pointer to the raw input arguments.
+ \return a general error code.
+ \ingroup RaycasterBenchmark
+ */
+int main(int argc, char** argv) {
+
+	// Arguments parsing.
+	std::map<std::string, std::vector<std::string>> arguments;
+	Config::parseFromArgs(argc, argv, arguments);
+	if(arguments.count("mesh") == 0){
+		Log::Error() << Log::Utilities << "Specify path to mesh." << std::endl;
+		return 3;
+	}
+	const std::string meshPath = arguments["mesh"][0];
+	const size_t rayCount = arguments.count("rays") > 0 ? (size_t)std::stoi(arguments["rays"][0]) : 1000000;
+	const size_t validateCount = arguments.count("validate") > 0 ? (size_t)std::stoi(arguments["validate"][0]) : 1000;
+
+	const std::string meshText = Resources::loadStringFromExternalFile(meshPath);
+	if(meshText.empty()){
+		Log::Error() << Log::Resources << "Unable to load mesh at path " << meshPath << "." << std::endl;
+		return 1;
+	}
+	Mesh mesh;
+	std::stringstream meshStream(meshText);
+	MeshUtilities::loadObj(meshStream, mesh, MeshUtilities::Indexed);
+	if(mesh.indices.empty() || rayCount == 0){
+		Log::Error() << Log::Resources << "Mesh at path " << meshPath << " has no faces." << std::endl;
+		return 1;
+	}
+
+	const auto startBuild = std::chrono::steady_clock::now();
+	const MeshBVH bvh(mesh);
+	const auto endBuild = std::chrono::steady_clock::now();
+	const double durationBuild = std::chrono::duration_cast<std::chrono::microseconds>(endBuild - startBuild).count() / 1000.0;
+	Log::Info() << Log::Utilities << "Hierarchy over " << bvh.triangleCount() << " triangles, " << bvh.nodeCount() << " nodes, built in " << durationBuild << "ms." << std::endl;
+
+	// Generate rays from a sphere around the mesh towards its bounding box.
+	Random::seed(42);
+	const BoundingBox & box = bvh.bounds();
+	const BoundingSphere sphere = box.getSphere();
+	std::vector<Ray> rays;
+	rays.reserve(rayCount);
+	for(size_t rid = 0; rid < rayCount; ++rid){
+		const float cosTheta = Random::Float(-1.0f, 1.0f);
+		const float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+		const float phi = Random::Float(0.0f, 2.0f * float(M_PI));
+		const glm::vec3 origin = sphere.center + 1.5f * sphere.radius * glm::vec3(sinTheta * std::cos(phi), cosTheta, sinTheta * std::sin(phi));
+		const glm::vec3 target = box.minis + (box.maxis - box.minis) * glm::vec3(Random::Float(), Random::Float(), Random::Float());
+		rays.emplace_back(origin, glm::normalize(target - origin));
+	}
+
+	// Closest hit queries.
+	size_t hitCount = 0;
+	float distSum = 0.0f;
+	const auto startClosest = std::chrono::steady_clock::now();
+	for(const Ray & ray : rays){
+		const RayHit hit = bvh.intersect(ray);
+		if(hit.hit){
+			++hitCount;
+			distSum += hit.dist;
+		}
+	}
+	const auto endClosest = std::chrono::steady_clock::now();
+	const double durationClosest = std::chrono::duration_cast<std::chrono::microseconds>(endClosest - startClosest).count() / 1000000.0;
+	Log::Info() << Log::Utilities << "Closest hit: " << (double(rayCount) / durationClosest / 1000000.0) << " Mrays/s, " << (100.0f * float(hitCount) / float(rayCount)) << "% hits (mean distance " << (hitCount > 0 ? distSum / float(hitCount) : 0.0f) << ")." << std::endl;
+
+	// Any hit queries.
+	size_t anyCount = 0;
+	const auto startAny = std::chrono::steady_clock::now();
+	for(const Ray & ray : rays){
+		anyCount += bvh.intersectsAny(ray) ? 1 : 0;
+	}
+	const auto endAny = std::chrono::steady_clock::now();
+	const double durationAny = std::chrono::duration_cast<std::chrono::microseconds>(endAny - startAny).count() / 1000000.0;
+	Log::Info() << Log::Utilities << "Any hit: " << (double(rayCount) / durationAny / 1000000.0) << " Mrays/s, " << (100.0f * float(anyCount) / float(rayCount)) << "% hits." << std::endl;
+
+	// Compare with the brute force reference.
+	size_t mismatches = 0;
+	const size_t validated = std::min(validateCount, rayCount);
+	double durationReference = 0.0;
+	for(size_t rid = 0; rid < validated; ++rid){
+		const RayHit hit = bvh.intersect(rays[rid]);
+		const auto startReference = std::chrono::steady_clock::now();
+		const float reference = bruteForceIntersection(mesh, rays[rid]);
+		const auto endReference = std::chrono::steady_clock::now();
+		durationReference += std::chrono::duration_cast<std::chrono::microseconds>(endReference - startReference).count() / 1000000.0;
+		const bool referenceHit = reference < std::numeric_limits<float>::max();
+		if(hit.hit != referenceHit || (hit.hit && std::abs(hit.dist - reference) > 1e-4f * sphere.radius)){
+			++mismatches;
+		}
+	}
+	if(validated > 0){
+		Log::Info() << Log::Utilities << mismatches << " mismatches over " << validated << " rays compared to brute force (" << (double(validated) / durationReference / 1000000.0) << " Mrays/s)." << std::endl;
+	}
+	return mismatches == 0 ? 0 : 1;
+}
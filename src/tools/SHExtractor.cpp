@@ -2,6 +2,7 @@
 #include "Config.hpp"
 #include "resources/ImageUtilities.hpp"
 #include "resources/ResourcesManager.hpp"
+#include "helpers/TaskScheduler.hpp"
 #include <map>
 
 ///
@@ -14,7 +15,7 @@
  */
 
 /** Irradiance spherical harmonics coefficients extractor for a radiance HDR cubemap.
- Expects "-map path/to/envmap" (without the suffixes and extension) and output a txt with the SH coefficients in the same directory.
+ Expects "-map path/to/envmap" (without the suffixes and extension) and output a txt with the SH coefficients in the same directory. Optionally expects "-threads count" (hardware thread count by default).
  \param argc the number of input arguments.
  \param argv a pointer to the raw input arguments.
  \return a general error code.
@@ -31,6 +32,7 @@ int main(int argc, char** argv) {
 		return 3;
 	}
 	const std::string rootPath = arguments["map"][0];
+	TaskScheduler::setup(arguments.count("threads") > 0 ? (unsigned int)std::stoi(arguments["threads"][0]) : 0);
 
 	// Paths for each side.
 	const std::vector<std::string> paths { rootPath + "_px.exr", rootPath + "_nx.exr", rootPath + "_py.exr", rootPath + "_ny.exr", rootPath + "_pz.exr", rootPath + "_nz.exr" };
@@ -80,9 +82,16 @@ int main(int argc, char** argv) {
 	const float y3 = 0.315392f;
 	const float y4 = 0.546274f;
 	
-	float denom = 0.0f;
-	for(int i = 0; i < 6; ++i){
-		for(unsigned int y = 0; y < height; ++y){
+	// Each row of each face accumulates its contributions separately, the rows are then summed in order so that the result doesn't depend on the threads scheduling.
+	const size_t rowCount = 6 * size_t(height);
+	std::vector<glm::vec3> rowCoeffs(rowCount * 9, glm::vec3(0.0f));
+	std::vector<float> rowDenoms(rowCount, 0.0f);
+	TaskScheduler::parallelFor(0, rowCount, 0, [&](size_t firstRow, size_t endRow){
+		for(size_t row = firstRow; row < endRow; ++row){
+			const int i = int(row / height);
+			const unsigned int y = (unsigned int)(row % height);
+			glm::vec3 * LCoeffs = &rowCoeffs[row * 9];
+			float & denom = rowDenoms[row];
 			for(unsigned int x = 0; x < width; ++x){
 				
 				const float v = -1.0f + 1.0f/float(width) + float(y) * 2.0f/float(width);
@@ -125,6 +134,14 @@ int main(int argc, char** argv) {
 				
 			}
 		}
+	});
+	
+	float denom = 0.0f;
+	for(size_t row = 0; row < rowCount; ++row){
+		denom += rowDenoms[row];
+		for(int i = 0; i < 9; ++i){
+			LCoeffs[i] += rowCoeffs[row * 9 + i];
+		}
 	}
 	
 	// Normalization.
@@ -0,0 +1,117 @@
+#include "Common.hpp"
+#include "Config.hpp"
+#include "resources/ResourcesManager.hpp"
+#include "resources/SceneDescription.hpp"
+#include <map>
+#include <sstream>
+#include <chrono>
+#include <cstring>
+
+/**
+ \defgroup SceneCompiler Scene Compiler
+ \brief Compile a text scene description into the binary format read without parsing, and compare the loading times of both forms, without any GPU work.
+ \details Can also generate a large text description, for loading stress tests.
+ \see SceneDescription
+ \ingroup Tools
+ */
+
+/** Measure the duration of a function.
+ \param func the function to run
+ \return the duration in milliseconds
+ \ingroup SceneCompiler
+ */
+template<typename Function>
+double timeRun(const Function & func){
+	const auto start = std::chrono::steady_clock::now();
+	func();
+	const auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / 1000000.0;
+}
+
+/** Generate a description of a grid of spheres over a ground plane, lit by point lights.
+ \param count the number of spheres
+ \return the description text
+ \ingroup SceneCompiler
+ */
+std::string generateGrid(size_t count){
+	std::stringstream text;
+	text << "# Grid of " << count << " spheres, generated by SceneCompiler." << std::endl;
+	text << "environment: studio studio_shcoeffs" << std::endl;
+	text << "batch:" << std::endl;
+	text << "material: wood sphere_wood_lacquered_albedo:srgb sphere_wood_lacquered_normal sphere_wood_lacquered_rough_met_ao" << std::endl;
+	text << "material: gold sphere_gold_worn_albedo:srgb sphere_gold_worn_normal sphere_gold_worn_rough_met_ao" << std::endl;
+	text << "material: plane plane_texture_color:srgb plane_texture_normal plane_texture_rough_met_ao plane_texture_depth" << std::endl;
+	const size_t side = size_t(std::ceil(std::sqrt(double(std::max(count, size_t(1))))));
+	text << "node: grid scale 0.25" << std::endl;
+	text << "object: parallax plane plane noshadow translation 0 -0.25 0 scale " << (0.5f * float(side) + 1.0f) << std::endl;
+	for(size_t sid = 0; sid < count; ++sid){
+		const size_t x = sid % side;
+		const size_t z = sid / side;
+		const float offset = 0.5f * float(side - 1);
+		text << "object: regular sphere " << ((x + z) % 2 == 0 ? "wood" : "gold") << " parent grid translation " << (4.0f * (float(x) - offset)) << " 0 " << (4.0f * (float(z) - offset)) << std::endl;
+	}
+	for(size_t lid = 0; lid < 16; ++lid){
+		const float angle = 2.0f * float(M_PI) * float(lid) / 16.0f;
+		text << "point: position " << (0.25f * float(side) * std::cos(angle)) << " 0.5 " << (0.25f * float(side) * std::sin(angle)) << " color 4 3 2 radius " << (0.25f * float(side)) << std::endl;
+	}
+	return text.str();
+}
+
+/** Scene compiler: expects "-scene path" to a text description, or "-grid count" to generate one, and optionally "-output path" for the compiled description (the input path followed by "bin" by default) and "-text path" to save the generated description.
+ \param argc the number of input arguments.
+ \param argv a pointer to the raw input arguments.
+ \return a general error code.
+ \ingroup SceneCompiler
+ */
+int main(int argc, char** argv) {
+
+	// Arguments parsing.
+	std::map<std::string, std::vector<std::string>> arguments;
+	Config::parseFromArgs(argc, argv, arguments);
+	std::string text;
+	std::string outputPath = arguments.count("output") > 0 ? arguments["output"][0] : "";
+	if(arguments.count("scene") > 0){
+		const std::string inputPath = arguments["scene"][0];
+		text = Resources::loadStringFromExternalFile(inputPath);
+		outputPath = outputPath.empty() ? (inputPath + "bin") : outputPath;
+	} else if(arguments.count("grid") > 0){
+		text = generateGrid((size_t)std::stoi(arguments["grid"][0]));
+		if(arguments.count("text") > 0){
+			Resources::saveStringToExternalFile(arguments["text"][0], text);
+		}
+	}
+	if(text.empty() || outputPath.empty()){
+		Log::Error() << Log::Utilities << "Specify a text description with -scene, or -grid and -output." << std::endl;
+		return 3;
+	}
+	
+	// Parse the text description.
+	SceneDescription description;
+	bool valid = false;
+	const double durationParse = timeRun([&](){
+		valid = description.parse(text);
+	});
+	if(!valid){
+		return 1;
+	}
+	Log::Info() << Log::Utilities << "Parsed " << description.instances().size() << " objects, " << description.nodes().size() << " nodes, " << description.materials().size() << " materials and " << description.lights().size() << " lights in " << durationParse << "ms." << std::endl;
+	
+	// Compile, then read back the compiled description and check that it is identical.
+	std::vector<char> data;
+	description.write(data);
+	SceneDescription compiled;
+	const double durationRead = timeRun([&](){
+		valid = compiled.read(data.data(), data.size());
+	});
+	std::vector<char> roundtrip;
+	compiled.write(roundtrip);
+	if(!valid || roundtrip.size() != data.size() || std::memcmp(roundtrip.data(), data.data(), data.size()) != 0){
+		Log::Error() << Log::Utilities << "The compiled description differs when read back." << std::endl;
+		return 1;
+	}
+	Log::Info() << Log::Utilities << "Compiled description of " << data.size() << " bytes read in " << durationRead << "ms." << std::endl;
+	
+	Resources::saveRawDataToExternalFile(outputPath, data.data(), data.size());
+	Log::Info() << Log::Utilities << "Saved compiled description to " << outputPath << "." << std::endl;
+	return 0;
+}
@@ -0,0 +1,147 @@
+#include "Common.hpp"
+#include "Config.hpp"
+#include "helpers/TaskScheduler.hpp"
+#include <map>
+#include <chrono>
+#include <thread>
+
+/**
+ \defgroup TaskSchedulerBenchmark Task Scheduler Benchmark
+ \brief Measure the scaling of the work-stealing task scheduler from one thread to all hardware threads, on balanced and unbalanced parallel loops and on a large number of small tasks, without any GPU work.
+ \ingroup Tools
+ */
+
+/** Perform an amount of integer work on an item.
+ \param item the item index
+ \param iterations the number of hashing iterations
+ \return a hash of the item
+ \ingroup TaskSchedulerBenchmark
+ */
+uint64_t work(size_t item, size_t iterations){
+	uint64_t hash = uint64_t(item) * 0x9E3779B97F4A7C15ull + 1;
+	for(size_t i = 0; i < iterations; ++i){
+		hash ^= hash << 13;
+		hash ^= hash >> 7;
+		hash ^= hash << 17;
+	}
+	return hash;
+}
+
+/** Run a function multiple times and keep the fastest run.
+ \param repeats the number of runs
+ \param func the function to run
+ \return the shortest duration in milliseconds
+ \ingroup TaskSchedulerBenchmark
+ */
+template<typename Function>
+double bestRun(size_t repeats, const Function & func){
+	double best = 0.0;
+	for(size_t rid = 0; rid < repeats; ++rid){
+		const auto start = std::chrono::steady_clock::now();
+		func();
+		const auto end = std::chrono::steady_clock::now();
+		const double duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / 1000000.0;
+		best = (rid == 0) ? duration : std::min(best, duration);
+	}
+	return best;
+}
+
+/** Task scheduler benchmark: optionally expects "-items count" (1000000 by default), "-tasks count" (100000 by default), "-threads count" (hardware thread count by default) and "-repeats count" (5 by default).
+ \param argc the number of input arguments.
+ \param argv a pointer to the raw input arguments.
+ \return a general error code.
+ \ingroup TaskSchedulerBenchmark
+ */
+int main(int argc, char** argv) {
+
+	// Arguments parsing.
+	std::map<std::string, std::vector<std::string>> arguments;
+	Config::parseFromArgs(argc, argv, arguments);
+	const size_t itemCount = arguments.count("items") > 0 ? (size_t)std::stoi(arguments["items"][0]) : 1000000;
+	const size_t taskCount = arguments.count("tasks") > 0 ? (size_t)std::stoi(arguments["tasks"][0]) : 100000;
+	const unsigned int maxThreads = arguments.count("threads") > 0 ? (unsigned int)std::stoi(arguments["threads"][0]) : std::max(1u, std::thread::hardware_concurrency());
+	const size_t repeats = arguments.count("repeats") > 0 ? (size_t)std::stoi(arguments["repeats"][0]) : 5;
+	if(itemCount == 0 || maxThreads == 0 || repeats == 0){
+		Log::Error() << Log::Utilities << "Specify a non-zero number of items, threads and repeats." << std::endl;
+		return 3;
+	}
+	Log::Info() << Log::Utilities << itemCount << " items, " << taskCount << " tasks, up to " << maxThreads << " threads (" << std::thread::hardware_concurrency() << " hardware threads)." << std::endl;
+	
+	// Single-threaded references.
+	uint64_t referenceUniform = 0;
+	uint64_t referenceUnbalanced = 0;
+	for(size_t item = 0; item < itemCount; ++item){
+		referenceUniform += work(item, 64);
+		referenceUnbalanced += work(item, (item * 512) / itemCount);
+	}
+	
+	size_t errors = 0;
+	double baseUniform = 0.0;
+	double baseUnbalanced = 0.0;
+	double baseTasks = 0.0;
+	for(unsigned int threadCount = 1; threadCount <= maxThreads; ++threadCount){
+		TaskScheduler::setup(threadCount);
+		
+		// Balanced loop, each item has the same cost.
+		std::atomic<uint64_t> sumUniform(0);
+		const double durationUniform = bestRun(repeats, [&](){
+			sumUniform = 0;
+			TaskScheduler::parallelFor(0, itemCount, 0, [&sumUniform](size_t begin, size_t end){
+				uint64_t sum = 0;
+				for(size_t item = begin; item < end; ++item){
+					sum += work(item, 64);
+				}
+				sumUniform += sum;
+			});
+		});
+		
+		// Unbalanced loop, the cost of items increases along the range: the last chunks have to be stolen to keep threads busy.
+		std::atomic<uint64_t> sumUnbalanced(0);
+		const double durationUnbalanced = bestRun(repeats, [&](){
+			sumUnbalanced = 0;
+			TaskScheduler::parallelFor(0, itemCount, 1024, [&sumUnbalanced, itemCount](size_t begin, size_t end){
+				uint64_t sum = 0;
+				for(size_t item = begin; item < end; ++item){
+					sum += work(item, (item * 512) / itemCount);
+				}
+				sumUnbalanced += sum;
+			});
+		});
+		
+		// Many small tasks submitted from the calling thread, followed by a continuation.
+		std::atomic<size_t> completed(0);
+		std::atomic<size_t> continued(0);
+		const double durationTasks = bestRun(repeats, [&](){
+			completed = 0;
+			TaskGroup group;
+			for(size_t tid = 0; tid < taskCount; ++tid){
+				group.run([&completed, tid](){
+					if(work(tid, 16) != 0){
+						++completed;
+					}
+				});
+			}
+			group.then([&completed, &continued, taskCount](){
+				continued += (completed == taskCount) ? 1 : 0;
+			});
+			group.wait();
+		});
+		
+		errors += (sumUniform != referenceUniform) ? 1 : 0;
+		errors += (sumUnbalanced != referenceUnbalanced) ? 1 : 0;
+		errors += (continued != repeats) ? 1 : 0;
+		
+		if(threadCount == 1){
+			baseUniform = durationUniform;
+			baseUnbalanced = durationUnbalanced;
+			baseTasks = durationTasks;
+		}
+		// Efficiency is the speedup relative to one thread, divided by the thread count.
+		const double threads = double(threadCount);
+		Log::Info() << Log::Utilities << threadCount << " threads: balanced " << durationUniform << "ms (efficiency " << (baseUniform / durationUniform / threads) << "), unbalanced " << durationUnbalanced << "ms (efficiency " << (baseUnbalanced / durationUnbalanced / threads) << "), small tasks " << (durationTasks * 1000.0 / double(std::max(taskCount, size_t(1)))) << "us per task (efficiency " << (baseTasks / durationTasks / threads) << ")." << std::endl;
+	}
+	TaskScheduler::clean();
+	
+	Log::Info() << Log::Utilities << "Incorrect results: " << errors << "." << std::endl;
+	return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,110 @@
+#include "Common.hpp"
+#include "Config.hpp"
+#include "TransformHierarchy.hpp"
+#include "helpers/GenerationUtilities.hpp"
+#include <map>
+#include <chrono>
+
+/**
+ \defgroup TransformsBenchmark Transforms Benchmark
+ \brief Measure the incremental update of a transformation hierarchy where a few nodes are animated, compared to recomputing all world and normal matrices, without any GPU work.
+ \ingroup Tools
+ */
+
+/** Generate a random transformation.
+ \return a matrix combining a translation, a rotation and a uniform scaling
+ \ingroup TransformsBenchmark
+ */
+glm::mat4 randomTransformation(){
+	const glm::vec3 translation(Random::Float(-1.0f, 1.0f), Random::Float(-1.0f, 1.0f), Random::Float(-1.0f, 1.0f));
+	const glm::vec3 axis = glm::normalize(glm::vec3(Random::Float(-1.0f, 1.0f), Random::Float(0.1f, 1.0f), Random::Float(-1.0f, 1.0f)));
+	const glm::mat4 rotation = glm::rotate(glm::mat4(1.0f), Random::Float(0.0f, 2.0f * float(M_PI)), axis);
+	return glm::scale(glm::translate(glm::mat4(1.0f), translation) * rotation, glm::vec3(Random::Float(0.8f, 1.2f)));
+}
+
+/** Transforms benchmark: optionally expects "-nodes count" (10000 by default), "-animated count" (100 by default) and "-frames count" (1000 by default).
+ \param argc the number of input arguments.
+ \param argv a pointer to the raw input arguments.
+ \return a general error code.
+ \ingroup TransformsBenchmark
+ */
+int main(int argc, char** argv) {
+
+	// Arguments parsing.
+	std::map<std::string, std::vector<std::string>> arguments;
+	Config::parseFromArgs(argc, argv, arguments);
+	const size_t nodeCount = arguments.count("nodes") > 0 ? (size_t)std::stoi(arguments["nodes"][0]) : 10000;
+	const size_t animatedCount = std::min(nodeCount, arguments.count("animated") > 0 ? (size_t)std::stoi(arguments["animated"][0]) : size_t(100));
+	const size_t frameCount = arguments.count("frames") > 0 ? (size_t)std::stoi(arguments["frames"][0]) : 1000;
+	if(nodeCount == 0 || frameCount == 0){
+		Log::Error() << Log::Utilities << "Specify a non-zero number of nodes and frames." << std::endl;
+		return 3;
+	}
+	
+	// Build a random hierarchy: a few roots, each other node attached to a random previous node.
+	Random::seed(42);
+	TransformHierarchy hierarchy;
+	for(size_t nid = 0; nid < nodeCount; ++nid){
+		const TransformHierarchy::Node parent = nid < 4 ? TransformHierarchy::None : TransformHierarchy::Node(Random::Int(0, int(nid) - 1));
+		hierarchy.add(randomTransformation(), parent);
+	}
+	hierarchy.update();
+	std::vector<TransformHierarchy::Node> animated(animatedCount);
+	for(size_t aid = 0; aid < animatedCount; ++aid){
+		animated[aid] = TransformHierarchy::Node(Random::Int(0, int(nodeCount) - 1));
+	}
+	// Each animated node rotates around a random axis.
+	std::vector<glm::mat4> animations(animatedCount);
+	for(size_t aid = 0; aid < animatedCount; ++aid){
+		const glm::vec3 axis = glm::normalize(glm::vec3(Random::Float(-1.0f, 1.0f), Random::Float(0.1f, 1.0f), Random::Float(-1.0f, 1.0f)));
+		animations[aid] = glm::rotate(glm::mat4(1.0f), 0.01f, axis);
+	}
+	
+	// Incremental updates.
+	size_t updatedCount = 0;
+	double durationIncremental = 0.0;
+	for(size_t fid = 0; fid < frameCount; ++fid){
+		const auto start = std::chrono::steady_clock::now();
+		for(size_t aid = 0; aid < animatedCount; ++aid){
+			const TransformHierarchy::Node node = animated[aid];
+			hierarchy.setLocal(node, animations[aid] * hierarchy.local(node));
+		}
+		updatedCount += hierarchy.update();
+		const auto end = std::chrono::steady_clock::now();
+		durationIncremental += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / 1000.0;
+	}
+	Log::Info() << Log::Utilities << "Incremental: " << (durationIncremental / double(frameCount)) << "us per frame, " << (updatedCount / frameCount) << " nodes updated per frame out of " << nodeCount << "." << std::endl;
+	
+	// Full recomputation of all world and normal matrices, as a reference.
+	std::vector<glm::mat4> worlds(nodeCount);
+	std::vector<glm::mat3> normals(nodeCount);
+	double durationFull = 0.0;
+	for(size_t fid = 0; fid < frameCount; ++fid){
+		const auto start = std::chrono::steady_clock::now();
+		for(size_t nid = 0; nid < nodeCount; ++nid){
+			const TransformHierarchy::Node parent = hierarchy.parent(TransformHierarchy::Node(nid));
+			const glm::mat4 & local = hierarchy.local(TransformHierarchy::Node(nid));
+			worlds[nid] = parent == TransformHierarchy::None ? local : worlds[parent] * local;
+			normals[nid] = glm::transpose(glm::inverse(glm::mat3(worlds[nid])));
+		}
+		const auto end = std::chrono::steady_clock::now();
+		durationFull += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / 1000.0;
+	}
+	Log::Info() << Log::Utilities << "Full: " << (durationFull / double(frameCount)) << "us per frame." << std::endl;
+	
+	// Compare the final state with the reference.
+	float maxError = 0.0f;
+	for(size_t nid = 0; nid < nodeCount; ++nid){
+		const TransformHierarchy::Node node = TransformHierarchy::Node(nid);
+		for(int c = 0; c < 4; ++c){
+			const glm::vec4 delta = glm::abs(hierarchy.world(node)[c] - worlds[nid][c]) / (glm::abs(worlds[nid][c]) + 1.0f);
+			maxError = std::max(maxError, std::max(std::max(delta.x, delta.y), std::max(delta.z, delta.w)));
+		}
+		for(int c = 0; c < 3; ++c){
+			const glm::vec3 delta = glm::abs(hierarchy.normalMatrix(node)[c] - normals[nid][c]) / (glm::abs(normals[nid][c]) + 1.0f);
+			maxError = std::max(maxError, std::max(std::max(delta.x, delta.y), delta.z));
+		}
+	}
+	Log::Info() << Log::Utilities << "Maximum relative difference with the full recomputation: " << maxError << "." << std::endl;
+	return maxError < 1e-3f ? 0 : 1;
+}